@@ -87,6 +87,8 @@ void FFMPEG::SetupCodec(const char *filename, int codec_id)
 	int ret;
 	m_sws_flags = SWS_BICUBIC;
 	m_frame_count=0;
+	m_last_seconds=0;
+	m_time_offset=0;
 	
 	//You must call these subroutines otherwise you get errors!!
 	avcodec_register_all();
@@ -234,6 +236,19 @@ void FFMPEG::SetupCodec(const char *filename, int codec_id)
 //-----------------------------
 void FFMPEG::WriteFrame(void){
 
+	EncodeFrame(m_src_picture.data, m_src_picture.linesize);
+}
+
+
+
+//=============================
+// Encode Video Frame
+//-----------------------------
+// Converts an RGB24 picture to YUV and encodes it. The source is
+// read in place, so callers don't need to stage it in m_src_picture
+//-----------------------------
+void FFMPEG::EncodeFrame(const uint8_t * const Src[], const int SrcStride[]){
+
 	//If video is not initalised then don't write frame
 	if (!m_AVIMutex) {return;}
 
@@ -242,23 +257,13 @@ void FFMPEG::WriteFrame(void){
 
 	//Inits
 	int ret;
-	static struct SwsContext *sws_ctx;
 	AVCodecContext *c = m_video_st->codec;
 
-	//If we haven't already done so init the context of the frame conversion from RGB to YUV
-	if (!sws_ctx) {
-		sws_ctx = sws_getContext(c->width, c->height, AV_PIX_FMT_RGB24,
-									c->width, c->height, AV_PIX_FMT_YUV420P,
-									sws_flags, NULL, NULL, NULL);
-		if (!sws_ctx) {
-			return;
-		}
+	//Convert RGB frame (Src) to and YUV frame (m_dst_picture), in bands spread over the worker pool
+	if (!m_yuv.convert(Src[0], SrcStride[0], m_dst_picture.data, m_dst_picture.linesize,
+						c->width, c->height, sws_flags, NULL)) {
+		return;
 	}
-
-	//Convert RGB frame (m_src_picture) to and YUV frame (m_dst_picture)
-	sws_scale(sws_ctx,
-				m_src_picture.data, m_src_picture.linesize,
-				0, c->height, m_dst_picture.data, m_dst_picture.linesize);
 	
 	
 	//Some inits for encoding the frame
@@ -406,23 +411,52 @@ void FFMPEG::WriteDummyFrame(){
 //-----------------------------
 // Processes an RGB frame supplied by the user
 //-----------------------------
-void FFMPEG::WriteFrame(unsigned char * RGBFrame) {
+void FFMPEG::WriteFrame(const unsigned char * RGBFrame) {
 	
 	//Data should be in the format RGBRGBRGB...etc and should be Width*Height*3 long
-	
-	//Step through height of frame
-	for (int y=0;y<m_c->height;y++) {  //Height Loop
 
-		//Step through width of frame
-		for (int x=0;x<m_c->width;x++) { //Width Loop
+	//If video is not initalised then don't write frame
+	if (!m_AVIMutex) {return;}
 
-			//Save RGB frame to FFMPEG's source frame
-			m_src_picture.data[0][y * m_src_picture.linesize[0] + x*3+0] = RGBFrame[(y*m_c->width+x)*3+0];  //Red Channel
-			m_src_picture.data[0][y * m_src_picture.linesize[0] + x*3+1] = RGBFrame[(y*m_c->width+x)*3+1];  //Green Channel
-			m_src_picture.data[0][y * m_src_picture.linesize[0] + x*3+2] = RGBFrame[(y*m_c->width+x)*3+2];  //Blue Channel
-		}
-	}
+	//Hand the caller's frame straight to the RGB to YUV conversion, no staging copy
+	const uint8_t * Src[4] = {RGBFrame, NULL, NULL, NULL};
+	int SrcStride[4] = {m_c->width*3, 0, 0, 0};
 
 	//Send frame off to FFMPEG for encoding
-	WriteFrame();
+	EncodeFrame(Src, SrcStride);
+}
+
+
+
+//=============================
+// Write Frame At
+//-----------------------------
+// Processes an RGB frame captured Seconds after the start of the
+// video. The frame is repeated until the video's timeline reaches its
+// capture time, and dropped if the timeline is already past it, so
+// playback runs at the speed the frames were captured at. A capture
+// clock that goes backwards (camera reset or reconnected) or jumps more
+// than a second ahead (e.g. falling back to host time) is rebased onto
+// the frames already written, so at most a second of copies is added
+//-----------------------------
+void FFMPEG::WriteFrame(const unsigned char * RGBFrame, double Seconds) {
+
+	//If video is not initalised then don't write frame
+	if (!m_AVIMutex) {return;}
+
+	//Index of the video frame the capture time falls on
+	int target = (int)((Seconds + m_time_offset) * m_AVIMOV_FPS);
+	if (Seconds < m_last_seconds || target > m_frame_count + m_AVIMOV_FPS) {
+		m_time_offset = (double)m_frame_count / m_AVIMOV_FPS - Seconds;
+		target = m_frame_count;
+	}
+	m_last_seconds = Seconds;
+
+	while (m_frame_count <= target) {
+		int before = m_frame_count;
+		WriteFrame(RGBFrame);
+
+		//Encoder failed, don't spin on it
+		if (m_frame_count == before) {return;}
+	}
 }
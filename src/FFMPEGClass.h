@@ -62,6 +62,8 @@ extern "C" {
 	static int sws_flags = SWS_BICUBIC;
 }
 
+#include <yuvconverter.h>
+
 //=============================
 // FFMPEG Class
 //-----------------------------
@@ -77,7 +79,8 @@ public:
 
 	void SetupVideo(char * filename, int Width, int Height, int FPS, int GOB, int BitPerSecond);
 	void WriteDummyFrame();
-    void WriteFrame(unsigned char * RGBFrame);
+    void WriteFrame(const unsigned char * RGBFrame);
+	void WriteFrame(const unsigned char * RGBFrame, double Seconds);
 	void CloseVideo(void);
 	
 	int GetVideoWidth(void) {return m_AVIMOV_WIDTH;}
@@ -93,6 +96,8 @@ private:
 	int	m_AVIMOV_GOB;
 	int	m_AVIMOV_BPS;
 	int m_frame_count;
+	double m_last_seconds;
+	double m_time_offset;
 	int	m_AVIMOV_WIDTH;
 	int	m_AVIMOV_HEIGHT;
 
@@ -104,6 +109,7 @@ private:
 
 	void CloseCodec(void);
 	void WriteFrame(void);
+	void EncodeFrame(const uint8_t * const Src[], const int SrcStride[]);
 	void SetupCodec(const char *filename, int codec_id);
 
 	AVFrame *m_frame;
@@ -114,4 +120,7 @@ private:
 	AVCodec *m_video_codec;
     AVPicture m_src_picture, m_dst_picture;
 
+	//RGB to YUV conversion, one swscale context per band of rows
+	YuvConverter m_yuv;
+
 };
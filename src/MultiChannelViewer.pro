@@ -5,7 +5,7 @@
 #-------------------------------------------------
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = MultiChannelViewer
 TEMPLATE = app
@@ -17,12 +17,56 @@ SOURCES += main.cpp\
         multichannelviewer.cpp \
     camera.cpp \
     FFMPEGClass.cpp \
-    autoexpose.cpp
+    autoexpose.cpp \
+    framepool.cpp \
+    frameinfo.cpp \
+    bandwidthmanager.cpp \
+    packetprobe.cpp \
+    cameraregistry.cpp \
+    framepairer.cpp \
+    syntheticcamera.cpp \
+    rawrecorder.cpp \
+    replaysource.cpp \
+    attributequeue.cpp \
+    attributesnapshot.cpp \
+    circledetector.cpp \
+    medianfilter.cpp \
+    workerpool.cpp \
+    imagekernels.cpp \
+    yuvconverter.cpp \
+    temporalfilter.cpp \
+    defectmap.cpp \
+    bayerdemosaic.cpp \
+    framesource.cpp \
+    frameprocessor.cpp
 
 HEADERS  += multichannelviewer.h \
     camera.h \
     FFMPEGClass.h \
-    autoexpose.h
+    autoexpose.h \
+    framepool.h \
+    frameinfo.h \
+    bandwidthmanager.h \
+    packetprobe.h \
+    cameraregistry.h \
+    framepairer.h \
+    framesource.h \
+    frameformat.h \
+    syntheticcamera.h \
+    rawrecorder.h \
+    replaysource.h \
+    attributequeue.h \
+    attributesnapshot.h \
+    circledetector.h \
+    medianfilter.h \
+    workerpool.h \
+    imagekernels.h \
+    yuvconverter.h \
+    temporalfilter.h \
+    defectmap.h \
+    bayerdemosaic.h \
+    demosaicreference.h \
+    frameprocessor.h
 
 
 FORMS    += multichannelviewer.ui
@@ -31,12 +75,27 @@ DISTFILES += \
     README.md
 
 
+#Linux: there is no PvAPI build for it here, so it runs synthetic cameras and recordings only
+unix:!macx {
+    CONFIG += nopvapi link_pkgconfig
+    PKGCONFIG += libavcodec libavformat libavutil libswresample libswscale
+}
+
+#Without PvAPI (qmake CONFIG+=nopvapi): the camera backend is left out, --synthetic and --replay still work
+nopvapi {
+    DEFINES += NO_PVAPI
+    SOURCES -= camera.cpp attributesnapshot.cpp
+    HEADERS -= camera.h attributesnapshot.h
+}
+
 #Windows Libraries and Settings
 win32 {
     contains(QT_ARCH, i386) {
-        INCLUDEPATH += $$PWD/lib/x86/win32/include/PvAPI
-        DEPENDPATH += $$PWD/lib/x86/win32/include/PvAPI
-        LIBS += -L$$PWD/lib/x86/win32/ -lPvAPI
+        !nopvapi {
+            INCLUDEPATH += $$PWD/lib/x86/win32/include/PvAPI
+            DEPENDPATH += $$PWD/lib/x86/win32/include/PvAPI
+            LIBS += -L$$PWD/lib/x86/win32/ -lPvAPI
+        }
 
 
         INCLUDEPATH += $$PWD/lib/x86/win32/include
@@ -68,10 +127,12 @@ macx {
         LIBS += -lbz2.1.0
         LIBS += -liconv
 
-        INCLUDEPATH += $$PWD/lib/x64/osx/include/PvAPI
-        DEPENDPATH += $$PWD/lib/x64/osx/include/PvAPI
-        LIBS += -L$$PWD/lib/x64/osx -lPvAPI
-        PRE_TARGETDEPS += $$PWD/lib/x64/osx/libPvAPI.a
+        !nopvapi {
+            INCLUDEPATH += $$PWD/lib/x64/osx/include/PvAPI
+            DEPENDPATH += $$PWD/lib/x64/osx/include/PvAPI
+            LIBS += -L$$PWD/lib/x64/osx -lPvAPI
+            PRE_TARGETDEPS += $$PWD/lib/x64/osx/libPvAPI.a
+        }
 
         INCLUDEPATH += $$PWD/lib/x64/osx/include
         DEPENDPATH += $$PWD/lib/x64/osx/include
@@ -0,0 +1,86 @@
+#include "attributequeue.h"
+
+#include <frameinfo.h>
+
+AttributeQueue::AttributeQueue()
+{
+    this->Coalesced = 0;
+}
+
+void AttributeQueue::post(const QString &name, unsigned long value)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Requested.insert(name, value);
+
+    int waiting = -1;
+    for (int i = 0; i < this->Pending.count(); i++)
+        if (this->Pending[i].Name == name)
+            waiting = i;
+
+    /// Back to what the camera already has: nothing to write, and a waiting change is void
+    if (this->Written.contains(name) && this->Written.value(name) == value)
+    {
+        if (waiting >= 0)
+            this->Pending.remove(waiting);
+        this->Coalesced++;
+        return;
+    }
+
+    if (waiting >= 0)
+    {
+        this->Pending[waiting].Value = value;
+        this->Pending[waiting].Requested = hostTimeUs();
+        this->Coalesced++;
+        return;
+    }
+
+    AttributeChange change;
+    change.Name = name;
+    change.Value = value;
+    change.Requested = hostTimeUs();
+    this->Pending.append(change);
+}
+
+QVector<AttributeChange> AttributeQueue::take()
+{
+    QMutexLocker locker(&this->Mutex);
+    QVector<AttributeChange> changes = this->Pending;
+    this->Pending.clear();
+    return changes;
+}
+
+void AttributeQueue::written(const QString &name, unsigned long value)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Written.insert(name, value);
+
+    /// A value posted since is still the one asked for
+    for (int i = 0; i < this->Pending.count(); i++)
+        if (this->Pending[i].Name == name)
+            return;
+    this->Requested.insert(name, value);
+}
+
+void AttributeQueue::invalidate()
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Written.clear();
+}
+
+unsigned long AttributeQueue::requested(const QString &name, unsigned long fallback)
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Requested.value(name, fallback);
+}
+
+int AttributeQueue::pending()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Pending.count();
+}
+
+unsigned long AttributeQueue::coalesced()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Coalesced;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The AttributeQueue class collects camera attribute writes from any
+ * thread so the camera's own thread can apply them between frames. Only
+ * the latest value asked for each attribute is kept, and a value equal to
+ * the one the camera already has is dropped, so a slider dragged across
+ * fifty positions or an autoexposure loop that settles costs at most one
+ * write per frame.
+ */
+
+#ifndef ATTRIBUTEQUEUE_H
+#define ATTRIBUTEQUEUE_H
+
+#include <QMutex>
+#include <QVector>
+#include <QHash>
+#include <QString>
+
+/**
+ * @brief An attribute write waiting for, or applied by, the camera thread
+ */
+struct AttributeChange
+{
+    QString         Name;           //!< PvAPI attribute name, e.g. "ExposureValue"
+    unsigned long   Value;          //!< Value asked for
+    qint64          Requested;      //!< Host time (us) of the latest post() for this attribute, see hostTimeUs()
+};
+
+class AttributeQueue
+{
+public:
+
+    AttributeQueue();
+
+    /**
+     * @brief Asks for an attribute to be written. Thread-safe, never blocks on the camera
+     *
+     * Replaces a value still waiting for the same attribute. A value equal to the one last
+     * written is dropped, and cancels a different value still waiting.
+     *
+     * @param name PvAPI attribute name
+     * @param value Value to write
+     */
+    void post(const QString &name, unsigned long value);
+
+    /**
+     * @brief Removes and returns the waiting writes, in the order their attributes were first posted
+     */
+    QVector<AttributeChange> take();
+
+    /**
+     * @brief Records the value the camera now has, so posting it again is a no-op
+     *
+     * Called after a write succeeded, and for values written outside the queue (e.g. in
+     * captureSetup()). Does not touch a value still waiting for the attribute.
+     */
+    void written(const QString &name, unsigned long value);
+
+    /**
+     * @brief Forgets every value written, so the next post() of each attribute goes through
+     *
+     * For when the camera may have lost its settings, e.g. after it was reopened.
+     */
+    void invalidate();
+
+    /**
+     * @brief Gets the value last asked for an attribute. Thread-safe
+     *
+     * That is the value last posted, or the one last recorded by written() if nothing has
+     * been posted since. invalidate() leaves it alone.
+     *
+     * @param fallback Returned if the attribute was never posted or written
+     */
+    unsigned long requested(const QString &name, unsigned long fallback);
+
+    /**
+     * @brief Gets the number of writes waiting
+     */
+    int pending();
+
+    /**
+     * @brief Gets the number of posts that were merged into a waiting write or dropped as no-ops
+     */
+    unsigned long coalesced();
+
+private:
+
+    QMutex          Mutex;          //!< Guards everything below
+    QVector<AttributeChange> Pending; //!< Waiting writes, at most one per attribute
+    QHash<QString, unsigned long> Written; //!< Last value the camera accepted, by attribute
+    QHash<QString, unsigned long> Requested; //!< Value last asked for, by attribute, see requested()
+    unsigned long   Coalesced;      //!< See coalesced()
+};
+
+#endif // ATTRIBUTEQUEUE_H
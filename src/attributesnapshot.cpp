@@ -0,0 +1,202 @@
+#include "attributesnapshot.h"
+
+AttributeSnapshot::AttributeSnapshot()
+{
+    this->Handle = NULL;
+}
+
+bool AttributeSnapshot::load(tPvHandle handle)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Handle = handle;
+    this->Entries.clear();
+
+    tPvAttrListPtr list;
+    unsigned long length = 0;
+    if (PvAttrList(handle, &list, &length) != ePvErrSuccess)
+        return false;
+
+    /// Attribute information comes from the driver. Only the constant values cost a round trip
+    for (unsigned long i = 0; i < length; i++)
+    {
+        tPvAttributeInfo info;
+        if (PvAttrInfo(handle, list[i], &info) != ePvErrSuccess)
+            continue;
+
+        AttributeEntry entry;
+        entry.Datatype = info.Datatype;
+        entry.Flags = info.Flags;
+        entry.Loaded = false;
+        entry.Number = 0;
+        entry.HasRange = false;
+        entry.Minimum = 0;
+        entry.Maximum = 0;
+
+        QString name(list[i]);
+        if ((entry.Flags & ePvFlagConst) && (entry.Flags & ePvFlagRead))
+            read(name, entry);
+        this->Entries.insert(name, entry);
+    }
+    return true;
+}
+
+void AttributeSnapshot::invalidate()
+{
+    QMutexLocker locker(&this->Mutex);
+    QList<QString> names = this->Entries.keys();
+    for (int i = 0; i < names.count(); i++)
+    {
+        AttributeEntry &entry = this->Entries[names[i]];
+        if (!(entry.Flags & ePvFlagConst))
+        {
+            entry.Loaded = false;
+            entry.HasRange = false;
+        }
+    }
+}
+
+bool AttributeSnapshot::isLoaded()
+{
+    QMutexLocker locker(&this->Mutex);
+    return !this->Entries.isEmpty();
+}
+
+bool AttributeSnapshot::contains(const QString &name)
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Entries.contains(name);
+}
+
+bool AttributeSnapshot::isWritable(const QString &name)
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Entries.contains(name) && (this->Entries[name].Flags & ePvFlagWrite);
+}
+
+QString AttributeSnapshot::text(const QString &name, const QString &fallback)
+{
+    QMutexLocker locker(&this->Mutex);
+    AttributeEntry* entry = fetch(name);
+    if (!entry || (entry->Datatype != ePvDatatypeString && entry->Datatype != ePvDatatypeEnum))
+        return fallback;
+    return entry->Text;
+}
+
+unsigned long AttributeSnapshot::uint32(const QString &name, unsigned long fallback)
+{
+    QMutexLocker locker(&this->Mutex);
+    AttributeEntry* entry = fetch(name);
+    if (!entry || entry->Datatype != ePvDatatypeUint32)
+        return fallback;
+    return static_cast<unsigned long>(entry->Number);
+}
+
+double AttributeSnapshot::number(const QString &name, double fallback)
+{
+    QMutexLocker locker(&this->Mutex);
+    AttributeEntry* entry = fetch(name);
+    if (!entry || entry->Datatype == ePvDatatypeString || entry->Datatype == ePvDatatypeEnum)
+        return fallback;
+    return entry->Number;
+}
+
+bool AttributeSnapshot::range(const QString &name, unsigned long *minimum, unsigned long *maximum)
+{
+    QMutexLocker locker(&this->Mutex);
+    if (!this->Entries.contains(name) || this->Entries[name].Datatype != ePvDatatypeUint32)
+        return false;
+
+    AttributeEntry &entry = this->Entries[name];
+    if (!entry.HasRange)
+    {
+        tPvUint32 low = 0;
+        tPvUint32 high = 0;
+        if (PvAttrRangeUint32(this->Handle, name.toLatin1().constData(), &low, &high) != ePvErrSuccess)
+            return false;
+        entry.Minimum = low;
+        entry.Maximum = high;
+        entry.HasRange = !(entry.Flags & ePvFlagVolatile);
+    }
+    *minimum = entry.Minimum;
+    *maximum = entry.Maximum;
+    return true;
+}
+
+void AttributeSnapshot::update(const QString &name, unsigned long value)
+{
+    QMutexLocker locker(&this->Mutex);
+    if (!this->Entries.contains(name) || (this->Entries[name].Flags & ePvFlagVolatile))
+        return;
+    this->Entries[name].Number = value;
+    this->Entries[name].Loaded = true;
+}
+
+bool AttributeSnapshot::read(const QString &name, AttributeEntry &entry)
+{
+    QByteArray key = name.toLatin1();
+    const char* attribute = key.constData();
+    char buffer[SNAPSHOT_STRING_SIZE];
+    tPvErr err = ePvErrWrongType;
+
+    switch (entry.Datatype)
+    {
+    case ePvDatatypeString:
+        err = PvAttrStringGet(this->Handle, attribute, buffer, SNAPSHOT_STRING_SIZE, NULL);
+        break;
+    case ePvDatatypeEnum:
+        err = PvAttrEnumGet(this->Handle, attribute, buffer, SNAPSHOT_STRING_SIZE, NULL);
+        break;
+    case ePvDatatypeUint32:
+    {
+        tPvUint32 value = 0;
+        err = PvAttrUint32Get(this->Handle, attribute, &value);
+        entry.Number = value;
+        break;
+    }
+    case ePvDatatypeFloat32:
+    {
+        tPvFloat32 value = 0;
+        err = PvAttrFloat32Get(this->Handle, attribute, &value);
+        entry.Number = value;
+        break;
+    }
+    case ePvDatatypeInt64:
+    {
+        tPvInt64 value = 0;
+        err = PvAttrInt64Get(this->Handle, attribute, &value);
+        entry.Number = static_cast<double>(value);
+        break;
+    }
+    case ePvDatatypeBoolean:
+    {
+        tPvBoolean value = 0;
+        err = PvAttrBooleanGet(this->Handle, attribute, &value);
+        entry.Number = value;
+        break;
+    }
+    default:
+        return false;   //!< Commands and raw data have no value to keep
+    }
+
+    if (err != ePvErrSuccess)
+        return false;
+    if (entry.Datatype == ePvDatatypeString || entry.Datatype == ePvDatatypeEnum)
+    {
+        buffer[SNAPSHOT_STRING_SIZE - 1] = '\0';
+        entry.Text = QString(buffer);
+    }
+    entry.Loaded = true;
+    return true;
+}
+
+AttributeEntry* AttributeSnapshot::fetch(const QString &name)
+{
+    if (!this->Entries.contains(name))
+        return NULL;
+
+    AttributeEntry &entry = this->Entries[name];
+    bool current = entry.Loaded && !(entry.Flags & ePvFlagVolatile);
+    if (!current && ((entry.Flags & ePvFlagRead) == 0 || !read(name, entry)))
+        return NULL;
+    return &entry;
+}
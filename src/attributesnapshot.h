@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The AttributeSnapshot class keeps a camera's attributes in memory, so
+ * questions like "is this the NIR camera" or "does it support binning"
+ * don't cost a GigE round trip each time they are asked.
+ *
+ * load() walks PvAttrList() once when the camera is opened. Every
+ * attribute's type and access flags are kept, and the values of constant
+ * attributes (part number, serial number, sensor size, clock frequency...)
+ * are read straight away. Other values are read the first time they are
+ * asked for and kept until invalidate(). Volatile attributes, which the
+ * camera may change on its own, are always read from the camera.
+ */
+
+#ifndef ATTRIBUTESNAPSHOT_H
+#define ATTRIBUTESNAPSHOT_H
+
+#define SNAPSHOT_STRING_SIZE 64     //!< Longest string or enum value kept, terminator included
+
+#include <QMutex>
+#include <QHash>
+#include <QString>
+#include <PvAPI/PvApi.h>
+
+/**
+ * @brief What the snapshot knows about one attribute
+ */
+struct AttributeEntry
+{
+    tPvDatatype     Datatype;       //!< Type reported by PvAttrInfo()
+    unsigned long   Flags;          //!< Combination of tPvAttributeFlags
+    bool            Loaded;         //!< True once Text or Number holds the camera's value
+    QString         Text;           //!< Value of a string or enum attribute
+    double          Number;         //!< Value of a numeric or boolean attribute
+    bool            HasRange;       //!< True once Minimum and Maximum have been read (Uint32 only)
+    unsigned long   Minimum;        //!< Smallest value the camera accepts
+    unsigned long   Maximum;        //!< Largest value the camera accepts
+};
+
+class AttributeSnapshot
+{
+public:
+
+    AttributeSnapshot();
+
+    /**
+     * @brief Lists the camera's attributes and reads every constant one
+     *
+     * Replaces whatever was loaded before, e.g. after the camera was reopened.
+     *
+     * @param handle Open camera
+     * @return true if the attribute list could be read, false otherwise
+     */
+    bool load(tPvHandle handle);
+
+    /**
+     * @brief Forgets every value read so far, except those of constant attributes
+     *
+     * The next query of each attribute reads it from the camera again.
+     */
+    void invalidate();
+
+    /**
+     * @brief Checks if load() succeeded
+     */
+    bool isLoaded();
+
+    /**
+     * @brief Checks if the camera has an attribute
+     */
+    bool contains(const QString &name);
+
+    /**
+     * @brief Checks if an attribute exists and may be written
+     */
+    bool isWritable(const QString &name);
+
+    /**
+     * @brief Gets a string or enum attribute
+     * @param fallback Returned if the attribute doesn't exist or can't be read
+     */
+    QString text(const QString &name, const QString &fallback = QString());
+
+    /**
+     * @brief Gets a Uint32 attribute
+     * @param fallback Returned if the attribute doesn't exist or can't be read
+     */
+    unsigned long uint32(const QString &name, unsigned long fallback = 0);
+
+    /**
+     * @brief Gets a numeric (Uint32, Float32, Int64) or boolean attribute
+     * @param fallback Returned if the attribute doesn't exist or can't be read
+     */
+    double number(const QString &name, double fallback = 0);
+
+    /**
+     * @brief Gets the values a Uint32 attribute accepts
+     * @return true if minimum and maximum were filled in, false otherwise
+     */
+    bool range(const QString &name, unsigned long *minimum, unsigned long *maximum);
+
+    /**
+     * @brief Records a value just written to the camera, so it needn't be read back
+     */
+    void update(const QString &name, unsigned long value);
+
+private:
+
+    /**
+     * @brief Reads an attribute's value from the camera into its entry. Mutex must be held
+     * @return true if the value was read
+     */
+    bool read(const QString &name, AttributeEntry &entry);
+
+    /**
+     * @brief Finds an attribute and makes sure its value is current. Mutex must be held
+     * @return The entry, NULL if the attribute doesn't exist or can't be read
+     */
+    AttributeEntry* fetch(const QString &name);
+
+    QMutex          Mutex;          //!< Guards everything below, queries come from several threads
+    tPvHandle       Handle;         //!< Camera the snapshot was loaded from, NULL before load()
+    QHash<QString, AttributeEntry> Entries; //!< Every attribute of the camera, by name
+};
+
+#endif // ATTRIBUTESNAPSHOT_H
@@ -1,11 +1,73 @@
 #include "autoexpose.h"
 
-AutoExpose::AutoExpose(Camera *Cam1, Camera *Cam2, QObject *parent) : QObject(parent)
+AutoExpose::AutoExpose(FrameSource *Cam1, FrameSource *Cam2, QObject *parent) : QObject(parent)
 {
     this->Cam1 = Cam1;
     this->Cam2 = Cam2;
     this->exposure_WL = 80000;
     this->exposure_NIR = 300000;
+    this->TargetFPS = 0;
+    this->Binning = 1;
+    this->Starved = 0;
+    this->Recovered = 0;
+    this->Waited_WL = 0;
+    this->Waited_NIR = 0;
+}
+
+void AutoExpose::setTargetFPS(double fps)
+{
+    this->TargetFPS = fps;
+}
+
+unsigned int AutoExpose::adaptBinning(FrameSource *cam, unsigned int exposure, unsigned int ceiling)
+{
+    /// Only bin up while the ceiling is what holds the image back, and only bin down with room to
+    /// spare, so the camera does not flip between two factors
+    if (exposure >= ceiling && this->Binning < AUTOEXPOSURE_MAX_BINNING)
+    {
+        this->Recovered = 0;
+        if (++this->Starved >= AUTOEXPOSURE_BINNING_PATIENCE && cam->setBinning(this->Binning*2))
+        {
+            this->Binning *= 2;
+            this->Starved = 0;
+            return exposure / 2;    //!< Twice the frame rate, and 2x2 pixels still gather twice the light
+        }
+    }
+    else if (this->Binning > 1 && exposure*4.0 <= ceiling*AUTOEXPOSURE_UNBIN_MARGIN)
+    {
+        this->Starved = 0;
+        if (++this->Recovered >= AUTOEXPOSURE_BINNING_PATIENCE && cam->setBinning(this->Binning/2))
+        {
+            this->Binning /= 2;
+            this->Recovered = 0;
+            return exposure * 4;    //!< Same brightness from a quarter of the pixel area
+        }
+    }
+    else
+    {
+        this->Starved = 0;
+        this->Recovered = 0;
+    }
+    return exposure;
+}
+
+bool AutoExpose::settled(const FrameInfo &info, unsigned int &asked, int &waited)
+{
+    if (info.ExposureValue == 0)
+        return true;    //!< The source doesn't know, nothing to wait for
+
+    unsigned long difference = (info.ExposureValue > asked) ? info.ExposureValue - asked : asked - info.ExposureValue;
+    if (difference <= asked*AUTOEXPOSURE_SETTLE_TOLERANCE)
+    {
+        waited = 0;
+        return true;
+    }
+    if (++waited < AUTOEXPOSURE_SETTLE_FRAMES)
+        return false;
+
+    asked = info.ExposureValue;
+    waited = 0;
+    return true;
 }
 
 void AutoExpose::ChangeExposure_WL(unsigned int new_exposure)
@@ -18,13 +80,12 @@ void AutoExpose::ChangeExposure_NIR(unsigned int new_exposure)
     this->exposure_NIR = new_exposure;
 }
 
-void AutoExpose::AutoExposure_Two_Cams(QImage *Cam1_Image, unsigned char *Cam2_Image_Raw)
+void AutoExpose::AutoExposure_Two_Cams(QImage Cam1_Image, FrameBuffer Cam2_Image_Raw, FrameInfo Cam1_Info, FrameInfo Cam2_Info)
 {
     /// The algorithm used here is relatively complex, and functions as a self-correcting algorithm.
-    /// The first step is to acquire the latest two frames from the cameras. Since the latest frame
-    /// is constantly updating, mutexes are put in place to prevent the data from updating until the
-    /// frame data has been copied to local storage (freeing access to the lastest frame data as early
-    /// as possible)
+    /// The first step is to acquire the latest two frames from the cameras. Both are shared handles
+    /// to pooled buffers: the render path has moved on to new buffers for the next frame, so these
+    /// can be read in place without copying them to local storage first.
     ///
     /// Afterwards, the next step is to convert both frames into a quantifiable scalar format for comparison.
     /// The easiest way to do that is by comparing their intensities. The NIR image is in a 16-bit Monochrome
@@ -72,42 +133,36 @@ void AutoExpose::AutoExposure_Two_Cams(QImage *Cam1_Image, unsigned char *Cam2_I
     /// Limits are set to ensure that the new exposure never increases or decreases by more than 30%.
     /// Additional lower and upper bounds are set individually for the WL camera and NIR camera to ensure
     /// that their corresponding exposure times never goes below or above certain values
+    ///
+    /// A camera whose frame was taken before its last change is left alone until its frames catch up,
+    /// so one change isn't made twice from the same stale image.
 
-    unsigned short* Image_WL_data = new unsigned short[HEIGHT*WIDTH];
-    unsigned short* Image_NIR_data = new unsigned short[HEIGHT*WIDTH];
-
-    //Mutex1.lock();
-    //QMutexLocker *Locker = new QMutexLocker(&Mutex1);
-    QImage Image_WL = Cam1_Image->copy();
-    //delete Locker;
-    //Mutex1.unlock();
+    if (Cam1_Image.isNull() || Cam2_Image_Raw.isNull())
+        return;
 
-    //Mutex2.lock();
-    //Locker = new QMutexLocker(&Mutex2);
-    std::memcpy(Image_NIR_data, Cam2_Image_Raw, HEIGHT*WIDTH*2);
-    //delete Locker;
-    //Mutex2.unlock();
+    bool settled_WL = settled(Cam1_Info, this->exposure_WL, this->Waited_WL);
+    bool settled_NIR = settled(Cam2_Info, this->exposure_NIR, this->Waited_NIR);
+    if (!settled_WL && !settled_NIR)
+        return;
 
-    unsigned char* Image_WL_Original = Image_WL.bits();
-    for (int i = 0; i < Image_WL.height()*Image_WL.width(); i++)
-    {
-        double r = Image_WL_Original[0];
-        double g = Image_WL_Original[1];
-        double b = Image_WL_Original[2];
-        Image_WL_data[i] = static_cast<unsigned short>((0.21*r + 0.72*g + 0.07*b)*16); //!< Converts WL RGB 24-bit to 16-bit Mono
-        Image_WL_Original = Image_WL_Original + 3;
-    }
+    const unsigned char* Image_WL_Original = Cam1_Image.constBits();
+    const unsigned short* Image_NIR_data = reinterpret_cast<const unsigned short*>(Cam2_Image_Raw.data());
 
     int Histogram_WL[4096] = {0};
     //int Histogram_NIR[4096] = {0};
     int Histogram_NIR[65535] = {0};
     int pixel_count = 0;
 
-    for (int i = 0; i < Image_WL.height()*Image_WL.width(); i++)
+    for (int i = 0; i < Cam1_Image.height()*Cam1_Image.width(); i++)
     {
-        if (Image_WL_data[i] > 32)
+        double r = Image_WL_Original[0];
+        double g = Image_WL_Original[1];
+        double b = Image_WL_Original[2];
+        unsigned short WL = static_cast<unsigned short>((0.21*r + 0.72*g + 0.07*b)*16); //!< Converts WL RGB 24-bit to 16-bit Mono
+        Image_WL_Original = Image_WL_Original + 3;
+
+        if (WL > 32)
         {
-            unsigned short WL = static_cast<unsigned short>(Image_WL_data[i]);
             Histogram_WL[WL]++;
             unsigned short NIR = static_cast<unsigned short>(Image_NIR_data[i]);
             Histogram_NIR[NIR]++;
@@ -163,46 +218,51 @@ void AutoExpose::AutoExposure_Two_Cams(QImage *Cam1_Image, unsigned char *Cam2_I
     //if (new_exposure_WL > 550000)
     //    new_exposure_WL = 550000;
 
+    unsigned int ceiling_NIR = 550000;
+    if (this->TargetFPS > 0)
+    {
+        ceiling_NIR = qMin(ceiling_NIR, static_cast<unsigned int>(1000000.0 / this->TargetFPS));
+        if (settled_NIR)
+            new_exposure_NIR = adaptBinning(Cam2, new_exposure_NIR, ceiling_NIR);
+    }
+
     if (new_exposure_NIR < 100)
         new_exposure_NIR = 100;
-    if (new_exposure_NIR > 550000)
-        new_exposure_NIR = 550000;
+    if (new_exposure_NIR > ceiling_NIR)
+        new_exposure_NIR = ceiling_NIR;
 
-    this->exposure_WL = new_exposure_WL;
-    this->exposure_NIR = new_exposure_NIR;
-
-    tPvHandle* Cam1_Handle = Cam1->getHandle();
-    tPvHandle* Cam2_Handle = Cam2->getHandle();
-    PvAttrUint32Set(*Cam1_Handle, "ExposureValue", this->exposure_WL);
-    PvAttrUint32Set(*Cam2_Handle, "ExposureValue", this->exposure_NIR);
-
-    delete[] Image_WL_data;
-    delete[] Image_NIR_data;
+    if (settled_WL)
+    {
+        this->exposure_WL = new_exposure_WL;
+        Cam1->setExposure(this->exposure_WL);
+    }
+    if (settled_NIR)
+    {
+        this->exposure_NIR = new_exposure_NIR;
+        Cam2->setExposure(this->exposure_NIR);
+    }
 }
 
-void AutoExpose::AutoExposure_WL_Cam(QImage *Cam1_Image)
+void AutoExpose::AutoExposure_WL_Cam(QImage Cam1_Image, FrameInfo Cam1_Info)
 {
-    unsigned short* Image_WL_data = new unsigned short[HEIGHT*WIDTH];
-    QImage Image_WL = Cam1_Image->copy();
+    if (Cam1_Image.isNull() || !settled(Cam1_Info, this->exposure_WL, this->Waited_WL))
+        return;
 
-    unsigned char* Image_WL_Original = Image_WL.bits();
-    for (int i = 0; i < Image_WL.height()*Image_WL.width(); i++)
+    const unsigned char* Image_WL_Original = Cam1_Image.constBits();
+
+    int Histogram_WL[4096] = {0};
+    int pixel_count = 0;
+
+    for (int i = 0; i < Cam1_Image.height()*Cam1_Image.width(); i++)
     {
         double r = Image_WL_Original[0];
         double g = Image_WL_Original[1];
         double b = Image_WL_Original[2];
-        Image_WL_data[i] = static_cast<unsigned short>((0.21*r + 0.72*g + 0.07*b)*16); //!< Converts WL RGB 24-bit to 16-bit Mono
+        unsigned short WL = static_cast<unsigned short>((0.21*r + 0.72*g + 0.07*b)*16); //!< Converts WL RGB 24-bit to 16-bit Mono
         Image_WL_Original = Image_WL_Original + 3;
-    }
-
-    int Histogram_WL[4096] = {0};
-    int pixel_count = 0;
 
-    for (int i = 0; i < Image_WL.height()*Image_WL.width(); i++)
-    {
-        if (Image_WL_data[i] > 32)
+        if (WL > 32)
         {
-            unsigned short WL = static_cast<unsigned short>(Image_WL_data[i]);
             Histogram_WL[WL]++;
             pixel_count++;
         }
@@ -237,22 +297,15 @@ void AutoExpose::AutoExposure_WL_Cam(QImage *Cam1_Image)
 
     this->exposure_WL = new_exposure_WL;
 
-    tPvHandle* Cam1_Handle = Cam1->getHandle();
-    PvAttrUint32Set(*Cam1_Handle, "ExposureValue", this->exposure_WL);
-
-    delete[] Image_WL_data;
+    Cam1->setExposure(this->exposure_WL);
 }
 
-void AutoExpose::AutoExposure_NIR_Cam(unsigned char* Cam2_Image_Raw)
+void AutoExpose::AutoExposure_NIR_Cam(FrameBuffer Cam2_Image_Raw, FrameInfo Cam2_Info)
 {
+    if (Cam2_Image_Raw.isNull() || !settled(Cam2_Info, this->exposure_NIR, this->Waited_NIR))
+        return;
 
-    unsigned short* Image_NIR_data = new unsigned short[HEIGHT*WIDTH];
-
-    //Mutex2.lock();
-    //Locker = new QMutexLocker(&Mutex2);
-    std::memcpy(Image_NIR_data, Cam2_Image_Raw, HEIGHT*WIDTH*2);
-    //delete Locker;
-    //Mutex2.unlock();
+    const unsigned short* Image_NIR_data = reinterpret_cast<const unsigned short*>(Cam2_Image_Raw.data());
 
     int Histogram_NIR[4096] = {0};
     int pixel_count = 0;
@@ -290,16 +343,20 @@ void AutoExpose::AutoExposure_NIR_Cam(unsigned char* Cam2_Image_Raw)
 
     unsigned int new_exposure_NIR = (double) this->exposure_NIR*exposure_NIR_multiplier;
 
+    unsigned int ceiling_NIR = 330000;
+    if (this->TargetFPS > 0)
+    {
+        ceiling_NIR = qMin(ceiling_NIR, static_cast<unsigned int>(1000000.0 / this->TargetFPS));
+        new_exposure_NIR = adaptBinning(Cam1, new_exposure_NIR, ceiling_NIR);
+    }
+
     if (new_exposure_NIR < 100)
         new_exposure_NIR = 100;
-    if (new_exposure_NIR > 330000)
-        new_exposure_NIR = 330000;
+    if (new_exposure_NIR > ceiling_NIR)
+        new_exposure_NIR = ceiling_NIR;
 
     this->exposure_NIR = new_exposure_NIR;
     //std::cout << "Exposure_NIR: " << exposure_NIR;
 
-    tPvHandle* Cam1_Handle = Cam1->getHandle();
-    PvAttrUint32Set(*Cam1_Handle, "ExposureValue", this->exposure_NIR);
-
-    delete[] Image_NIR_data;
+    Cam1->setExposure(this->exposure_NIR);
 }
@@ -4,18 +4,37 @@
 #define WIDTH 640
 #define HEIGHT 480
 #define AUTOEXPOSURE_CUTOFF 3000.0
+#define AUTOEXPOSURE_MAX_BINNING 4          //!< Coarsest binning the target frame rate mode switches the NIR camera to
+#define AUTOEXPOSURE_BINNING_PATIENCE 5     //!< Updates in a row a binning change has to be called for before it is made
+#define AUTOEXPOSURE_UNBIN_MARGIN 0.7       //!< Binning is dropped once full resolution would need less than this share of the ceiling
+#define AUTOEXPOSURE_SETTLE_TOLERANCE 0.02  //!< A frame within this share of the exposure asked for was taken with it
+#define AUTOEXPOSURE_SETTLE_FRAMES 10       //!< Frames waited for the exposure asked for before going on from the camera's own value
 
 #include <QObject>
-#include <camera.h>
+#include <framesource.h>
+#include <framepool.h>
+#include <frameinfo.h>
 
 class AutoExpose : public QObject
 {
     Q_OBJECT
 public:
-    explicit AutoExpose(Camera* Cam1 = 0, Camera* Cam2 = 0, QObject *parent = 0);
+    explicit AutoExpose(FrameSource* Cam1 = 0, FrameSource* Cam2 = 0, QObject *parent = 0);
     void ChangeExposure_WL(unsigned int new_exposure);
     void ChangeExposure_NIR(unsigned int new_exposure);
 
+    /**
+     * @brief Holds the NIR camera at a minimum frame rate by binning it when it runs out of exposure
+     *
+     * The NIR exposure is capped at 1/fps. When the camera still needs more light at the cap,
+     * it is switched to 2x2, then 4x4 binning and its exposure is cut by the binning factor:
+     * the frame rate goes up while each binned pixel still collects more light. Binning is
+     * dropped again once the signal would be enough at full resolution.
+     *
+     * @param fps Target NIR frame rate, 0 turns the mode off (full resolution, usual exposure cap)
+     */
+    void setTargetFPS(double fps);
+
 signals:
 
 public slots:
@@ -34,34 +53,71 @@ public slots:
      * the previous value.
      *
      * This function is thread-safe, and in fact is recommended to be run in a seperate thread.
-     * The latest frame datas have mutex locks to prevent the data from being overwritten while
-     * copying the data to stack memory.
+     * Both frames are shared handles to pooled buffers, so they stay valid while they are read
+     * and no copy of the pixel data is made.
+     *
+     * A camera is only stepped once its frames carry the exposure last asked for, see settled().
      *
      * Currently, the NIR camera tends to max out the exposure time as it is constantly signal-starved.
      * The WL camera sits at a comfortable frame-rate, but the exposure time usually ends up a bit lower
      * than it could be, resulting in a slightly starved signal from distances,
      *
-     * @param Cam1_Image Latest WL image. Function makes an internal copy.
-     * @param Cam2_Image_Raw Latest NIR-image (raw, not false-colored). Function makes an internal copy.
+     * @param Cam1_Image Latest WL image (shallow copy, shares the rendered frame)
+     * @param Cam2_Image_Raw Latest NIR-image (raw, not false-colored)
+     * @param Cam1_Info Metadata of the WL frame, for the exposure it was taken with
+     * @param Cam2_Info Metadata of the NIR frame
      */
-    void AutoExposure_Two_Cams(QImage* Cam1_Image, unsigned char* Cam2_Image_Raw);
+    void AutoExposure_Two_Cams(QImage Cam1_Image, FrameBuffer Cam2_Image_Raw, FrameInfo Cam1_Info, FrameInfo Cam2_Info);
 
     /**
      * @brief Autoexposure algorithm based on the relative intensities of pixel data for WL Camera only
      *
      * AutoExposure_WL_Cam operates the same way as AutoExposure_Two_Cams does, but only for the WL camera.
      *
-     * @param Cam1_Image Latest WL image. Function makes an internal copy.
+     * @param Cam1_Image Latest WL image (shallow copy, shares the rendered frame)
+     * @param Cam1_Info Metadata of the WL frame
      */
-    void AutoExposure_WL_Cam(QImage* Cam1_Image);
+    void AutoExposure_WL_Cam(QImage Cam1_Image, FrameInfo Cam1_Info);
 
-    void AutoExposure_NIR_Cam(unsigned char* Cam2_Image_Raw);
+    void AutoExposure_NIR_Cam(FrameBuffer Cam2_Image_Raw, FrameInfo Cam2_Info);
 
 private:
-    Camera* Cam1;
-    Camera* Cam2;
+
+    /**
+     * @brief Steps the NIR camera's binning up or down, see setTargetFPS()
+     *
+     * @param cam The NIR camera
+     * @param exposure Exposure the histogram asks for, in microseconds
+     * @param ceiling Longest exposure allowed
+     * @return Exposure to use, rescaled if the binning was changed
+     */
+    unsigned int adaptBinning(FrameSource* cam, unsigned int exposure, unsigned int ceiling);
+
+    /**
+     * @brief Checks if a frame was taken with the exposure last asked for
+     *
+     * A frame from before the last change says nothing about it, and stepping from it again would
+     * overshoot. With chunk data the frame's exposure is exact; without it FrameInfo holds the last
+     * write the camera confirmed. A camera that keeps another value (rounded, clamped, or set
+     * elsewhere) for AUTOEXPOSURE_SETTLE_FRAMES frames is taken at its word.
+     *
+     * @param info Metadata of the frame
+     * @param asked Exposure last asked for, replaced by the camera's value if it gave up waiting
+     * @param waited Frames waited so far for this camera
+     * @return true if the frame can be used to step the exposure
+     */
+    bool settled(const FrameInfo &info, unsigned int &asked, int &waited);
+
+    FrameSource* Cam1;
+    FrameSource* Cam2;
     unsigned int exposure_WL;
     unsigned int exposure_NIR;
+    double TargetFPS;               //!< NIR frame rate to hold, 0 when the mode is off
+    unsigned int Binning;           //!< Binning factor the NIR camera was last asked for
+    int Starved;                    //!< Updates in a row the NIR exposure sat at its ceiling
+    int Recovered;                  //!< Updates in a row the NIR signal was enough for less binning
+    int Waited_WL;                  //!< WL frames in a row not yet taken with exposure_WL, see settled()
+    int Waited_NIR;                 //!< NIR frames in a row not yet taken with exposure_NIR
 };
 
 #endif // AUTOEXPOSE_H
@@ -0,0 +1,158 @@
+#include "bandwidthmanager.h"
+
+BandwidthManager::BandwidthManager(unsigned long linkBytesPerSecond, QObject *parent) : QObject(parent)
+{
+    this->LinkBytesPerSecond = linkBytesPerSecond;
+    connect(&this->Timer, SIGNAL(timeout()), this, SLOT(rebalance()));
+}
+
+void BandwidthManager::addCamera(FrameSource *cam)
+{
+    Channel channel;
+    channel.Cam = cam;
+    channel.Allocated = 0;
+    channel.LastDelivered = 0;
+    this->Channels.append(channel);
+
+    /// Until something has been measured every camera gets the same share
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        this->Channels[i].Allocated = this->LinkBytesPerSecond / this->Channels.count();
+        this->Channels[i].Cam->setStreamBytesPerSecond(this->Channels[i].Allocated);
+    }
+}
+
+void BandwidthManager::start()
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+        this->Channels[i].LastDelivered = this->Channels[i].Cam->getStatistics().Delivered;
+    this->Elapsed.start();
+    this->Timer.start(BANDWIDTH_INTERVAL);
+}
+
+void BandwidthManager::stop()
+{
+    this->Timer.stop();
+}
+
+unsigned long BandwidthManager::allocation(FrameSource *cam) const
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+        if (this->Channels[i].Cam == cam)
+            return this->Channels[i].Allocated;
+    return 0;
+}
+
+void BandwidthManager::rebalance()
+{
+    double seconds = this->Elapsed.restart() / 1000.0;
+    if (seconds <= 0 || this->Channels.isEmpty())
+        return;
+
+    QVector<unsigned long> demands;
+    QVector<double> measured;
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        Channel &channel = this->Channels[i];
+        unsigned long delivered = channel.Cam->getStatistics().Delivered;
+        double fps = (delivered - channel.LastDelivered) / seconds;
+        channel.LastDelivered = delivered;
+
+        measured.append(fps * channel.Cam->getFrameSize());
+        demands.append(demand(channel.Cam, measured[i], channel.Allocated));
+    }
+
+    QVector<unsigned long> allocations = allocate(demands, this->LinkBytesPerSecond, BANDWIDTH_FLOOR);
+
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        Channel &channel = this->Channels[i];
+        double change = static_cast<double>(allocations[i]) - static_cast<double>(channel.Allocated);
+        if (change < 0)
+            change = -change;
+        if (change <= BANDWIDTH_HYSTERESIS * channel.Allocated)
+            continue;   //!< Not worth a register write
+
+        channel.Allocated = allocations[i];
+        channel.Cam->setStreamBytesPerSecond(channel.Allocated);
+        emit allocationChanged(channel.Cam, channel.Allocated, measured[i]);
+    }
+}
+
+unsigned long BandwidthManager::demand(FrameSource *cam, double measured, unsigned long allocated) const
+{
+    unsigned long frameSize = cam->getFrameSize();
+    if (frameSize == 0)
+        return allocated;   //!< Not set up yet, keep what it has
+
+    double want;
+    if (measured >= BANDWIDTH_STARVED * allocated)
+        want = allocated * BANDWIDTH_GROWTH;    //!< Running at its limit, it may well be bandwidth-bound
+    else
+        want = measured * BANDWIDTH_HEADROOM;
+
+    /// The exposure caps the frame rate, so more bandwidth than this can't be used
+    unsigned long exposure = cam->getExposure();
+    if (exposure > 0)
+    {
+        double ceiling = frameSize * (1000000.0 / exposure) * BANDWIDTH_HEADROOM;
+        if (want > ceiling)
+            want = ceiling;
+    }
+
+    if (want > this->LinkBytesPerSecond)
+        want = this->LinkBytesPerSecond;
+    return static_cast<unsigned long>(want);
+}
+
+QVector<unsigned long> BandwidthManager::allocate(const QVector<unsigned long> &demands, unsigned long budget, unsigned long floor)
+{
+    int count = demands.count();
+    QVector<unsigned long> allocations(count, 0);
+    if (count == 0)
+        return allocations;
+
+    if (floor * count > budget)
+        floor = budget / count;
+
+    QVector<int> unsatisfied;
+    for (int i = 0; i < count; i++)
+        unsatisfied.append(i);
+
+    /// Water-filling: settle every camera asking for less than an equal share of what's left
+    unsigned long remaining = budget;
+    while (!unsatisfied.isEmpty())
+    {
+        unsigned long share = remaining / unsatisfied.count();
+        bool settled = false;
+
+        for (int j = unsatisfied.count() - 1; j >= 0; j--)
+        {
+            int i = unsatisfied[j];
+            unsigned long want = qMax(demands[i], floor);
+            if (want <= share)
+            {
+                allocations[i] = want;
+                remaining -= want;
+                unsatisfied.remove(j);
+                settled = true;
+            }
+        }
+
+        if (!settled)
+        {
+            /// Everyone left wants more than an equal share, so split what's left equally
+            for (int j = 0; j < unsatisfied.count(); j++)
+                allocations[unsatisfied[j]] = share;
+            remaining -= share * unsatisfied.count();
+            unsatisfied.clear();
+        }
+    }
+
+    /// Whatever nobody asked for is spread evenly as headroom
+    unsigned long spare = remaining / count;
+    for (int i = 0; i < count; i++)
+        allocations[i] += spare;
+
+    return allocations;
+}
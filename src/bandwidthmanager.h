@@ -0,0 +1,142 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The BandwidthManager class splits the GigE link budget between the cameras.
+ * It periodically measures the payload rate each camera actually achieves
+ * (frame size x delivered frames per second) and works out how much each one
+ * could use at its current exposure. Cameras that are exposure-limited, such as
+ * the NIR camera at 500 ms, give their unused share back to the others, and a
+ * camera whose measured rate sits at its allocation is treated as starved and
+ * offered more.
+ */
+
+#ifndef BANDWIDTHMANAGER_H
+#define BANDWIDTHMANAGER_H
+
+#define BANDWIDTH_INTERVAL 2000         //!< Milliseconds between two rebalances
+#define BANDWIDTH_FLOOR 4000000         //!< Least bandwidth a camera is ever given, in bytes per second
+#define BANDWIDTH_HEADROOM 1.2          //!< Margin kept above a camera's expected payload rate
+#define BANDWIDTH_STARVED 0.9           //!< Measured/allocated ratio above which a camera counts as starved
+#define BANDWIDTH_GROWTH 1.5            //!< Factor a starved camera's demand grows by per rebalance
+#define BANDWIDTH_HYSTERESIS 0.05       //!< Allocations changing by less than this fraction are not rewritten
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
+#include <framesource.h>
+
+class BandwidthManager : public QObject
+{
+    Q_OBJECT
+public:
+
+    /**
+     * @brief Creates a manager sharing linkBytesPerSecond between its cameras
+     *
+     * @param linkBytesPerSecond Total StreamBytesPerSecond available on the link
+     * @param parent Parent object (Defaults to no parent)
+     */
+    explicit BandwidthManager(unsigned long linkBytesPerSecond = LINK_BYTES_PER_SECOND, QObject *parent = 0);
+
+    /**
+     * @brief Adds a camera to the set sharing the link
+     *
+     * Every camera added so far is given an equal share straight away, so this should be
+     * called before Camera::captureSetup().
+     */
+    void addCamera(FrameSource* cam);
+
+    /**
+     * @brief Starts rebalancing every BANDWIDTH_INTERVAL milliseconds
+     */
+    void start();
+
+    /**
+     * @brief Stops rebalancing, leaving the current allocations in place
+     */
+    void stop();
+
+    /**
+     * @brief Gets the bandwidth currently given to a camera
+     * @return StreamBytesPerSecond of cam, 0 if cam isn't managed
+     */
+    unsigned long allocation(FrameSource* cam) const;
+
+    /**
+     * @brief Splits budget between cameras asking for demands bytes per second
+     *
+     * Max-min fair: cameras asking for less than an equal share get what they ask for,
+     * and the rest is split equally between the cameras that want more. Bandwidth left
+     * over once every demand is met is spread evenly, so any camera can speed up before
+     * the next rebalance. Every camera gets at least floor.
+     *
+     * @param demands Bandwidth each camera could use, in bytes per second
+     * @param budget Total bandwidth to share
+     * @param floor Least bandwidth given to any camera
+     * @return Allocation for each camera, in the same order as demands
+     */
+    static QVector<unsigned long> allocate(const QVector<unsigned long> &demands, unsigned long budget, unsigned long floor);
+
+public slots:
+
+    /**
+     * @brief Measures every camera and redistributes the link budget
+     */
+    void rebalance();
+
+signals:
+
+    /**
+     * @brief Emitted when a camera's allocation is rewritten
+     * @param cam Camera whose StreamBytesPerSecond changed
+     * @param bytesPerSecond New allocation
+     * @param measured Payload rate measured over the last interval, in bytes per second
+     */
+    void allocationChanged(FrameSource* cam, unsigned long bytesPerSecond, double measured);
+
+private:
+
+    /**
+     * @brief Works out how much bandwidth a camera could use
+     *
+     * A camera can't use more than its frame size times the frame rate its exposure
+     * allows. Below that, a camera running at its allocation asks for more, and one
+     * running below it asks for what it measured plus some headroom.
+     */
+    unsigned long demand(FrameSource* cam, double measured, unsigned long allocated) const;
+
+    /**
+     * @brief Per-camera bookkeeping between two rebalances
+     */
+    struct Channel
+    {
+        FrameSource*    Cam;            //!< Managed camera
+        unsigned long   Allocated;      //!< StreamBytesPerSecond last written
+        unsigned long   LastDelivered;  //!< Delivered counter at the previous rebalance
+    };
+
+    QVector<Channel>    Channels;       //!< Cameras sharing the link
+    unsigned long       LinkBytesPerSecond; //!< Budget shared between Channels
+    QTimer              Timer;          //!< Drives rebalance()
+    QElapsedTimer       Elapsed;        //!< Time since the previous rebalance
+};
+
+#endif // BANDWIDTHMANAGER_H
@@ -0,0 +1,631 @@
+#include "bayerdemosaic.h"
+#include "medianfilter.h"
+#include "demosaicreference.h"
+
+#include <QVector>
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef NO_PVAPI
+#include <PvAPI/PvApi.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEMOSAIC_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifndef ULONG_PADDING
+#define ULONG_PADDING(x) (((x+3) & ~3) - x)
+#endif
+
+/**
+ * @brief Mirrors a column or row index that falls off the frame back onto it, keeping its parity
+ */
+static inline int mirror(int i, int size)
+{
+    if (i < 0)
+        i = -i;
+    else if (i >= size)
+        i = 2*size - 2 - i;
+    return qBound(0, i, size - 1);  //!< Frames one pixel wide or high have nothing to mirror
+}
+
+/**
+ * @brief Demosaics pixels [from, to) of a row, one at a time
+ *
+ * A pixel of the row's own colour (red on red rows, blue on blue rows) sits on columns of
+ * chromaParity. It keeps its value, takes green from the 4 pixels beside and above/below it,
+ * and the other colour from the 4 diagonal ones. A green pixel takes the row's colour from
+ * its left and right, and the other colour from above and below.
+ */
+static void demosaicScalar(const unsigned char* up, const unsigned char* row, const unsigned char* down,
+                           unsigned char* out, int width, int from, int to, int chromaParity, bool redRow)
+{
+    for (int x = from; x < to; x++)
+    {
+        int left = mirror(x - 1, width);
+        int right = mirror(x + 1, width);
+        int own, green, other;
+        if ((x & 1) == chromaParity)
+        {
+            own = row[x];
+            green = (row[left] + row[right] + up[x] + down[x] + 2) >> 2;
+            other = (up[left] + up[right] + down[left] + down[right] + 2) >> 2;
+        }
+        else
+        {
+            own = (row[left] + row[right] + 1) >> 1;
+            green = row[x];
+            other = (up[x] + down[x] + 1) >> 1;
+        }
+        out[3*x] = static_cast<unsigned char>((redRow) ? own : other);
+        out[3*x + 1] = static_cast<unsigned char>(green);
+        out[3*x + 2] = static_cast<unsigned char>((redRow) ? other : own);
+    }
+}
+
+/**
+ * @brief Rounds a colour in 16ths of a level to a byte
+ */
+static inline unsigned char gradientByte(int sixteenths)
+{
+    if (sixteenths < 0)     //!< Overshoot of dark edges, (x + 8) >> 4 is 0 for -8 to -1 too
+        return 0;
+    return static_cast<unsigned char>(qMin(255, (sixteenths + 8) >> 4));
+}
+
+/**
+ * @brief Demosaics pixels [from, to) of a row the gradient-corrected way, one at a time
+ *
+ * Like demosaicScalar(), and then the Laplacian of the pixel's own colour (itself against
+ * the pixels of its colour two away) is added in, as Malvar, He and Cutler weigh it. Weights
+ * are in 16ths.
+ *
+ * @param lines Rows two above to two below the one demosaiced, mirrored at the edges
+ */
+static void gradientScalar(const unsigned char* const lines[5], unsigned char* out, int width,
+                           int from, int to, int chromaParity, bool redRow)
+{
+    const unsigned char* up = lines[1];
+    const unsigned char* row = lines[2];
+    const unsigned char* down = lines[3];
+    for (int x = from; x < to; x++)
+    {
+        int left = mirror(x - 1, width);
+        int right = mirror(x + 1, width);
+        int centre = row[x];
+        int across = row[left] + row[right];
+        int upright = up[x] + down[x];
+        int across2 = row[mirror(x - 2, width)] + row[mirror(x + 2, width)];
+        int upright2 = lines[0][x] + lines[4][x];
+        int diagonals = up[left] + up[right] + down[left] + down[right];
+        int own, green, other;
+        if ((x & 1) == chromaParity)
+        {
+            own = 16*centre;
+            green = 8*centre + 4*(across + upright) - 2*(across2 + upright2);
+            other = 12*centre + 4*diagonals - 3*(across2 + upright2);
+        }
+        else
+        {
+            own = 10*centre + 8*across - 2*across2 - 2*diagonals + upright2;
+            green = 16*centre;
+            other = 10*centre + 8*upright - 2*upright2 - 2*diagonals + across2;
+        }
+        out[3*x] = gradientByte((redRow) ? own : other);
+        out[3*x + 1] = gradientByte(green);
+        out[3*x + 2] = gradientByte((redRow) ? other : own);
+    }
+}
+
+#if defined(DEMOSAIC_SSE2)
+/**
+ * @brief Loads 8 pixels into 16-bit lanes
+ */
+static inline __m128i load8(const unsigned char* p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+}
+
+/**
+ * @brief a where mask is set, b elsewhere
+ */
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/**
+ * @brief Writes 4 pixels held as R, G, B, 0 in 32-bit lanes as 12 bytes of RGB24, and 4 bytes beyond
+ *
+ * Each 64-bit half is squeezed to 6 bytes with shifts and masks (SSE2 has no byte shuffle) and
+ * stored 8 bytes at a time; the 2 extra bytes are overwritten by the next pixels.
+ */
+static inline void store4(unsigned char* out, __m128i pixels)
+{
+    const __m128i low = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    const __m128i high = _mm_set_epi32(0x0000FFFF, static_cast<int>(0xFF000000), 0x0000FFFF, static_cast<int>(0xFF000000));
+    __m128i packed = _mm_or_si128(_mm_and_si128(pixels, low), _mm_and_si128(_mm_srli_epi64(pixels, 8), high));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 6), _mm_srli_si128(packed, 8));
+}
+
+/**
+ * @brief Writes 8 pixels from 16-bit lanes of 0 to 255 as 24 bytes of RGB24, and 2 bytes beyond
+ */
+static inline void store8(unsigned char* out, __m128i red, __m128i green, __m128i blue)
+{
+    __m128i red_green = _mm_or_si128(red, _mm_slli_epi16(green, 8));
+    store4(out, _mm_unpacklo_epi16(red_green, blue));
+    store4(out + 12, _mm_unpackhi_epi16(red_green, blue));
+}
+
+/**
+ * @brief The chroma lane mask of demosaicVector(): lanes on columns of chromaParity set
+ */
+static inline __m128i chromaMask(int chromaParity)
+{
+    return (chromaParity == 0) ? _mm_set1_epi32(0x0000FFFF) : _mm_set1_epi32(static_cast<int>(0xFFFF0000));
+}
+
+/**
+ * @brief demosaicScalar() on 8 pixels at a time, in 16-bit lanes so the means are exact
+ *
+ * Blocks start on even columns from column 2, so lanes alternate between the row's colour
+ * and green in the same order every time. Each block reads one pixel either side of it and
+ * writes 2 bytes into the pixel after it, so the last pixels of the row are done one at a
+ * time afterwards.
+ */
+static void demosaicVector(const unsigned char* up, const unsigned char* row, const unsigned char* down,
+                           unsigned char* out, int width, int chromaParity, bool redRow)
+{
+    const __m128i chroma = chromaMask(chromaParity);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+
+    int x = 2;
+    for (; x + 8 < width; x += 8)
+    {
+        __m128i centre = load8(row + x);
+        __m128i left = load8(row + x - 1);
+        __m128i right = load8(row + x + 1);
+        __m128i above = load8(up + x);
+        __m128i below = load8(down + x);
+        __m128i diagonals = _mm_add_epi16(_mm_add_epi16(load8(up + x - 1), load8(up + x + 1)),
+                                          _mm_add_epi16(load8(down + x - 1), load8(down + x + 1)));
+
+        __m128i across = _mm_add_epi16(left, right);
+        __m128i upright = _mm_add_epi16(above, below);
+        __m128i cross = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(across, upright), two), 2);
+        __m128i corner = _mm_srli_epi16(_mm_add_epi16(diagonals, two), 2);
+        across = _mm_srli_epi16(_mm_add_epi16(across, one), 1);
+        upright = _mm_srli_epi16(_mm_add_epi16(upright, one), 1);
+
+        __m128i own = select(chroma, centre, across);
+        __m128i green = select(chroma, cross, centre);
+        __m128i other = select(chroma, corner, upright);
+        store8(out + 3*x, (redRow) ? own : other, green, (redRow) ? other : own);
+    }
+    demosaicScalar(up, row, down, out, width, 0, qMin(2, width), chromaParity, redRow);
+    demosaicScalar(up, row, down, out, width, qMax(x, 2), width, chromaParity, redRow);
+}
+
+/**
+ * @brief Rounds 16-bit lanes of colours in 16ths of a level to 0 to 255, like gradientByte()
+ */
+static inline __m128i gradientRound(__m128i sixteenths)
+{
+    __m128i rounded = _mm_srai_epi16(_mm_add_epi16(sixteenths, _mm_set1_epi16(8)), 4);
+    return _mm_min_epi16(_mm_max_epi16(rounded, _mm_setzero_si128()), _mm_set1_epi16(255));
+}
+
+/**
+ * @brief gradientScalar() on 8 pixels at a time, like demosaicVector()
+ *
+ * Weights are powers of two or sums of them, so shifts and adds do without multiplies.
+ * In 16ths of a level the sums stay within -3060 to 7150, well inside a signed 16-bit lane.
+ * Blocks read two pixels either side of them, so they stop two pixels earlier.
+ */
+static void gradientVector(const unsigned char* const lines[5], unsigned char* out, int width,
+                           int chromaParity, bool redRow)
+{
+    const __m128i chroma = chromaMask(chromaParity);
+    const unsigned char* up = lines[1];
+    const unsigned char* row = lines[2];
+    const unsigned char* down = lines[3];
+
+    int x = 2;
+    for (; x + 10 <= width; x += 8)
+    {
+        __m128i centre = load8(row + x);
+        __m128i across = _mm_add_epi16(load8(row + x - 1), load8(row + x + 1));
+        __m128i upright = _mm_add_epi16(load8(up + x), load8(down + x));
+        __m128i across2 = _mm_add_epi16(load8(row + x - 2), load8(row + x + 2));
+        __m128i upright2 = _mm_add_epi16(load8(lines[0] + x), load8(lines[4] + x));
+        __m128i diagonals = _mm_add_epi16(_mm_add_epi16(load8(up + x - 1), load8(up + x + 1)),
+                                          _mm_add_epi16(load8(down + x - 1), load8(down + x + 1)));
+        __m128i ring2 = _mm_add_epi16(across2, upright2);
+        __m128i centre8 = _mm_slli_epi16(centre, 3);
+        __m128i centre10 = _mm_add_epi16(centre8, _mm_slli_epi16(centre, 1));
+        __m128i diagonals2 = _mm_slli_epi16(diagonals, 1);
+
+        /// On red and blue pixels
+        __m128i chroma_green = _mm_sub_epi16(_mm_add_epi16(centre8, _mm_slli_epi16(_mm_add_epi16(across, upright), 2)),
+                                             _mm_slli_epi16(ring2, 1));
+        __m128i chroma_other = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(centre8, _mm_slli_epi16(centre, 2)), _mm_slli_epi16(diagonals, 2)),
+                                             _mm_add_epi16(ring2, _mm_slli_epi16(ring2, 1)));
+
+        /// On green pixels
+        __m128i green_own = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(centre10, _mm_slli_epi16(across, 3)),
+                                                        _mm_add_epi16(_mm_slli_epi16(across2, 1), diagonals2)), upright2);
+        __m128i green_other = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(centre10, _mm_slli_epi16(upright, 3)),
+                                                          _mm_add_epi16(_mm_slli_epi16(upright2, 1), diagonals2)), across2);
+
+        __m128i own = select(chroma, centre, gradientRound(green_own));
+        __m128i green = select(chroma, gradientRound(chroma_green), centre);
+        __m128i other = gradientRound(select(chroma, chroma_other, green_other));
+        store8(out + 3*x, (redRow) ? own : other, green, (redRow) ? other : own);
+    }
+    gradientScalar(lines, out, width, 0, qMin(2, width), chromaParity, redRow);
+    gradientScalar(lines, out, width, qMax(x, 2), width, chromaParity, redRow);
+}
+#endif
+
+BayerDemosaic::BayerDemosaic()
+{
+    this->Bayer = NULL;
+    this->Rgb = NULL;
+    this->Width = 0;
+    this->Height = 0;
+    this->Stride = 0;
+    this->RedX = 0;
+    this->RedY = 0;
+    this->Method = DemosaicBilinear;
+    this->Vectorised = true;
+}
+
+void BayerDemosaic::setMethod(DemosaicMethod method)
+{
+    this->Method = method;
+}
+
+DemosaicMethod BayerDemosaic::method() const
+{
+    return this->Method;
+}
+
+void BayerDemosaic::run(const unsigned char *bayer, int width, int height, BayerLayout pattern,
+                        unsigned char *rgb, int stride, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Bayer = bayer;
+    this->Rgb = rgb;
+    this->Width = width;
+    this->Height = height;
+    this->Stride = stride;
+    this->RedX = (pattern == BayerGRBG || pattern == BayerBGGR) ? 1 : 0;
+    this->RedY = (pattern == BayerGBRG || pattern == BayerBGGR) ? 1 : 0;
+    pool->parallelFor(KernelInterpolation, *this, height, WorkerPool::stripeRows(width*3));
+}
+
+void BayerDemosaic::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    for (int y = begin; y < end; y++)
+    {
+        const unsigned char* lines[5];
+        for (int i = 0; i < 5; i++)
+            lines[i] = this->Bayer + mirror(y + i - 2, this->Height)*this->Width;
+        unsigned char* out = this->Rgb + y*this->Stride;
+        bool red_row = (y & 1) == this->RedY;
+        int chroma_parity = (red_row) ? this->RedX : 1 - this->RedX;
+        bool gradient = this->Method == DemosaicGradient;
+#if defined(DEMOSAIC_SSE2)
+        if (this->Vectorised)
+        {
+            if (gradient)
+                gradientVector(lines, out, this->Width, chroma_parity, red_row);
+            else
+                demosaicVector(lines[1], lines[2], lines[3], out, this->Width, chroma_parity, red_row);
+            continue;
+        }
+#endif
+        if (gradient)
+            gradientScalar(lines, out, this->Width, 0, this->Width, chroma_parity, red_row);
+        else
+            demosaicScalar(lines[1], lines[2], lines[3], out, this->Width, 0, this->Width, chroma_parity, red_row);
+    }
+}
+
+const char* BayerDemosaic::instructionSet()
+{
+#if defined(DEMOSAIC_SSE2)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+/**
+ * @brief Samples a smooth colour scene through a Bayer filter of the given pattern
+ */
+static void benchmarkScene(unsigned char* bayer, int width, int height, BayerLayout pattern)
+{
+    int red_x = (pattern == BayerGRBG || pattern == BayerBGGR) ? 1 : 0;
+    int red_y = (pattern == BayerGBRG || pattern == BayerBGGR) ? 1 : 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            double value;
+            if ((x & 1) == red_x && (y & 1) == red_y)
+                value = 128 + 100*std::sin(x/37.0 + y/53.0);
+            else if ((x & 1) != red_x && (y & 1) != red_y)
+                value = 128 + 100*std::cos(x/61.0 - y/29.0);
+            else
+                value = 128 + 90*std::sin((x + y)/45.0);
+            bayer[y*width + x] = static_cast<unsigned char>(value + 0.5);
+        }
+    }
+}
+
+/**
+ * @brief Draws a frame of sharp edges, a disc crossed by stripes, in colours that move together like tissue
+ *
+ * @param rgb The true colours, RGB24 rows of 3 * width bytes
+ * @param bayer The same through a Bayer filter of the given pattern
+ */
+static void benchmarkEdges(unsigned char* rgb, unsigned char* bayer, int width, int height, BayerLayout pattern)
+{
+    int red_x = (pattern == BayerGRBG || pattern == BayerBGGR) ? 1 : 0;
+    int red_y = (pattern == BayerGBRG || pattern == BayerBGGR) ? 1 : 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int dx = x - width/2;
+            int dy = y - height/2;
+            int light = (dx*dx + dy*dy < height*height/9) ? 200 : 70;
+            if (((x + 2*y)/13) % 2)
+                light -= 50;
+            unsigned char* pixel = rgb + 3*(y*width + x);
+            pixel[0] = static_cast<unsigned char>(light*9/10 + 20);
+            pixel[1] = static_cast<unsigned char>(light*6/10);
+            pixel[2] = static_cast<unsigned char>(light*4/10 + 10);
+            int colour = 1;
+            if ((x & 1) == red_x && (y & 1) == red_y)
+                colour = 0;
+            else if ((x & 1) != red_x && (y & 1) != red_y)
+                colour = 2;
+            bayer[y*width + x] = pixel[colour];
+        }
+    }
+}
+
+#ifndef NO_PVAPI
+/**
+ * @brief Runs PvUtilityColorInterpolate() like the viewer used to, into rows padded to 4 bytes
+ */
+static void sdkInterpolate(unsigned char* bayer, int width, int height, BayerLayout pattern, unsigned char* rgb)
+{
+    tPvFrame frame;
+    memset(&frame, 0, sizeof(tPvFrame));
+    frame.ImageBuffer = bayer;
+    frame.ImageBufferSize = width*height;
+    frame.ImageSize = width*height;
+    frame.Width = width;
+    frame.Height = height;
+    frame.Format = ePvFmtBayer8;
+    frame.BitDepth = 8;
+    frame.BayerPattern = static_cast<tPvBayerPattern>(pattern);
+    PvUtilityColorInterpolate(&frame, &rgb[0], &rgb[1], &rgb[2], 2, ULONG_PADDING(width*3));
+}
+#endif
+
+bool BayerDemosaic::benchmark()
+{
+    bool passed = true;
+    const BayerLayout patterns[4] = {BayerRGGB, BayerGBRG, BayerGRBG, BayerBGGR};
+    const char* names[4] = {"RGGB", "GBRG", "GRBG", "BGGR"};
+    const char* methods[2] = {"bilinear", "gradient"};
+    WorkerPool single(1);
+    std::cout << "Bilinear and gradient-corrected demosaic, vectorised with " << instructionSet() << std::endl;
+
+    /// Vectorised against plain C++ on noise, for sizes that leave every kind of row tail. Row padding must stay untouched
+    const int sizes[6][2] = {{640, 480}, {641, 479}, {19, 7}, {17, 5}, {2, 2}, {1, 3}};
+    for (int m = 0; m < 2; m++)
+    {
+        unsigned int seed = 12345;
+        bool exact = true;
+        for (int s = 0; s < 6; s++)
+        {
+            int width = sizes[s][0];
+            int height = sizes[s][1];
+            int stride = width*3 + 5;
+            QVector<unsigned char> bayer(width*height);
+            for (int i = 0; i < width*height; i++)
+            {
+                seed = seed*1103515245 + 12345;
+                bayer[i] = (seed >> 16) & 0xFF;
+            }
+            for (int p = 0; p < 4; p++)
+            {
+                QVector<unsigned char> vector(stride*height, 0xAB);
+                QVector<unsigned char> plain(stride*height, 0xAB);
+                BayerDemosaic demosaic;
+                demosaic.setMethod((DemosaicMethod)m);
+                demosaic.run(bayer.constData(), width, height, patterns[p], vector.data(), stride, &single);
+                demosaic.Vectorised = false;
+                demosaic.run(bayer.constData(), width, height, patterns[p], plain.data(), stride, &single);
+                bool same = vector == plain;
+                for (int y = 0; y < height && same; y++)
+                    for (int i = width*3; i < stride && same; i++)
+                        same = plain[y*stride + i] == 0xAB;
+                if (!same)
+                    std::cout << "  " << methods[m] << " " << width << "x" << height << " " << names[p]
+                              << ": VECTORISED DIFFERS FROM PLAIN" << std::endl;
+                exact = exact && same;
+            }
+        }
+        std::cout << "  " << methods[m] << ": vectorised and plain C++ " << ((exact) ? "match" : "DIFFER")
+                  << " for every pattern" << std::endl;
+        passed = passed && exact;
+    }
+
+    /// Both against the reference frame, every pixel, vectorised and plain C++
+    const char* kinds[2] = {"plain C++", "vectorised"};
+    for (int m = 0; m < 2; m++)
+    {
+        const int size = DEMOSAIC_REFERENCE_WIDTH*DEMOSAIC_REFERENCE_HEIGHT*3;
+        for (int v = 0; v < 2; v++)
+        {
+            int largest = 0;
+            int over = 0;
+            for (int p = 0; p < 4; p++)
+            {
+                const unsigned char* reference = (m == DemosaicGradient) ? DemosaicReferenceGradient[p]
+                                                                         : DemosaicReferenceBilinear[p];
+                QVector<unsigned char> rgb(size);
+                BayerDemosaic demosaic;
+                demosaic.setMethod((DemosaicMethod)m);
+                demosaic.Vectorised = v != 0;
+                demosaic.run(DemosaicReferenceBayer, DEMOSAIC_REFERENCE_WIDTH, DEMOSAIC_REFERENCE_HEIGHT,
+                             patterns[p], rgb.data(), DEMOSAIC_REFERENCE_WIDTH*3, &single);
+                for (int i = 0; i < size; i++)
+                {
+                    int difference = std::abs(rgb[i] - reference[i]);
+                    largest = qMax(largest, difference);
+                    if (difference > DEMOSAIC_REFERENCE_MAX_ERROR)
+                        over++;
+                }
+            }
+            passed = passed && over == 0;
+            std::cout << "  " << methods[m] << ", " << kinds[v] << " against the reference frame: " << largest
+                      << " levels largest difference, " << over << " values more than " << DEMOSAIC_REFERENCE_MAX_ERROR
+                      << " off" << ((over == 0) ? "" : ", WRONG") << std::endl;
+        }
+    }
+
+    const int width = 640;
+    const int height = 480;
+    const int stride = width*3 + ULONG_PADDING(width*3);
+    QVector<unsigned char> bayer(width*height);
+    QVector<unsigned char> ours(stride*height);
+
+#ifndef NO_PVAPI
+    /// Bilinear against the SDK on a smooth scene, away from the edges. Printed only, the SDK's rounding is not documented
+    QVector<unsigned char> sdk(stride*height);
+    for (int p = 0; p < 4; p++)
+    {
+        benchmarkScene(bayer.data(), width, height, patterns[p]);
+        BayerDemosaic demosaic;
+        demosaic.run(bayer.constData(), width, height, patterns[p], ours.data(), stride, &single);
+        sdkInterpolate(bayer.data(), width, height, patterns[p], sdk.data());
+
+        int largest = 0;
+        int over = 0;
+        for (int y = 2; y < height - 2; y++)
+        {
+            for (int i = 6; i < (width - 2)*3; i++)
+            {
+                int difference = std::abs(ours[y*stride + i] - sdk[y*stride + i]);
+                largest = qMax(largest, difference);
+                if (difference > DEMOSAIC_REFERENCE_MAX_ERROR)
+                    over++;
+            }
+        }
+        std::cout << "  " << names[p] << " against PvUtilityColorInterpolate: " << largest << " levels largest difference, "
+                  << over << " values more than " << DEMOSAIC_REFERENCE_MAX_ERROR << " off" << std::endl;
+    }
+#endif
+
+    /// Both against the true colours of sharp edges, where bilinear leaves colour fringes
+    QVector<unsigned char> truth(width*height*3);
+    for (int p = 0; p < 4; p++)
+    {
+        benchmarkEdges(truth.data(), bayer.data(), width, height, patterns[p]);
+        double error[2];
+        for (int m = 0; m < 2; m++)
+        {
+            BayerDemosaic demosaic;
+            demosaic.setMethod((DemosaicMethod)m);
+            demosaic.run(bayer.constData(), width, height, patterns[p], ours.data(), stride, &single);
+            double sum = 0;
+            int count = 0;
+            for (int y = 2; y < height - 2; y++)
+            {
+                for (int i = 6; i < (width - 2)*3; i++)
+                {
+                    sum += std::abs(ours[y*stride + i] - truth[y*width*3 + i]);
+                    count++;
+                }
+            }
+            error[m] = sum / count;
+        }
+        passed = passed && error[1] < error[0];
+        std::cout << "  " << names[p] << " edges, mean error: bilinear " << error[0] << " levels, gradient "
+                  << error[1] << ((error[1] < error[0]) ? "" : ", NO BETTER") << std::endl;
+    }
+
+    /// Throughput on the WL view and a full sensor frame, against the frame time at 30 fps
+    const int timed[2][2] = {{640, 480}, {MEDIAN_BENCHMARK_WIDTH, MEDIAN_BENCHMARK_HEIGHT}};
+    for (int s = 0; s < 2; s++)
+    {
+        int width = timed[s][0];
+        int height = timed[s][1];
+        int stride = width*3 + ULONG_PADDING(width*3);
+        QVector<unsigned char> bayer(width*height);
+        QVector<unsigned char> rgb(stride*height);
+        benchmarkScene(bayer.data(), width, height, BayerRGGB);
+        std::cout << width << "x" << height << ", " << DEMOSAIC_BUDGET_MS << " ms per frame at 30 fps:" << std::endl;
+
+        double sdk_ms = 0;
+#ifdef NO_PVAPI
+        const int first = 1;    //!< No SDK to time against
+#else
+        const int first = 0;
+#endif
+        for (int r = first; r < 7; r++)
+        {
+            /// The SDK, then plain C++ on 1 thread, vectorised on 1 thread and vectorised on the shared pool for each method
+            BayerDemosaic demosaic;
+            int variant = (r - 1) % 3;
+            demosaic.setMethod((r > 3) ? DemosaicGradient : DemosaicBilinear);
+            demosaic.Vectorised = variant != 0;
+            int repeats = 0;
+            QElapsedTimer clock;
+            clock.start();
+            do
+            {
+#ifndef NO_PVAPI
+                if (r == 0)
+                    sdkInterpolate(bayer.data(), width, height, BayerRGGB, rgb.data());
+                else
+#endif
+                    demosaic.run(bayer.constData(), width, height, BayerRGGB, rgb.data(), stride,
+                                 (variant == 2) ? WorkerPool::shared() : &single);
+                repeats++;
+            }while (clock.elapsed() < 300 || repeats < 3);
+            double ms = clock.nsecsElapsed() / 1000000.0 / repeats;
+
+            const char* variants[3] = {"plain C++, 1 thread", "vectorised, 1 thread", "vectorised, shared pool"};
+            if (r == 0)
+            {
+                sdk_ms = ms;
+                std::cout << "  PvUtilityColorInterpolate: ";
+            }
+            else
+                std::cout << "  " << methods[demosaic.method()] << ", " << variants[variant] << ": ";
+            std::cout << ms << " ms/frame, " << width*height / ms / 1000.0 << " Mpixel/s";
+            if (sdk_ms > 0)
+                std::cout << ", " << sdk_ms / ms << "x the SDK";
+            std::cout << ((ms <= DEMOSAIC_BUDGET_MS) ? "" : ", OVER BUDGET") << std::endl;
+        }
+    }
+    return passed;
+}
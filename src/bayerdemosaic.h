@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The BayerDemosaic class turns the WL camera's Bayer8 frames into
+ * RGB24, in place of PvUtilityColorInterpolate(), which runs on one
+ * thread and only writes whole frames.
+ *
+ * DemosaicBilinear is plain bilinear interpolation: a missing green is
+ * the mean of the four greens around it, a missing red or blue the mean
+ * of the two or four nearest ones. It is cheap, but leaves colour
+ * fringes along sharp edges. DemosaicGradient is the gradient-corrected
+ * interpolation of Malvar, He and Cutler (ICASSP 2004): the bilinear
+ * estimate is corrected by the Laplacian of the pixel's own colour over
+ * a 5x5 window, which removes most of the fringing for about three times
+ * the cost. Its weights are multiples of 1/16, so it is exact in
+ * integers.
+ *
+ * Any of the four Bayer patterns is handled, and rows of the output may
+ * have any stride. Each row only reads the rows up to two away from it,
+ * so stripes of rows can go to different workers without any overlap.
+ * Beyond the edges the frame is mirrored, which keeps the Bayer pattern.
+ *
+ * Eight pixels are done at once with SSE2 on x86-64 builds, one at a
+ * time in plain C++ elsewhere; both give the same result.
+ */
+
+#ifndef BAYERDEMOSAIC_H
+#define BAYERDEMOSAIC_H
+
+#define DEMOSAIC_REFERENCE_MAX_ERROR 1  //!< Levels any value may be off the reference frame's, which are exact values rounded to nearest
+#define DEMOSAIC_BUDGET_MS (1000.0/30)  //!< Time a frame may take at 30 fps, benchmark() compares with it
+
+#include <workerpool.h>
+#include <frameformat.h>
+
+/**
+ * @brief How BayerDemosaic fills in the two colours each pixel lacks
+ */
+enum DemosaicMethod
+{
+    DemosaicBilinear,   //!< Mean of the nearest pixels of the colour, 3x3
+    DemosaicGradient    //!< Malvar-He-Cutler, bilinear corrected by the Laplacian of the pixel's colour, 5x5
+};
+
+class BayerDemosaic : public RowKernel
+{
+public:
+    BayerDemosaic();
+
+    /**
+     * @brief Sets how the next frames are demosaiced, DemosaicBilinear by default
+     */
+    void setMethod(DemosaicMethod method);
+
+    /**
+     * @brief Gets how frames are demosaiced
+     */
+    DemosaicMethod method() const;
+
+    /**
+     * @brief Demosaics width x height Bayer8 pixels
+     *
+     * @param bayer Bayer8 pixels, rows of width bytes
+     * @param pattern Colours of the top left 2x2 pixels, FrameInfo::BayerPattern of a frame
+     * @param rgb Where the RGB pixels go
+     * @param stride Bytes from one row of rgb to the next, at least 3 * width
+     * @param pool Pool to spread the rows over, NULL for WorkerPool::shared()
+     */
+    void run(const unsigned char* bayer, int width, int height, BayerLayout pattern,
+             unsigned char* rgb, int stride, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+    /**
+     * @brief Gets the instruction set the demosaic was built for: "SSE2" or "none"
+     */
+    static const char* instructionSet();
+
+    /**
+     * @brief Checks the demosaic and times it against PvUtilityColorInterpolate()
+     *
+     * For both methods the vectorised demosaic must give the same pixels as the plain C++
+     * one for every pattern, and no value of either may be more than
+     * DEMOSAIC_REFERENCE_MAX_ERROR off the reference frame's (see demosaicreference.h).
+     * DemosaicGradient must also come closer than DemosaicBilinear to the true colours of a
+     * frame with sharp edges. How far DemosaicBilinear is from PvUtilityColorInterpolate()
+     * is printed but not checked. Times are compared with the budget of a frame at 30 fps.
+     * Prints the results to std::cout. Run with --benchmark-demosaic.
+     *
+     * @return true if every check passed
+     */
+    static bool benchmark();
+
+private:
+    const unsigned char* Bayer;     //!< Frame run() was given
+    unsigned char*  Rgb;            //!< Where it goes
+    int             Width;
+    int             Height;
+    int             Stride;         //!< Bytes per row of Rgb
+    int             RedX;           //!< Column (0 or 1) of the red pixels in the pattern
+    int             RedY;           //!< Row (0 or 1) of the red pixels in the pattern
+    DemosaicMethod  Method;
+    bool            Vectorised;     //!< False forces the plain C++ version, for benchmark()
+};
+
+#endif // BAYERDEMOSAIC_H
@@ -1,17 +1,99 @@
 #include "camera.h"
 
-Camera::Camera(QObject *parent) : QObject(parent)
+PvPacketPath::PvPacketPath(tPvHandle handle)
+{
+    this->Handle = handle;
+}
+
+bool PvPacketPath::adjust(unsigned long maximum)
+{
+    return PvCaptureAdjustPacketSize(this->Handle, maximum) == ePvErrSuccess;
+}
+
+unsigned long PvPacketPath::packetSize()
+{
+    tPvUint32 size = 0;
+    if (PvAttrUint32Get(this->Handle, "PacketSize", &size) != ePvErrSuccess)
+        return 0;
+    return size;
+}
+
+Camera::Camera(QObject *parent) : FrameSource(parent)
 {
     this->Mono16 = false;
     this->Disconnected = false;
+    this->Stopping = false;
+    this->Replugged = false;
+    this->Reconnecting = false;
+    this->ResumePending = false;
+    this->UnpluggedAt = 0;
+    this->RepluggedAt = 0;
     this->Handle = NULL;
+    this->ID = 0;
+    this->Address = 0;
+    this->RingSize = FRAMESCOUNT;
+    this->Pool = NULL;
+    memset(&(this->CurrentFrame),0,sizeof(tPvFrame));
+    memset(&(this->CurrentInfo),0,sizeof(FrameInfo));
+    this->TimestampFrequency = 0;
+    this->FrameExposure = 0;
+    this->AncillarySize = 0;
+    this->StreamBytesPerSecond = LINK_BYTES_PER_SECOND / 2;
+    this->FrameSize = 0;
+    memset(&(this->PacketInfo),0,sizeof(PacketProbeResult));
+    memset(&(this->Statistics),0,sizeof(CaptureStatistics));
+    this->LastFrameCount = 0;
+    this->HaveFrameCount = false;
+    this->LastStatisticsRead = 0;
+    this->Continuous = false;
+    this->Streaming = false;
+    this->Trigger = TriggerFreerun;
+    this->Binning = 1;
+    this->PendingBinning = 1;
+    this->Crop = QRect(0, 0, CAMERA_VIEW_WIDTH, CAMERA_VIEW_HEIGHT);
+    this->PendingCrop = this->Crop;
+    this->RegionX = 0;
+    this->RegionY = 0;
 }
 
 Camera::Camera(unsigned long UniqueID)
 {
     tPvErr err = PvCameraOpen(UniqueID, ePvAccessMaster, &Handle);
+    if (err == ePvErrSuccess)
+        this->Snapshot.load(this->Handle);
+    this->ID = UniqueID;
+    this->Address = 0;
     this->Mono16 = false;
     this->Disconnected = false;
+    this->Stopping = false;
+    this->Replugged = false;
+    this->Reconnecting = false;
+    this->ResumePending = false;
+    this->UnpluggedAt = 0;
+    this->RepluggedAt = 0;
+    this->RingSize = FRAMESCOUNT;
+    this->Pool = NULL;
+    memset(&(this->CurrentFrame),0,sizeof(tPvFrame));
+    memset(&(this->CurrentInfo),0,sizeof(FrameInfo));
+    this->TimestampFrequency = 0;
+    this->FrameExposure = 0;
+    this->AncillarySize = 0;
+    this->StreamBytesPerSecond = LINK_BYTES_PER_SECOND / 2;
+    this->FrameSize = 0;
+    memset(&(this->PacketInfo),0,sizeof(PacketProbeResult));
+    memset(&(this->Statistics),0,sizeof(CaptureStatistics));
+    this->LastFrameCount = 0;
+    this->HaveFrameCount = false;
+    this->LastStatisticsRead = 0;
+    this->Continuous = false;
+    this->Streaming = false;
+    this->Trigger = TriggerFreerun;
+    this->Binning = 1;
+    this->PendingBinning = 1;
+    this->Crop = QRect(0, 0, CAMERA_VIEW_WIDTH, CAMERA_VIEW_HEIGHT);
+    this->PendingCrop = this->Crop;
+    this->RegionX = 0;
+    this->RegionY = 0;
 }
 
 Camera::~Camera()
@@ -19,7 +101,7 @@ Camera::~Camera()
    // for (int i = 0; i < FRAMESCOUNT; i++)
         //delete[] static_cast<unsigned char*>(Frames[0].ImageBuffer);
    PvCommandRun(this->Handle, "AcquisitionStop");
-
+   delete this->Pool;
 }
 
 void Camera::setID(unsigned long ID)
@@ -27,6 +109,21 @@ void Camera::setID(unsigned long ID)
     this->ID = ID;
 }
 
+unsigned long Camera::getID()
+{
+    return this->ID;
+}
+
+void Camera::setAddress(unsigned long address)
+{
+    this->Address = address;
+}
+
+unsigned long Camera::getAddress()
+{
+    return this->Address;
+}
+
 void Camera::setCameraName(char name[])
 {
     std::strncpy(this->CameraName, name, 32);
@@ -34,7 +131,78 @@ void Camera::setCameraName(char name[])
 
 tPvFrame* Camera::getFramePtr()
 {
-    return &(this->Frames[0]);
+    return &(this->CurrentFrame);
+}
+
+FrameBuffer Camera::getFrame()
+{
+    return this->CurrentBuffer;
+}
+
+FrameInfo Camera::getFrameInfo()
+{
+    return this->CurrentInfo;
+}
+
+void Camera::setExposure(unsigned long exposure)
+{
+    this->Attributes.post("ExposureValue", exposure);
+}
+
+unsigned long Camera::getExposure()
+{
+    return this->Attributes.requested("ExposureValue", 0);
+}
+
+PacketProbeResult Camera::getPacketInfo()
+{
+    return this->PacketInfo;
+}
+
+unsigned long Camera::getFrameSize()
+{
+    return this->FrameSize;
+}
+
+void Camera::setStreamBytesPerSecond(unsigned long bytesPerSecond)
+{
+    this->Attributes.post("StreamBytesPerSecond", bytesPerSecond);
+}
+
+bool Camera::setAttribute(const char *name, unsigned long value)
+{
+    this->Attributes.post(name, value);
+    return true;
+}
+
+bool Camera::setBinning(unsigned int factor)
+{
+    if (!this->Mono16 || factor < 1 || factor > MAX_BINNING)
+        return false;   //!< Binning a Bayer sensor mixes colours
+    unsigned long lowest, highest;
+    if (this->Snapshot.range("BinningX", &lowest, &highest) && factor > highest)
+        return false;
+    QMutexLocker locker(&this->FrameMutex);
+    this->PendingBinning = factor;
+    return true;
+}
+
+unsigned int Camera::getBinning()
+{
+    return this->Binning;
+}
+
+bool Camera::setCrop(const QRect &crop)
+{
+    if (crop.isEmpty() || crop.x() < 0 || crop.y() < 0
+            || crop.x() + crop.width() > CAMERA_VIEW_WIDTH || crop.y() + crop.height() > CAMERA_VIEW_HEIGHT)
+        return false;
+    if (crop.x() % CAMERA_CROP_ALIGN != 0 || crop.y() % CAMERA_CROP_ALIGN != 0
+            || crop.width() % CAMERA_CROP_ALIGN != 0 || crop.height() % CAMERA_CROP_ALIGN != 0)
+        return false;
+    QMutexLocker locker(&this->FrameMutex);
+    this->PendingCrop = crop;
+    return true;
 }
 
 tPvHandle* Camera::getHandle()
@@ -44,9 +212,99 @@ tPvHandle* Camera::getHandle()
 
 bool Camera::GrabHandleFromID()
 {
-    tPvErr err = PvCameraOpen(this->ID, ePvAccessMaster, &Handle);
+    tPvErr err = ePvErrNotFound;
+    if (this->Address != 0)
+        err = PvCameraOpenByAddr(this->Address, ePvAccessMaster, &Handle);
+    if (err != ePvErrSuccess)   //!< No address, or the camera came back with another one
+        err = PvCameraOpen(this->ID, ePvAccessMaster, &Handle);
     if (err != ePvErrSuccess)
         return false;
+    this->Snapshot.load(this->Handle);
+    return true;
+}
+
+void Camera::linkEvent(bool present)
+{
+    QMutexLocker locker(&this->FrameMutex);
+    if (present)
+    {
+        this->Replugged = true;
+        this->RepluggedAt = hostTimeUs();
+    }
+    else
+    {
+        this->Disconnected = true;
+        if (this->UnpluggedAt == 0)
+            this->UnpluggedAt = hostTimeUs();
+    }
+    this->FrameCondition.wakeAll();
+}
+
+bool Camera::reconnect()
+{
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        if (this->Stopping)
+            return false;
+        if (this->UnpluggedAt == 0)
+            this->UnpluggedAt = hostTimeUs();
+    }
+    std::cout << this->CameraName << " unplugged, waiting for it to come back" << std::endl;
+
+    /// The old handle is dead. Frames still queued come back cancelled and keep their buffers
+    PvCaptureQueueClear(this->Handle);
+    PvCaptureEnd(this->Handle);
+    PvCameraClose(this->Handle);
+    this->Streaming = false;
+
+    unsigned long exposure = getExposure();
+    unsigned long regionX = this->RegionX;
+    unsigned long regionY = this->RegionY;
+    unsigned int binning = this->Binning;
+    QRect crop = this->Crop;
+
+    while (true)
+    {
+        {
+            QMutexLocker locker(&this->FrameMutex);
+            if (!this->Replugged && !this->Stopping)
+                this->FrameCondition.wait(&this->FrameMutex, CAMERA_RECONNECT_POLL);
+            if (this->Stopping)
+                return false;
+            this->Replugged = false;
+            this->Disconnected = false;     //!< An unplug from here on is caught by the next waitForFrame()
+        }
+
+        /// Opening fails until the camera has booted and taken its IP address again
+        if (!GrabHandleFromID())
+            continue;
+
+        this->FrameSize = 0;
+        this->Reconnecting = true;
+        captureSetup();
+        this->Reconnecting = false;
+        if (this->FrameSize != 0)
+            break;  //!< Otherwise captureSetup() could not read the camera and closed it again
+    }
+
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        if (this->RepluggedAt < this->UnpluggedAt) //!< Link event missed, found by polling
+            this->RepluggedAt = hostTimeUs();
+        this->CompletedFrames.clear();
+    }
+    this->HaveFrameCount = false;   //!< The camera counts frames from 1 again after a power cycle
+    this->Processor.reset();    //!< The scene has moved on while the camera was gone
+
+    /// captureSetup() put the defaults back, the settings in use before the unplug go through the queue
+    setExposure(exposure);
+    setAttribute("RegionX", regionX);
+    setAttribute("RegionY", regionY);
+    applyAttributes();
+    if (binning != this->Binning || crop != this->Crop)
+        changeGeometry(binning, crop);
+
+    this->ResumePending = true;
     return true;
 }
 
@@ -58,28 +316,30 @@ void Camera::captureSetup()
         //PvAttrBooleanSet(this->Handle, "StreamFrameRateConstrain", true);
         PvAttrEnumSet(this->Handle, "ExposureMode", "Manual");
         PvAttrUint32Set(this->Handle, "ExposureValue", 500000);
-        PvAttrUint32Set(this->Handle,"StreamBytesPerSecond", 115000000 / 2 - 20000000);
 
         PvAttrUint32Set(this->Handle, "BinningX", 1);
         PvAttrUint32Set(this->Handle, "BinningY", 1);
 
-        PvAttrUint32Set(this->Handle, "Width", 640);
-        PvAttrUint32Set(this->Handle, "Height", 480);
-        PvAttrUint32Set(this->Handle, "RegionX", 295);  //x = 295
-        PvAttrUint32Set(this->Handle, "RegionY", 236);  //y = 236
+        PvAttrUint32Set(this->Handle, "Width", CAMERA_VIEW_WIDTH);
+        PvAttrUint32Set(this->Handle, "Height", CAMERA_VIEW_HEIGHT);
+        this->RegionX = 295;
+        this->RegionY = 236;
+        PvAttrUint32Set(this->Handle, "RegionX", this->RegionX);  //x = 295
+        PvAttrUint32Set(this->Handle, "RegionY", this->RegionY);  //y = 236
     }
     else
     {
-        PvAttrUint32Set(this->Handle, "StreamBytesPerSecond", 115000000 / 2 + 20000000);
         PvAttrEnumSet(this->Handle, "PixelFormat", "Bayer8");
 
         PvAttrUint32Set(this->Handle, "BinningX", 1);
         PvAttrUint32Set(this->Handle, "BinningY", 1);
 
-        PvAttrUint32Set(this->Handle, "Width", 640); //x = 269
-        PvAttrUint32Set(this->Handle, "Height", 480); //y = 332
-        PvAttrUint32Set(this->Handle, "RegionX", 523);
-        PvAttrUint32Set(this->Handle, "RegionY", 180);
+        PvAttrUint32Set(this->Handle, "Width", CAMERA_VIEW_WIDTH); //x = 269
+        PvAttrUint32Set(this->Handle, "Height", CAMERA_VIEW_HEIGHT); //y = 332
+        this->RegionX = 523;
+        this->RegionY = 180;
+        PvAttrUint32Set(this->Handle, "RegionX", this->RegionX);
+        PvAttrUint32Set(this->Handle, "RegionY", this->RegionY);
 
         //PvAttrUint32Set(this->Handle, "ExposureAutoMax", 60000);
         PvAttrEnumSet(this->Handle, "ExposureMode", "Manual");
@@ -87,6 +347,14 @@ void Camera::captureSetup()
 
     }
 
+    this->Binning = 1;
+    this->Crop = QRect(0, 0, CAMERA_VIEW_WIDTH, CAMERA_VIEW_HEIGHT);
+    if (!this->Reconnecting)
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        this->Stopping = false;
+    }
+
     tPvErr errCode;
     if((errCode = PvAttrUint32Get(this->Handle,"TotalBytesPerFrame",&this->FrameSize)) != ePvErrSuccess)
     {
@@ -94,300 +362,628 @@ void Camera::captureSetup()
         PvCameraClose(this->Handle);
         return;
     }
-    memset(&(this->Frames[0]),0,sizeof(tPvFrame));
+    /// Chunk data tells each frame's exposure, gain and sync levels (firmware 1.42 and later)
+    this->AncillarySize = 0;
+    if (this->Snapshot.isWritable("ChunkModeActive")
+            && PvAttrBooleanSet(this->Handle, "ChunkModeActive", true) == ePvErrSuccess)
+    {
+        tPvUint32 size = 0;
+        PvAttrUint32Get(this->Handle, "NonImagePayloadSize", &size);
+        if (size >= ANCILLARY_CHUNK_SIZE && size <= CAMERA_ANCILLARY_SIZE)
+            this->AncillarySize = size;
+        else
+            PvAttrBooleanSet(this->Handle, "ChunkModeActive", false);
+    }
+    std::cout << "Chunk mode: " << ((this->AncillarySize > 0) ? "on" : "off") << std::endl;
 
-    this->Frames[0].ImageBuffer = new char[this->FrameSize];
-    this->Frames[0].ImageBufferSize = this->FrameSize;
+    /// Single-shot mode only ever uses Frames[0]; continuous mode keeps RingSize frames queued
+    unsigned int count = (this->Continuous) ? this->RingSize : 1;
+    if (!this->Pool)
+        this->Pool = new FramePool(this->FrameSize, count + FRAMEPOOL_SPARE);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        memset(&(this->Frames[i]),0,sizeof(tPvFrame));
+
+        if (this->RingBuffers[i].isNull())  //!< A reconnected camera keeps its buffers
+            this->RingBuffers[i] = this->Pool->acquire();
+        this->Frames[i].ImageBuffer = this->RingBuffers[i].data();
+        this->Frames[i].ImageBufferSize = this->FrameSize;
+        this->Frames[i].Context[0] = this;
+        this->Frames[i].Context[1] = reinterpret_cast<void*>(static_cast<size_t>(i));
+        if (this->AncillarySize > 0)
+        {
+            this->Frames[i].AncillaryBuffer = this->AncillaryBuffers[i];
+            this->Frames[i].AncillaryBufferSize = this->AncillarySize;
+        }
+    }
 
-    PvCaptureAdjustPacketSize(this->Handle,8228);
-   // PvAttrUint32Set(this->Handle,"StreamBytesPerSecond", 115000000 / 2);
+    /// Largest packet the camera, NIC and switch all carry. Has to happen before PvCaptureStart()
+    PvPacketPath path(this->Handle);
+    if (this->Reconnecting && this->PacketInfo.PacketSize != 0)
+    {
+        /// Same camera back on the same cable: skip the probe, it costs a round trip per candidate
+        PvAttrUint32Set(this->Handle, "PacketSize", this->PacketInfo.PacketSize);
+    }
+    else
+        this->PacketInfo = PacketProbe::probe(path);
+    std::cout << "Packet size: " << this->PacketInfo.PacketSize
+              << ((this->PacketInfo.Jumbo) ? " (jumbo)" : "")
+              << ((this->PacketInfo.Fallback) ? " (fallback, no candidate negotiated)" : "")
+              << ", MTU needed " << this->PacketInfo.PacketSize
+              << ", overhead " << PACKET_OVERHEAD << " bytes/packet"
+              << ", " << this->PacketInfo.packetsPerFrame(this->FrameSize) << " packets/frame" << std::endl;
+    PvAttrUint32Set(this->Handle, "StreamBytesPerSecond", this->StreamBytesPerSecond); //!< Starting share, rebalanced by BandwidthManager
 
     //start driver stream
     PvCaptureStart(this->Handle);
-    //set frame triggers to be generated internally
-    PvAttrEnumSet(this->Handle, "FrameStartTriggerMode", "Freerun");
+    switch (this->Trigger)
+    {
+    case TriggerSlave:
+        //start each frame on the master's SyncOut1 pulse
+        PvAttrEnumSet(this->Handle, "FrameStartTriggerMode", "SyncIn1");
+        PvAttrEnumSet(this->Handle, "FrameStartTriggerEvent", "EdgeRising");
+        break;
+    case TriggerMaster:
+        //drive SyncOut1 high while exposing, so slaves start exposing with this camera
+        PvAttrEnumSet(this->Handle, "SyncOut1Mode", "Exposing");
+        PvAttrEnumSet(this->Handle, "SyncOut1Invert", "Off");
+        //fall through, the master itself free-runs
+    default:
+        //set frame triggers to be generated internally
+        PvAttrEnumSet(this->Handle, "FrameStartTriggerMode", "Freerun");
+    }
     //set camera to receive continuous number of frame triggers
     PvAttrEnumSet(this->Handle, "AcquisitionMode", "Continuous");
-    //PvCaptureAdjustPacketSize(this->Handle,8228);
     PvAttrUint32Set(this->Handle, "HeartbeatTimeout", 775000);
 
-    tPvUint32 interval;
-    PvAttrUint32Get(this->Handle, "HeartbeatInterval", &interval);
-    std::cout << std::endl << interval << " interval" << std::endl;
+    /// Needed to turn hardware timestamps into seconds, and to know the exposure of the first frames
+    this->TimestampFrequency = this->Snapshot.uint32("TimeStampFrequency");
+    PvAttrUint32Get(this->Handle, "ExposureValue", &this->FrameExposure);
 
-    char PartVer[50];
-    PvAttrStringGet(this->Handle, "PartVersion",PartVer,50, NULL);
-    unsigned long PartNum;
-    PvAttrUint32Get(this->Handle, "PartNumber", &PartNum);
+    /// What was written above needs no queued write. Anything queued before setup still goes out
+    this->Attributes.invalidate();
+    this->Attributes.written("ExposureValue", this->FrameExposure);
+    this->Attributes.written("RegionX", this->RegionX);
+    this->Attributes.written("RegionY", this->RegionY);
+    this->Attributes.written("StreamBytesPerSecond", this->StreamBytesPerSecond);
+    this->Unconfirmed.clear();
 
-    std::cout << "PartVer: " << PartVer << "\nPartNum: " << PartNum << std::endl;
+    /// Setup changed geometry, formats and triggers, so cached values are read again when asked for
+    this->Snapshot.invalidate();
+
+    std::cout << std::endl << this->Snapshot.uint32("HeartbeatInterval") << " interval" << std::endl;
+    std::cout << "PartVer: " << this->Snapshot.text("PartVersion").toStdString()
+              << "\nPartNum: " << this->Snapshot.uint32("PartNumber") << std::endl;
 }
 
 void Camera::captureEnd()
 {
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        this->Stopping = true;
+    }
     if (!this->Disconnected)
     {
         PvCommandRun(this->Handle, "AcquisitionStop");
+        if (this->Streaming)
+        {
+            PvCaptureQueueClear(this->Handle);  //!< Returns all queued frames with ePvErrCancelled
+            this->Streaming = false;
+        }
         PvCaptureEnd(this->Handle);
         PvCameraClose(this->Handle);
     }
+
+    /// Wakes the camera thread in case it is still waiting in capture()
+    QMutexLocker locker(&this->FrameMutex);
+    this->Disconnected = true;
+    this->FrameCondition.wakeAll();
 }
 
-void Camera::capture()
+void PVDECL Camera::FrameDoneCallback(tPvFrame* Frame)
 {
+    Camera* cam = static_cast<Camera*>(Frame->Context[0]);
+    int index = static_cast<int>(reinterpret_cast<size_t>(Frame->Context[1]));
 
-    PvCommandRun(this->Handle, "AcquisitionStart");
-    //PvCaptureQueueClear(this->Handle);
+    if (Frame->Status == ePvErrCancelled) //!< Queue was cleared by captureEnd()
+        return;
 
-    tPvErr errcode;
-    do
+    QMutexLocker locker(&cam->FrameMutex);
+    if (Frame->Status == ePvErrUnplugged)
+        cam->Disconnected = true;
+    else
     {
-        errcode = PvCaptureQueueFrame(this->Handle, &(this->Frames[0]), NULL);
-        PvCaptureWaitForFrameDone(this->Handle, &(this->Frames[0]), PVINFINITE);
-    }while (errcode != ePvErrSuccess && errcode != ePvErrUnplugged);
+        cam->HostTimes[index] = hostTimeUs();
+        cam->CompletedFrames.enqueue(index);
+    }
+    cam->FrameCondition.wakeOne();
+}
 
-    //if (errcode != ePvErrSuccess)
-        //std::cout << "Frame is Kill" << std::endl;
+void Camera::startStreaming()
+{
+    for (unsigned int i = 0; i < this->RingSize; i++)
+        if (!this->RingBuffers[i].isNull())     //!< Entries the pool had no buffer for join later, see requeueStarved()
+            PvCaptureQueueFrame(this->Handle, &(this->Frames[i]), FrameDoneCallback);
 
-    PvCommandRun(this->Handle, "AcquisitionStop");
+    PvCommandRun(this->Handle, "AcquisitionStart");
+    this->Streaming = true;
+}
+
+void Camera::requeueFrame(int index)
+{
+    if (this->RingBuffers[index].isNull() && !refillFrame(index))
+        return; //!< Consumers hold every buffer, the driver counts what arrives meanwhile as dropped
+    tPvErr errcode = PvCaptureQueueFrame(this->Handle, &(this->Frames[index]), FrameDoneCallback);
     if (errcode == ePvErrUnplugged)
     {
+        QMutexLocker locker(&this->FrameMutex);
         this->Disconnected = true;
-        QMessageBox errBox;
-        errBox.critical(0,"Error","Camera unplugged. Please replug camera and restart program.");
-        errBox.setFixedSize(500,200);
-        QApplication::exit(1);
     }
+}
+
+void Camera::handOut(int index)
+{
+    this->CurrentFrame = this->Frames[index];
+    this->CurrentBuffer = this->RingBuffers[index];
+
+    tPvFrame* frame = &(this->CurrentFrame);
+    this->CurrentInfo.CameraID = this->ID;
+    this->CurrentInfo.Timestamp = (static_cast<unsigned long long>(frame->TimestampHi) << 32) | frame->TimestampLo;
+    this->CurrentInfo.TimestampFrequency = this->TimestampFrequency;
+    this->CurrentInfo.FrameCount = frame->FrameCount;
+    this->CurrentInfo.HostTime = this->HostTimes[index];
+    this->CurrentInfo.StreamBytesPerSecond = this->StreamBytesPerSecond;
+    this->CurrentInfo.Width = frame->Width;
+    this->CurrentInfo.Height = frame->Height;
+    this->CurrentInfo.ImageSize = frame->ImageSize;
+    this->CurrentInfo.Format = static_cast<FrameFormat>(frame->Format);   //!< Same numbering, see frameformat.h
+    this->CurrentInfo.BitDepth = frame->BitDepth;
+    this->CurrentInfo.BayerPattern = static_cast<BayerLayout>(frame->BayerPattern);
+    this->CurrentInfo.OffsetX = this->Crop.x();
+    this->CurrentInfo.OffsetY = this->Crop.y();
+    this->CurrentInfo.Binning = this->Binning;
+    this->CurrentInfo.SensorX = this->RegionX + this->Crop.x();
+    this->CurrentInfo.SensorY = this->RegionY + this->Crop.y();
+
+    /// Chunk data says what the frame was really exposed with. Without it, the last confirmed write is assumed
+    this->CurrentInfo.Ancillary = false;
+    this->CurrentInfo.AcquisitionCount = 0;
+    this->CurrentInfo.Gain = 0;
+    this->CurrentInfo.SyncInLevels = 0;
+    this->CurrentInfo.SyncOutLevels = 0;
+    this->CurrentInfo.readAncillary(frame->AncillaryBuffer, frame->AncillarySize);
+    confirmAttributes();
+    if (this->CurrentInfo.Ancillary)
+        this->FrameExposure = this->CurrentInfo.ExposureValue;
+    else
+        this->CurrentInfo.ExposureValue = this->FrameExposure;
+
+    QMutexLocker locker(&this->StatisticsMutex);
+    this->Statistics.Delivered++;
+    if (this->ResumePending)
+    {
+        QMutexLocker frameLocker(&this->FrameMutex);
+        qint64 now = hostTimeUs();
+        this->Statistics.Reconnects++;
+        this->Statistics.OutageMs = static_cast<unsigned long>((now - this->UnpluggedAt) / 1000);
+        this->Statistics.ResumeMs = static_cast<unsigned long>((now - this->RepluggedAt) / 1000);
+        this->UnpluggedAt = 0;
+        this->ResumePending = false;
+    }
+
+    refillFrame(index);
+}
 
+bool Camera::refillFrame(int index)
+{
+    this->RingBuffers[index] = this->Pool->acquire();
+    this->Frames[index].ImageBuffer = this->RingBuffers[index].data();
+    return !this->RingBuffers[index].isNull();
+}
 
-    if (Mono16)
+void Camera::requeueStarved()
+{
+    while (true)
     {
-        medianFilter(3);
-        /*// Median Filter
-        unsigned short* rawPtr = static_cast<unsigned short*>(Frames[0].ImageBuffer);
-        unsigned char* filter = new unsigned char[Frames[0].ImageSize];
-        memset(filter, 0, Frames[0].ImageSize);
-        unsigned short* filterPtr = reinterpret_cast<unsigned short*>(filter);
-        QVector<unsigned short> window(9);    
-        for (int i = 1; i < Frames[0].Height - 1; i++)
+        bool queued = false;
+        for (unsigned int i = 0; i < this->RingSize; i++)
         {
-            for (int j = 1; j < Frames[0].Width - 1; j++)
-            {
-                window[0] = rawPtr[Frames[0].Width*(i-1) + (j-1)];
-                window[1] = rawPtr[Frames[0].Width*(i-1) + (j)];
-                window[2] = rawPtr[Frames[0].Width*(i-1) + (j+1)];
-                window[3] = rawPtr[Frames[0].Width*(i) + (j-1)];
-                window[4] = rawPtr[Frames[0].Width*(i) + (j)];
-                window[5] = rawPtr[Frames[0].Width*(i) + (j+1)];
-                window[6] = rawPtr[Frames[0].Width*(i+1) + (j-1)];
-                window[7] = rawPtr[Frames[0].Width*(i+1) + (j)];
-                window[8] = rawPtr[Frames[0].Width*(i+1) + (j+1)];
-
-                qSort(window);
-                filterPtr[Frames[0].Width*(i) + j] = window[4];
-            }
-        }*/
+            if (this->RingBuffers[i].isNull() && refillFrame(i))
+                requeueFrame(i);
+            queued = queued || !this->RingBuffers[i].isNull();
+        }
+        if (queued)
+            return;
 
+        QMutexLocker locker(&this->FrameMutex);
+        if (this->Stopping || this->Disconnected)
+            return;
+        this->FrameCondition.wait(&this->FrameMutex, CAMERA_STARVED_POLL);
+    }
+}
 
+int Camera::waitForFrame()
+{
+    int completed[MAX_FRAMESCOUNT];
+    while (true)
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        while (this->CompletedFrames.isEmpty() && !this->Disconnected && !this->Stopping)
+            this->FrameCondition.wait(&this->FrameMutex);
+
+        if (this->Disconnected || this->Stopping)
+            return -1;
 
+        int count = 0;
+        while (!this->CompletedFrames.isEmpty())
+            completed[count++] = this->CompletedFrames.dequeue();
+        locker.unlock();
 
-        /*//Binning Correcting Factor
-        unsigned char * correct = new unsigned char[Frames[0].ImageSize];
-        unsigned short* correctPtr = reinterpret_cast<unsigned short*>(correct);
-        for (int i = 0; i < Frames[0].Height/2; i++)
+        /// Only the newest good frame is worth processing. Older ones go straight back to the driver.
+        int index = -1;
+        for (int i = 0; i < count; i++)
         {
-            for (int j = 0; j < Frames[0].Width/2; j++)
+            accountFrame(&(this->Frames[completed[i]]));
+            if (this->Frames[completed[i]].Status != ePvErrSuccess)
+            {
+                requeueFrame(completed[i]); //!< Frame was lost or incomplete, wait for the next one
+                continue;
+            }
+            if (index >= 0)
             {
-                //correctPtr[Frames[0].Width*2*i + 2*j] = rawPtr[Frames[0].Width*i + j];
-                correctPtr[coord(2*i,2*j,Frames[0].Width)] = filterPtr[Frames[0].Width*(i+100) + (j+135)];
+                requeueFrame(index);
+                QMutexLocker statsLocker(&this->StatisticsMutex);
+                this->Statistics.Skipped++;
+            }
+            index = completed[i];
+        }
+
+        if (index >= 0)
+            return index;
+    }
+}
 
-                //correctPtr[Frames[0].Width*2*i + 2*j+1] = rawPtr[Frames[0].Width*i + j];
-                correctPtr[coord(2*i,(2*j + 1), Frames[0].Width)] = filterPtr[Frames[0].Width*(i+100) + (j+135)];
+void Camera::applyAttributes()
+{
+    QVector<AttributeChange> changes = this->Attributes.take();
+    if (changes.isEmpty())
+        return;
 
-                //correctPtr[Frames[0].Width*2*i + 1 + 2*j] = rawPtr[Frames[0].Width*i + j];
-                correctPtr[coord((2*i + 1) , 2*j, Frames[0].Width)] = filterPtr[Frames[0].Width*(i+100) + (j+135)];
+    int written = 0;
+    for (int i = 0; i < changes.count(); i++)
+    {
+        QString name = changes[i].Name;
+        unsigned long value = changes[i].Value;
 
-                //correctPtr[Frames[0].Width*2*i + 1 + 2*j + 1] = rawPtr[Frames[0].Width*i + j];
-                correctPtr[coord((2*i + 1), (2*j + 1), Frames[0].Width)] = filterPtr[Frames[0].Width*(i+100) + (j+135)];
-            }
-        }*/
-        //memcpy(rawPtr,correctPtr,Frames[0].ImageSize);
-        //memcpy(rawPtr, filterPtr, Frames[0].ImageSize);
+        /// The region places the whole window in unbinned pixels, so it does not move when binning or the crop change
+        if (name == "RegionX")
+        {
+            this->RegionX = value;
+            value = (value + this->Crop.x()) / this->Binning;
+        }
+        else if (name == "RegionY")
+        {
+            this->RegionY = value;
+            value = (value + this->Crop.y()) / this->Binning;
+        }
 
-        //delete[] filter;
-        //delete[] correct;
+        tPvErr errcode = PvAttrUint32Set(this->Handle, name.toLatin1().constData(), value);
+        if (errcode == ePvErrUnplugged)
+        {
+            this->Attributes.post(name, changes[i].Value);  //!< Kept for when the camera is back
+            continue;
+        }
+        if (errcode != ePvErrSuccess)
+        {
+            std::cout << "Camera rejected " << name.toStdString() << " = " << value << " (error " << errcode << ")" << std::endl;
+            continue;
+        }
+        this->Attributes.written(name, changes[i].Value);
+        this->Snapshot.update(name, value);
+
+        AppliedAttribute applied;
+        applied.Change = changes[i];
+        applied.Latch = 0;
+        applied.Latched = true;
+        applied.WrittenAt = 0;
+        this->Unconfirmed.append(applied);
+        written++;
     }
+    if (written == 0)
+        return;
 
-    emit frameReady(this);
+    /// Frames stamped after this latch started exposing after the writes. Frames already exposing
+    /// or queued in the driver are not, whatever order they arrive in. In single-shot mode the
+    /// next frame has not started yet, so any frame will do
+    unsigned long long latch = 0;
+    bool latched = true;
+    if (this->Continuous)
+    {
+        tPvUint32 hi = 0;
+        tPvUint32 lo = 0;
+        latched = PvCommandRun(this->Handle, "TimeStampValueLatch") == ePvErrSuccess
+                  && PvAttrUint32Get(this->Handle, "TimeStampValueHi", &hi) == ePvErrSuccess
+                  && PvAttrUint32Get(this->Handle, "TimeStampValueLo", &lo) == ePvErrSuccess;
+        latch = (static_cast<unsigned long long>(hi) << 32) | lo;
+    }
+    qint64 now = hostTimeUs();
+    for (int i = this->Unconfirmed.count() - written; i < this->Unconfirmed.count(); i++)
+    {
+        this->Unconfirmed[i].Latch = latch;
+        this->Unconfirmed[i].Latched = latched;
+        this->Unconfirmed[i].WrittenAt = now;
+    }
 }
 
-void Camera::SetMono16Bit()
+void Camera::confirmAttributes()
 {
-    this->Mono16 = true;
+    for (int i = 0; i < this->Unconfirmed.count(); )
+    {
+        const AppliedAttribute &applied = this->Unconfirmed[i];
+        bool carried;
+        if (this->CurrentInfo.Ancillary && applied.Change.Name == "ExposureValue"
+                && this->CurrentInfo.ExposureValue == applied.Change.Value)
+            carried = true;     //!< The frame's own chunk data says so
+        else if (applied.Latched)
+            carried = this->CurrentInfo.Timestamp >= applied.Latch;
+        else    //!< Without the camera clock, wait for a frame that arrived a whole exposure after the write
+            carried = this->CurrentInfo.HostTime - static_cast<qint64>(this->FrameExposure) >= applied.WrittenAt;
+        if (!carried)
+        {
+            i++;
+            continue;
+        }
+
+        if (applied.Change.Name == "ExposureValue")
+            this->FrameExposure = applied.Change.Value;
+        else if (applied.Change.Name == "StreamBytesPerSecond")
+        {
+            /// Frames still in flight were sent at the old rate, so only frames from this one on carry the new one
+            this->StreamBytesPerSecond = applied.Change.Value;
+            this->CurrentInfo.StreamBytesPerSecond = applied.Change.Value;
+        }
+        FrameInfo info = this->CurrentInfo;
+        if (!info.Ancillary)
+            info.ExposureValue = this->FrameExposure;
+        emit attributeApplied(this, applied.Change.Name, applied.Change.Value, applied.Change.Requested, info);
+        this->Unconfirmed.remove(i);
+    }
 }
 
-bool Camera::isWhiteLight()
+void Camera::accountFrame(const tPvFrame *frame)
 {
-    char PartVer[20];
-    tPvErr uwut = PvAttrStringGet(this->Handle, "PartVersion",PartVer, 20, NULL);
-    unsigned long PartNum;
-    tPvErr uwut2 = PvAttrUint32Get(this->Handle, "PartNumber", &PartNum);
+    QMutexLocker locker(&this->StatisticsMutex);
 
-    if ((std::strcmp(PartVer, "A") == 0) && PartNum == 20007)
-        return true;
-    return false;
+    if (frame->Status == ePvErrDataMissing)
+        this->Statistics.Incomplete++;
+    else if (frame->Status == ePvErrDataLost)
+        this->Statistics.Dropped++;
+
+    if (frame->FrameCount == 0) //!< No block ID, nothing to compare against
+        return;
+
+    if (this->HaveFrameCount)
+    {
+        /// Block IDs run 1..65535 and skip 0 when they roll over
+        long gap = static_cast<long>(frame->FrameCount) - static_cast<long>(this->LastFrameCount);
+        bool rollover = this->LastFrameCount > CAMERA_BLOCK_ID_MAX - CAMERA_BLOCK_ID_WRAP
+                && frame->FrameCount <= CAMERA_BLOCK_ID_WRAP;
+        if (gap <= 0 && rollover)
+            gap += CAMERA_BLOCK_ID_MAX;
+
+        /// A repeated or out-of-order ID only moves the count back, it says nothing about drops
+        if (gap > 1)
+            this->Statistics.Dropped += gap - 1;
+    }
+    this->LastFrameCount = frame->FrameCount;
+    this->HaveFrameCount = true;
 }
 
-bool Camera::isNearInfrared()
+void Camera::readDriverStatistics()
 {
-    char PartVer[20];
-    PvAttrStringGet(this->Handle, "PartVersion",PartVer, 20, NULL);
-    unsigned long PartNum;
-    PvAttrUint32Get(this->Handle, "PartNumber", &PartNum);
-
-    if ((std::strcmp(PartVer, "B") == 0) && PartNum == 20030)
-        return true;
-    return false;
+    tPvUint32 framesDropped = 0;
+    tPvUint32 packetsMissed = 0;
+    tPvUint32 packetsResent = 0;
+    PvAttrUint32Get(this->Handle, "StatFramesDropped", &framesDropped);
+    PvAttrUint32Get(this->Handle, "StatPacketsMissed", &packetsMissed);
+    PvAttrUint32Get(this->Handle, "StatPacketsResent", &packetsResent);
+
+    QMutexLocker locker(&this->StatisticsMutex);
+    this->Statistics.DriverDropped = framesDropped;
+    this->Statistics.PacketsMissed = packetsMissed;
+    this->Statistics.PacketsResent = packetsResent;
 }
 
-void Camera::copyCamera(Camera &cam)
+CaptureStatistics Camera::getStatistics()
 {
-    std::strncpy(this->CameraName, cam.CameraName, 32);
-    this->Handle = cam.Handle;
-    for (int i = 0; i < FRAMESCOUNT; i++)
-        this->Frames[i] = cam.Frames[i];
-    this->FrameSize = cam.FrameSize;
-    this->Mono16 = cam.Mono16;
-    this->Disconnected = cam.Disconnected;
+    QMutexLocker locker(&this->StatisticsMutex);
+    return this->Statistics;
 }
 
-void Camera::changeBinning(int scale)
+tPvErr Camera::captureSingle()
 {
-    PvAttrUint32Set(this->Handle, "BinningX", scale);
-    PvAttrUint32Set(this->Handle, "BinningY", scale);
+    /// The last frame's buffer went to consumers, a fresh one is needed to fill
+    while (this->RingBuffers[0].isNull() && !refillFrame(0))
+    {
+        QMutexLocker locker(&this->FrameMutex);
+        if (this->Stopping || this->Disconnected)
+            return ePvErrCancelled;
+        this->FrameCondition.wait(&this->FrameMutex, CAMERA_STARVED_POLL);
+    }
+
+    PvCommandRun(this->Handle, "AcquisitionStart");
+    //PvCaptureQueueClear(this->Handle);
+
+    tPvErr errcode;
+    do
+    {
+        errcode = PvCaptureQueueFrame(this->Handle, &(this->Frames[0]), NULL);
+        PvCaptureWaitForFrameDone(this->Handle, &(this->Frames[0]), PVINFINITE);
+    }while (errcode != ePvErrSuccess && errcode != ePvErrUnplugged);
+
+    //if (errcode != ePvErrSuccess)
+        //std::cout << "Frame is Kill" << std::endl;
+
+    PvCommandRun(this->Handle, "AcquisitionStop");
+    return errcode;
 }
 
-void Camera::medianFilter(int radius)
+void Camera::capture()
 {
-    unsigned short* rawPtr = static_cast<unsigned short*>(Frames[0].ImageBuffer);
-    unsigned char* filter = new unsigned char[Frames[0].ImageSize];
-    memset(filter, 0, Frames[0].ImageSize);
-    unsigned short* filterPtr = reinterpret_cast<unsigned short*>(filter);
+    tPvErr errcode = ePvErrSuccess;
 
-    int h = Frames[0].Height;
-    int w = Frames[0].Width;
-    int Histogram[4096] = {0};
-    int median = 0;
-    int middle_element = (((2*radius + 1)*(2*radius+1))/2);
+    applyAttributes();
 
-    for (int j = 0; j < (2*radius + 1); j++)
+    this->FrameMutex.lock();
+    unsigned int binning = this->PendingBinning;
+    QRect crop = this->PendingCrop;
+    this->FrameMutex.unlock();
+    if (binning != this->Binning || crop != this->Crop)
+        changeGeometry(binning, crop);
+
+    if (this->Continuous)
     {
-        for (int i = 0; i < (2*radius + 1); i++)
+        if (!this->Streaming)
+            startStreaming();
+        requeueStarved();
+
+        int index = waitForFrame();
+        while (index < 0)
         {
-            Histogram[rawPtr[coord(i,j,w)]]++;
+            /// Unplugged: the rest of the program keeps running while the camera is brought back
+            if (!reconnect())
+                return; //!< Stopped by captureEnd(), nothing to report
+            startStreaming();
+            requeueStarved();
+            index = waitForFrame();
         }
-    }
 
-    int sum = 0;
-    int k = 0;
-    while (sum <= middle_element)
+        /// The ring entry gets a fresh buffer, so it can be refilled while this one is processed
+        handOut(index);
+        requeueFrame(index);
+    }
+    else
     {
-        sum += Histogram[k];
-        k++;
+        while ((errcode = captureSingle()) == ePvErrUnplugged)
+        {
+            if (!reconnect())
+                return;
+        }
+        if (errcode == ePvErrCancelled)
+            return; //!< Stopped while waiting for a buffer
+        this->HostTimes[0] = hostTimeUs();
+        accountFrame(&(this->Frames[0]));
+        handOut(0);
     }
-    k--;
-    median = k;
-    filterPtr[coord(radius,radius,w)] = median;
 
-    int x = radius + 1;
-    int y = radius;
-    while (true)
+    /// Recorders get the frame as the sensor delivered it, before anything below replaces or corrects it
+    emit rawFrameReady(this, this->CurrentBuffer, this->CurrentInfo);
+
+    /// Driver counters cost a network round trip each, so they're only refreshed once a second
+    if (hostTimeUs() - this->LastStatisticsRead > 1000000)
     {
-        for (x = radius + 1; x < (w - radius); x++) //Replace then Slide right
-        {
-            for (int i = 0; i < (2*radius + 1); i++)
-            {
-                Histogram[rawPtr[coord(x - (radius+1), y - radius + i, w)]]--;
-                Histogram[rawPtr[coord(x + radius, y - radius + i, w)]]++;
-            }
+        readDriverStatistics();
+        this->LastStatisticsRead = hostTimeUs();
+    }
 
-            sum = 0;
-            k = 0;
-            while (sum <= middle_element)
-            {
-                sum += Histogram[k];
-                k++;
-            }
-            median = k;
-            filterPtr[coord(x,y,w)] = median;
-        }
-        x--;
-        y++;
+    /// NIR frames are corrected and denoised into buffers of their own, the raw one is left as it was
+    this->CurrentBuffer = processFrame(this->CurrentBuffer, this->CurrentInfo, this->Pool);
+    this->CurrentFrame.ImageBuffer = this->CurrentBuffer.data();
 
-        //if (y out of bounds) break;
-        if (y + radius >= h)
-            break;
+    emit frameReady(this, this->CurrentBuffer, this->CurrentInfo);
+}
 
-        for (int i = 0; i < (2*radius + 1); i++) //Slide down
-        {
-            Histogram[rawPtr[coord(x - radius + i, y-(radius+1),w)]]--;
-            Histogram[rawPtr[coord(x - radius + i, y + radius, w)]]++;
-        }
+void Camera::SetMono16Bit()
+{
+    this->Mono16 = true;
+}
 
-        sum = 0;
-        k = 0;
-        while (sum <= middle_element)
-        {
-            sum += Histogram[k];
-            k++;
-        }
-        median = k;
-        filterPtr[coord(x,y,w)] = median;
-        x--; //Initial Slide left
+void Camera::setContinuous(bool enable)
+{
+    this->Continuous = enable;
+}
 
-        while (x >= radius) //Replace then Slide left
-        {
+void Camera::setRingSize(unsigned int count)
+{
+    if (count < 2)
+        count = 2;
+    if (count > MAX_FRAMESCOUNT)
+        count = MAX_FRAMESCOUNT;
+    this->RingSize = count;
+}
 
-            for (int i = 0; i < (2*radius + 1); i++)
-            {
-                Histogram[rawPtr[coord(x + (radius+1), y - radius + i, w)]]--;
-                Histogram[rawPtr[coord(x - radius, y - radius + i, w)]]++;
-            }
+void Camera::setTriggerMode(TriggerMode mode)
+{
+    this->Trigger = mode;
+}
 
-            sum = 0;
-            k = 0;
-            while (sum <= middle_element)
-            {
-                sum += Histogram[k];
-                k++;
-            }
-            median = k;
-            filterPtr[coord(x,y,w)] = median;
-            x--;
-        }
-        x++;
-        y++; //Initial Slide down
+bool Camera::isWhiteLight()
+{
+    if (this->Snapshot.text("PartVersion") == "A" && this->Snapshot.uint32("PartNumber") == 20007)
+        return true;
+    return false;
+}
 
-        if (y + radius >= h)
-            break;
+bool Camera::isNearInfrared()
+{
+    if (this->Snapshot.text("PartVersion") == "B" && this->Snapshot.uint32("PartNumber") == 20030)
+        return true;
+    return false;
+}
 
-        for (int i = 0; i < (2*radius + 1); i++) //Slide down
-        {
-            Histogram[rawPtr[coord(x - radius + i, y-(radius+1),w)]]--;
-            Histogram[rawPtr[coord(x - radius + i, y + radius, w)]]++;
-        }
+AttributeSnapshot* Camera::getSnapshot()
+{
+    return &(this->Snapshot);
+}
 
-        sum = 0;
-        k = 0;
-        while (sum <= middle_element)
-        {
-            sum += Histogram[k];
-            k++;
-        }
-        median = k;
-        filterPtr[coord(x,y,w)] = median;
+void Camera::copyCamera(Camera &cam)
+{
+    std::strncpy(this->CameraName, cam.CameraName, 32);
+    this->Handle = cam.Handle;
+    for (int i = 0; i < MAX_FRAMESCOUNT; i++)
+        this->Frames[i] = cam.Frames[i];
+    this->FrameSize = cam.FrameSize;
+    this->Mono16 = cam.Mono16;
+    this->Disconnected = cam.Disconnected;
+    this->RingSize = cam.RingSize;
+    this->Continuous = cam.Continuous;
+    this->CurrentFrame = cam.CurrentFrame;
+}
 
+void Camera::changeGeometry(unsigned int scale, const QRect &crop)
+{
+    this->Processor.reset();    //!< A crop of the same size still shows other pixels
+
+    /// Frame geometry is locked while acquiring. Queued frames come back cancelled and are requeued below
+    bool streaming = this->Streaming;
+    if (streaming)
+    {
+        PvCommandRun(this->Handle, "AcquisitionStop");
+        PvCaptureQueueClear(this->Handle);
+        this->Streaming = false;
+        QMutexLocker locker(&this->FrameMutex);
+        this->CompletedFrames.clear();
     }
-    memcpy(rawPtr, filterPtr, Frames[0].ImageSize);
-    delete[] filter;
+
+    /// The region goes to the corner first, so a growing window never sticks out of the sensor
+    PvAttrUint32Set(this->Handle, "RegionX", 0);
+    PvAttrUint32Set(this->Handle, "RegionY", 0);
+    PvAttrUint32Set(this->Handle, "BinningX", scale);
+    PvAttrUint32Set(this->Handle, "BinningY", scale);
+    PvAttrUint32Set(this->Handle, "Width", crop.width() / scale);
+    PvAttrUint32Set(this->Handle, "Height", crop.height() / scale);
+    PvAttrUint32Set(this->Handle, "RegionX", (this->RegionX + crop.x()) / scale);
+    PvAttrUint32Set(this->Handle, "RegionY", (this->RegionY + crop.y()) / scale);
+    this->Binning = scale;
+    this->Crop = crop;
+
+    /// Binned and cropped frames are smaller, so they fit the buffers allocated for full resolution
+    PvAttrUint32Get(this->Handle, "TotalBytesPerFrame", &this->FrameSize);
+    this->Snapshot.invalidate();
+    this->HaveFrameCount = false;   //!< Don't count the frames skipped while stopped as dropped
+    std::cout << "Binning " << scale << "x" << scale << ", " << crop.width() / scale << "x" << crop.height() / scale
+              << " at (" << crop.x() << "," << crop.y() << "), " << this->FrameSize << " bytes/frame" << std::endl;
+
+    if (streaming)
+        startStreaming();
 }
@@ -20,7 +20,7 @@
  *
  * The Camera class is an object that represents an AVT Camera.
  * The Camera class has functions for connecting to a camera and
- * capturing frames
+ * capturing frames. It is the PvAPI implementation of FrameSource
  */
 
 #ifndef CAMERA_H
@@ -28,7 +28,17 @@
 
 #define _OSX
 #define _x64
-#define FRAMESCOUNT 3
+#define FRAMESCOUNT 3        //!< Default number of frames kept queued in continuous mode
+#define MAX_FRAMESCOUNT 16   //!< Upper bound for the continuous-mode frame ring
+#define MAX_BINNING 8        //!< Largest binning factor setBinning() accepts
+#define CAMERA_VIEW_WIDTH 640  //!< Width of the sensor window streamed when nothing is cropped, in unbinned pixels
+#define CAMERA_VIEW_HEIGHT 480 //!< Height of that window
+#define CAMERA_CROP_ALIGN 8  //!< Crop edges are multiples of this, so every binning factor divides them
+#define CAMERA_ANCILLARY_SIZE 256 //!< Largest chunk data a frame may carry, chunk mode stays off above it
+#define CAMERA_RECONNECT_POLL 250 //!< Milliseconds between attempts to reopen an unplugged camera, in case its link event is missed
+#define CAMERA_STARVED_POLL 20    //!< Milliseconds between looks for a free buffer when the whole ring is out of them
+#define CAMERA_BLOCK_ID_MAX 65535 //!< Last block ID before the camera's frame counter rolls over to 1
+#define CAMERA_BLOCK_ID_WRAP 1024 //!< Block IDs this close to either end of the range are taken for a rollover when they go backwards
 
 //#define coord(x,y,width) (y*width + x)
 
@@ -36,12 +46,38 @@
 #include <QThread>
 #include <QMessageBox>
 #include <QApplication>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <framepool.h>
+#include <frameinfo.h>
+#include <framesource.h>
+#include <packetprobe.h>
+#include <attributequeue.h>
+#include <attributesnapshot.h>
 #include <PvAPI/PvApi.h>
 #include <PvAPI/PvRegIo.h>
 #include <cstring>
 #include <iostream>
 
-class Camera : public QObject
+/**
+ * @brief PacketPath to a real camera through PvAPI
+ *
+ * Must be probed before PvCaptureStart(), the driver refuses to change the packet size while capturing.
+ */
+class PvPacketPath : public PacketPath
+{
+public:
+    explicit PvPacketPath(tPvHandle handle);
+
+    bool adjust(unsigned long maximum);
+    unsigned long packetSize();
+
+private:
+    tPvHandle       Handle;         //!< Camera being probed
+};
+
+class Camera : public FrameSource
 {
     Q_OBJECT
 public:
@@ -72,6 +108,25 @@ public:
      */
     void setID(unsigned long ID);
 
+    /**
+     * @brief Gets the Camera's UniqueID
+     */
+    unsigned long getID();
+
+    /**
+     * @brief Sets the IP address GrabHandleFromID() tries first
+     *
+     * Lets a camera be opened without PvAPI's discovery broadcast (see PvInitializeNoDiscovery()).
+     *
+     * @param address IPv4 address in network byte order, 0 to open by UniqueID only
+     */
+    void setAddress(unsigned long address);
+
+    /**
+     * @brief Gets the IP address set with setAddress(), 0 if none
+     */
+    unsigned long getAddress();
+
     /**
      * @brief Sets Camera's CameraName = the parameter passed
      *
@@ -82,10 +137,107 @@ public:
     /**
      * @brief Gets the Camera's Frame (where the image data is stored)
      *
+     * The returned frame describes the frame last handed out by capture(). Its
+     * ImageBuffer is the same buffer getFrame() returns.
+     *
      * @return A pointer to the Camera's Frame
      */
     tPvFrame* getFramePtr();
 
+    /**
+     * @brief Gets a shared handle to the pixel data of the frame last handed out by capture()
+     *
+     * The handle keeps the buffer alive after the camera has moved on to the next frame,
+     * so consumers can hold on to it instead of copying the data.
+     *
+     * @return Reference-counted handle to the frame's buffer
+     */
+    FrameBuffer getFrame();
+
+    /**
+     * @brief Gets the metadata of the frame last handed out by capture()
+     *
+     * Prefer the copy passed along with frameReady(), which cannot change underneath the caller.
+     */
+    FrameInfo getFrameInfo();
+
+    /**
+     * @brief Queues the camera's exposure time, written by capture() before the next frame
+     *
+     * Returns straight away. Frames keep reporting the old exposure in FrameInfo::ExposureValue
+     * until the first frame exposed with the new one, which is announced by attributeApplied().
+     *
+     * @param exposure Exposure time in microseconds
+     */
+    void setExposure(unsigned long exposure);
+
+    /**
+     * @brief Gets a snapshot of the camera's frame counters
+     *
+     * Thread-safe, may be called from the GUI thread while the camera streams.
+     */
+    CaptureStatistics getStatistics();
+
+    /**
+     * @brief Gets the exposure last asked for with setExposure(), or set up by captureSetup(). Thread-safe
+     * @return Exposure time in microseconds, 0 before either
+     */
+    unsigned long getExposure();
+
+    /**
+     * @brief Gets the size of one frame on the wire, as read in captureSetup()
+     * @return TotalBytesPerFrame in bytes, 0 before captureSetup()
+     */
+    unsigned long getFrameSize();
+
+    /**
+     * @brief Gets the stream packet size negotiated in captureSetup()
+     */
+    PacketProbeResult getPacketInfo();
+
+    /**
+     * @brief Sets the camera's share of the link bandwidth
+     *
+     * Queued like setExposure(), so it is written before the first frame when called before
+     * captureSetup(). Frames report the new rate in FrameInfo::StreamBytesPerSecond from the
+     * first one sent at it, announced by attributeApplied().
+     *
+     * @param bytesPerSecond Value for the StreamBytesPerSecond attribute
+     */
+    void setStreamBytesPerSecond(unsigned long bytesPerSecond);
+
+    /**
+     * @brief Queues an integer attribute, written by capture() with PvAttrUint32Set before the next frame
+     *
+     * Only the latest value of each attribute is written, and values the camera already
+     * has are not written at all. A value the camera rejects is logged.
+     *
+     * @return true once the value is queued
+     */
+    bool setAttribute(const char* name, unsigned long value);
+
+    /**
+     * @brief Asks for factor x factor binning (NIR only), applied by capture() before the next frame
+     *
+     * The field of view stays the same: width, height and region are divided by the factor.
+     *
+     * @return true if the request was taken, false for a WL camera or a factor the camera doesn't support
+     */
+    bool setBinning(unsigned int factor);
+
+    unsigned int getBinning();
+
+    /**
+     * @brief Asks for only part of the CAMERA_VIEW_WIDTH x CAMERA_VIEW_HEIGHT window to be streamed
+     *
+     * Applied by capture() before the next frame, like setBinning(). RegionX and RegionY keep
+     * placing the whole window, the crop moves along with it.
+     *
+     * @param crop Part of the window to keep, edges multiples of CAMERA_CROP_ALIGN. The whole window turns cropping off
+     * @return true if the request was taken, false if the crop doesn't fit the window or isn't aligned
+     */
+    bool setCrop(const QRect &crop);
+
     tPvHandle* getHandle();
 
     /**
@@ -96,11 +248,22 @@ public:
      * in the private members (unsigned long ID) correspond with the physical
      * Camera's ID. The physical camera's ID can be retrieved by using the
      * PvAPI function PvCameraListEx(), then reading the Camera's ID from there.
+     * A camera with an address (see setAddress()) is opened by address first.
      *
      * @return True if camera connected succesfully, false otherwise
      */
     bool GrabHandleFromID();
 
+    /**
+     * @brief Tells the camera its link went down or came back. Thread-safe
+     *
+     * Called from the PvAPI link callback (see CameraRegistry). An unplugged camera's thread
+     * waits in capture() and reopens the camera as soon as it is back.
+     *
+     * @param present true when the camera was plugged back in, false when it was unplugged
+     */
+    void linkEvent(bool present);
+
     /**
      * @brief Gets the camera ready for capturing and streaming images
      */
@@ -108,6 +271,8 @@ public:
 
     /**
      * @brief Stops all streaming-related processes in the camera
+     *
+     * Also gives up waiting for an unplugged camera to come back.
      */
     void captureEnd();
 
@@ -116,33 +281,80 @@ public:
      */
     void SetMono16Bit();
 
+    /**
+     * @brief Enables or disables continuous acquisition
+     *
+     * In continuous mode the camera is started once and a ring of frames is kept
+     * queued in the driver, so the sensor can read out the next frame while the
+     * current one is being processed. Must be called before captureSetup().
+     *
+     * @param enable True for continuous acquisition, false for one AcquisitionStart/Stop per frame
+     */
+    void setContinuous(bool enable);
+
+    /**
+     * @brief Sets how many frames are kept queued in continuous mode
+     *
+     * Must be called before captureSetup(). Values are clamped to [2, MAX_FRAMESCOUNT].
+     *
+     * @param count Number of frame buffers in the ring
+     */
+    void setRingSize(unsigned int count);
+
+    /**
+     * @brief Sets how frames are started
+     *
+     * Must be called before captureSetup(). For synchronised capture the master's SyncOut1
+     * is wired to every slave's SyncIn1, so each slave exposes together with the master.
+     *
+     * @param mode Free-running, trigger master or trigger slave
+     */
+    void setTriggerMode(TriggerMode mode);
+
     /**
      * @brief Checks if camera is a White Light camera
+     *
+     * Answered from the attribute snapshot, without talking to the camera.
+     *
      * @return true if camera is a White Light camera, false otherwise
      */
     bool isWhiteLight();
 
     /**
      * @brief Checks if camera is a Near Infrared camera
+     *
+     * Answered from the attribute snapshot, without talking to the camera.
+     *
      * @return true if camera is a Near Infrared camera, false otherwise
      */
     bool isNearInfrared();
 
+    /**
+     * @brief Gets the camera's attributes as loaded when it was opened
+     *
+     * Constant attributes (identity, sensor) never cost a round trip. Others are read once
+     * and kept until the camera invalidates the snapshot, which setup and binning changes do.
+     */
+    AttributeSnapshot* getSnapshot();
+
     void copyCamera(Camera &cam);
 
     /**
-     * @brief Changes binning (resolution scaling) of camera equal to scale
+     * @brief Changes binning (resolution scaling) and cropping of the camera
      *
      * Note that the value passed scales it by 1/scale. So if a value of 2 is passed,
-     * the video resolution scales down by 1/2
+     * the video resolution scales down by 1/2. Width, height and region are scaled
+     * along, so the field of view does not change. Acquisition is stopped and restarted
+     * around the change, so this must run on the camera's thread (other threads use
+     * setBinning() and setCrop()).
+     *
+     * @param scale Binning factor
+     * @param crop Part of the window to stream, in unbinned pixels
      */
-    void changeBinning(int scale);
+    void changeGeometry(unsigned int scale, const QRect &crop);
 
     inline int coord(int x, int y, int width) {return (y*width + x);}
 
-    void medianFilter(int radius);
-
-
 public slots:
 
     /**
@@ -150,25 +362,171 @@ public slots:
      *
      * The frame is then stored in tPvFrame Frames inside the object itself.
      * After it's done, it emits the frameReady signal, to be used by other functions.
+     * If the camera is unplugged, waits for it to be plugged back in (see reconnect()).
      */
     void capture();
 
-signals:
+private:
+
+    /**
+     * @brief Frame-done callback invoked by PvAPI on its own thread
+     *
+     * Hands the completed frame over to the camera thread, which is waiting in capture().
+     */
+    static void PVDECL FrameDoneCallback(tPvFrame* Frame);
 
     /**
-     * @brief Signal emitted after capture() has finished capturing a frame.
-     * @param cam Pointer to this object
+     * @brief Queues every frame of the ring and starts acquisition (continuous mode)
      */
-    void frameReady(Camera* cam);
+    void startStreaming();
+
+    /**
+     * @brief Gives a frame back to the driver so it can be filled again
+     *
+     * A ring entry without a buffer gets one first. If the pool has none to spare it stays
+     * out of the ring until requeueStarved() finds one.
+     *
+     * @param index Index of the frame in Frames
+     */
+    void requeueFrame(int index);
+
+    /**
+     * @brief Attaches a fresh pool buffer to a ring entry
+     * @return false if the pool is exhausted, the entry is left without a buffer
+     */
+    bool refillFrame(int index);
+
+    /**
+     * @brief Puts ring entries left without a buffer back in the ring, once buffers come back
+     *
+     * With no entry queued no frame could ever complete, so then it waits for a buffer.
+     */
+    void requeueStarved();
+
+    /**
+     * @brief Hands the buffer of a completed frame out to consumers
+     *
+     * The frame's buffer becomes CurrentBuffer and the ring entry is given a fresh
+     * buffer from the pool, so it can be queued again straight away.
+     *
+     * @param index Index of the completed frame in Frames
+     */
+    void handOut(int index);
+
+    /**
+     * @brief Blocks until the driver has completed a frame (continuous mode)
+     *
+     * If several frames completed while the previous one was being processed, only the
+     * most recent one is returned and the older ones are queued again.
+     *
+     * @return Index of the completed frame in Frames, or -1 if the camera was unplugged
+     */
+    int waitForFrame();
+
+    /**
+     * @brief Updates the frame counters for a frame returned by the driver
+     *
+     * Detects gaps in the 16-bit frame counter (including its rollover) and failed completions.
+     * A counter that goes backwards is only a rollover from near CAMERA_BLOCK_ID_MAX to a small
+     * ID. Any other step back is a repeated or reordered frame and resyncs the counter without
+     * counting drops.
+     */
+    void accountFrame(const tPvFrame* frame);
+
+    /**
+     * @brief Reads the driver's frame and packet counters into Statistics
+     */
+    void readDriverStatistics();
+
+    /**
+     * @brief Writes the queued attributes. Camera thread only, between two frames
+     *
+     * Latches the camera clock after the writes, so handOut() can tell the first frame
+     * exposed with the new values.
+     */
+    void applyAttributes();
+
+    /**
+     * @brief Emits attributeApplied() for the writes CurrentInfo is the first frame to carry
+     */
+    void confirmAttributes();
+
+    /**
+     * @brief An attribute written by applyAttributes() that no frame has carried yet
+     */
+    struct AppliedAttribute
+    {
+        AttributeChange     Change;     //!< The write
+        unsigned long long  Latch;      //!< Camera clock just after the write, frames stamped later carry it
+        bool                Latched;    //!< False if the clock could not be read, HostTime is compared instead
+        qint64              WrittenAt;  //!< Host time (us) the write returned
+    };
+
+    /**
+     * @brief Reopens an unplugged camera and sets it up as it was. Camera thread only
+     *
+     * Waits for the camera's link to come back, retrying every CAMERA_RECONNECT_POLL ms.
+     * The frame pool, the ring's buffers and the packet size found by the first setup are
+     * kept, so the camera is streaming again after a single captureSetup() round. Exposure,
+     * region and binning are restored.
+     *
+     * @return true once the camera is set up again, false if captureEnd() was called
+     */
+    bool reconnect();
+
+    /**
+     * @brief Old capture path: one AcquisitionStart/Stop round trip per frame
+     * @return Queue error code of the last attempt
+     */
+    tPvErr captureSingle();
 
-private:
     unsigned long   ID;                     //!< Camera's ID. Retrieved from PvCameraListEx()
+    unsigned long   Address;                //!< Camera's IP address in network byte order, 0 if unknown
     char            CameraName[32];         //!< Camera's Name. Retrieved from PvCameraListEx()
     tPvHandle       Handle;                 //!< Camera's Handle. Use GrabHandleFromID() to initialize.
-    tPvFrame        Frames[FRAMESCOUNT];    //!< Camera's Frame. Use captureSetup() to initialize.
+    tPvFrame        Frames[MAX_FRAMESCOUNT];//!< Camera's Frames. Use captureSetup() to initialize.
+    unsigned int    RingSize;               //!< Number of Frames used in continuous mode
+    FrameBuffer     RingBuffers[MAX_FRAMESCOUNT]; //!< Pool buffers currently attached to Frames
+    tPvFrame        CurrentFrame;           //!< Copy of the frame last handed out by capture()
+    FrameBuffer     CurrentBuffer;          //!< Pixel data of CurrentFrame, shared with consumers
+    FramePool*      Pool;                   //!< Frame buffers. Created in captureSetup()
+    FrameInfo       CurrentInfo;            //!< Metadata of CurrentFrame
+    qint64          HostTimes[MAX_FRAMESCOUNT]; //!< Host arrival time of each ring frame
+    unsigned char   AncillaryBuffers[MAX_FRAMESCOUNT][CAMERA_ANCILLARY_SIZE]; //!< Chunk data of each ring frame
+    unsigned long   AncillarySize;          //!< Chunk data bytes per frame, 0 when chunk mode is off. Set in captureSetup()
+    unsigned long   TimestampFrequency;     //!< Camera clock ticks per second. Read in captureSetup()
+    unsigned long   FrameExposure;          //!< Exposure the frames currently coming in were taken with
+    AttributeQueue  Attributes;             //!< Writes waiting for the camera thread
+    QVector<AppliedAttribute> Unconfirmed;  //!< Writes made but not yet seen in a frame. Camera thread only
+    unsigned long   StreamBytesPerSecond;   //!< Link bandwidth the frames coming in were sent at. Camera thread only
+    CaptureStatistics Statistics;           //!< Frame counters, see getStatistics()
+    QMutex          StatisticsMutex;        //!< Guards Statistics against readers on other threads
+    unsigned long   LastFrameCount;         //!< Frame counter of the last frame returned by the driver
+    bool            HaveFrameCount;         //!< False until the first frame counter has been seen
+    qint64          LastStatisticsRead;     //!< Host time the driver counters were last read
+    bool            Continuous;             //!< True when frames are streamed without per-frame Start/Stop
+    TriggerMode     Trigger;                //!< How frames are started, see setTriggerMode()
+    bool            Streaming;              //!< True once the frame ring has been queued and acquisition started
+    QMutex          FrameMutex;             //!< Guards CompletedFrames and Disconnected against the PvAPI callback thread
+    QWaitCondition  FrameCondition;         //!< Signalled by FrameDoneCallback()
+    QQueue<int>     CompletedFrames;        //!< Indices of frames returned by the driver, oldest first
     unsigned long   FrameSize;              //!< Camera's FrameSize. Use captureSetup() to initialize.
+    PacketProbeResult PacketInfo;           //!< Packet size found by PacketProbe in captureSetup()
+    AttributeSnapshot Snapshot;             //!< Attributes read when the camera was opened, see getSnapshot()
+    unsigned int    Binning;                //!< Binning factor the camera is set to
+    unsigned int    PendingBinning;         //!< Binning factor asked for by setBinning(), guarded by FrameMutex
+    QRect           Crop;                   //!< Part of the window the camera streams, in unbinned pixels
+    QRect           PendingCrop;            //!< Crop asked for by setCrop(), guarded by FrameMutex
+    unsigned long   RegionX;                //!< Region origin in unbinned pixels, see setAttribute(). Camera thread only
+    unsigned long   RegionY;                //!< Region origin in unbinned pixels, see setAttribute(). Camera thread only
     bool            Mono16;                 //!< Determines if Camera should operate in Mono8 or Mono16 (NIR)
     bool            Disconnected;           //!< True when Camera is disconnected
+    bool            Stopping;               //!< Set by captureEnd(), guarded by FrameMutex
+    bool            Replugged;              //!< Set when the link comes back, guarded by FrameMutex
+    bool            Reconnecting;           //!< True while reconnect() runs captureSetup()
+    bool            ResumePending;          //!< True from a reconnect until the first frame after it
+    qint64          UnpluggedAt;            //!< Host time (us) the camera was lost, 0 while connected. Guarded by FrameMutex
+    qint64          RepluggedAt;            //!< Host time (us) the camera came back. Guarded by FrameMutex
 };
 
 #endif // CAMERA_H
@@ -0,0 +1,387 @@
+#include "cameraregistry.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <iostream>
+
+#ifndef NO_PVAPI
+#include <camera.h>
+
+/**
+ * @brief Link callback invoked by PvAPI on its own thread, passes the event on to the registry
+ */
+static void PVDECL linkCallback(void *context, tPvInterface linkInterface, tPvLinkEvent event, unsigned long uniqueId)
+{
+    Q_UNUSED(linkInterface);
+    static_cast<CameraRegistry*>(context)->linkEvent(uniqueId, event == ePvLinkAdd);
+}
+
+/**
+ * @brief Keeps what the registry needs of a camera PvAPI found
+ */
+static FoundCamera foundCamera(const tPvCameraInfoEx &info)
+{
+    FoundCamera found;
+    found.UniqueId = info.UniqueId;
+    found.Name = QString(info.CameraName);
+    found.Master = (info.PermittedAccess & ePvAccessMaster) != 0;
+    return found;
+}
+#endif
+
+CameraRegistry::CameraRegistry(QObject *parent) : QObject(parent)
+{
+    this->Listening = false;
+    this->Arrivals = 0;
+}
+
+CameraRegistry::~CameraRegistry()
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        CameraChannel* channel = this->Channels[i];
+        if (channel->Thread->isRunning())
+        {
+            channel->Thread->quit();
+            channel->Thread->wait();
+        }
+        delete channel->Video;
+        delete channel->Recorder;
+        delete channel->Cam;
+        delete channel->Thread;
+        delete channel;
+    }
+}
+
+int CameraRegistry::open()
+{
+    for (int i = 0; i < this->Found.count(); i++)
+        openCamera(i, 0);
+
+    if (!this->Channels.isEmpty())
+        listen();
+    return this->Channels.count();
+}
+
+#ifndef NO_PVAPI
+bool CameraRegistry::initialize(bool discovery)
+{
+    tPvErr error = (discovery) ? PvInitialize() : PvInitializeNoDiscovery();
+    if (error != ePvErrSuccess)
+    {
+        std::cout << "PvInitialize err: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void CameraRegistry::uninitialize()
+{
+    PvUnInitialize();
+}
+
+QStringList CameraRegistry::discover(int expected)
+{
+    listen();
+
+    /// Cameras answer PvAPI's broadcast within a few hundred milliseconds. Each one raises a link event
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lastArrival = 0;
+    unsigned long known = PvCameraCount();
+    while (timer.elapsed() < REGISTRY_DISCOVERY_TIMEOUT)
+    {
+        if (expected > 0 && known >= static_cast<unsigned long>(expected))
+            break;
+        if (known > 0 && timer.elapsed() - lastArrival >= REGISTRY_DISCOVERY_SETTLE)
+            break;
+
+        this->LinkMutex.lock();
+        int arrivals = this->Arrivals;
+        this->LinkCondition.wait(&this->LinkMutex, REGISTRY_DISCOVERY_SETTLE / 3);
+        bool arrived = this->Arrivals != arrivals;
+        this->LinkMutex.unlock();
+
+        unsigned long count = PvCameraCount();   //!< Also catches cameras found before listen()
+        if (arrived || count != known)
+            lastArrival = timer.elapsed();
+        known = count;
+    }
+
+    tPvCameraInfoEx list[REGISTRY_MAX_CAMERAS];
+    unsigned long count = PvCameraListEx(list, REGISTRY_MAX_CAMERAS, NULL, sizeof(tPvCameraInfoEx));
+    this->Found.clear();
+    for (unsigned long i = 0; i < count && i < REGISTRY_MAX_CAMERAS; i++)
+        this->Found.append(foundCamera(list[i]));
+
+    QStringList names;
+    for (int i = 0; i < this->Found.count(); i++)
+        names << this->Found[i].Name;
+    return names;
+}
+
+int CameraRegistry::openByAddress(const QStringList &addresses)
+{
+    /// Asking first costs one round trip per camera, and leaves nothing to undo when the list is stale
+    QVector<FoundCamera> found;
+    QVector<unsigned long> address;
+    for (int i = 0; i < addresses.count() && found.count() < REGISTRY_MAX_CAMERAS; i++)
+    {
+        tPvCameraInfoEx info;
+        address.append(addresses[i].toUInt());
+        if (PvCameraInfoByAddrEx(address.last(), &info, NULL, sizeof(tPvCameraInfoEx)) != ePvErrSuccess)
+            return 0;
+        found.append(foundCamera(info));
+    }
+    this->Found = found;
+
+    for (int i = 0; i < this->Found.count(); i++)
+        openCamera(i, address[i]);
+
+    if (!this->Channels.isEmpty())
+        listen();
+    return this->Channels.count();
+}
+
+QStringList CameraRegistry::addresses()
+{
+    QStringList list;
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        Camera* cam = qobject_cast<Camera*>(this->Channels[i]->Cam);
+        if (!cam)
+            continue;
+
+        unsigned long address = cam->getAddress();
+        tPvIpSettings settings;
+        if (address == 0 && PvCameraIpSettingsGet(cam->getID(), &settings) == ePvErrSuccess)
+            address = settings.CurrentIpAddress;
+        if (address != 0)
+            list << QString::number(address);
+    }
+    return list;
+}
+
+bool CameraRegistry::openCamera(int index, unsigned long address)
+{
+    if (!this->Found[index].Master)
+        return false;   //!< Opened by another application
+
+    QByteArray name = this->Found[index].Name.toLatin1();
+    Camera* cam = new Camera();
+    cam->setID(this->Found[index].UniqueId);
+    cam->setAddress(address);
+    cam->setCameraName(name.data());
+    if (!cam->GrabHandleFromID())
+    {
+        delete cam;
+        return false;
+    }
+
+    cam->setContinuous(true);   //!< Keeps a ring of frames queued instead of starting/stopping per frame
+    addChannel(cam, (cam->isNearInfrared()) ? RoleNearInfrared : RoleWhiteLight);
+    return true;
+}
+
+void CameraRegistry::listen()
+{
+    if (this->Listening)
+        return;
+    PvLinkCallbackRegister(linkCallback, ePvLinkAdd, this);
+    PvLinkCallbackRegister(linkCallback, ePvLinkRemove, this);
+    this->Listening = true;
+}
+
+void CameraRegistry::linkEvent(unsigned long uniqueId, bool arrived)
+{
+    QMutexLocker locker(&this->LinkMutex);
+    if (arrived)
+    {
+        this->Arrivals++;
+        this->LinkCondition.wakeAll();
+    }
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        Camera* cam = qobject_cast<Camera*>(this->Channels[i]->Cam);
+        if (cam && cam->getID() == uniqueId)
+            cam->linkEvent(arrived);
+    }
+}
+#else
+bool CameraRegistry::initialize(bool discovery)
+{
+    Q_UNUSED(discovery);
+    std::cout << "Built without PvAPI, only --synthetic and --replay are available" << std::endl;
+    return false;
+}
+
+void CameraRegistry::uninitialize()
+{
+}
+
+QStringList CameraRegistry::discover(int expected)
+{
+    Q_UNUSED(expected);
+    return QStringList();
+}
+
+int CameraRegistry::openByAddress(const QStringList &addresses)
+{
+    Q_UNUSED(addresses);
+    return 0;
+}
+
+QStringList CameraRegistry::addresses()
+{
+    return QStringList();
+}
+
+bool CameraRegistry::openCamera(int index, unsigned long address)
+{
+    Q_UNUSED(index);
+    Q_UNUSED(address);
+    return false;
+}
+
+void CameraRegistry::listen()
+{
+}
+
+void CameraRegistry::linkEvent(unsigned long uniqueId, bool arrived)
+{
+    Q_UNUSED(uniqueId);
+    Q_UNUSED(arrived);
+}
+#endif
+
+int CameraRegistry::openSynthetic(const QStringList &roles, unsigned int width, unsigned int height, double fps)
+{
+    for (int i = 0; i < roles.count(); i++)
+    {
+        CameraRole role = (roles[i].trimmed().toUpper() == "NIR") ? RoleNearInfrared : RoleWhiteLight;
+        addChannel(new SyntheticCamera(width, height, fps), role);
+    }
+    return this->Channels.count();
+}
+
+int CameraRegistry::openReplay(const QStringList &files, ReplayMode mode, bool loop)
+{
+    for (int i = 0; i < files.count(); i++)
+    {
+        ReplaySource* source = new ReplaySource(files[i], mode);
+        if (!source->isValid())
+        {
+            std::cout << "Cannot replay " << files[i].toStdString() << std::endl;
+            delete source;
+            continue;
+        }
+        source->setLoop(loop);
+        addChannel(source, (source->isNearInfrared()) ? RoleNearInfrared : RoleWhiteLight);
+    }
+    return this->Channels.count();
+}
+
+void CameraRegistry::addChannel(FrameSource *source, CameraRole role)
+{
+    CameraChannel* channel = new CameraChannel;
+    channel->Index = this->Channels.count();
+    channel->Role = role;
+    channel->Cam = source;
+    channel->Thread = new QThread();
+    channel->Video = new FFMPEG();
+    channel->Recorder = new RawRecorder();
+    channel->Display = NULL;
+    channel->RecordStart = -1;
+    channel->Screenshot = false;
+    memset(&channel->LastStatistics, 0, sizeof(CaptureStatistics));
+    channel->ExposureLag = -1;
+    channel->FirstFrame = -1;
+
+    /// First camera of a role keeps the plain name, so file names stay as they were with two cameras
+    int ordinal = 1;
+    for (int i = 0; i < this->Channels.count(); i++)
+        if (this->Channels[i]->Role == role)
+            ordinal++;
+    channel->Name = (role == RoleNearInfrared) ? "NIR" : "WL";
+    if (ordinal > 1)
+        channel->Name.append(QString::number(ordinal));
+
+    if (role == RoleNearInfrared)
+        source->SetMono16Bit();
+    source->moveToThread(channel->Thread);
+
+    QMutexLocker locker(&this->LinkMutex);
+    this->Channels.append(channel);
+}
+
+int CameraRegistry::count() const
+{
+    return this->Channels.count();
+}
+
+CameraChannel* CameraRegistry::channel(int index) const
+{
+    return this->Channels[index];
+}
+
+CameraChannel* CameraRegistry::channelOf(FrameSource *cam) const
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+        if (this->Channels[i]->Cam == cam)
+            return this->Channels[i];
+    return NULL;
+}
+
+CameraChannel* CameraRegistry::channelNamed(const QString &name) const
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+        if (this->Channels[i]->Name == name)
+            return this->Channels[i];
+    return NULL;
+}
+
+CameraChannel* CameraRegistry::primary(CameraRole role) const
+{
+    for (int i = 0; i < this->Channels.count(); i++)
+        if (this->Channels[i]->Role == role)
+            return this->Channels[i];
+    return NULL;
+}
+
+void CameraRegistry::start()
+{
+    /// Setups only talk to their own camera, so they overlap instead of adding up
+    QVector<QFuture<void> > setups;
+    for (int i = 0; i < this->Channels.count(); i++)
+        setups.append(QtConcurrent::run(this->Channels[i]->Cam, &FrameSource::captureSetup));
+    for (int i = 0; i < setups.count(); i++)
+        setups[i].waitForFinished();
+
+    for (int i = 0; i < this->Channels.count(); i++)
+        connect(this->Channels[i]->Thread, SIGNAL(started()), this->Channels[i]->Cam, SLOT(capture()));
+
+    /// Threads only start once every camera is set up, so no camera streams while another is configured
+    for (int i = 0; i < this->Channels.count(); i++)
+        this->Channels[i]->Thread->start();
+}
+
+void CameraRegistry::stop()
+{
+#ifndef NO_PVAPI
+    if (this->Listening)
+    {
+        PvLinkCallbackUnRegister(linkCallback, ePvLinkAdd);
+        PvLinkCallbackUnRegister(linkCallback, ePvLinkRemove);
+        this->Listening = false;
+    }
+#endif
+
+    for (int i = 0; i < this->Channels.count(); i++)
+    {
+        CameraChannel* channel = this->Channels[i];
+        channel->Thread->quit();
+        channel->Cam->captureEnd();     //!< Also wakes the camera thread if it is waiting for a frame
+        channel->Thread->wait(2000);
+    }
+}
@@ -0,0 +1,274 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The CameraRegistry class discovers, opens and streams any number of
+ * cameras. Each camera gets a CameraChannel holding its own capture thread,
+ * video encoder and the latest rendered frame, so adding a camera (a second
+ * NIR band for instance) means adding a channel rather than another set of
+ * Cam/thread/Video members.
+ *
+ * While streaming, the registry listens to PvAPI's link events and tells
+ * the camera concerned when it is unplugged or plugged back in, so it can
+ * reconnect on its own.
+ *
+ * Only cameraregistry.cpp talks to PvAPI here. Built with NO_PVAPI
+ * (CONFIG+=nopvapi) it has no cameras to offer, and only synthetic
+ * cameras and replayed recordings can be opened.
+ */
+
+#ifndef CAMERAREGISTRY_H
+#define CAMERAREGISTRY_H
+
+#define REGISTRY_MAX_CAMERAS 8      //!< Most cameras discover() lists
+#define REGISTRY_DISCOVERY_TIMEOUT 3000 //!< Longest discover() waits for cameras to answer, in milliseconds
+#define REGISTRY_DISCOVERY_SETTLE 300   //!< discover() returns once no camera has turned up for this long, in milliseconds
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QLabel>
+#include <framesource.h>
+#include <syntheticcamera.h>
+#include <replaysource.h>
+#include <framepool.h>
+#include <frameinfo.h>
+#include <FFMPEGClass.h>
+#include <rawrecorder.h>
+
+/**
+ * @brief What a camera looks at, decides how its frames are processed
+ */
+enum CameraRole
+{
+    RoleWhiteLight,     //!< Bayer8 colour camera
+    RoleNearInfrared    //!< Mono16 fluorescence camera, false-coloured for display
+};
+
+/**
+ * @brief A camera discover() or openByAddress() found
+ */
+struct FoundCamera
+{
+    unsigned long   UniqueId;       //!< Camera's UniqueId
+    QString         Name;           //!< Camera's name, as the user knows it
+    bool            Master;         //!< True if master access is granted, false if another application has the camera
+};
+
+/**
+ * @brief One camera and everything that belongs to its stream
+ */
+struct CameraChannel
+{
+    int             Index;          //!< Position in the registry
+    CameraRole      Role;           //!< Decides the processing chain
+    QString         Name;           //!< Display and file name, e.g. "WL", "NIR", "NIR2"
+    FrameSource*    Cam;            //!< Camera or synthetic source. Owned by the registry, lives on Thread
+    QThread*        Thread;         //!< Capture thread of Cam
+    FFMPEG*         Video;          //!< Encoder for this channel's recording
+    RawRecorder*    Recorder;       //!< Lossless recording of the sensor data, used when Recording/Raw is set
+    QLabel*         Display;        //!< Where rendered frames are shown. Not owned
+
+    QMutex          Mutex;          //!< Guards Image, Raw and Info
+    QImage          Image;          //!< Latest rendered 24-bit RGB frame (shallow, shares a pooled buffer)
+    FrameBuffer     Raw;            //!< Latest raw frame as it came from the camera
+    FrameInfo       Info;           //!< Metadata of Raw and Image
+
+    double          RecordStart;    //!< Capture time (s) of the first recorded frame, -1 before it arrives
+    bool            Screenshot;     //!< Set to true when the next rendered frame should be saved
+    CaptureStatistics LastStatistics; //!< Counters logged last time
+    double          ExposureLag;    //!< Time (ms) from the last exposure request to the first frame taken with it, -1 before one
+    qint64          FirstFrame;     //!< Time (ms) from startup to the first frame, -1 before it
+};
+
+class CameraRegistry : public QObject
+{
+    Q_OBJECT
+public:
+
+    explicit CameraRegistry(QObject *parent = 0);
+
+    /**
+     * @brief Stops every channel and frees its camera, thread and encoder
+     */
+    ~CameraRegistry();
+
+    /**
+     * @brief Initializes PvAPI, before any camera is looked for or opened
+     *
+     * @param discovery False to skip the discovery broadcast, for openByAddress()
+     * @return false if PvAPI could not be initialized, or the program was built without it
+     */
+    bool initialize(bool discovery);
+
+    /**
+     * @brief Shuts PvAPI down again, after stop() and once no frame of a camera is held
+     */
+    void uninitialize();
+
+    /**
+     * @brief Lists the cameras on the network
+     *
+     * Waits for PvAPI's link events instead of a fixed delay: returns as soon as expected
+     * cameras are known, or REGISTRY_DISCOVERY_SETTLE ms after the last camera turned up,
+     * and after REGISTRY_DISCOVERY_TIMEOUT ms at most. Needs initialize() with discovery.
+     *
+     * @param expected Number of cameras to wait for, 0 if unknown
+     * @return Names of the cameras found, in the order open() will use them
+     */
+    QStringList discover(int expected = 0);
+
+    /**
+     * @brief Opens every camera found by the last discover() that grants master access
+     *
+     * Each opened camera gets a channel with its role worked out from the camera's
+     * part number, its own thread and its own encoder. Channels are numbered per role,
+     * so the second NIR camera is called "NIR2". Link events are listened to from here
+     * until stop().
+     *
+     * @return Number of cameras opened
+     */
+    int open();
+
+    /**
+     * @brief Opens cameras by IP address, without discovery
+     *
+     * Works after initialize() without discovery. Every address is asked for its camera's
+     * information first, and nothing is opened unless all of them answer, so a stale
+     * list can be retried with discover() and open().
+     *
+     * @param addresses IPv4 addresses in network byte order, as returned by addresses()
+     * @return Number of cameras opened, 0 if any address did not answer
+     */
+    int openByAddress(const QStringList &addresses);
+
+    /**
+     * @brief Gets the IP address of every open camera, for openByAddress() on the next start
+     */
+    QStringList addresses();
+
+    /**
+     * @brief Opens synthetic cameras instead of real ones
+     *
+     * @param roles One entry per camera, "WL" or "NIR"
+     * @param width Frame width in pixels
+     * @param height Frame height in pixels
+     * @param fps Frames per second, 0 to generate frames as fast as possible
+     * @return Number of cameras opened
+     */
+    int openSynthetic(const QStringList &roles, unsigned int width, unsigned int height, double fps);
+
+    /**
+     * @brief Plays back raw recordings instead of opening cameras
+     *
+     * Each recording gets a channel, its role read from the recorded pixel format.
+     * Files that cannot be read are skipped.
+     *
+     * @param files Raw recordings (.mcvraw), typically the ones made together in one session
+     * @param mode How the recordings are paced
+     * @param loop Start over at the end of a recording instead of stopping
+     * @return Number of recordings opened
+     */
+    int openReplay(const QStringList &files, ReplayMode mode, bool loop);
+
+    /**
+     * @brief Gets the number of open channels
+     */
+    int count() const;
+
+    /**
+     * @brief Gets a channel by index
+     */
+    CameraChannel* channel(int index) const;
+
+    /**
+     * @brief Gets the channel streaming from cam
+     * @return The channel, NULL if cam isn't in the registry
+     */
+    CameraChannel* channelOf(FrameSource* cam) const;
+
+    /**
+     * @brief Gets a channel by its Name
+     * @return The channel, NULL if no channel has that name
+     */
+    CameraChannel* channelNamed(const QString &name) const;
+
+    /**
+     * @brief Gets the first channel with a given role
+     * @return The channel, NULL if no camera has that role
+     */
+    CameraChannel* primary(CameraRole role) const;
+
+    /**
+     * @brief Sets every camera up and starts its capture thread
+     *
+     * The cameras are set up in parallel, each setup being a few dozen attribute round
+     * trips. Each thread's started() signal is wired to its camera's capture(), so every
+     * camera starts streaming as soon as its thread is running.
+     */
+    void start();
+
+    /**
+     * @brief Ends capture on every camera and waits for its thread
+     *
+     * Stops listening to link events, so call it before uninitialize().
+     */
+    void stop();
+
+    /**
+     * @brief Tells the camera with uniqueId that its link went down or came back
+     *
+     * Called on PvAPI's thread by the link callback listen() registers.
+     *
+     * @param arrived True if the camera turned up, false if it was unplugged
+     */
+    void linkEvent(unsigned long uniqueId, bool arrived);
+
+private:
+
+    /**
+     * @brief Gives an opened source a channel, a name and a thread of its own
+     */
+    void addChannel(FrameSource* source, CameraRole role);
+
+    /**
+     * @brief Opens the camera described by Found[index] and gives it a channel
+     * @param address IP address to reopen it by, 0 to go by its UniqueId
+     */
+    bool openCamera(int index, unsigned long address);
+
+    /**
+     * @brief Registers the link callback, if it isn't already
+     */
+    void listen();
+
+    QVector<CameraChannel*> Channels;   //!< Open channels, in discovery order
+    QVector<FoundCamera> Found;         //!< Result of the last discover() or openByAddress()
+    bool            Listening;          //!< True while the link callback is registered
+    QMutex          LinkMutex;          //!< Guards Channels against linkEvent(), and Arrivals
+    QWaitCondition  LinkCondition;      //!< Signalled by linkEvent() when a camera turns up
+    int             Arrivals;           //!< Cameras that turned up since the link callback was registered
+};
+
+#endif // CAMERAREGISTRY_H
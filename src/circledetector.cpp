@@ -0,0 +1,139 @@
+#include "circledetector.h"
+
+CircleDetector::CircleDetector()
+{
+    this->Width = 0;
+    this->Height = 0;
+    this->Seen = 0;
+}
+
+void CircleDetector::reset()
+{
+    this->Peak.clear();
+    this->Width = 0;
+    this->Height = 0;
+    this->Seen = 0;
+}
+
+bool CircleDetector::add(const FrameBuffer &frame, const FrameInfo &info)
+{
+    if (this->Seen >= CIRCLE_DETECT_FRAMES)
+        return true;
+    if (frame.isNull() || info.Binning > 1 || info.OffsetX != 0 || info.OffsetY != 0)
+        return false;   //!< Part of the view is missing, the box would be off
+    if (this->Width != 0 && (info.Width != (unsigned long)this->Width || info.Height != (unsigned long)this->Height))
+        return false;
+
+    int count = info.Width*info.Height;
+    if (info.Format == FormatBayer8 && info.ImageSize >= (unsigned long)count)
+    {
+        if (this->Width == 0)
+            this->Peak.fill(0, count);
+        const unsigned char* src = frame.data();
+        unsigned char* peak = this->Peak.data();
+        for (int i = 0; i < count; i++)
+            if (src[i] > peak[i])
+                peak[i] = src[i];
+    }
+    else if (info.Format == FormatMono16 && info.ImageSize >= (unsigned long)count*2)
+    {
+        if (this->Width == 0)
+            this->Peak.fill(0, count);
+        const unsigned short* src = reinterpret_cast<const unsigned short*>(frame.data());
+        unsigned char* peak = this->Peak.data();
+        int shift = (info.BitDepth > 8) ? info.BitDepth - 8 : 0;
+        for (int i = 0; i < count; i++)
+        {
+            unsigned int level = qMin(src[i] >> shift, 255);
+            if (level > peak[i])
+                peak[i] = level;
+        }
+    }
+    else
+        return false;
+
+    this->Width = info.Width;
+    this->Height = info.Height;
+    this->Seen++;
+    return this->Seen >= CIRCLE_DETECT_FRAMES;
+}
+
+QRect CircleDetector::bounds()
+{
+    if (this->Seen == 0)
+        return QRect();
+
+    const unsigned char* peak = this->Peak.constData();
+    int count = this->Width*this->Height;
+
+    /// The lit level is relative to the brightest pixels, so it holds for any exposure
+    int histogram[256] = {0};
+    for (int i = 0; i < count; i++)
+        histogram[peak[i]]++;
+    int brightest = 0;
+    int sum = 0;
+    for (int level = 0; level < 256; level++)
+    {
+        sum += histogram[level];
+        if (sum >= 0.99*count)
+        {
+            brightest = level;
+            break;
+        }
+    }
+    int lit = qMax(CIRCLE_MIN_LEVEL, static_cast<int>(brightest*CIRCLE_LEVEL));
+    if (brightest <= lit)
+        return QRect();     //!< Nothing stands out: no light, or light everywhere
+
+    QVector<int> rows(this->Height, 0);
+    QVector<int> columns(this->Width, 0);
+    for (int y = 0; y < this->Height; y++)
+    {
+        const unsigned char* row = peak + y*this->Width;
+        for (int x = 0; x < this->Width; x++)
+        {
+            if (row[x] > lit)
+            {
+                rows[y]++;
+                columns[x]++;
+            }
+        }
+    }
+
+    int top = 0;
+    int bottom = this->Height - 1;
+    int left = 0;
+    int right = this->Width - 1;
+    while (top < this->Height && rows[top] < CIRCLE_MIN_LIT)
+        top++;
+    while (bottom > top && rows[bottom] < CIRCLE_MIN_LIT)
+        bottom--;
+    while (left < this->Width && columns[left] < CIRCLE_MIN_LIT)
+        left++;
+    while (right > left && columns[right] < CIRCLE_MIN_LIT)
+        right--;
+    if (top >= this->Height || left >= this->Width)
+        return QRect();
+
+    QRect box = aligned(left, top, right + 1, bottom + 1, CIRCLE_MARGIN, this->Width, this->Height);
+    if (box.width()*box.height() > CIRCLE_MAX_COVER*count)
+        return QRect();
+    return box;
+}
+
+QRect CircleDetector::transfer(const QRect &box, int width, int height, bool mirror)
+{
+    if (box.isEmpty())
+        return QRect();
+    int left = (mirror) ? width - (box.x() + box.width()) : box.x();
+    return aligned(left, box.y(), left + box.width(), box.y() + box.height(), CIRCLE_TRANSFER_MARGIN, width, height);
+}
+
+QRect CircleDetector::aligned(int left, int top, int right, int bottom, int margin, int width, int height)
+{
+    left = qMax(0, left - margin) / CIRCLE_ALIGN * CIRCLE_ALIGN;
+    top = qMax(0, top - margin) / CIRCLE_ALIGN * CIRCLE_ALIGN;
+    right = qMin(width, (right + margin + CIRCLE_ALIGN - 1) / CIRCLE_ALIGN * CIRCLE_ALIGN);
+    bottom = qMin(height, (bottom + margin + CIRCLE_ALIGN - 1) / CIRCLE_ALIGN * CIRCLE_ALIGN);
+    return QRect(left, top, right - left, bottom - top);
+}
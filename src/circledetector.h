@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The CircleDetector class finds the circle the endoscope lights on the
+ * sensor. The rest of the frame stays dark, so cropping the cameras to
+ * the circle's bounding box sends fewer bytes per frame over the link
+ * without losing any of the image.
+ *
+ * It keeps the brightest value each pixel reached over a few frames, so
+ * a dark scene or a moving instrument doesn't hide part of the circle.
+ * Pixels above a share of the brightest level count as lit. The box
+ * spans the rows and columns with enough lit pixels, grown by a margin
+ * and aligned so every binning factor and the Bayer pattern still fit.
+ */
+
+#ifndef CIRCLEDETECTOR_H
+#define CIRCLEDETECTOR_H
+
+#define CIRCLE_DETECT_FRAMES 8      //!< Frames looked at before the box is computed
+#define CIRCLE_MIN_LEVEL 8          //!< Pixels at or below this 8-bit level are never lit
+#define CIRCLE_LEVEL 0.2            //!< Pixels above this share of the 99th percentile count as lit
+#define CIRCLE_MIN_LIT 8            //!< Lit pixels a row or column needs to be inside the box, so specks don't count
+#define CIRCLE_MARGIN 8             //!< Pixels added around the box, for a circle that isn't quite still
+#define CIRCLE_TRANSFER_MARGIN 16   //!< Extra pixels added when another camera uses the box, see transfer()
+#define CIRCLE_ALIGN 8              //!< Box edges are multiples of this (largest binning factor, even for Bayer)
+#define CIRCLE_MAX_COVER 0.9        //!< Boxes covering more of the frame than this aren't worth cropping to
+
+#include <QVector>
+#include <QRect>
+
+#include <framepool.h>
+#include <frameinfo.h>
+
+class CircleDetector
+{
+public:
+
+    CircleDetector();
+
+    /**
+     * @brief Forgets every frame seen, to start over
+     */
+    void reset();
+
+    /**
+     * @brief Adds a frame to the ones the circle is looked for in
+     *
+     * Only full, unbinned and uncropped Bayer8 or Mono16 frames are used. Others are ignored.
+     *
+     * @return true once CIRCLE_DETECT_FRAMES frames were added and bounds() can be called
+     */
+    bool add(const FrameBuffer &frame, const FrameInfo &info);
+
+    /**
+     * @brief Gets the circle's bounding box, in pixels of the frames added
+     * @return The box, empty if no circle was found or it covers nearly the whole frame
+     */
+    QRect bounds();
+
+    /**
+     * @brief Gets the box to use on another camera looking through the same endoscope
+     *
+     * The box is grown by CIRCLE_TRANSFER_MARGIN, as the cameras are only roughly aligned.
+     *
+     * @param box Box found on the first camera
+     * @param width Width of the frames, the same for both cameras
+     * @param height Height of the frames
+     * @param mirror true if one of the two images is mirrored (the WL camera sits behind the dichroic)
+     */
+    static QRect transfer(const QRect &box, int width, int height, bool mirror);
+
+private:
+
+    /**
+     * @brief Grows a box by a margin, aligns it to CIRCLE_ALIGN and clips it to the frame
+     * @param right One past the right edge
+     * @param bottom One past the bottom edge
+     */
+    static QRect aligned(int left, int top, int right, int bottom, int margin, int width, int height);
+
+    QVector<unsigned char> Peak;    //!< Brightest 8-bit level each pixel reached
+    int             Width;          //!< Width of the frames added, 0 before the first one
+    int             Height;         //!< Height of the frames added
+    int             Seen;           //!< Frames added since reset()
+};
+
+#endif // CIRCLEDETECTOR_H
@@ -0,0 +1,205 @@
+#include "defectmap.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * @brief Median of count values, the mean of the middle two for an even count. Sorts values
+ */
+static inline int smallMedian(int* values, int count)
+{
+    for (int i = 1; i < count; i++)     //!< At most 8 values, insertion sort is quickest
+    {
+        int value = values[i];
+        int j = i;
+        for (; j > 0 && values[j - 1] > value; j--)
+            values[j] = values[j - 1];
+        values[j] = value;
+    }
+    if (count % 2)
+        return values[count/2];
+    return (values[count/2 - 1] + values[count/2] + 1) / 2;
+}
+
+DefectMap::DefectMap()
+{
+    this->Placed = false;
+    this->Width = 0;
+    this->Height = 0;
+    this->OriginX = 0;
+    this->OriginY = 0;
+    this->Binning = 1;
+    this->DarkCount = 0;
+    this->DarkWidth = 0;
+    this->DarkHeight = 0;
+    this->DarkOriginX = 0;
+    this->DarkOriginY = 0;
+}
+
+void DefectMap::setDefects(const QVector<QPoint> &defects)
+{
+    this->Defects = defects;
+    this->Placements.clear();
+    this->Placed = false;
+}
+
+QVector<QPoint> DefectMap::defects() const
+{
+    return this->Defects;
+}
+
+void DefectMap::place(int width, int height, int originX, int originY, int binning)
+{
+    if (this->Placed && width == this->Width && height == this->Height && originX == this->OriginX
+            && originY == this->OriginY && binning == this->Binning)
+        return;
+    this->Placed = true;
+    this->Width = width;
+    this->Height = height;
+    this->OriginX = originX;
+    this->OriginY = originY;
+    this->Binning = binning;
+    this->Placements.clear();
+    if (this->Defects.isEmpty() || width <= 0 || height <= 0)
+        return;
+    binning = qMax(binning, 1);
+
+    /// Marked first, so defects binned into the same pixel count once and never serve as neighbours
+    QVector<unsigned char> mask(width*height, 0);
+    QVector<int> marked;
+    for (int i = 0; i < this->Defects.count(); i++)
+    {
+        int x = this->Defects[i].x() - originX;
+        int y = this->Defects[i].y() - originY;
+        if (x < 0 || y < 0 || x/binning >= width || y/binning >= height)
+            continue;
+        int index = (y/binning)*width + x/binning;
+        if (!mask[index])
+            marked.append(index);
+        mask[index] = 1;
+    }
+
+    for (int i = 0; i < marked.count(); i++)
+    {
+        PlacedDefect defect;
+        defect.Index = marked[i];
+        defect.Count = 0;
+        int x = marked[i] % width;
+        int y = marked[i] / width;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= width || y + dy < 0 || y + dy >= height)
+                    continue;
+                int neighbour = (y + dy)*width + x + dx;
+                if (!mask[neighbour])
+                    defect.Neighbours[defect.Count++] = neighbour;
+            }
+        }
+        if (defect.Count > 0)   //!< Inside a cluster of defects there is nothing good to go by
+            this->Placements.append(defect);
+    }
+}
+
+void DefectMap::correct(unsigned short *frame) const
+{
+    int values[8];
+    for (int i = 0; i < this->Placements.count(); i++)
+    {
+        const PlacedDefect &defect = this->Placements[i];
+        for (int j = 0; j < defect.Count; j++)
+            values[j] = frame[defect.Neighbours[j]];
+        frame[defect.Index] = static_cast<unsigned short>(smallMedian(values, defect.Count));
+    }
+}
+
+void DefectMap::addDarkFrame(const unsigned short *frame, int width, int height, int originX, int originY)
+{
+    if (this->DarkCount == 0 || width != this->DarkWidth || height != this->DarkHeight
+            || originX != this->DarkOriginX || originY != this->DarkOriginY)
+    {
+        this->DarkSum.fill(0, width*height);
+        this->DarkCount = 0;
+        this->DarkWidth = width;
+        this->DarkHeight = height;
+        this->DarkOriginX = originX;
+        this->DarkOriginY = originY;
+    }
+    unsigned int* sum = this->DarkSum.data();
+    for (int i = 0; i < width*height; i++)
+        sum[i] += frame[i];
+    this->DarkCount++;
+}
+
+int DefectMap::darkFrames() const
+{
+    return this->DarkCount;
+}
+
+void DefectMap::clearDarkFrames()
+{
+    this->DarkSum = QVector<unsigned int>();
+    this->DarkCount = 0;
+}
+
+QVector<QPoint> DefectMap::findDefects(int threshold) const
+{
+    QVector<QPoint> defects;
+    if (this->DarkCount == 0)
+        return defects;
+
+    int width = this->DarkWidth;
+    int height = this->DarkHeight;
+    QVector<int> average(width*height);
+    for (int i = 0; i < width*height; i++)
+        average[i] = (this->DarkSum[i] + this->DarkCount/2) / this->DarkCount;
+
+    int values[8];
+    for (int y = 0; y < height && defects.count() < DEFECT_MAX_COUNT; y++)
+    {
+        for (int x = 0; x < width && defects.count() < DEFECT_MAX_COUNT; x++)
+        {
+            int count = 0;
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                    if ((dx != 0 || dy != 0) && x + dx >= 0 && x + dx < width && y + dy >= 0 && y + dy < height)
+                        values[count++] = average[(y + dy)*width + x + dx];
+            if (count > 0 && std::abs(average[y*width + x] - smallMedian(values, count)) > threshold)
+                defects.append(QPoint(this->DarkOriginX + x, this->DarkOriginY + y));
+        }
+    }
+    return defects;
+}
+
+void DefectMap::write(QDataStream &stream, const QVector<QPoint> &defects)
+{
+    stream << static_cast<quint32>(DEFECT_FILE_MAGIC) << static_cast<quint32>(defects.count());
+    for (int i = 0; i < defects.count(); i++)
+        stream << static_cast<quint16>(defects[i].x()) << static_cast<quint16>(defects[i].y());
+}
+
+bool DefectMap::read(QDataStream &stream, QVector<QPoint> &defects)
+{
+    defects.clear();
+    quint32 magic = 0;
+    quint32 count = 0;
+    stream >> magic >> count;
+    if (stream.status() != QDataStream::Ok || magic != DEFECT_FILE_MAGIC || count > DEFECT_MAX_COUNT)
+        return false;
+
+    defects.reserve(count);
+    for (quint32 i = 0; i < count; i++)
+    {
+        quint16 x = 0;
+        quint16 y = 0;
+        stream >> x >> y;
+        defects.append(QPoint(x, y));
+    }
+    if (stream.status() != QDataStream::Ok)
+    {
+        defects.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The DefectMap class corrects the hot and dead pixels of the NIR
+ * sensor, which are most of what a small median filter removes, without
+ * touching the rest of the frame.
+ *
+ * Defects are found once, from dark frames taken with the lens covered:
+ * a pixel whose average differs from the median of its neighbours'
+ * averages by more than a threshold is defective. The list is kept in
+ * sensor coordinates (unbinned pixels of the full sensor), so it holds
+ * whatever region, crop or binning the camera streams later on.
+ *
+ * place() works out where the defects fall in the frames being streamed
+ * and which neighbours of each one are good, only when the frames
+ * change geometry. correct() then replaces each defective pixel with
+ * the median of its good neighbours, so it costs a few operations per
+ * defect rather than a window per pixel.
+ */
+
+#ifndef DEFECTMAP_H
+#define DEFECTMAP_H
+
+#define DEFECT_CALIBRATION_FRAMES 32    //!< Dark frames averaged to find defects
+#define DEFECT_THRESHOLD 64             //!< Default difference (levels) from the neighbours that makes a pixel defective
+#define DEFECT_MAX_COUNT 65536          //!< Most defects kept, more means the frames weren't dark
+#define DEFECT_FILE_MAGIC 0x4D435644    //!< "MCVD", starts the defect list in a parameter file
+
+#include <QVector>
+#include <QPoint>
+#include <QDataStream>
+
+class DefectMap
+{
+public:
+
+    DefectMap();
+
+    /**
+     * @brief Replaces the defect list, placed again on the next place()
+     * @param defects Defective pixels, in sensor coordinates
+     */
+    void setDefects(const QVector<QPoint> &defects);
+
+    /**
+     * @brief Gets the defect list, in sensor coordinates
+     */
+    QVector<QPoint> defects() const;
+
+    /**
+     * @brief Finds the defects that fall in the frames being streamed, and their good neighbours
+     *
+     * Does nothing if the geometry is the one already placed. A binned pixel is defective
+     * if any of the sensor pixels it sums is.
+     *
+     * @param width Width of the frames in pixels
+     * @param height Height of the frames in pixels
+     * @param originX Left edge of the frames on the sensor, in unbinned pixels
+     * @param originY Top edge of the frames on the sensor, in unbinned pixels
+     * @param binning Binning factor of the frames
+     */
+    void place(int width, int height, int originX, int originY, int binning);
+
+    /**
+     * @brief Replaces each placed defect with the median of its good neighbours
+     *
+     * @param frame Mono16 frame of the geometry given to place(), corrected in place
+     */
+    void correct(unsigned short* frame) const;
+
+    /**
+     * @brief Adds a frame to the average findDefects() works from
+     *
+     * Frames must be taken at full resolution (no binning) with the lens covered. A frame of
+     * another size or origin than the previous ones starts the average over.
+     *
+     * @param originX Left edge of the frame on the sensor, in unbinned pixels
+     * @param originY Top edge of the frame on the sensor, in unbinned pixels
+     */
+    void addDarkFrame(const unsigned short* frame, int width, int height, int originX, int originY);
+
+    /**
+     * @brief Gets the number of frames in the average since the last clearDarkFrames()
+     */
+    int darkFrames() const;
+
+    /**
+     * @brief Drops the dark frames and frees their memory
+     */
+    void clearDarkFrames();
+
+    /**
+     * @brief Finds the defects in the dark frames added so far
+     *
+     * @param threshold Difference in levels from the median of the 8 neighbours above which a
+     *                  pixel is defective, either way
+     * @return Defective pixels in sensor coordinates, at most DEFECT_MAX_COUNT
+     */
+    QVector<QPoint> findDefects(int threshold) const;
+
+    /**
+     * @brief Writes a defect list after the Param block of a parameter file
+     */
+    static void write(QDataStream &stream, const QVector<QPoint> &defects);
+
+    /**
+     * @brief Reads a defect list written by write()
+     * @return false if the stream doesn't hold one, defects is left empty then
+     */
+    static bool read(QDataStream &stream, QVector<QPoint> &defects);
+
+private:
+
+    /**
+     * @brief A defect in the frames being streamed
+     */
+    struct PlacedDefect
+    {
+        int         Index;              //!< Offset of the pixel in the frame
+        int         Count;              //!< Good neighbours, 0 to 8
+        int         Neighbours[8];      //!< Offsets of the good neighbours
+    };
+
+    QVector<QPoint> Defects;            //!< Defect list, in sensor coordinates
+    QVector<PlacedDefect> Placements;   //!< Defects placed in the frames being streamed
+    bool            Placed;             //!< False until place() has run since the list changed
+    int             Width;              //!< Geometry the defects were placed for
+    int             Height;
+    int             OriginX;
+    int             OriginY;
+    int             Binning;
+
+    QVector<unsigned int> DarkSum;      //!< Sum of each pixel over the dark frames
+    int             DarkCount;          //!< Dark frames in DarkSum
+    int             DarkWidth;          //!< Geometry of the dark frames
+    int             DarkHeight;
+    int             DarkOriginX;
+    int             DarkOriginY;
+};
+
+#endif // DEFECTMAP_H
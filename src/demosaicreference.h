@@ -0,0 +1,246 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Reference frame BayerDemosaic::benchmark() checks both demosaics
+ * against: a 13x7 Bayer8 frame of noise with a hard edge on its right,
+ * and the RGB it demosaics to with each of the four Bayer patterns.
+ *
+ * The RGB was worked out apart from BayerDemosaic, straight from the
+ * definitions. Bilinear: a colour the pixel lacks is the mean of the
+ * nearest pixels of that colour in its 3x3 neighbourhood. Gradient: the
+ * four 5x5 filters of Malvar, He and Cutler (ICASSP 2004), as printed in
+ * the paper. Beyond the edges the frame is mirrored without repeating
+ * the edge pixel, and every value is rounded to the nearest level,
+ * halves up, and clamped to 0..255. An exact demosaic can therefore be
+ * at most one level off any value, see DEMOSAIC_REFERENCE_MAX_ERROR.
+ *
+ * Only bayerdemosaic.cpp includes this file.
+ */
+
+#ifndef DEMOSAICREFERENCE_H
+#define DEMOSAICREFERENCE_H
+
+#define DEMOSAIC_REFERENCE_WIDTH 13     //!< Width of the reference frame, odd and past one SSE2 block of 8
+#define DEMOSAIC_REFERENCE_HEIGHT 7     //!< Height of the reference frame
+
+/// Bayer8 pixels, one row per line
+static const unsigned char DemosaicReferenceBayer[DEMOSAIC_REFERENCE_WIDTH*DEMOSAIC_REFERENCE_HEIGHT] = {
+    169,  92,  50, 141, 195,  83, 155,  90, 145, 230, 230, 230, 230,
+     71, 146, 149, 101, 221, 113,  11, 209, 232, 230, 230, 230, 230,
+    153,  28,  41, 129, 225,  12,  12, 207,  69, 230, 230, 230, 230,
+    139, 240,  53,  70,  19, 244, 134, 177, 106,  20,  20,  20,  20,
+    206, 196,  18, 152, 169, 251, 221,  65, 157,  20,  20,  20,  20,
+    177, 226,  90, 235, 162,  48,  56,   7,  44,  20,  20,  20,  20,
+     79, 162,  10,  86,  42, 144, 207, 109, 235,  20,  20,  20,  20
+};
+
+/// Bilinear RGB for RGGB, GBRG, GRBG and BGGR (BayerLayout order), each row of pixels on three lines
+static const unsigned char DemosaicReferenceBilinear[4][DEMOSAIC_REFERENCE_WIDTH*DEMOSAIC_REFERENCE_HEIGHT*3] = {
+    {   // RGGB
+        169,  82, 146, 110,  92, 146,  50, 133, 124, 123, 141, 101, 195,
+        167, 107, 175,  83, 113, 155,  49, 161, 150,  90, 209, 145, 196,
+        220, 188, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+        161,  71, 146, 103,  85, 146,  46, 149, 124, 128, 160, 101, 210,
+        221, 107, 147,  82, 113,  84,  11, 161,  95, 135, 209, 107, 232,
+        220, 169, 231, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+        153,  67, 193,  97,  28, 193,  41,  90, 139, 133, 129,  86, 225,
+         95, 132, 119,  12, 179,  12,  91, 186,  41, 207, 193,  69, 194,
+        159, 150, 230, 125, 230, 178, 125, 230, 230, 125, 230, 178, 125,
+        180, 139, 240, 105, 104, 240,  30,  53, 155, 113,  88,  70, 197,
+         19, 157, 157, 104, 244, 117, 134, 211, 115, 128, 177, 113, 106,
+         99, 119,  94,  20, 125,  20,  20, 125,  73,  20, 125,  20,  20,
+        206, 177, 233, 112, 196, 233,  18, 123, 193,  94, 152, 153, 169,
+        146, 149, 195, 251, 146, 221, 127, 119, 189,  65,  92, 157,  59,
+         56,  89,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        143, 177, 226,  78, 156, 226,  14,  90, 231,  60, 123, 235, 106,
+        162, 142, 160, 153,  48, 214,  56,  28, 205,  69,   7, 196,  44,
+         14, 108,  26,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+         79, 170, 226,  45, 162, 226,  10, 107, 231,  26,  86, 235,  42,
+        139, 142, 125, 144,  48, 207,  91,  28, 221, 109,   7, 235,  54,
+         14, 128,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20
+    },
+    {   // GBRG
+         71, 169,  92, 110, 128,  92, 149,  50, 117, 185, 112, 141, 221,
+        195, 112, 116, 144,  83,  11, 155,  87, 122, 180,  90, 232, 145,
+        160, 231, 209, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+         71, 154,  60, 110, 146,  60, 149,  85,  98, 185, 101, 135, 221,
+        159,  91, 116, 113,  48,  11, 122,  98, 122, 209, 149, 232, 163,
+        189, 231, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+        105, 153,  28, 103, 145,  28, 101,  41,  79, 111, 109, 129, 120,
+        225,  71,  96, 149,  12,  73,  12, 110, 121, 117, 207, 169,  69,
+        219, 147, 137, 230, 125, 230, 230, 125, 178, 230, 125, 230, 230,
+        139, 210, 112,  96, 240, 112,  53,  92, 126,  36,  70, 141,  19,
+        177, 136,  77, 244, 132, 134, 164, 134, 120, 177, 136, 106, 106,
+        131,  63,  20, 125,  20,  73, 125,  20,  20, 125,  20,  73, 125,
+        158, 206, 196, 115, 173, 196,  72,  18, 174,  81, 123, 152,  91,
+        169, 202,  93, 171, 251,  95, 221, 158,  85, 141,  65,  75, 157,
+         43,  48,  54,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        177, 184, 179, 134, 226, 179,  90, 122, 149, 126, 235, 119, 162,
+        124, 158, 109,  48, 198,  56, 121, 142,  50,   7,  87,  44, 105,
+         54,  32,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        177,  79, 162, 134, 135, 162,  90,  10, 124, 126, 131,  86, 162,
+         42, 115, 109,  86, 144,  56, 207, 127,  50, 114, 109,  44, 235,
+         65,  32,  74,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20
+    },
+    {   // GRBG
+         92, 169,  71,  92, 128, 110, 117,  50, 149, 141, 112, 185, 112,
+        195, 221,  83, 144, 116,  87, 155,  11,  90, 180, 122, 160, 145,
+        232, 230, 209, 231, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+         60, 154,  71,  60, 146, 110,  98,  85, 149, 135, 101, 185,  91,
+        159, 221,  48, 113, 116,  98, 122,  11, 149, 209, 122, 189, 163,
+        232, 230, 230, 231, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+         28, 153, 105,  28, 145, 103,  79,  41, 101, 129, 109, 111,  71,
+        225, 120,  12, 149,  96, 110,  12,  73, 207, 117, 121, 219,  69,
+        169, 230, 137, 147, 230, 230, 125, 230, 178, 125, 230, 230, 125,
+        112, 210, 139, 112, 240,  96, 126,  92,  53, 141,  70,  36, 136,
+        177,  19, 132, 244,  77, 134, 164, 134, 136, 177, 120, 131, 106,
+        106, 125,  20,  63, 125,  73,  20, 125,  20,  20, 125,  73,  20,
+        196, 206, 158, 196, 173, 115, 174,  18,  72, 152, 123,  81, 202,
+        169,  91, 251, 171,  93, 158, 221,  95,  65, 141,  85,  43, 157,
+         75,  20,  54,  48,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        179, 184, 177, 179, 226, 134, 149, 122,  90, 119, 235, 126, 158,
+        124, 162, 198,  48, 109, 142, 121,  56,  87,   7,  50,  54, 105,
+         44,  20,  20,  32,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        162,  79, 177, 162, 135, 134, 124,  10,  90,  86, 131, 126, 115,
+         42, 162, 144,  86, 109, 127, 207,  56, 109, 114,  50,  65, 235,
+         44,  20,  74,  32,  20,  20,  20,  20,  20,  20,  20,  20,  20
+    },
+    {   // BGGR
+        146,  82, 169, 146,  92, 110, 124, 133,  50, 101, 141, 123, 107,
+        167, 195, 113,  83, 175, 161,  49, 155, 209,  90, 150, 220, 196,
+        145, 230, 230, 188, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+        146,  71, 161, 146,  85, 103, 124, 149,  46, 101, 160, 128, 107,
+        221, 210, 113,  82, 147, 161,  11,  84, 209, 135,  95, 220, 232,
+        107, 230, 231, 169, 230, 230, 230, 230, 230, 230, 230, 230, 230,
+        193,  67, 153, 193,  28,  97, 139,  90,  41,  86, 129, 133, 132,
+         95, 225, 179,  12, 119, 186,  91,  12, 193, 207,  41, 159, 194,
+         69, 125, 230, 150, 125, 178, 230, 125, 230, 230, 125, 178, 230,
+        240, 139, 180, 240, 104, 105, 155,  53,  30,  70,  88, 113, 157,
+         19, 197, 244, 104, 157, 211, 134, 117, 177, 128, 115,  99, 106,
+        113,  20,  94, 119,  20,  20, 125,  20,  73, 125,  20,  20, 125,
+        233, 177, 206, 233, 196, 112, 193, 123,  18, 153, 152,  94, 149,
+        146, 169, 146, 251, 195, 119, 127, 221,  92,  65, 189,  56,  59,
+        157,  20,  20,  89,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        226, 177, 143, 226, 156,  78, 231,  90,  14, 235, 123,  60, 142,
+        162, 106,  48, 153, 160,  28,  56, 214,   7,  69, 205,  14,  44,
+        196,  20,  26, 108,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+        226, 170,  79, 226, 162,  45, 231, 107,  10, 235,  86,  26, 142,
+        139,  42,  48, 144, 125,  28,  91, 207,   7, 109, 221,  14,  54,
+        235,  20,  20, 128,  20,  20,  20,  20,  20,  20,  20,  20,  20
+    }
+};
+
+/// Malvar-He-Cutler RGB for RGGB, GBRG, GRBG and BGGR (BayerLayout order), each row of pixels on three lines
+static const unsigned char DemosaicReferenceGradient[4][DEMOSAIC_REFERENCE_WIDTH*DEMOSAIC_REFERENCE_HEIGHT*3] = {
+    {   // RGGB
+        169, 115, 197,  86,  92, 156,  50, 102,  77, 112, 141,  75, 195,
+        182, 130, 142,  83, 118, 155,  81, 209, 132,  90, 172, 145, 203,
+        230, 205, 230, 221, 230, 241, 246, 230, 230, 230, 230, 230, 230,
+        168,  71, 136,  94,  79, 146,  83, 149, 144, 123, 157, 101, 255,
+        221, 195, 106,  55, 113,  52,  11,  71, 115, 148, 209, 130, 232,
+        255, 212, 255, 230, 255, 230, 217, 255, 255, 230, 255, 230, 217,
+        153,  86, 222,  61,  28, 133,  41,  55,  86, 172, 129,  77, 225,
+        156, 223,  57,  12, 117,  12,  13,  69,  89, 207, 255,  69, 160,
+        109, 181, 230, 191, 230, 224, 195, 255, 230, 204, 230, 204, 164,
+        186, 139, 255, 157, 139, 240,   0,  53, 120,  12,  21,  70, 105,
+         19, 101, 255, 175, 244, 133, 134, 216, 158, 157, 177,  89, 106,
+         98,  50,  48,  20,  52,  20,   0,  86,  46,  20,  46,  20,   0,
+        206, 247, 255, 146, 196, 255,  18,  79, 126, 106, 152, 208, 169,
+        167, 181, 255, 251, 251, 221, 169, 183, 173,  65,  68, 157,  69,
+         72,  82,  20,   0,  20,   0,   0,  33,  20,   0,  20,   0,   0,
+        135, 177, 244,  74, 153, 226,   0,  90, 179, 127, 168, 235, 114,
+        162, 157,  96, 111,  48, 167,  56,   0, 163,  41,   7, 183,  44,
+         14, 110,  28,  20,  22,  20,  17,  20,  20,  20,  20,  20,  20,
+         79, 155, 204,  73, 162, 227,  10,  92, 209,   0,  86, 207,  42,
+         90,  69, 167, 144,  33, 207, 105,  48, 252, 109,  44, 235, 104,
+         88, 110,  20,  20,  20,   0,   0,  20,  20,  20,  20,  20,  20
+    },
+    {   // GBRG
+         72, 169, 131, 125, 138,  92, 131,  50,  46, 210, 128, 141, 246,
+        195, 183, 130, 154,  83,  46, 155,  62,  53, 134,  90, 220, 145,
+        101, 255, 226, 230, 225, 230, 241, 230, 230, 230, 230, 230, 230,
+         71, 126,  18, 143, 146,  67, 149,  97, 117, 163, 101, 129, 221,
+        219, 182,  97, 113,  20,  11,  53,   0, 186, 209, 205, 232, 207,
+        255, 251, 230, 255, 230, 255, 255, 217, 230, 255, 230, 255, 255,
+         62, 153,  40,  41, 103,  28,  72,  41,   0, 145, 132, 129, 152,
+        225, 161,   0,  71,  12,   0,  12,  11, 202, 171, 207, 110,  69,
+        171, 191, 166, 230, 194, 230, 255, 164, 204, 230, 204, 230, 255,
+        139, 235, 150, 178, 240, 183,  53,  69,  92,   0,  70, 116,  19,
+        115,  43, 130, 244, 201, 134, 207, 198, 154, 177, 179, 106, 105,
+        129,   7,  20,  59,  20,  36,  70,   0,  20,  46,  20,  46,  86,
+        144, 206, 218, 161, 203, 196,   3,  18,  45,  71, 116, 152, 103,
+        169, 219, 211, 249, 251, 167, 221, 210,  24, 100,  65, 122, 157,
+        102,   0,  22,  20,   2,  20,  16,   0,   0,  20,   0,  20,  33,
+        177, 211, 219, 207, 226, 252,  90, 107, 126, 228, 235, 215, 162,
+        164, 218,  47,  48, 126,  56,  99, 110,   0,   7,   0,  44,  99,
+         44,   0,  20,   0,  20,  17,  16,  20,  20,  20,  20,  20,  20,
+         63,  79, 122, 135, 136, 162,   0,  10,   2,  76,  97,  86,  89,
+         42,  65,  86,  71, 144, 134, 207, 235,  77, 132, 109, 159, 235,
+        196,  15,  63,  20,  33,  20,   0,  20,  20,  20,  20,  20,  20
+    },
+    {   // GRBG
+        131, 169,  72,  92, 138, 125,  46,  50, 131, 141, 128, 210, 183,
+        195, 246,  83, 154, 130,  62, 155,  46,  90, 134,  53, 101, 145,
+        220, 230, 226, 255, 241, 230, 225, 230, 230, 230, 230, 230, 230,
+         18, 126,  71,  67, 146, 143, 117,  97, 149, 129, 101, 163, 182,
+        219, 221,  20, 113,  97,   0,  53,  11, 205, 209, 186, 255, 207,
+        232, 255, 230, 251, 255, 255, 230, 255, 230, 217, 255, 255, 230,
+         40, 153,  62,  28, 103,  41,   0,  41,  72, 129, 132, 145, 161,
+        225, 152,  12,  71,   0,  11,  12,   0, 207, 171, 202, 171,  69,
+        110, 230, 166, 191, 255, 230, 194, 230, 204, 164, 255, 230, 204,
+        150, 235, 139, 183, 240, 178,  92,  69,  53, 116,  70,   0,  43,
+        115,  19, 201, 244, 130, 198, 207, 134, 179, 177, 154, 129, 105,
+        106,  59,  20,   7,  70,  36,  20,  46,  20,   0,  86,  46,  20,
+        218, 206, 144, 196, 203, 161,  45,  18,   3, 152, 116,  71, 219,
+        169, 103, 251, 249, 211, 210, 221, 167,  65, 100,  24, 102, 157,
+        122,  20,  22,   0,  16,  20,   2,  20,   0,   0,  33,  20,   0,
+        219, 211, 177, 252, 226, 207, 126, 107,  90, 215, 235, 228, 218,
+        164, 162, 126,  48,  47, 110,  99,  56,   0,   7,   0,  44,  99,
+         44,   0,  20,   0,  16,  17,  20,  20,  20,  20,  20,  20,  20,
+        122,  79,  63, 162, 136, 135,   2,  10,   0,  86,  97,  76,  65,
+         42,  89, 144,  71,  86, 235, 207, 134, 109, 132,  77, 196, 235,
+        159,  20,  63,  15,   0,  20,  33,  20,  20,  20,  20,  20,  20
+    },
+    {   // BGGR
+        197, 115, 169, 156,  92,  86,  77, 102,  50,  75, 141, 112, 130,
+        182, 195, 118,  83, 142, 209,  81, 155, 172,  90, 132, 230, 203,
+        145, 221, 230, 205, 246, 241, 230, 230, 230, 230, 230, 230, 230,
+        136,  71, 168, 146,  79,  94, 144, 149,  83, 101, 157, 123, 195,
+        221, 255, 113,  55, 106,  71,  11,  52, 209, 148, 115, 255, 232,
+        130, 230, 255, 212, 217, 230, 255, 230, 255, 255, 217, 230, 255,
+        222,  86, 153, 133,  28,  61,  86,  55,  41,  77, 129, 172, 223,
+        156, 225, 117,  12,  57,  69,  13,  12, 255, 207,  89, 109, 160,
+         69, 191, 230, 181, 195, 224, 230, 204, 230, 255, 164, 204, 230,
+        255, 139, 186, 240, 139, 157, 120,  53,   0,  70,  21,  12, 101,
+         19, 105, 244, 175, 255, 216, 134, 133, 177, 157, 158,  98, 106,
+         89,  20,  48,  50,   0,  20,  52,  20,  46,  86,   0,  20,  46,
+        255, 247, 206, 255, 196, 146, 126,  79,  18, 208, 152, 106, 181,
+        167, 169, 251, 251, 255, 183, 169, 221,  68,  65, 173,  72,  69,
+        157,   0,  20,  82,   0,   0,  20,   0,  20,  33,   0,   0,  20,
+        244, 177, 135, 226, 153,  74, 179,  90,   0, 235, 168, 127, 157,
+        162, 114,  48, 111,  96,   0,  56, 167,   7,  41, 163,  14,  44,
+        183,  20,  28, 110,  17,  20,  22,  20,  20,  20,  20,  20,  20,
+        204, 155,  79, 227, 162,  73, 209,  92,  10, 207,  86,   0,  69,
+         90,  42,  33, 144, 167,  48, 105, 207,  44, 109, 252,  88, 104,
+        235,  20,  20, 110,   0,   0,  20,  20,  20,  20,  20,  20,  20
+    }
+};
+
+#endif // DEMOSAICREFERENCE_H
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The pixel formats and Bayer layouts a frame can come in. They mirror
+ * PvAPI's tPvImageFormat and tPvBayerPattern value for value, so Camera
+ * converts with a cast and raw recordings stay readable, but only the
+ * camera backend needs the SDK's headers.
+ */
+
+#ifndef FRAMEFORMAT_H
+#define FRAMEFORMAT_H
+
+/**
+ * @brief Layout of a frame's pixels, numbered as tPvImageFormat
+ */
+enum FrameFormat
+{
+    FormatMono8         = 0,    //!< Monochrome, 8 bits
+    FormatMono16        = 1,    //!< Monochrome, 16 bits, LSB aligned (NIR, 12 significant bits)
+    FormatBayer8        = 2,    //!< Bayer colour, 8 bits (WL)
+    FormatBayer16       = 3,    //!< Bayer colour, 16 bits, LSB aligned
+    FormatRgb24         = 4,    //!< RGB, 8 bits x 3
+    FormatRgb48         = 5,    //!< RGB, 16 bits x 3, LSB aligned
+    FormatYuv411        = 6,    //!< YUV 411
+    FormatYuv422        = 7,    //!< YUV 422
+    FormatYuv444        = 8,    //!< YUV 444
+    FormatBgr24         = 9,    //!< BGR, 8 bits x 3
+    FormatRgba32        = 10,   //!< RGBA, 8 bits x 4
+    FormatBgra32        = 11,   //!< BGRA, 8 bits x 4
+    FormatMono12Packed  = 12,   //!< Monochrome, 12 bits, packed
+    FormatBayer12Packed = 13    //!< Bayer colour, 12 bits, packed
+};
+
+/**
+ * @brief Colours of the top left 2x2 pixels of a Bayer frame, numbered as tPvBayerPattern
+ */
+enum BayerLayout
+{
+    BayerRGGB           = 0,    //!< First line RGRG, second line GBGB
+    BayerGBRG           = 1,    //!< First line GBGB, second line RGRG
+    BayerGRBG           = 2,    //!< First line GRGR, second line BGBG
+    BayerBGGR           = 3     //!< First line BGBG, second line GRGR
+};
+
+#endif // FRAMEFORMAT_H
@@ -0,0 +1,60 @@
+#include "frameinfo.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <cstring>
+
+double FrameInfo::timestampSeconds() const
+{
+    if (this->TimestampFrequency == 0)
+        return this->HostTime / 1000000.0;
+    return static_cast<double>(this->Timestamp) / static_cast<double>(this->TimestampFrequency);
+}
+
+/**
+ * @brief Reads a 32-bit word of chunk data, swapping it if the camera sent it big-endian
+ */
+static quint32 chunkWord(const uchar* data, int offset, bool swap)
+{
+    quint32 word;
+    std::memcpy(&word, data + offset, sizeof(quint32));
+    if (swap)
+        word = ((word & 0xFF) << 24) | ((word & 0xFF00) << 8) | ((word >> 8) & 0xFF00) | (word >> 24);
+    return word;
+}
+
+bool FrameInfo::readAncillary(const void *data, unsigned long size)
+{
+    if (data == NULL || size < ANCILLARY_CHUNK_SIZE)
+        return false;
+
+    /// The chunk ID says which byte order the words are in
+    const uchar* chunk = static_cast<const uchar*>(data);
+    bool swap = false;
+    if (chunkWord(chunk, 40, false) != ANCILLARY_CHUNK_ID)
+    {
+        if (chunkWord(chunk, 40, true) != ANCILLARY_CHUNK_ID)
+            return false;
+        swap = true;
+    }
+
+    quint32 sync = chunkWord(chunk, 16, swap);  //!< SyncIn levels in the first half, SyncOut in the second
+    this->AcquisitionCount = chunkWord(chunk, 0, swap);
+    this->ExposureValue = chunkWord(chunk, 8, swap);
+    this->Gain = chunkWord(chunk, 12, swap);
+    this->SyncInLevels = static_cast<unsigned short>((swap) ? (sync >> 16) : (sync & 0xFFFF));
+    this->SyncOutLevels = static_cast<unsigned short>((swap) ? (sync & 0xFFFF) : (sync >> 16));
+    this->Ancillary = true;
+    return true;
+}
+
+qint64 hostTimeUs()
+{
+    static QElapsedTimer clock;
+    static QMutex clockMutex;
+
+    QMutexLocker locker(&clockMutex);
+    if (!clock.isValid())
+        clock.start();
+    return clock.nsecsElapsed() / 1000;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * FrameInfo is the metadata record that travels with every frame emitted
+ * by a Camera: which camera it came from, when the sensor captured it,
+ * its frame counter and the exposure it was taken with. Consumers read
+ * this instead of the camera's shared tPvFrame.
+ *
+ * Cameras in chunk mode send ancillary data with every frame, which
+ * readAncillary() parses: the exposure and gain the sensor really used,
+ * and the levels of the sync lines, with no attribute read needed.
+ */
+
+#ifndef FRAMEINFO_H
+#define FRAMEINFO_H
+
+#include <QMetaType>
+#include <QtGlobal>
+
+#include <framepool.h>
+#include <frameformat.h>
+
+#define ANCILLARY_CHUNK_ID 1000     //!< Chunk ID PvAPI cameras put in their ancillary data
+#define ANCILLARY_CHUNK_SIZE 48     //!< Bytes of ancillary data parsed, see tPvFrame::AncillaryBuffer
+
+struct FrameInfo
+{
+    unsigned long       CameraID;           //!< UniqueId of the camera that captured the frame
+    unsigned long long  Timestamp;          //!< Hardware timestamp, in camera clock ticks
+    unsigned long       TimestampFrequency; //!< Camera clock ticks per second (0 if unknown)
+    unsigned long       FrameCount;         //!< Hardware frame counter (16-bit, rolls over at 65535)
+    unsigned long       ExposureValue;      //!< Exposure the frame was captured with, in microseconds
+    qint64              HostTime;           //!< Host arrival time in microseconds, see hostTimeUs()
+    unsigned long       StreamBytesPerSecond; //!< Rate the camera sent the frame at, in bytes per second (0 if unknown)
+    unsigned long       Width;              //!< Image width in pixels
+    unsigned long       Height;             //!< Image height in pixels
+    unsigned long       ImageSize;          //!< Image size in bytes
+    FrameFormat         Format;             //!< Pixel format
+    unsigned long       BitDepth;           //!< Number of significant bits per pixel
+    BayerLayout         BayerPattern;       //!< Bayer pattern, if Format is a bayer format
+    unsigned long       OffsetX;            //!< Left edge of the frame in the camera's uncropped view, in unbinned pixels
+    unsigned long       OffsetY;            //!< Top edge of the frame in the camera's uncropped view, in unbinned pixels
+    unsigned long       Binning;            //!< Binning factor the frame was captured with, 0 if unknown
+    unsigned long       SensorX;            //!< Left edge of the frame on the sensor (region and crop), in unbinned pixels
+    unsigned long       SensorY;            //!< Top edge of the frame on the sensor (region and crop), in unbinned pixels
+    bool                Ancillary;          //!< True if ExposureValue and the fields below came from the frame's chunk data
+    unsigned long       AcquisitionCount;   //!< Camera's acquisition counter (chunk data)
+    unsigned long       Gain;               //!< Gain the frame was captured with, in dB (chunk data)
+    unsigned short      SyncInLevels;       //!< SyncIn line levels during capture, bit 0 is SyncIn1 (chunk data)
+    unsigned short      SyncOutLevels;      //!< SyncOut line levels during capture, bit 0 is SyncOut1 (chunk data)
+
+    /**
+     * @brief Gets the hardware timestamp in seconds
+     *
+     * Falls back to the host arrival time if the camera's clock frequency is unknown.
+     */
+    double timestampSeconds() const;
+
+    /**
+     * @brief Fills ExposureValue, AcquisitionCount, Gain and the sync levels from chunk data
+     *
+     * Leaves the frame untouched if the data is too short or isn't a chunk PvAPI knows.
+     *
+     * @param data Ancillary data the camera sent with the frame
+     * @param size Bytes of data, tPvFrame::AncillarySize
+     * @return true if the chunk was parsed, and Ancillary set
+     */
+    bool readAncillary(const void* data, unsigned long size);
+};
+
+/**
+ * @brief Monotonic host clock shared by every camera, in microseconds
+ */
+qint64 hostTimeUs();
+
+Q_DECLARE_METATYPE(FrameInfo)
+Q_DECLARE_METATYPE(FrameBuffer)
+
+#endif // FRAMEINFO_H
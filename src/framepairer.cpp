@@ -0,0 +1,312 @@
+#include "framepairer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FramePairer::FramePairer(int streams, double tolerance, int depth)
+{
+    this->Streams = streams;
+    this->Tolerance = tolerance;
+    this->Depth = depth;
+    this->Pending.resize(streams);
+    this->Offset.resize(streams);
+    this->WindowOffset.resize(streams);
+    this->WindowCount.resize(streams);
+    this->HaveOffset.resize(streams);
+    this->Rate.resize(streams);
+    this->reset();
+}
+
+void FramePairer::reset()
+{
+    for (int k = 0; k < this->Streams; k++)
+    {
+        this->Pending[k].clear();
+        this->Offset[k] = 0;
+        this->WindowOffset[k] = 0;
+        this->WindowCount[k] = 0;
+        this->HaveOffset[k] = false;
+        this->Rate[k] = 0;
+    }
+    this->Paired = 0;
+    this->Unpaired = 0;
+    this->LastSkew = 0;
+}
+
+double FramePairer::toCommonClock(int stream, const FrameInfo &info)
+{
+    /// The hardware timestamp is latched at exposure start, the host time once the frame has arrived
+    double hardware = info.timestampSeconds();
+    double offset = info.HostTime / 1000000.0 - hardware - info.ExposureValue / 1000000.0;
+
+    /// A camera paces each frame out at its stream rate, so arrival lags the exposure by the transfer
+    /// time too. Left in, it would shift a camera with bigger frames or less bandwidth later than the rest
+    if (info.StreamBytesPerSecond > 0)
+        offset -= (double)info.ImageSize / info.StreamBytesPerSecond;
+
+    /// Estimates made at another rate carry another transfer time, so they start over
+    if (info.StreamBytesPerSecond != this->Rate[stream])
+    {
+        this->Rate[stream] = info.StreamBytesPerSecond;
+        this->HaveOffset[stream] = false;
+        this->WindowCount[stream] = 0;
+    }
+
+    if (!this->HaveOffset[stream])
+    {
+        this->Offset[stream] = offset;
+        this->WindowOffset[stream] = offset;
+        this->HaveOffset[stream] = true;
+    }
+    else
+    {
+        if (offset < this->Offset[stream])
+            this->Offset[stream] = offset;      //!< A faster delivery is a better estimate straight away
+        if (this->WindowCount[stream] == 0 || offset < this->WindowOffset[stream])
+            this->WindowOffset[stream] = offset;
+    }
+
+    /// Restarts the estimate every window, so a slowly drifting camera clock is followed
+    if (++this->WindowCount[stream] >= PAIRING_OFFSET_WINDOW)
+    {
+        this->Offset[stream] = this->WindowOffset[stream];
+        this->WindowCount[stream] = 0;
+    }
+
+    return hardware + this->Offset[stream];
+}
+
+bool FramePairer::push(int stream, const QImage &image, const FrameInfo &info, FrameGroup *group)
+{
+    PendingFrame frame;
+    frame.Image = image;
+    frame.Info = info;
+    frame.Time = this->toCommonClock(stream, info);
+
+    this->Pending[stream].enqueue(frame);
+    if (this->Pending[stream].count() > this->Depth)
+    {
+        this->Pending[stream].dequeue();
+        this->Unpaired++;
+    }
+
+    return this->match(group);
+}
+
+bool FramePairer::match(FrameGroup *group)
+{
+    QQueue<PendingFrame> &reference = this->Pending[0];
+
+    while (!reference.isEmpty())
+    {
+        double time = reference.first().Time;
+        QVector<int> matches(this->Streams, -1);
+        bool hopeless = false;
+        bool waiting = false;
+
+        for (int k = 1; k < this->Streams && !hopeless; k++)
+        {
+            QQueue<PendingFrame> &queue = this->Pending[k];
+
+            /// Frames too old for the oldest reference frame are too old for every later one too
+            while (!queue.isEmpty() && queue.first().Time < time - this->Tolerance)
+            {
+                queue.dequeue();
+                this->Unpaired++;
+            }
+
+            double best = this->Tolerance;
+            for (int i = 0; i < queue.count(); i++)
+            {
+                double distance = queue[i].Time - time;
+                if (distance < 0)
+                    distance = -distance;
+                if (distance <= best)
+                {
+                    best = distance;
+                    matches[k] = i;
+                }
+            }
+
+            if (matches[k] < 0)
+            {
+                /// Frames arrive in capture order, so once the stream is past the window nothing will match
+                if (!queue.isEmpty() && queue.last().Time > time + this->Tolerance)
+                    hopeless = true;
+                else
+                    waiting = true;
+            }
+        }
+
+        if (hopeless)
+        {
+            reference.dequeue();
+            this->Unpaired++;
+            continue;
+        }
+        if (waiting)
+            return false;
+
+        group->Images.clear();
+        group->Infos.clear();
+        group->Time = time;
+        group->Skew = 0;
+
+        PendingFrame first = reference.dequeue();
+        group->Images.append(first.Image);
+        group->Infos.append(first.Info);
+
+        for (int k = 1; k < this->Streams; k++)
+        {
+            QQueue<PendingFrame> &queue = this->Pending[k];
+            for (int i = 0; i < matches[k]; i++)
+            {
+                queue.dequeue();    //!< Passed over for a closer frame
+                this->Unpaired++;
+            }
+            PendingFrame frame = queue.dequeue();
+            group->Images.append(frame.Image);
+            group->Infos.append(frame.Info);
+
+            double skew = frame.Time - time;
+            if (skew < 0)
+                skew = -skew;
+            if (skew > group->Skew)
+                group->Skew = skew;
+        }
+
+        this->Paired++;
+        this->LastSkew = group->Skew;
+        return true;
+    }
+    return false;
+}
+
+void FramePairer::setTolerance(double tolerance)
+{
+    this->Tolerance = tolerance;
+}
+
+double FramePairer::tolerance() const
+{
+    return this->Tolerance;
+}
+
+unsigned long FramePairer::paired() const
+{
+    return this->Paired;
+}
+
+unsigned long FramePairer::unpaired() const
+{
+    return this->Unpaired;
+}
+
+double FramePairer::lastSkew() const
+{
+    return this->LastSkew;
+}
+
+/**
+ * @brief A synthetic frame waiting to be delivered, see FramePairer::check()
+ */
+struct SyntheticArrival
+{
+    int         Stream;
+    FrameInfo   Info;
+};
+
+static bool arrivesFirst(const SyntheticArrival &a, const SyntheticArrival &b)
+{
+    return a.Info.HostTime < b.Info.HostTime;
+}
+
+bool FramePairer::check()
+{
+    /// Stream 0 is a WL camera sending 1360x1024 Bayer8, stream 1 a NIR camera sending binned Mono16
+    struct Case { const char* Name; double Jitter; int Drop; double Drift; unsigned long Rate0; unsigned long Rate1; unsigned long Rate1Later; };
+    const Case cases[] = {
+        {"triggered, same transfer time", 0.001, 0, 0, 40000000, 20000000, 20000000},
+        {"transfer times 26 ms apart", 0.001, 0, 0, 40000000, 80000000, 80000000},
+        {"3 ms arrival jitter", 0.003, 0, 0, 40000000, 80000000, 80000000},
+        {"10% of frames dropped", 0.003, 10, 0, 40000000, 80000000, 80000000},
+        {"clocks drifting 200 ppm apart", 0.003, 0, 0.0002, 40000000, 80000000, 80000000},
+        {"NIR bandwidth rebalanced halfway", 0.003, 5, 0.0001, 40000000, 80000000, 30000000}
+    };
+    const int frames = 6000;                //!< 200 s at 30 fps, long enough for the clocks to drift 40 ms
+    const double period = 1.0/30;
+    const unsigned long size[2] = {1360*1024, 680*512*2};
+    const unsigned long exposure[2] = {10000, 30000};
+    const unsigned long frequency[2] = {36855000, 1000000};
+    const double boot[2] = {-123.4, -5.6};  //!< When each camera's clock started, on the host clock
+
+    bool passed = true;
+    std::cout << "Frame pairing on synthetic streams" << std::endl;
+    for (unsigned int c = 0; c < sizeof(cases)/sizeof(cases[0]); c++)
+    {
+        const Case &test = cases[c];
+        unsigned int seed = 12345 + c;
+        QVector<SyntheticArrival> arrivals;
+        QVector<bool> delivered(frames*2);
+
+        for (int n = 0; n < frames; n++)
+        {
+            double trigger = 10.0 + n*period;   //!< Both cameras expose together, as in SyncTriggered
+            for (int k = 0; k < 2; k++)
+            {
+                seed = seed*1103515245 + 12345;
+                delivered[n*2 + k] = (int)((seed >> 16) % 100) >= test.Drop;
+                if (!delivered[n*2 + k])
+                    continue;
+
+                unsigned long rate = (k == 0) ? test.Rate0 : ((n < frames/2) ? test.Rate1 : test.Rate1Later);
+                double drift = (k == 1) ? test.Drift : 0;
+
+                seed = seed*1103515245 + 12345;
+                double jitter = test.Jitter * ((seed >> 16) % 1000) / 1000.0;
+                double arrival = trigger + exposure[k] / 1000000.0 + (double)size[k] / rate + 0.0004 + jitter;
+
+                SyntheticArrival frame;
+                memset(&frame.Info, 0, sizeof(FrameInfo));
+                frame.Stream = k;
+                frame.Info.Timestamp = (unsigned long long)((trigger - boot[k]) * (1.0 + drift) * frequency[k]);
+                frame.Info.TimestampFrequency = frequency[k];
+                frame.Info.ExposureValue = exposure[k];
+                frame.Info.HostTime = (qint64)(arrival * 1000000.0);
+                frame.Info.ImageSize = size[k];
+                frame.Info.StreamBytesPerSecond = rate;
+                frame.Info.AcquisitionCount = n;
+                arrivals.append(frame);
+            }
+        }
+        std::stable_sort(arrivals.begin(), arrivals.end(), arrivesFirst);
+
+        int complete = 0;
+        for (int n = 0; n < frames; n++)
+            if (delivered[n*2] && delivered[n*2 + 1])
+                complete++;
+
+        FramePairer pairer(2);
+        QImage image;
+        FrameGroup group;
+        int wrong = 0;
+        double worst = 0;
+        for (int i = 0; i < arrivals.count(); i++)
+        {
+            if (!pairer.push(arrivals[i].Stream, image, arrivals[i].Info, &group))
+                continue;
+            if (group.Infos[0].AcquisitionCount != group.Infos[1].AcquisitionCount)
+                wrong++;
+            if (group.Skew > worst)
+                worst = group.Skew;
+        }
+
+        /// Every frame both cameras delivered has to be paired, with its own partner only
+        bool right = wrong == 0 && pairer.paired() == (unsigned long)complete;
+        passed = passed && right;
+        std::cout << "  " << test.Name << ": " << pairer.paired() << " of " << complete << " paired, "
+                  << wrong << " wrong, skew up to " << worst * 1000.0 << " ms" << ((right) ? "" : ", WRONG") << std::endl;
+    }
+    return passed;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The FramePairer class matches frames from several cameras by when they
+ * were captured, so that a composite only ever blends frames taken at the
+ * same moment. Each camera's hardware clock is mapped onto the host clock
+ * first, then every frame of the reference stream (stream 0) is grouped with
+ * the closest frame of each other stream, provided it lies within the
+ * tolerance. Frames that can no longer be matched are dropped.
+ *
+ * The pairer only looks at FrameInfo, so it can be fed synthetic timestamp
+ * streams as well as real frames.
+ */
+
+#ifndef FRAMEPAIRER_H
+#define FRAMEPAIRER_H
+
+#define PAIRING_TOLERANCE 0.025     //!< Default largest capture time difference within a group, in seconds
+#define PAIRING_DEPTH 32            //!< Most frames kept waiting per stream
+#define PAIRING_OFFSET_WINDOW 256   //!< Frames per clock offset estimate, so drift between clocks is followed
+
+#include <QVector>
+#include <QQueue>
+#include <QImage>
+#include <frameinfo.h>
+
+/**
+ * @brief Frames captured at the same moment, one per stream
+ */
+struct FrameGroup
+{
+    QVector<QImage>     Images;     //!< Image of each stream, in stream order
+    QVector<FrameInfo>  Infos;      //!< Metadata of each stream's frame
+    double              Time;       //!< Capture time of the reference frame on the common clock, in seconds
+    double              Skew;       //!< Largest capture time difference to the reference frame, in seconds
+};
+
+class FramePairer
+{
+public:
+
+    /**
+     * @brief Creates a pairer for a number of streams
+     *
+     * @param streams Number of streams. Stream 0 is the reference every group is built around
+     * @param tolerance Largest capture time difference within a group, in seconds
+     * @param depth Most frames kept waiting per stream
+     */
+    FramePairer(int streams, double tolerance = PAIRING_TOLERANCE, int depth = PAIRING_DEPTH);
+
+    /**
+     * @brief Adds a frame and checks if it completes a group
+     *
+     * @param stream Stream the frame belongs to
+     * @param image Frame's image, handed back in the group
+     * @param info Frame's metadata, used for its capture time
+     * @param group Filled in if a group was completed
+     * @return true if group was filled in, false otherwise
+     */
+    bool push(int stream, const QImage &image, const FrameInfo &info, FrameGroup* group);
+
+    /**
+     * @brief Maps a frame's capture time onto the common (host) clock
+     *
+     * The offset between a camera's clock and the host clock is estimated as the smallest
+     * host arrival time minus hardware exposure start seen over the last PAIRING_OFFSET_WINDOW
+     * frames. The frame's transfer time, ImageSize over StreamBytesPerSecond, is taken off
+     * first, which leaves the clock offset plus the shortest network and host latency, about
+     * the same for every camera on the link.
+     *
+     * @return Exposure start of the frame on the host clock, in seconds
+     */
+    double toCommonClock(int stream, const FrameInfo &info);
+
+    /**
+     * @brief Drops every waiting frame and forgets the clock offsets
+     */
+    void reset();
+
+    void setTolerance(double tolerance);
+    double tolerance() const;
+
+    unsigned long paired() const;      //!< Groups completed so far
+    unsigned long unpaired() const;    //!< Frames dropped without a match so far
+    double lastSkew() const;           //!< Skew of the last completed group, in seconds
+
+    /**
+     * @brief Pairs synthetic triggered streams and checks every group holds one trigger's frames
+     *
+     * The streams have arrival jitter, dropped frames, drifting clocks and different transfer
+     * times, and the NIR stream's bandwidth changes halfway through one of them.
+     *
+     * @return true if every frame both streams delivered was paired with its own partner
+     */
+    static bool check();
+
+private:
+
+    /**
+     * @brief A frame waiting for its partners
+     */
+    struct PendingFrame
+    {
+        QImage          Image;
+        FrameInfo       Info;
+        double          Time;           //!< Capture time on the common clock
+    };
+
+    /**
+     * @brief Tries to build a group around the oldest waiting reference frame
+     */
+    bool match(FrameGroup* group);
+
+    int                 Streams;        //!< Number of streams
+    double              Tolerance;      //!< Largest capture time difference within a group
+    int                 Depth;          //!< Most frames kept per stream
+    QVector< QQueue<PendingFrame> > Pending; //!< Frames waiting to be grouped, oldest first, per stream
+    QVector<double>     Offset;         //!< Current clock offset of each stream
+    QVector<double>     WindowOffset;   //!< Smallest offset seen in the current window
+    QVector<int>        WindowCount;    //!< Frames seen in the current window
+    QVector<bool>       HaveOffset;     //!< False until a stream's first frame
+    QVector<unsigned long> Rate;        //!< Stream rate the current offset was estimated at
+    unsigned long       Paired;         //!< Groups completed
+    unsigned long       Unpaired;       //!< Frames dropped
+    double              LastSkew;       //!< Skew of the last group
+};
+
+#endif // FRAMEPAIRER_H
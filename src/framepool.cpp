@@ -0,0 +1,168 @@
+#include "framepool.h"
+
+/// Guards FrameSlot::Pool of every pool's slots. Outlives all pools, unlike their own mutexes
+static QMutex SlotMutex;
+
+FrameBuffer::FrameBuffer()
+{
+    this->Slot = NULL;
+}
+
+FrameBuffer::FrameBuffer(FrameSlot *slot)
+{
+    this->Slot = slot;
+}
+
+FrameBuffer::FrameBuffer(const FrameBuffer &other)
+{
+    this->Slot = other.Slot;
+    if (this->Slot)
+        this->Slot->Ref.ref();
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer &other)
+{
+    if (other.Slot)
+        other.Slot->Ref.ref(); //!< Taken first so self-assignment is safe
+    release(this->Slot);
+    this->Slot = other.Slot;
+    return *this;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    release(this->Slot);
+}
+
+unsigned char* FrameBuffer::data() const
+{
+    return (this->Slot) ? this->Slot->Data : NULL;
+}
+
+unsigned long FrameBuffer::size() const
+{
+    return (this->Slot) ? this->Slot->Size : 0;
+}
+
+bool FrameBuffer::isNull() const
+{
+    return this->Slot == NULL;
+}
+
+void FrameBuffer::reset()
+{
+    release(this->Slot);
+    this->Slot = NULL;
+}
+
+QImage FrameBuffer::toImage(int width, int height, int bytesPerLine, QImage::Format format) const
+{
+    if (!this->Slot)
+        return QImage();
+
+    this->Slot->Ref.ref(); //!< Dropped again by releaseImage() when Qt lets go of the image
+    return QImage(this->Slot->Data, width, height, bytesPerLine, format, releaseImage, this->Slot);
+}
+
+void FrameBuffer::releaseImage(void *info)
+{
+    release(static_cast<FrameSlot*>(info));
+}
+
+void FrameBuffer::release(FrameSlot *slot)
+{
+    if (!slot || slot->Ref.deref())
+        return;
+
+    QMutexLocker locker(&SlotMutex);
+    if (slot->Pool)
+    {
+        slot->Pool->recycle(slot);
+        return;
+    }
+    locker.unlock();
+    qFreeAligned(slot->Data); //!< Pool is gone, the last user frees the slot
+    delete slot;
+}
+
+FramePool::FramePool(unsigned long bufferSize, int count, int limit)
+{
+    this->BufferSize = bufferSize;
+    this->Limit = (limit > 0) ? qMax(limit, count) : count + FRAMEPOOL_GROWTH;
+    this->Slots.reserve(count);
+    this->FreeSlots.reserve(count);
+
+    QMutexLocker locker(&this->Mutex);
+    for (int i = 0; i < count; i++)
+        this->FreeSlots.append(allocateSlot());
+}
+
+FramePool::~FramePool()
+{
+    QMutexLocker slotLocker(&SlotMutex);   //!< Taken before Mutex, like release() does
+    QMutexLocker locker(&this->Mutex);
+    for (int i = 0; i < this->Slots.count(); i++)
+    {
+        FrameSlot* slot = this->Slots[i];
+        if (this->FreeSlots.contains(slot))
+        {
+            qFreeAligned(slot->Data);
+            delete slot;
+        }
+        else
+            slot->Pool = NULL;
+    }
+}
+
+FrameBuffer FramePool::acquire()
+{
+    QMutexLocker locker(&this->Mutex);
+
+    FrameSlot* slot;
+    if (this->FreeSlots.isEmpty())
+    {
+        if (this->Slots.count() >= this->Limit)
+            return FrameBuffer();
+        slot = allocateSlot();
+        this->FreeSlots.reserve(this->Slots.count()); //!< recycle() never has to grow the free list
+    }
+    else
+        slot = this->FreeSlots.takeLast(); //!< Most recently used buffer is the most likely to be cached
+
+    slot->Ref.store(1);
+    return FrameBuffer(slot);
+}
+
+unsigned long FramePool::bufferSize() const
+{
+    return this->BufferSize;
+}
+
+int FramePool::available()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->FreeSlots.count();
+}
+
+int FramePool::capacity()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Slots.count();
+}
+
+FrameSlot* FramePool::allocateSlot()
+{
+    FrameSlot* slot = new FrameSlot;
+    slot->Data = static_cast<unsigned char*>(qMallocAligned(this->BufferSize, FRAMEPOOL_ALIGNMENT));
+    slot->Size = this->BufferSize;
+    slot->Ref.store(0);
+    slot->Pool = this;
+    this->Slots.append(slot);
+    return slot;
+}
+
+void FramePool::recycle(FrameSlot *slot)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->FreeSlots.append(slot);
+}
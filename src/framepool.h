@@ -0,0 +1,200 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The FramePool class owns a set of preallocated, aligned image buffers.
+ * Buffers are handed out as reference-counted FrameBuffer handles, so that
+ * the display, overlay, autoexposure, screenshot and encoder paths can all
+ * share one buffer without copying it. When the last handle goes away the
+ * buffer returns to its pool instead of being freed.
+ */
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#define FRAMEPOOL_ALIGNMENT 32  //!< Byte alignment of every pooled buffer (wide enough for AVX2)
+#define FRAMEPOOL_SPARE 4       //!< Extra buffers on top of what the producer keeps for itself
+#define FRAMEPOOL_GROWTH 64     //!< Buffers a pool may add to its initial count, enough for a full raw recorder queue
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVector>
+#include <QImage>
+
+class FramePool;
+
+/**
+ * @brief One preallocated buffer, shared by every FrameBuffer handle pointing at it
+ */
+struct FrameSlot
+{
+    unsigned char*  Data;       //!< Aligned pixel storage
+    unsigned long   Size;       //!< Size of Data in bytes
+    QAtomicInt      Ref;        //!< Number of live FrameBuffer handles (and QImages) using this slot
+    FramePool*      Pool;       //!< Pool the slot returns to, NULL once the pool has been destroyed. Guarded by the slot mutex
+};
+
+/**
+ * @brief Reference-counted handle to a pooled buffer
+ *
+ * Copying a FrameBuffer only bumps a reference count. The buffer goes back to its
+ * pool when the last handle is destroyed.
+ */
+class FrameBuffer
+{
+public:
+
+    /**
+     * @brief Creates a null handle
+     */
+    FrameBuffer();
+
+    FrameBuffer(const FrameBuffer &other);
+    FrameBuffer& operator=(const FrameBuffer &other);
+
+    /**
+     * @brief Drops this handle's reference
+     */
+    ~FrameBuffer();
+
+    /**
+     * @brief Gets the buffer's data
+     * @return Pointer to the buffer, NULL for a null handle
+     */
+    unsigned char* data() const;
+
+    /**
+     * @brief Gets the buffer's capacity in bytes
+     */
+    unsigned long size() const;
+
+    /**
+     * @brief Checks if the handle points at a buffer
+     * @return true if the handle is null, false otherwise
+     */
+    bool isNull() const;
+
+    /**
+     * @brief Releases the buffer held by this handle, leaving it null
+     */
+    void reset();
+
+    /**
+     * @brief Wraps the buffer in a QImage without copying it
+     *
+     * The QImage holds its own reference, so the buffer stays alive for as long as
+     * the image (or any shallow copy of it) does. Only use the image's const accessors
+     * (constBits(), constScanLine()); the non-const ones make Qt detach into a copy.
+     */
+    QImage toImage(int width, int height, int bytesPerLine, QImage::Format format) const;
+
+private:
+    friend class FramePool;
+
+    /**
+     * @brief Adopts a slot whose reference count was already incremented
+     */
+    explicit FrameBuffer(FrameSlot* slot);
+
+    /**
+     * @brief QImage cleanup function, drops the reference taken by toImage()
+     */
+    static void releaseImage(void* info);
+
+    /**
+     * @brief Drops one reference on slot, returning it to its pool on the last one
+     *
+     * The slot's pool is read under a mutex shared by every pool, which ~FramePool() also
+     * takes, so a pool can't be destroyed between the read and the recycle.
+     */
+    static void release(FrameSlot* slot);
+
+    FrameSlot*      Slot;       //!< Shared slot, NULL for a null handle
+};
+
+class FramePool
+{
+public:
+
+    /**
+     * @brief Preallocates count buffers of bufferSize bytes each
+     *
+     * @param bufferSize Size of each buffer in bytes
+     * @param count Number of buffers allocated up front
+     * @param limit Most buffers the pool may own, 0 for count + FRAMEPOOL_GROWTH
+     */
+    FramePool(unsigned long bufferSize, int count, int limit = 0);
+
+    /**
+     * @brief Frees every buffer that is back in the pool
+     *
+     * Buffers that are still referenced are freed when their last handle goes away.
+     */
+    ~FramePool();
+
+    /**
+     * @brief Hands out a free buffer
+     *
+     * If every buffer is in use the pool grows by one, so a slow consumer never
+     * stalls the producer. Once the pool has grown to the working set, streaming
+     * does not allocate anymore. A consumer that stops letting go of buffers would
+     * make it grow for good, so past its limit the pool hands out nothing and the
+     * producer has to drop the frame.
+     *
+     * @return Handle to a buffer of bufferSize() bytes, contents undefined. A null handle
+     *         if the pool owns its limit of buffers and all of them are in use
+     */
+    FrameBuffer acquire();
+
+    /**
+     * @brief Gets the size of each buffer in bytes
+     */
+    unsigned long bufferSize() const;
+
+    /**
+     * @brief Gets the number of buffers currently in the pool
+     */
+    int available();
+
+    /**
+     * @brief Gets the number of buffers owned by the pool, in use or not
+     */
+    int capacity();
+
+private:
+    friend class FrameBuffer;
+
+    /**
+     * @brief Allocates a new aligned slot. Mutex must be held.
+     */
+    FrameSlot* allocateSlot();
+
+    /**
+     * @brief Puts a slot back on the free list once its last reference is gone. The slot mutex must be held
+     */
+    void recycle(FrameSlot* slot);
+
+    unsigned long       BufferSize;     //!< Size of every buffer in bytes
+    int                 Limit;          //!< Most slots the pool may own
+    QMutex              Mutex;          //!< Guards Slots and FreeSlots
+    QVector<FrameSlot*> Slots;          //!< Every slot owned by this pool
+    QVector<FrameSlot*> FreeSlots;      //!< Slots ready to be handed out
+};
+
+#endif // FRAMEPOOL_H
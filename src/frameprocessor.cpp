@@ -0,0 +1,148 @@
+#include "frameprocessor.h"
+
+#include <cstring>
+#include <iostream>
+
+FrameProcessor::FrameProcessor()
+{
+    this->MedianSize = FRAMEPROCESSOR_MEDIAN_SIZE;
+    this->Denoise = DenoiseMedian;
+    this->TemporalWeight = TEMPORAL_WEIGHT;
+    this->TemporalMotion = TEMPORAL_MOTION;
+    this->DefectsChanged = false;
+    this->DarkFrames = 0;
+    this->DefectThreshold = DEFECT_THRESHOLD;
+}
+
+bool FrameProcessor::setMedianSize(int size)
+{
+    if (size != 1 && (size < 3 || size % 2 == 0 || size > 2*MEDIAN_MAX_RADIUS + 1))
+        return false;
+    QMutexLocker locker(&this->Mutex);
+    this->MedianSize = size;
+    return true;
+}
+
+bool FrameProcessor::setDenoise(DenoiseMode mode, int weight, int motion)
+{
+    if (weight < 1 || weight > TEMPORAL_WEIGHT_ONE || motion < 0 || motion > TEMPORAL_MAX_LEVEL)
+        return false;
+    QMutexLocker locker(&this->Mutex);
+    this->Denoise = mode;
+    this->TemporalWeight = weight;
+    this->TemporalMotion = motion;
+    return true;
+}
+
+void FrameProcessor::setDefects(const QVector<QPoint> &defects)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->DefectList = defects;
+    this->DefectsChanged = true;
+}
+
+QVector<QPoint> FrameProcessor::getDefects()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->DefectList;
+}
+
+void FrameProcessor::findDefects(int frames, int threshold)
+{
+    QMutexLocker locker(&this->Mutex);
+    this->DarkFrames = qMax(frames, 1);
+    this->DefectThreshold = threshold;
+}
+
+void FrameProcessor::reset()
+{
+    this->Temporal.reset();
+}
+
+FrameBuffer FrameProcessor::process(const FrameBuffer &frame, const FrameInfo &info, FramePool *pool, int *found)
+{
+    *found = -1;
+    if (frame.isNull() || !pool)
+        return frame;
+
+    this->Mutex.lock();
+    int median = this->MedianSize;
+    DenoiseMode denoise = this->Denoise;
+    int weight = this->TemporalWeight;
+    int motion = this->TemporalMotion;
+    this->Mutex.unlock();
+
+    FrameBuffer corrected = correctDefects(frame, info, pool, found);
+
+    /// Averages left over from before a switch back to the median would be stale by the next switch
+    if (denoise != DenoiseTemporal)
+        this->Temporal.reset();
+
+    if (denoise != DenoiseTemporal && median <= 1)
+        return corrected;
+
+    FrameBuffer filtered = pool->acquire();    //!< Filtered frame replaces the corrected one, no copy back
+    if (filtered.isNull())
+        return corrected;   //!< Pool exhausted, the frame goes out unfiltered
+    const unsigned short* src = reinterpret_cast<const unsigned short*>(corrected.data());
+    unsigned short* dst = reinterpret_cast<unsigned short*>(filtered.data());
+    if (denoise == DenoiseTemporal)
+    {
+        this->Temporal.setWeights(weight, motion);
+        this->Temporal.apply(src, dst, info.Width, info.Height, info.ExposureValue, info.Gain);
+    }
+    else
+        this->Median.apply(src, dst, info.Width, info.Height, median);
+    return filtered;
+}
+
+FrameBuffer FrameProcessor::correctDefects(const FrameBuffer &frame, const FrameInfo &info, FramePool *pool, int *found)
+{
+    const unsigned short* pixels = reinterpret_cast<const unsigned short*>(frame.data());
+    int origin_x = info.SensorX;
+    int origin_y = info.SensorY;
+
+    this->Mutex.lock();
+    int dark_frames = this->DarkFrames;
+    int threshold = this->DefectThreshold;
+    this->Mutex.unlock();
+
+    /// Dark frames are averaged as they came from the sensor, and only unbinned so defects map to single pixels
+    if (dark_frames > 0 && info.Binning <= 1)
+    {
+        this->Defects.addDarkFrame(pixels, info.Width, info.Height, origin_x, origin_y);
+        if (this->Defects.darkFrames() >= dark_frames)
+        {
+            QVector<QPoint> defects = this->Defects.findDefects(threshold);
+            this->Defects.clearDarkFrames();
+            this->Mutex.lock();
+            this->DarkFrames = 0;
+            this->DefectList = defects;
+            this->DefectsChanged = true;
+            this->Mutex.unlock();
+            std::cout << defects.count() << " defective pixels found in " << dark_frames << " dark frames" << std::endl;
+            *found = defects.count();
+        }
+    }
+
+    this->Mutex.lock();
+    if (this->DefectsChanged)
+    {
+        this->Defects.setDefects(this->DefectList);
+        this->DefectsChanged = false;
+    }
+    this->Mutex.unlock();
+
+    if (this->Defects.defects().isEmpty())
+        return frame;
+
+    /// The raw frame may still be waiting for a recorder, so the corrected one goes to a buffer of its own
+    FrameBuffer corrected = pool->acquire();
+    if (corrected.isNull())
+        return frame;   //!< Pool exhausted, the frame goes out uncorrected
+    memcpy(corrected.data(), pixels, info.ImageSize);
+
+    this->Defects.place(info.Width, info.Height, origin_x, origin_y, (info.Binning > 0) ? info.Binning : 1);
+    this->Defects.correct(reinterpret_cast<unsigned short*>(corrected.data()));
+    return corrected;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The FrameProcessor class is the processing every Mono16 (NIR) frame
+ * goes through before it is handed out, whatever source it came from:
+ * defective pixels are corrected (see DefectMap), then the frame is
+ * denoised with a spatial median (see MedianFilter) or a running average
+ * (see TemporalFilter).
+ *
+ * Every FrameSource owns one and runs it from its own thread, so a
+ * replayed recording goes through the same steps as the live camera and
+ * filter settings can be compared on the same frames. Each step writes a
+ * fresh pool buffer, the frame it was given is never modified.
+ */
+
+#ifndef FRAMEPROCESSOR_H
+#define FRAMEPROCESSOR_H
+
+#define FRAMEPROCESSOR_MEDIAN_SIZE 7    //!< Median window NIR frames are filtered with unless setMedianSize() says otherwise
+
+#include <QMutex>
+#include <QVector>
+#include <QPoint>
+#include <framepool.h>
+#include <frameinfo.h>
+#include <medianfilter.h>
+#include <temporalfilter.h>
+#include <defectmap.h>
+
+/**
+ * @brief How Mono16 (NIR) frames are denoised, see FrameProcessor::setDenoise()
+ */
+enum DenoiseMode
+{
+    DenoiseMedian,      //!< Spatial median of each frame, see FrameProcessor::setMedianSize()
+    DenoiseTemporal     //!< Motion-adaptive average of each pixel over frames, see TemporalFilter
+};
+
+class FrameProcessor
+{
+public:
+
+    FrameProcessor();
+
+    /**
+     * @brief Sets the median window frames are filtered with, from the next frame on. Thread-safe
+     *
+     * 3 and 5 use the vectorised filters of MedianFilter, larger sizes MedianFilter::constantTime().
+     *
+     * @param size Odd window width, or 1 to turn the filter off
+     * @return true if the size was taken
+     */
+    bool setMedianSize(int size);
+
+    /**
+     * @brief Picks how frames are denoised, from the next frame on. Thread-safe
+     *
+     * @param weight Base weight of a new frame for DenoiseTemporal, see TemporalFilter::setWeights()
+     * @param motion Motion threshold for DenoiseTemporal, in levels
+     * @return false if weight or motion is out of range, nothing is changed then
+     */
+    bool setDenoise(DenoiseMode mode, int weight = TEMPORAL_WEIGHT, int motion = TEMPORAL_MOTION);
+
+    /**
+     * @brief Sets the defective pixels corrected, from the next frame on. Thread-safe
+     * @param defects Defective pixels in sensor coordinates, empty for none
+     */
+    void setDefects(const QVector<QPoint> &defects);
+
+    /**
+     * @brief Gets the defective pixels being corrected, in sensor coordinates. Thread-safe
+     */
+    QVector<QPoint> getDefects();
+
+    /**
+     * @brief Averages the next frames to look for defective pixels. Thread-safe
+     *
+     * Binned frames are skipped. Once enough frames are in, the defects found replace the
+     * ones being corrected and process() reports how many there are.
+     *
+     * @param frames Dark frames to average
+     * @param threshold Difference in levels from the neighbours that makes a pixel defective
+     */
+    void findDefects(int frames, int threshold);
+
+    /**
+     * @brief Starts the temporal averages over with the next frame. Source thread only
+     *
+     * For changes the frames don't show, such as a camera's region moving or a recording
+     * starting over.
+     */
+    void reset();
+
+    /**
+     * @brief Corrects and denoises a Mono16 frame. Source thread only
+     *
+     * @param frame Frame as the sensor delivered it, left untouched
+     * @param info Metadata of the frame, for its size, place on the sensor, binning, exposure and gain
+     * @param pool Pool the processed frames are taken from. If it is exhausted a step is skipped
+     * @param found Set to the number of defects found when findDefects() completes with this frame, -1 otherwise
+     * @return The processed frame, frame itself if no step applied
+     */
+    FrameBuffer process(const FrameBuffer &frame, const FrameInfo &info, FramePool* pool, int* found);
+
+private:
+
+    /**
+     * @brief Adds frame to the dark frames while findDefects() runs, then corrects its defective pixels
+     * @return A corrected copy of frame, or frame itself if there is nothing to correct
+     */
+    FrameBuffer correctDefects(const FrameBuffer &frame, const FrameInfo &info, FramePool* pool, int* found);
+
+    QMutex          Mutex;                  //!< Guards the settings below, set from other threads
+    int             MedianSize;             //!< Median window, 1 for none
+    DenoiseMode     Denoise;                //!< How frames are denoised
+    int             TemporalWeight;         //!< Base weight for DenoiseTemporal
+    int             TemporalMotion;         //!< Motion threshold for DenoiseTemporal
+    QVector<QPoint> DefectList;             //!< Defects asked for by setDefects() or found
+    bool            DefectsChanged;         //!< DefectList is newer than Defects
+    int             DarkFrames;             //!< Dark frames findDefects() wants, 0 when not looking
+    int             DefectThreshold;        //!< Threshold findDefects() was given
+
+    MedianFilter    Median;                 //!< Keeps its histograms between frames. Source thread only
+    TemporalFilter  Temporal;               //!< Keeps each pixel's average between frames. Source thread only
+    DefectMap       Defects;                //!< Defects placed on the frames, and the dark frames. Source thread only
+};
+
+#endif // FRAMEPROCESSOR_H
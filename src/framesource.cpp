@@ -0,0 +1,38 @@
+#include "framesource.h"
+
+bool FrameSource::setMedianSize(int size)
+{
+    return this->Processor.setMedianSize(size);
+}
+
+bool FrameSource::setDenoise(DenoiseMode mode, int weight, int motion)
+{
+    return this->Processor.setDenoise(mode, weight, motion);
+}
+
+void FrameSource::setDefects(const QVector<QPoint> &defects)
+{
+    this->Processor.setDefects(defects);
+}
+
+QVector<QPoint> FrameSource::getDefects()
+{
+    return this->Processor.getDefects();
+}
+
+void FrameSource::findDefects(int frames, int threshold)
+{
+    this->Processor.findDefects(frames, threshold);
+}
+
+FrameBuffer FrameSource::processFrame(const FrameBuffer &frame, const FrameInfo &info, FramePool *pool)
+{
+    if (info.Format != FormatMono16)
+        return frame;
+
+    int found = -1;
+    FrameBuffer processed = this->Processor.process(frame, info, pool, &found);
+    if (found >= 0)
+        emit defectsFound(this, found);
+    return processed;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * FrameSource is the interface the rest of the program uses to get frames,
+ * whatever produces them. Camera implements it on top of PvAPI and
+ * SyntheticCamera generates frames, so the render, false-colour, overlay
+ * and encode pipeline can run without an AVT camera.
+ *
+ * A source lives on its own thread. Every call to capture() delivers one
+ * frame through rawFrameReady(), then through frameReady() once Mono16
+ * (NIR) frames have been through the source's FrameProcessor, so every
+ * source is corrected and denoised the same way.
+ */
+
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#define LINK_BYTES_PER_SECOND 115000000 //!< Usable payload of the shared GigE link, split between all cameras
+
+#include <QObject>
+#include <QRect>
+#include <framepool.h>
+#include <frameinfo.h>
+#include <frameprocessor.h>
+
+/**
+ * @brief Running frame counters for one camera
+ *
+ * Dropped and Incomplete point at losses on the link, DriverDropped and Skipped at a
+ * host that is too slow to keep buffers queued or to process every frame.
+ */
+struct CaptureStatistics
+{
+    unsigned long   Delivered;      //!< Frames handed to consumers through frameReady()
+    unsigned long   Dropped;        //!< Frames missing from the frame counter sequence, or returned with ePvErrDataLost
+    unsigned long   Incomplete;     //!< Frames returned with ePvErrDataMissing
+    unsigned long   Skipped;        //!< Complete frames requeued unprocessed because a newer one was already waiting
+    unsigned long   DriverDropped;  //!< Driver's StatFramesDropped: frames that arrived with no buffer queued
+    unsigned long   PacketsMissed;  //!< Driver's StatPacketsMissed
+    unsigned long   PacketsResent;  //!< Driver's StatPacketsResent
+    unsigned long   Reconnects;     //!< Times the camera was unplugged and streaming resumed
+    unsigned long   OutageMs;       //!< Last reconnect: time from the unplug to the first frame after it, in milliseconds
+    unsigned long   ResumeMs;       //!< Last reconnect: time from the camera coming back to its first frame, in milliseconds
+};
+
+/**
+ * @brief How a camera's frames are started
+ */
+enum TriggerMode
+{
+    TriggerFreerun,     //!< Camera starts frames on its own
+    TriggerMaster,      //!< Free-runs and signals each exposure on SyncOut1, for other cameras to follow
+    TriggerSlave        //!< Starts a frame on each rising edge of SyncIn1
+};
+
+class FrameSource : public QObject
+{
+    Q_OBJECT
+public:
+
+    explicit FrameSource(QObject *parent = 0) : QObject(parent) {}
+    virtual ~FrameSource() {}
+
+    /**
+     * @brief Gets the source ready for capturing and streaming images
+     */
+    virtual void captureSetup() = 0;
+
+    /**
+     * @brief Stops streaming. Wakes the source's thread if it is waiting in capture()
+     */
+    virtual void captureEnd() = 0;
+
+    /**
+     * @brief Switches the source to 16-bit monochrome (NIR) frames. Must be called before captureSetup()
+     */
+    virtual void SetMono16Bit() = 0;
+
+    /**
+     * @brief Checks if the source delivers Near Infrared (Mono16) frames
+     */
+    virtual bool isNearInfrared() = 0;
+
+    /**
+     * @brief Sets the exposure time
+     *
+     * Thread-safe. A camera only queues the value and writes it from its own thread
+     * between two frames, see attributeApplied().
+     *
+     * @param exposure Exposure time in microseconds
+     */
+    virtual void setExposure(unsigned long exposure) = 0;
+
+    /**
+     * @brief Gets the exposure last set, which may not have reached the camera yet
+     * @return Exposure time in microseconds
+     */
+    virtual unsigned long getExposure() = 0;
+
+    /**
+     * @brief Writes a camera attribute, such as RegionX
+     *
+     * Thread-safe, queued like setExposure().
+     *
+     * @return true if the source took the value, false otherwise
+     */
+    virtual bool setAttribute(const char* name, unsigned long value) = 0;
+
+    /**
+     * @brief Gets a snapshot of the source's frame counters. Thread-safe
+     */
+    virtual CaptureStatistics getStatistics() = 0;
+
+    /**
+     * @brief Gets the size of one frame in bytes, 0 before captureSetup()
+     */
+    virtual unsigned long getFrameSize() = 0;
+
+    /**
+     * @brief Sets the source's share of the link bandwidth, in bytes per second
+     */
+    virtual void setStreamBytesPerSecond(unsigned long bytesPerSecond) = 0;
+
+    /**
+     * @brief Sets how frames are started. Must be called before captureSetup()
+     */
+    virtual void setTriggerMode(TriggerMode mode) = 0;
+
+    /**
+     * @brief Asks for factor x factor binning, to trade resolution for signal and frame rate
+     *
+     * Thread-safe. The change is made on the source's own thread between two frames, so
+     * the next few frames may still arrive at the old size (see FrameInfo::Width).
+     *
+     * @param factor 1 for full resolution, 2 for 2x2 binning, 4 for 4x4...
+     * @return true if the source supports the factor, false otherwise
+     */
+    virtual bool setBinning(unsigned int factor) = 0;
+
+    /**
+     * @brief Gets the binning factor frames are currently delivered at
+     */
+    virtual unsigned int getBinning() = 0;
+
+    /**
+     * @brief Asks for only part of the view to be streamed, to send fewer bytes per frame
+     *
+     * Thread-safe, made between two frames like setBinning(). Frames then tell where they
+     * sit in the full view through FrameInfo::OffsetX and OffsetY.
+     *
+     * @param crop Part of the full, unbinned view to keep. Edges must be multiples of 8
+     * @return true if the source took the crop, false otherwise
+     */
+    virtual bool setCrop(const QRect &crop) = 0;
+
+    /**
+     * @brief Sets the median window Mono16 frames are filtered with, from the next frame on
+     *
+     * Thread-safe, see FrameProcessor::setMedianSize().
+     *
+     * @param size Odd window width, or 1 to turn the filter off
+     * @return true if the size was taken
+     */
+    bool setMedianSize(int size);
+
+    /**
+     * @brief Picks how Mono16 frames are denoised, from the next frame on
+     *
+     * DenoiseTemporal averages each pixel over frames instead of filtering each frame on its
+     * own, which keeps fine detail and costs much less than the median. The averages start
+     * over whenever the exposure, gain, binning or crop changes.
+     *
+     * @param weight Base weight of a new frame for DenoiseTemporal, see TemporalFilter::setWeights()
+     * @param motion Motion threshold for DenoiseTemporal, in levels
+     * @return false if weight or motion is out of range, nothing is changed then
+     */
+    bool setDenoise(DenoiseMode mode, int weight = TEMPORAL_WEIGHT, int motion = TEMPORAL_MOTION);
+
+    /**
+     * @brief Sets the hot and dead pixels corrected in Mono16 frames, from the next frame on
+     *
+     * Only these pixels are corrected, each with the median of its neighbours, before any
+     * denoising. See DefectMap.
+     *
+     * @param defects Defective pixels in sensor coordinates, empty for none
+     */
+    void setDefects(const QVector<QPoint> &defects);
+
+    /**
+     * @brief Gets the defective pixels being corrected, in sensor coordinates
+     */
+    QVector<QPoint> getDefects();
+
+    /**
+     * @brief Looks for defective pixels in the next frames, which must be dark (lens covered)
+     *
+     * Frames are averaged before any correction or denoising. Binned frames are skipped, so
+     * binning should be turned off until defectsFound() is emitted. The defects found then
+     * replace the ones being corrected.
+     *
+     * @param frames Dark frames to average
+     * @param threshold Difference in levels from the neighbours that makes a pixel defective
+     */
+    void findDefects(int frames = DEFECT_CALIBRATION_FRAMES, int threshold = DEFECT_THRESHOLD);
+
+public slots:
+
+    /**
+     * @brief Captures a single frame and hands it out through frameReady()
+     */
+    virtual void capture() = 0;
+
+signals:
+
+    /**
+     * @brief Signal emitted after capture() has finished capturing a frame.
+     * @param source Pointer to the source that captured the frame
+     * @param frame Shared handle to the frame's pixel data
+     * @param info Metadata of the frame (capture time, frame counter, exposure...)
+     */
+    void frameReady(FrameSource* source, FrameBuffer frame, FrameInfo info);
+
+    /**
+     * @brief Signal emitted with each frame as the sensor delivered it, before frameReady()
+     *
+     * Emitted from the source's thread before defect correction or denoising, which hand
+     * frameReady() a different buffer. The buffer carried here is never written to again.
+     *
+     * @param source Pointer to the source that captured the frame
+     * @param frame Shared handle to the frame's unprocessed pixel data
+     * @param info Metadata of the frame
+     */
+    void rawFrameReady(FrameSource* source, FrameBuffer frame, FrameInfo info);
+
+    /**
+     * @brief Signal emitted with the first frame captured after a queued attribute write took effect
+     *
+     * Emitted from the source's thread, just before frameReady() for that frame.
+     *
+     * @param source Pointer to the source the attribute was written to
+     * @param name Attribute name, e.g. "ExposureValue"
+     * @param value Value written
+     * @param requested Host time (us) the value was asked for, see hostTimeUs()
+     * @param info Metadata of the first frame carrying the new value
+     */
+    void attributeApplied(FrameSource* source, QString name, unsigned long value, qint64 requested, FrameInfo info);
+
+    /**
+     * @brief Emitted from the source's thread when findDefects() is done
+     * @param source The source
+     * @param count Defective pixels found, now being corrected
+     */
+    void defectsFound(FrameSource* source, int count);
+
+protected:
+
+    /**
+     * @brief Runs a frame through the source's FrameProcessor. Source thread only
+     *
+     * Frames other than Mono16 are returned as they are. Emits defectsFound() when the frame
+     * completes a findDefects() calibration.
+     *
+     * @param frame Frame as the sensor delivered it, already sent through rawFrameReady()
+     * @param info Metadata of the frame
+     * @param pool Pool the processed frames are taken from
+     * @return The frame to send through frameReady()
+     */
+    FrameBuffer processFrame(const FrameBuffer &frame, const FrameInfo &info, FramePool* pool);
+
+    FrameProcessor  Processor;          //!< Defect correction and denoising of Mono16 frames
+};
+
+#endif // FRAMESOURCE_H
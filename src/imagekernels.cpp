@@ -0,0 +1,527 @@
+#include "imagekernels.h"
+#include "bayerdemosaic.h"
+#include "medianfilter.h"
+#include "yuvconverter.h"
+#include "temporalfilter.h"
+#include "FFMPEGClass.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstring>
+#include <iostream>
+
+#ifndef ULONG_PADDING
+#define ULONG_PADDING(x) (((x+3) & ~3) - x)
+#endif
+
+BrightnessContrast::BrightnessContrast()
+{
+    this->Rgb = NULL;
+    this->View = NULL;
+    this->Width = 0;
+    this->ViewWidth = 0;
+    this->OffsetX = 0;
+    this->OffsetY = 0;
+    this->Brightness = 0;
+    this->Contrast = 100;
+}
+
+void BrightnessContrast::run(const unsigned char *rgb, int width, int height, unsigned char *view, int viewWidth,
+                             int offsetX, int offsetY, int brightness, int contrast, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Rgb = rgb;
+    this->View = view;
+    this->Width = width;
+    this->ViewWidth = viewWidth;
+    this->OffsetX = offsetX;
+    this->OffsetY = offsetY;
+    this->Brightness = brightness;
+    this->Contrast = contrast;
+    pool->parallelFor(KernelBrightness, *this, height, WorkerPool::stripeRows(width*3));
+}
+
+void BrightnessContrast::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    int stride = this->Width*3 + ULONG_PADDING(this->Width*3);     //!< Interpolated rows are padded to 4 bytes
+    for (int i = begin; i < end; i++)
+    {
+        const unsigned char* bufferPtr = this->Rgb + i*stride;
+        unsigned char* rowPtr = this->View + ((i + this->OffsetY)*this->ViewWidth + this->ViewWidth - 1 - this->OffsetX)*3;
+        for (int j = 0; j < this->Width; j++)
+        {
+            unsigned char r = bufferPtr[0];     //!< R-Pixel
+            unsigned char g = bufferPtr[1];     //!< G-Pixel
+            unsigned char b = bufferPtr[2];     //!< B-Pixel
+            bufferPtr += 3;
+
+            int r_brightcontr = (r*(this->Contrast*0.01) + this->Brightness);
+            int g_brightcontr = (g*(this->Contrast*0.01) + this->Brightness);
+            int b_brightcontr = (b*(this->Contrast*0.01) + this->Brightness);
+
+            if (r_brightcontr > 255) {r_brightcontr = 255;}
+            if (r_brightcontr < 0) {r_brightcontr = 0;}
+            if (g_brightcontr > 255) {g_brightcontr = 255;}
+            if (g_brightcontr < 0) {g_brightcontr = 0;}
+            if (b_brightcontr > 255) {b_brightcontr = 255;}
+            if (b_brightcontr < 0) {b_brightcontr = 0;}
+
+            rowPtr[0] = r_brightcontr;
+            rowPtr[1] = g_brightcontr;
+            rowPtr[2] = b_brightcontr;
+            rowPtr -= 3;
+        }
+    }
+}
+
+FalseColour::FalseColour()
+{
+    this->Raw = NULL;
+    this->Rgb = NULL;
+    this->Width = 0;
+    this->Threshold = 0;
+    memset(this->Thresholds, 0, sizeof(this->Thresholds));
+    this->Counting = false;
+}
+
+int FalseColour::histogram(const unsigned short *raw, int width, int height, int threshold, int *histogram, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    if (this->Counts.count() < pool->workers())
+        this->Counts.resize(pool->workers());
+    for (int i = 0; i < this->Counts.count(); i++)
+        this->Counts[i].fill(0, KERNEL_LEVELS + 1);     //!< Last count is the pixels above threshold
+
+    this->Raw = raw;
+    this->Width = width;
+    this->Threshold = threshold;
+    this->Counting = true;
+    pool->parallelFor(KernelFalseColour, *this, height, WorkerPool::stripeRows(width*2));
+
+    memset(histogram, 0, KERNEL_LEVELS*sizeof(int));
+    int pixel_count = 0;
+    for (int i = 0; i < this->Counts.count(); i++)
+    {
+        const int* counts = this->Counts[i].constData();
+        for (int k = 0; k < KERNEL_LEVELS; k++)
+            histogram[k] += counts[k];
+        pixel_count += counts[KERNEL_LEVELS];
+    }
+    return pixel_count;
+}
+
+void FalseColour::colour(const unsigned short *raw, int width, int height, const int *thresholds, unsigned char *rgb, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Raw = raw;
+    this->Rgb = rgb;
+    this->Width = width;
+    for (int i = 0; i < 6; i++)
+        this->Thresholds[i] = thresholds[i];
+    this->Counting = false;
+    pool->parallelFor(KernelFalseColour, *this, height, WorkerPool::stripeRows(width*2));
+}
+
+void FalseColour::rows(int begin, int end, int worker)
+{
+    const unsigned short* rawPtr = this->Raw + begin*this->Width;
+    int count = (end - begin)*this->Width;
+
+    if (this->Counting)
+    {
+        int* counts = this->Counts[worker].data();
+        for (int i = 0; i < count; i++)
+        {
+            if (rawPtr[i] > this->Threshold)
+            {
+                counts[rawPtr[i] & (KERNEL_LEVELS - 1)]++;
+                counts[KERNEL_LEVELS]++;
+            }
+        }
+        return;
+    }
+
+    /// Displays a particular RGB value that corresponds to the intensity of the pixels
+    unsigned char* bufferPtr = this->Rgb + begin*this->Width*3;
+    for (int i = 0; i < count; i++)
+    {
+        unsigned short counts = rawPtr[i];
+        unsigned char r;
+        unsigned char g;
+        unsigned char b;
+        if (counts <= this->Thresholds[0])
+        {
+            r = 0;
+            g = 0;
+            b = 0;
+        }
+        else if (counts <= this->Thresholds[1])
+        {
+            r = 0;
+            g = 0;
+            b = 255;
+        }
+        else if (counts <= this->Thresholds[2])
+        {
+            r = 0;
+            g = 255;
+            b = 255;
+        }
+        else if (counts <= this->Thresholds[3])
+        {
+            r = 0;
+            g = 255;
+            b = 0;
+        }
+        else if (counts <= this->Thresholds[4])
+        {
+            r = 255;
+            g = 255;
+            b = 0;
+        }
+        else if (counts <= this->Thresholds[5])
+        {
+            r = 255;
+            g = 0;
+            b = 0;
+        }
+        else
+        {
+            r = 255;
+            g = 255;
+            b = 255;
+        }
+
+        bufferPtr[0] = r;
+        bufferPtr[1] = g;
+        bufferPtr[2] = b;
+        bufferPtr = bufferPtr + 3;
+    }
+}
+
+Monochrome::Monochrome()
+{
+    this->Rgb = NULL;
+    this->Grey = NULL;
+    this->Width = 0;
+}
+
+void Monochrome::run(const unsigned char *rgb, unsigned char *grey, int width, int height, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Rgb = rgb;
+    this->Grey = grey;
+    this->Width = width;
+    pool->parallelFor(KernelMonochrome, *this, height, WorkerPool::stripeRows(width*3));
+}
+
+void Monochrome::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    const unsigned char* src = this->Rgb + begin*this->Width*3;
+    unsigned char* data = this->Grey + begin*this->Width*3;
+    int pixelCount = (end - begin)*this->Width;
+
+    // Convert each pixel to grayscale
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        int val = qGray(src[0], src[1], src[2]); //!< Qt's integrated Grayscale conversion
+
+        data[0] = val; //!< Pointer Arithmetic. Image is 3-byte aligned, each representing R, G, or B.
+        data[1] = val;
+        data[2] = val;
+        data += 3;
+        src += 3;
+    }
+}
+
+OverlayAlpha::OverlayAlpha()
+{
+    this->Rgb = NULL;
+    this->Argb = NULL;
+    this->Width = 0;
+    this->Alpha = 255;
+}
+
+void OverlayAlpha::run(const unsigned char *rgb, QRgb *argb, int width, int height, int alpha, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Rgb = rgb;
+    this->Argb = argb;
+    this->Width = width;
+    this->Alpha = alpha;
+    pool->parallelFor(KernelOverlay, *this, height, WorkerPool::stripeRows(width*3));
+}
+
+void OverlayAlpha::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    const unsigned char* overlay_src = this->Rgb + begin*this->Width*3;
+    QRgb* overlay_data = this->Argb + begin*this->Width;
+    QRgb transparent_pixel = qRgba(0,0,0,0);
+    int pixelCount = (end - begin)*this->Width;
+
+    for (int i = 0; i < pixelCount; i++)
+    {
+        if (overlay_src[0] == 0 && overlay_src[1] == 0 && overlay_src[2] == 0)
+            *overlay_data = transparent_pixel;
+        else
+            *overlay_data = qRgba(overlay_src[0], overlay_src[1], overlay_src[2], this->Alpha);
+        overlay_src = overlay_src + 3;
+        overlay_data++;
+    }
+}
+
+OverlayBlend::OverlayBlend()
+{
+    this->Rgb = NULL;
+    this->Frame = NULL;
+    this->Width = 0;
+    this->Alpha = 255;
+}
+
+void OverlayBlend::run(const unsigned char *rgb, unsigned char *frame, int width, int height, int alpha, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    this->Rgb = rgb;
+    this->Frame = frame;
+    this->Width = width;
+    this->Alpha = qBound(0, alpha, 255);
+    pool->parallelFor(KernelBlend, *this, height, WorkerPool::stripeRows(width*6));
+}
+
+void OverlayBlend::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    const unsigned char* overlay_src = this->Rgb + begin*this->Width*3;
+    unsigned char* frame_data = this->Frame + begin*this->Width*3;
+    int byteCount = (end - begin)*this->Width*3;
+    int alpha = this->Alpha;
+    int beta = 255 - alpha;
+
+    for (int i = 0; i < byteCount; i++)
+        frame_data[i] = (frame_data[i]*beta + overlay_src[i]*alpha + 127) / 255;    //!< Rounded, fits 16 bits
+}
+
+/**
+ * @brief Runs one kernel on the benchmark frames, with the pool given
+ */
+static void benchmarkKernel(ParallelKernel kernel, int variant, WorkerPool* pool, const QVector<unsigned char> &bayer,
+                            const QVector<unsigned short> &nir, QVector<unsigned char> &out, YuvConverter &yuv)
+{
+    const int width = 640;
+    const int height = 480;
+
+    switch (kernel)
+    {
+    case KernelMedian:
+    {
+        static MedianFilter filter;
+        filter.apply(nir.constData(), reinterpret_cast<unsigned short*>(out.data()), width, height, variant, pool);
+        break;
+    }
+    case KernelInterpolation:
+    {
+        static BayerDemosaic demosaic;
+        demosaic.setMethod((variant) ? DemosaicGradient : DemosaicBilinear);
+        demosaic.run(bayer.constData(), width, height, BayerRGGB, out.data(),
+                     width*3 + ULONG_PADDING(width*3), pool);
+        break;
+    }
+    case KernelBrightness:
+    {
+        static BrightnessContrast brightness;
+        brightness.run(bayer.constData(), width, height/3, out.data(), width, 0, 0, 10, 120, pool);
+        break;
+    }
+    case KernelFalseColour:
+    {
+        static FalseColour colour;
+        int histogram[KERNEL_LEVELS];
+        colour.histogram(nir.constData(), width, height, 18, histogram, pool);
+        int thresholds[6] = {18, 400, 800, 1600, 2400, 3200};
+        colour.colour(nir.constData(), width, height, thresholds, out.data(), pool);
+        break;
+    }
+    case KernelOverlay:
+    {
+        static OverlayAlpha overlay;
+        overlay.run(bayer.constData(), reinterpret_cast<QRgb*>(out.data()), width, height/3, 128, pool);
+        break;
+    }
+    case KernelMonochrome:
+    {
+        static Monochrome monochrome;
+        monochrome.run(bayer.constData(), out.data(), width, height/3, pool);
+        break;
+    }
+    case KernelYuv:
+    {
+        uint8_t* planes[3] = {out.data(), out.data() + width*height, out.data() + width*height*5/4};
+        int strides[3] = {width, width/2, width/2};
+        yuv.convert(bayer.constData(), width*3, planes, strides, width, height/3, SWS_BICUBIC, pool);
+        break;
+    }
+    case KernelBlend:
+    {
+        /// Blending accumulates into the frame, so it starts from the same background every time
+        static OverlayBlend blend;
+        memcpy(out.data(), nir.constData(), width*(height/3)*3);
+        blend.run(bayer.constData(), out.data(), width, height/3, 77, pool);
+        break;
+    }
+    case KernelTemporal:
+    {
+        /// The first frame only primes the averages, the second one is averaged in
+        static TemporalFilter filter;
+        filter.reset();
+        filter.apply(nir.constData(), reinterpret_cast<unsigned short*>(out.data()), width, height, 0, 0, pool);
+        filter.apply(nir.constData(), reinterpret_cast<unsigned short*>(out.data()), width, height, 0, 0, pool);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Median filters a frame over and over on a shared pool, standing in for a camera's thread
+ */
+class BenchmarkCaller : public QThread
+{
+public:
+    BenchmarkCaller(WorkerPool* pool, const QVector<unsigned short> &frame, int width, int height, int frames)
+    {
+        this->Pool = pool;
+        this->Frame = frame;
+        this->Out.resize(frame.count());
+        this->Width = width;
+        this->Height = height;
+        this->Frames = frames;
+    }
+
+    QVector<unsigned short> Out;    //!< Last filtered frame
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < this->Frames; i++)
+            this->Filter.apply(this->Frame.constData(), this->Out.data(), this->Width, this->Height, 7, this->Pool);
+    }
+
+private:
+    WorkerPool*     Pool;
+    MedianFilter    Filter;
+    QVector<unsigned short> Frame;
+    int             Width;
+    int             Height;
+    int             Frames;
+};
+
+bool ImageKernels::benchmark()
+{
+    const int width = 640;
+    const int height = 480;
+
+    /// One Bayer frame, also read as an RGB24 frame a third of the height, and one 12-bit NIR frame
+    QVector<unsigned char> bayer(width*height);
+    QVector<unsigned short> nir(width*height);
+    unsigned int seed = 12345;
+    for (int i = 0; i < width*height; i++)
+    {
+        seed = seed*1103515245 + 12345;
+        bayer[i] = (seed >> 16) & 0xFF;
+        nir[i] = (seed >> 8) & 0xFFF;
+    }
+
+    QVector<int> counts;
+    for (int workers = 1; workers < QThread::idealThreadCount(); workers *= 2)
+        counts.append(workers);
+    counts.append(QThread::idealThreadCount());
+
+    struct Run { ParallelKernel Kernel; int Variant; const char* Name; };
+    const Run runs[] = {
+        {KernelMedian, 3, "median 3x3"},
+        {KernelMedian, 5, "median 5x5"},
+        {KernelMedian, 7, "median 7x7"},
+        {KernelInterpolation, 0, "interpolation"},
+        {KernelInterpolation, 1, "interpolation (gradient)"},
+        {KernelBrightness, 0, "brightness"},
+        {KernelFalseColour, 0, "falsecolour"},
+        {KernelOverlay, 0, "overlay"},
+        {KernelMonochrome, 0, "monochrome"},
+        {KernelYuv, 0, "yuv"},
+        {KernelTemporal, 0, "temporal"},
+        {KernelBlend, 0, "blend"}
+    };
+
+    bool same = true;
+    std::cout << "Pixel loops on 640x480 frames, " << QThread::idealThreadCount() << " cores" << std::endl;
+    for (unsigned int r = 0; r < sizeof(runs)/sizeof(runs[0]); r++)
+    {
+        QVector<unsigned char> expected;
+        double serial_ms = 0;
+        std::cout << runs[r].Name << ":";
+        for (int c = 0; c < counts.count(); c++)
+        {
+            WorkerPool pool(counts[c]);
+            YuvConverter yuv;
+            QVector<unsigned char> out(width*height*4, 0);
+
+            int repeats = 0;
+            QElapsedTimer clock;
+            clock.start();
+            do
+            {
+                benchmarkKernel(runs[r].Kernel, runs[r].Variant, &pool, bayer, nir, out, yuv);
+                repeats++;
+            }while (clock.elapsed() < 300 || repeats < 3);
+            double ms = clock.nsecsElapsed() / 1000000.0 / repeats;
+
+            /// Every loop, the YUV conversion's bands included, has to give the serial result exactly
+            if (c == 0)
+            {
+                serial_ms = ms;
+                expected = out;
+            }
+            else if (out != expected)
+                same = false;
+            std::cout << "  " << counts[c] << ((counts[c] == 1) ? " thread " : " threads ") << ms << " ms ("
+                      << serial_ms / ms << "x)" << ((out == expected) ? "" : " differs") ;
+        }
+        std::cout << std::endl;
+    }
+
+    /// Two threads spreading frames at once, as the WL and NIR cameras' threads do. At least two workers, so
+    /// one thread finds the pool busy even on a single core
+    QVector<unsigned short> expected(width*height);
+    MedianFilter serial;
+    WorkerPool single(1);
+    serial.apply(nir.constData(), expected.data(), width, height, 7, &single);
+
+    const int frames = 20;
+    WorkerPool pool(qMax(2, QThread::idealThreadCount()));
+    BenchmarkCaller first(&pool, nir, width, height, frames);
+    BenchmarkCaller second(&pool, nir, width, height, frames);
+    QElapsedTimer clock;
+    clock.start();
+    first.start();
+    second.start();
+    first.wait();
+    second.wait();
+    double ms = clock.nsecsElapsed() / 1000000.0 / (2*frames);
+
+    bool shared = first.Out == expected && second.Out == expected;
+    same = same && shared;
+    std::cout << "2 threads sharing " << pool.workers() << " workers, median 7x7: " << ms << " ms per frame, "
+              << pool.queued(KernelMedian) << " of " << 2*frames << " frames waited for the pool, "
+              << pool.ranAlone(KernelMedian) << " ran alone" << ((shared) ? "" : ", differs") << std::endl;
+    return same;
+}
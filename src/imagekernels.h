@@ -0,0 +1,196 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The pixel loops the viewer runs on every frame it shows, written as
+ * RowKernels so a WorkerPool can spread them over every core:
+ * brightness/contrast of WL frames, false colouring of NIR frames, and
+ * the monochrome underlay and transparent overlays of the composite
+ * view, and the overlays blended into recorded composite frames. Each
+ * kernel gives the same pixels whether it runs on one thread or many.
+ *
+ * ImageKernels::benchmark() times every kernel, the Bayer demosaic, the
+ * median and temporal filters and the RGB to YUV conversion of
+ * recordings with growing thread counts.
+ */
+
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#define KERNEL_LEVELS 4096      //!< Levels of the NIR histogram, 12-bit data
+
+#include <QVector>
+#include <QRgb>
+
+#include <workerpool.h>
+
+/**
+ * @brief Brightness and contrast of an interpolated WL frame, mirrored into the view
+ *
+ * Each row is written right to left, which flips the WL image (needed due to dichroic).
+ */
+class BrightnessContrast : public RowKernel
+{
+public:
+    BrightnessContrast();
+
+    /**
+     * @param rgb Demosaiced frame, see BayerDemosaic
+     * @param width Width of the frame
+     * @param height Height of the frame
+     * @param view Where the frame goes, RGB24 rows of viewWidth pixels
+     * @param viewWidth Width of the view
+     * @param offsetX Left edge of a cropped frame in the (unmirrored) view
+     * @param offsetY Top edge of a cropped frame in the view
+     * @param brightness Added to each channel
+     * @param contrast Percentage each channel is scaled by
+     */
+    void run(const unsigned char* rgb, int width, int height, unsigned char* view, int viewWidth,
+             int offsetX, int offsetY, int brightness, int contrast, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+private:
+    const unsigned char* Rgb;
+    unsigned char*  View;
+    int             Width;
+    int             ViewWidth;
+    int             OffsetX;
+    int             OffsetY;
+    int             Brightness;
+    int             Contrast;
+};
+
+/**
+ * @brief False colouring of a Mono16 NIR frame
+ *
+ * histogram() counts the levels above the calibrated threshold, each worker in a
+ * histogram of its own, then colour() paints the levels between each pair of
+ * thresholds in one colour.
+ */
+class FalseColour : public RowKernel
+{
+public:
+    FalseColour();
+
+    /**
+     * @param histogram KERNEL_LEVELS counts, filled in
+     * @return Pixels above threshold
+     */
+    int histogram(const unsigned short* raw, int width, int height, int threshold, int* histogram, WorkerPool* pool);
+
+    /**
+     * @param thresholds Upper levels of the 6 bands, black to red
+     * @param rgb Where the RGB24 pixels go
+     */
+    void colour(const unsigned short* raw, int width, int height, const int* thresholds, unsigned char* rgb, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+private:
+    QVector<QVector<int> > Counts;  //!< Histogram of each worker
+    const unsigned short* Raw;
+    unsigned char*  Rgb;
+    int             Width;
+    int             Threshold;
+    int             Thresholds[6];
+    bool            Counting;   //!< True for histogram(), false for colour()
+};
+
+/**
+ * @brief Grey version of an RGB24 frame, still RGB24
+ */
+class Monochrome : public RowKernel
+{
+public:
+    Monochrome();
+
+    void run(const unsigned char* rgb, unsigned char* grey, int width, int height, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+private:
+    const unsigned char* Rgb;
+    unsigned char*  Grey;
+    int             Width;
+};
+
+/**
+ * @brief ARGB32 overlay of an RGB24 frame, black pixels transparent and the rest at one opacity
+ */
+class OverlayAlpha : public RowKernel
+{
+public:
+    OverlayAlpha();
+
+    /**
+     * @param alpha Alpha of pixels that aren't black, 0 to 255
+     */
+    void run(const unsigned char* rgb, QRgb* argb, int width, int height, int alpha, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+private:
+    const unsigned char* Rgb;
+    QRgb*           Argb;
+    int             Width;
+    int             Alpha;
+};
+
+/**
+ * @brief Blends an RGB24 overlay into an RGB24 frame at one opacity, for recorded composite frames
+ */
+class OverlayBlend : public RowKernel
+{
+public:
+    OverlayBlend();
+
+    /**
+     * @param rgb Overlay drawn on top
+     * @param frame Frame blended into, overlay * alpha + frame * (255 - alpha)
+     * @param alpha Opacity of the overlay, 0 to 255
+     */
+    void run(const unsigned char* rgb, unsigned char* frame, int width, int height, int alpha, WorkerPool* pool);
+
+    void rows(int begin, int end, int worker);
+
+private:
+    const unsigned char* Rgb;
+    unsigned char*  Frame;
+    int             Width;
+    int             Alpha;
+};
+
+class ImageKernels
+{
+public:
+
+    /**
+     * @brief Times every kernel on 640x480 frames with 1, 2, 4... workers up to one per core
+     *
+     * Prints the time per frame and the speed-up over one worker to std::cout. Then two threads
+     * median filter at once on one pool, and the frames that waited for the pool or ran alone
+     * are counted. Run with --benchmark-parallel.
+     *
+     * @return true if every kernel gave the same pixels with any number of workers and callers
+     */
+    static bool benchmark();
+};
+
+#endif // IMAGEKERNELS_H
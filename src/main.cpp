@@ -11,9 +11,12 @@
 #include <QImage>
 
 #include <iostream>
-#include <PvAPI/PvApi.h>
-#include <PvAPI/PvRegIo.h>
-#include <camera.h>
+#include <medianfilter.h>
+#include <imagekernels.h>
+#include <temporalfilter.h>
+#include <bayerdemosaic.h>
+#include <packetprobe.h>
+#include <framepairer.h>
 
 #include <FFMPEGClass.h>
 
@@ -23,6 +26,33 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    a.setOrganizationName("MultiChannelViewer");    //!< Where QSettings keeps the viewer's settings
+    a.setApplicationName("MultiChannelViewer");
+
+    /// --benchmark-median times the NIR median filters and checks them, no camera or window needed
+    if (a.arguments().contains("--benchmark-median"))
+        return (MedianFilter::benchmark()) ? 0 : 1;
+
+    /// --benchmark-parallel times every pixel loop with 1, 2, 4... threads
+    if (a.arguments().contains("--benchmark-parallel"))
+        return (ImageKernels::benchmark()) ? 0 : 1;
+
+    /// --benchmark-denoise compares the NIR temporal filter with the median on noisy frames
+    if (a.arguments().contains("--benchmark-denoise"))
+        return (TemporalFilter::benchmark()) ? 0 : 1;
+
+    /// --benchmark-demosaic checks both WL Bayer demosaics and times them against PvAPI's
+    if (a.arguments().contains("--benchmark-demosaic"))
+        return (BayerDemosaic::benchmark()) ? 0 : 1;
+
+    /// --check-packet-probe runs the GigE packet size probe against simulated network paths
+    if (a.arguments().contains("--check-packet-probe"))
+        return (PacketProbe::check()) ? 0 : 1;
+
+    /// --check-pairing runs the composite's frame pairer on synthetic streams with jitter, drops and drifting clocks
+    if (a.arguments().contains("--check-pairing"))
+        return (FramePairer::check()) ? 0 : 1;
+
     MultiChannelViewer w;
 
     w.show();
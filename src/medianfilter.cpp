@@ -0,0 +1,568 @@
+#include "medianfilter.h"
+
+#include <QVector>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__AVX2__)
+#define MEDIAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MEDIAN_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief One pixel at a time, the fallback and the tail of every row
+ */
+struct ScalarLanes
+{
+    typedef unsigned short Vector;
+    enum { Lanes = 1 };
+    static inline Vector load(const unsigned short* p) { return *p; }
+    static inline void store(unsigned short* p, Vector v) { *p = v; }
+    static inline Vector min(Vector a, Vector b) { return (a < b) ? a : b; }
+    static inline Vector max(Vector a, Vector b) { return (a < b) ? b : a; }
+};
+
+#if defined(MEDIAN_AVX2)
+/**
+ * @brief 16 pixels at a time
+ */
+struct VectorLanes
+{
+    typedef __m256i Vector;
+    enum { Lanes = 16 };
+    static inline Vector load(const unsigned short* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static inline void store(unsigned short* p, Vector v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static inline Vector min(Vector a, Vector b) { return _mm256_min_epu16(a, b); }
+    static inline Vector max(Vector a, Vector b) { return _mm256_max_epu16(a, b); }
+};
+#elif defined(MEDIAN_SSE2)
+/**
+ * @brief 8 pixels at a time
+ *
+ * SSE2 only compares signed 16-bit values. Flipping the top bit on load and store maps
+ * unsigned order onto signed order, so the results stay exact for any 16-bit value.
+ */
+struct VectorLanes
+{
+    typedef __m128i Vector;
+    enum { Lanes = 8 };
+    static inline Vector load(const unsigned short* p)
+    {
+        return _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi16(static_cast<short>(0x8000)));
+    }
+    static inline void store(unsigned short* p, Vector v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_xor_si128(v, _mm_set1_epi16(static_cast<short>(0x8000))));
+    }
+    static inline Vector min(Vector a, Vector b) { return _mm_min_epi16(a, b); }
+    static inline Vector max(Vector a, Vector b) { return _mm_max_epi16(a, b); }
+};
+#else
+typedef ScalarLanes VectorLanes;
+#endif
+
+/**
+ * @brief Puts the smaller value in a and the larger in b
+ */
+template <class V>
+static inline void exchange(typename V::Vector &a, typename V::Vector &b)
+{
+    typename V::Vector low = V::min(a, b);
+    b = V::max(a, b);
+    a = low;
+}
+
+template <class V>
+static inline typename V::Vector median3(typename V::Vector a, typename V::Vector b, typename V::Vector c)
+{
+    return V::max(V::min(a, b), V::min(V::max(a, b), c));
+}
+
+/**
+ * @brief Sorts the columns of three rows into their lowest, middle and highest values
+ * @return First column not done, for the next kind of lanes to carry on from
+ */
+template <class V>
+static int sortColumns3(const unsigned short* a, const unsigned short* b, const unsigned short* c,
+                        unsigned short* low, unsigned short* middle, unsigned short* high, int x, int end)
+{
+    for (; x + V::Lanes <= end; x += V::Lanes)
+    {
+        typename V::Vector p = V::load(a + x);
+        typename V::Vector q = V::load(b + x);
+        typename V::Vector r = V::load(c + x);
+        exchange<V>(p, q);
+        exchange<V>(q, r);
+        exchange<V>(p, q);
+        V::store(low + x, p);
+        V::store(middle + x, q);
+        V::store(high + x, r);
+    }
+    return x;
+}
+
+/**
+ * @brief Median of 3x3 from three sorted neighbouring columns
+ *
+ * The median of nine is the median of the largest low, the median middle and the smallest high.
+ *
+ * @return First pixel not done
+ */
+template <class V>
+static int combineColumns3(const unsigned short* low, const unsigned short* middle, const unsigned short* high,
+                           unsigned short* out, int x, int end)
+{
+    for (; x + V::Lanes <= end; x += V::Lanes)
+    {
+        typename V::Vector lows = V::max(V::max(V::load(low + x - 1), V::load(low + x)), V::load(low + x + 1));
+        typename V::Vector middles = median3<V>(V::load(middle + x - 1), V::load(middle + x), V::load(middle + x + 1));
+        typename V::Vector highs = V::min(V::min(V::load(high + x - 1), V::load(high + x)), V::load(high + x + 1));
+        V::store(out + x, median3<V>(lows, middles, highs));
+    }
+    return x;
+}
+
+/**
+ * @brief Median of 5x5 by forgetful selection
+ *
+ * 14 of the 25 values are enough to start: the smallest and largest of them can't be the
+ * median, so both are dropped and the next value comes in, until three are left.
+ *
+ * @param top First pixel of the window's top row, for x = 0
+ * @return First pixel not done
+ */
+template <class V>
+static int select5x5(const unsigned short* top, unsigned short* out, int width, int x, int end)
+{
+    for (; x + V::Lanes <= end; x += V::Lanes)
+    {
+        typename V::Vector v[25];
+        for (int j = 0; j < 5; j++)
+            for (int i = 0; i < 5; i++)
+                v[j*5 + i] = V::load(top + j*width + x - 2 + i);
+
+        int size = 14;
+        int next = 14;
+        while (true)
+        {
+            exchange<V>(v[0], v[size - 1]);
+            for (int i = 1; i < size - 1; i++)
+            {
+                exchange<V>(v[0], v[i]);
+                exchange<V>(v[i], v[size - 1]);
+            }
+            if (next == 25)
+                break;
+            v[0] = v[next++];   //!< The smallest makes room, the largest falls off the end
+            size--;
+        }
+        V::store(out + x, v[1]);
+    }
+    return x;
+}
+
+static inline int clamp(int value, int low, int high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+/**
+ * @brief Median of the window around one pixel, edge pixels repeated where it leaves the frame
+ * @param window Room for the (2 * radius + 1)^2 values of the window
+ */
+static unsigned short clampedMedian(const unsigned short* src, int width, int height, int x, int y, int radius,
+                                    unsigned short* window)
+{
+    int n = 0;
+    for (int j = -radius; j <= radius; j++)
+    {
+        const unsigned short* row = src + clamp(y + j, 0, height - 1)*width;
+        for (int i = -radius; i <= radius; i++)
+            window[n++] = row[clamp(x + i, 0, width - 1)];
+    }
+    std::nth_element(window, window + n/2, window + n);
+    return window[n/2];
+}
+
+/**
+ * @brief Filters the pixels of rows [begin, end) closer to the edge than radius, which the vectorised loops skip
+ * @param radius 1 or 2
+ */
+static void edgeMedians(const unsigned short* src, unsigned short* dst, int width, int height, int radius, int begin, int end)
+{
+    unsigned short window[25];
+    for (int y = begin; y < end; y++)
+    {
+        bool inside = y >= radius && y < height - radius;
+        for (int x = 0; x < width; x++)
+        {
+            if (inside && x == radius && width - radius > radius)
+                x = width - radius;     //!< Jump over the inside of the row
+            dst[y*width + x] = clampedMedian(src, width, height, x, y, radius, window);
+        }
+    }
+}
+
+/**
+ * @brief 3x3 median of rows [begin, end)
+ * @param columns Room for 3 * width values
+ */
+template <class V>
+static void median3x3Rows(const unsigned short* src, unsigned short* dst, int width, int height, int begin, int end,
+                          unsigned short* columns)
+{
+    edgeMedians(src, dst, width, height, 1, begin, end);
+    if (width < 3 || height < 3)
+        return;
+
+    unsigned short* low = columns;
+    unsigned short* middle = low + width;
+    unsigned short* high = middle + width;
+    for (int y = qMax(begin, 1); y < qMin(end, height - 1); y++)
+    {
+        const unsigned short* above = src + (y - 1)*width;
+        const unsigned short* row = above + width;
+        const unsigned short* below = row + width;
+        int x = sortColumns3<V>(above, row, below, low, middle, high, 0, width);
+        sortColumns3<ScalarLanes>(above, row, below, low, middle, high, x, width);
+
+        unsigned short* out = dst + y*width;
+        x = combineColumns3<V>(low, middle, high, out, 1, width - 1);
+        combineColumns3<ScalarLanes>(low, middle, high, out, x, width - 1);
+    }
+}
+
+/**
+ * @brief 5x5 median of rows [begin, end)
+ */
+template <class V>
+static void median5x5Rows(const unsigned short* src, unsigned short* dst, int width, int height, int begin, int end)
+{
+    edgeMedians(src, dst, width, height, 2, begin, end);
+    if (width < 5 || height < 5)
+        return;
+    for (int y = qMax(begin, 2); y < qMin(end, height - 2); y++)
+    {
+        const unsigned short* top = src + (y - 2)*width;
+        unsigned short* out = dst + y*width;
+        int x = select5x5<V>(top, out, width, 2, width - 2);
+        select5x5<ScalarLanes>(top, out, width, x, width - 2);
+    }
+}
+
+/**
+ * @brief Constant time median of rows [begin, end)
+ *
+ * Every column keeps a histogram of the rows under the window. Coarse histograms of all
+ * columns come first in columns, then the fine bins by coarse bin and column, so sliding
+ * the window along a row reads neighbouring memory.
+ *
+ * @param columns Column histograms, all zero. Resized and zeroed if they don't fit the width,
+ *                and left zero again, so the next frame doesn't clear megabytes of bins
+ */
+static void constantTimeRows(const unsigned short* src, unsigned short* dst, int width, int height, int radius,
+                             int begin, int end, QVector<unsigned short> &columns)
+{
+    const int middle = (2*radius + 1)*(2*radius + 1)/2;
+    const int fine_stride = width*MEDIAN_FINE_BINS;
+    if (begin >= end)
+        return;
+    if (columns.count() != width*(MEDIAN_COARSE_BINS + MEDIAN_LEVELS))
+        columns.fill(0, width*(MEDIAN_COARSE_BINS + MEDIAN_LEVELS));
+    unsigned short* coarse_columns = columns.data();
+    unsigned short* fine_columns = coarse_columns + width*MEDIAN_COARSE_BINS;
+    unsigned short coarse[MEDIAN_COARSE_BINS];  //!< Window's histogram. Counts fit as radius <= MEDIAN_MAX_RADIUS
+    unsigned short fines[MEDIAN_LEVELS];        //!< Only up to date for the bins updated says
+    int updated[MEDIAN_COARSE_BINS];            //!< Column the window was on when each coarse bin's fine bins were last updated
+
+    /// Column histograms start on the rows around the first row, edge rows counted again for the rows outside
+    for (int j = begin - radius; j <= begin + radius; j++)
+    {
+        const unsigned short* row = src + clamp(j, 0, height - 1)*width;
+        for (int x = 0; x < width; x++)
+        {
+            int value = row[x] & (MEDIAN_LEVELS - 1);
+            int k = value >> MEDIAN_FINE_SHIFT;
+            coarse_columns[x*MEDIAN_COARSE_BINS + k]++;
+            fine_columns[k*fine_stride + x*MEDIAN_FINE_BINS + (value & (MEDIAN_FINE_BINS - 1))]++;
+        }
+    }
+
+    for (int y = begin; y < end; y++)
+    {
+        if (y > begin)  //!< Slide every column down a row
+        {
+            const unsigned short* leaving = src + clamp(y - radius - 1, 0, height - 1)*width;
+            const unsigned short* entering = src + clamp(y + radius, 0, height - 1)*width;
+            for (int x = 0; x < width; x++)
+            {
+                int value = leaving[x] & (MEDIAN_LEVELS - 1);
+                int k = value >> MEDIAN_FINE_SHIFT;
+                coarse_columns[x*MEDIAN_COARSE_BINS + k]--;
+                fine_columns[k*fine_stride + x*MEDIAN_FINE_BINS + (value & (MEDIAN_FINE_BINS - 1))]--;
+                value = entering[x] & (MEDIAN_LEVELS - 1);
+                k = value >> MEDIAN_FINE_SHIFT;
+                coarse_columns[x*MEDIAN_COARSE_BINS + k]++;
+                fine_columns[k*fine_stride + x*MEDIAN_FINE_BINS + (value & (MEDIAN_FINE_BINS - 1))]++;
+            }
+        }
+
+        memset(coarse, 0, sizeof(coarse));
+        for (int i = -radius; i <= radius; i++)
+        {
+            const unsigned short* column = coarse_columns + clamp(i, 0, width - 1)*MEDIAN_COARSE_BINS;
+            for (int k = 0; k < MEDIAN_COARSE_BINS; k++)
+                coarse[k] += column[k];
+        }
+        for (int k = 0; k < MEDIAN_COARSE_BINS; k++)
+            updated[k] = -(2*radius + 2);     //!< The columns changed, every fine bin is stale
+
+        unsigned short* out = dst + y*width;
+        for (int x = 0; x < width; x++)
+        {
+            if (x > 0)  //!< Slide the window right a column
+            {
+                const unsigned short* leaving = coarse_columns + clamp(x - radius - 1, 0, width - 1)*MEDIAN_COARSE_BINS;
+                const unsigned short* entering = coarse_columns + clamp(x + radius, 0, width - 1)*MEDIAN_COARSE_BINS;
+                for (int k = 0; k < MEDIAN_COARSE_BINS; k++)
+                    coarse[k] += entering[k] - leaving[k];
+            }
+
+            int sum = 0;
+            int k = 0;
+            while (sum + coarse[k] <= middle)
+                sum += coarse[k++];
+
+            /// Only the coarse bin holding the median needs its fine bins, the others catch up when they're used
+            unsigned short* fine = fines + k*MEDIAN_FINE_BINS;
+            const unsigned short* bins = fine_columns + k*fine_stride;
+            if (x - updated[k] > 2*radius)
+            {
+                memset(fine, 0, MEDIAN_FINE_BINS*sizeof(unsigned short));
+                for (int i = x - radius; i <= x + radius; i++)
+                {
+                    const unsigned short* column = bins + clamp(i, 0, width - 1)*MEDIAN_FINE_BINS;
+                    for (int l = 0; l < MEDIAN_FINE_BINS; l++)
+                        fine[l] += column[l];
+                }
+            }
+            else
+            {
+                for (int p = updated[k] + 1; p <= x; p++)
+                {
+                    const unsigned short* leaving = bins + clamp(p - radius - 1, 0, width - 1)*MEDIAN_FINE_BINS;
+                    const unsigned short* entering = bins + clamp(p + radius, 0, width - 1)*MEDIAN_FINE_BINS;
+                    for (int l = 0; l < MEDIAN_FINE_BINS; l++)
+                        fine[l] += entering[l] - leaving[l];
+                }
+            }
+            updated[k] = x;
+
+            int l = 0;
+            while (sum + fine[l] <= middle)
+                sum += fine[l++];
+            out[x] = static_cast<unsigned short>(k*MEDIAN_FINE_BINS + l);
+        }
+    }
+
+    /// Takes the last window's rows back out, which zeroes exactly the bins they touched
+    for (int j = end - 1 - radius; j <= end - 1 + radius; j++)
+    {
+        const unsigned short* row = src + clamp(j, 0, height - 1)*width;
+        for (int x = 0; x < width; x++)
+        {
+            int value = row[x] & (MEDIAN_LEVELS - 1);
+            int k = value >> MEDIAN_FINE_SHIFT;
+            coarse_columns[x*MEDIAN_COARSE_BINS + k]--;
+            fine_columns[k*fine_stride + x*MEDIAN_FINE_BINS + (value & (MEDIAN_FINE_BINS - 1))]--;
+        }
+    }
+}
+
+MedianFilter::MedianFilter()
+{
+    this->Src = NULL;
+    this->Dst = NULL;
+    this->Width = 0;
+    this->Height = 0;
+    this->Size = 1;
+}
+
+void MedianFilter::apply(const unsigned short *src, unsigned short *dst, int width, int height, int size, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+    if (this->Scratch.count() < pool->workers())
+        this->Scratch.resize(pool->workers());
+    if (this->Histograms.count() < pool->workers())
+        this->Histograms.resize(pool->workers());
+
+    this->Src = src;
+    this->Dst = dst;
+    this->Width = width;
+    this->Height = height;
+    this->Size = (size == 3 || size == 5) ? size : 2*qMin(size/2, MEDIAN_MAX_RADIUS) + 1;
+
+    /// The constant time median sets up its column histograms for every stripe, so it gets one per worker
+    int stripe = (this->Size <= 5) ? WorkerPool::stripeRows(width*2*this->Size)
+                                   : (height + pool->workers() - 1) / pool->workers();
+    pool->parallelFor(KernelMedian, *this, height, stripe);
+}
+
+void MedianFilter::rows(int begin, int end, int worker)
+{
+    if (this->Size <= 1)
+    {
+        memcpy(this->Dst + begin*this->Width, this->Src + begin*this->Width, (end - begin)*this->Width*sizeof(unsigned short));
+        return;
+    }
+
+    QVector<unsigned short> &scratch = this->Scratch[worker];
+    if (this->Size == 3)
+    {
+        if (scratch.count() < 3*this->Width)
+            scratch.resize(3*this->Width);
+        median3x3Rows<VectorLanes>(this->Src, this->Dst, this->Width, this->Height, begin, end, scratch.data());
+    }
+    else if (this->Size == 5)
+        median5x5Rows<VectorLanes>(this->Src, this->Dst, this->Width, this->Height, begin, end);
+    else
+        constantTimeRows(this->Src, this->Dst, this->Width, this->Height, this->Size/2, begin, end, this->Histograms[worker]);
+}
+
+void MedianFilter::median3x3(const unsigned short *src, unsigned short *dst, int width, int height, bool vectorised)
+{
+    QVector<unsigned short> columns(3*width);
+    if (vectorised)
+        median3x3Rows<VectorLanes>(src, dst, width, height, 0, height, columns.data());
+    else
+        median3x3Rows<ScalarLanes>(src, dst, width, height, 0, height, columns.data());
+}
+
+void MedianFilter::median5x5(const unsigned short *src, unsigned short *dst, int width, int height, bool vectorised)
+{
+    if (vectorised)
+        median5x5Rows<VectorLanes>(src, dst, width, height, 0, height);
+    else
+        median5x5Rows<ScalarLanes>(src, dst, width, height, 0, height);
+}
+
+void MedianFilter::constantTime(const unsigned short *src, unsigned short *dst, int width, int height, int radius)
+{
+    if (radius < 1)
+    {
+        memcpy(dst, src, width*height*sizeof(unsigned short));
+        return;
+    }
+    if (this->Histograms.isEmpty())
+        this->Histograms.resize(1);
+    constantTimeRows(src, dst, width, height, qMin(radius, MEDIAN_MAX_RADIUS), 0, height, this->Histograms[0]);
+}
+
+void MedianFilter::reference(const unsigned short *src, unsigned short *dst, int width, int height, int radius)
+{
+    QVector<unsigned short> window((2*radius + 1)*(2*radius + 1));
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            dst[y*width + x] = clampedMedian(src, width, height, x, y, radius, window.data());
+}
+
+const char* MedianFilter::instructionSet()
+{
+#if defined(MEDIAN_AVX2)
+    return "AVX2";
+#elif defined(MEDIAN_SSE2)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+/**
+ * @brief Fills a frame like a bright NIR image: dark noise, a lit disc and hot and dead pixels
+ */
+static void benchmarkFrame(unsigned short* frame, int width, int height)
+{
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            seed = seed*1103515245 + 12345;
+            unsigned int noise = (seed >> 16) & 0x3FF;
+            int dx = x - width/2;
+            int dy = y - height/2;
+            bool lit = dx*dx + dy*dy < (height*height)/5;
+            unsigned short value = static_cast<unsigned short>((lit) ? 2500 + noise : 60 + (noise & 63));
+            if ((seed >> 8 & 0xFF) == 0)
+                value = ((seed >> 4) & 1) ? 4095 : 0;
+            frame[y*width + x] = value;
+        }
+    }
+}
+
+bool MedianFilter::benchmark()
+{
+    bool exact = true;
+    int sizes[2][2] = {{640, 480}, {MEDIAN_BENCHMARK_WIDTH, MEDIAN_BENCHMARK_HEIGHT}};
+    MedianFilter filter;
+    std::cout << "Median filters, vectorised with " << instructionSet() << std::endl;
+
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        QVector<unsigned short> src(width*height);
+        QVector<unsigned short> dst(width*height);
+        QVector<unsigned short> expected(width*height);
+        benchmarkFrame(src.data(), width, height);
+        std::cout << width << "x" << height << ":" << std::endl;
+
+        /// The 7x7 window is the NIR camera's default, the others are compared to it
+        struct Run { const char* Name; int Kind; int Radius; };
+        const Run runs[] = {
+            {"7x7 constant time (default)", 0, 3},
+            {"3x3 constant time", 0, 1},
+            {"3x3 scalar", 1, 1},
+            {"3x3 vectorised", 2, 1},
+            {"5x5 constant time", 0, 2},
+            {"5x5 scalar", 1, 2},
+            {"5x5 vectorised", 2, 2},
+            {"15x15 constant time", 0, 7},
+            {"31x31 constant time", 0, 15}
+        };
+        double reference_ms = 0;
+        for (unsigned int r = 0; r < sizeof(runs)/sizeof(runs[0]); r++)
+        {
+            reference(src.constData(), expected.data(), width, height, runs[r].Radius);
+
+            int repeats = 0;
+            QElapsedTimer clock;
+            clock.start();
+            do
+            {
+                if (runs[r].Kind == 0)
+                    filter.constantTime(src.constData(), dst.data(), width, height, runs[r].Radius);
+                else if (runs[r].Radius == 1)
+                    median3x3(src.constData(), dst.data(), width, height, runs[r].Kind == 2);
+                else
+                    median5x5(src.constData(), dst.data(), width, height, runs[r].Kind == 2);
+                repeats++;
+            }while (clock.elapsed() < 500 || repeats < 3);
+            double ms = clock.nsecsElapsed() / 1000000.0 / repeats;
+            if (r == 0)
+                reference_ms = ms;
+
+            bool match = memcmp(dst.constData(), expected.constData(), width*height*sizeof(unsigned short)) == 0;
+            exact = exact && match;
+            std::cout << "  " << runs[r].Name << ": " << ms << " ms/frame, " << reference_ms / ms << "x the default"
+                      << ((match) ? "" : ", DIFFERS FROM REFERENCE") << std::endl;
+        }
+    }
+    return exact;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The MedianFilter class removes the salt-and-pepper noise of the NIR
+ * camera's Mono16 frames.
+ *
+ * The 3x3 and 5x5 medians work on 8 (SSE2) or 16 (AVX2) pixels at once
+ * with min/max sorting networks, so their cost doesn't depend on how
+ * bright the image is. The 3x3 median sorts each column of three once
+ * and combines neighbouring columns; the 5x5 median uses forgetful
+ * selection, dropping the smallest and largest values of a shrinking
+ * window. AVX2 is used when the compiler targets it (-mavx2, /arch:AVX2),
+ * SSE2 on any other x86-64 build, plain C++ elsewhere.
+ *
+ * Larger windows use constantTime(), whose cost per pixel doesn't grow
+ * with the radius: every column keeps a histogram of the rows under the
+ * window, and the window's histogram adds the column entering on the
+ * right and drops the one leaving on the left. Histograms have two
+ * levels, 64 coarse bins of 64 levels each, so finding the median reads
+ * at most 128 bins of the 4096. It is exact for 12-bit data.
+ *
+ * Every filter gives the same result as reference(). Near the edges the
+ * window is filled by repeating the edge pixels.
+ */
+
+#ifndef MEDIANFILTER_H
+#define MEDIANFILTER_H
+
+#define MEDIAN_LEVELS 4096              //!< Levels constantTime() counts, 12-bit data
+#define MEDIAN_FINE_SHIFT 6             //!< A coarse bin holds 1 << MEDIAN_FINE_SHIFT levels
+#define MEDIAN_COARSE_BINS (MEDIAN_LEVELS >> MEDIAN_FINE_SHIFT)  //!< Coarse bins of the histograms
+#define MEDIAN_FINE_BINS (1 << MEDIAN_FINE_SHIFT)                //!< Fine bins in each coarse bin
+#define MEDIAN_MAX_RADIUS 127           //!< Largest constantTime() radius, window counts must fit 16 bits
+#define MEDIAN_BENCHMARK_WIDTH 1360     //!< Full sensor width used by benchmark()
+#define MEDIAN_BENCHMARK_HEIGHT 1024    //!< Full sensor height used by benchmark()
+
+#include <QVector>
+#include <workerpool.h>
+
+class MedianFilter : public RowKernel
+{
+public:
+
+    MedianFilter();
+
+    /**
+     * @brief Filters a frame with a size x size median
+     *
+     * Rows are spread over a WorkerPool. The histograms are kept from one call to the
+     * next, so a stream of frames of the same size doesn't allocate.
+     *
+     * @param src Frame to filter
+     * @param dst Where the filtered frame goes, must not overlap src
+     * @param width Width of the frame in pixels
+     * @param height Height of the frame in pixels
+     * @param size 3 or 5 for the vectorised medians, another odd size for constantTime()
+     * @param pool Pool to spread the rows over, NULL for WorkerPool::shared()
+     */
+    void apply(const unsigned short* src, unsigned short* dst, int width, int height, int size, WorkerPool* pool = NULL);
+
+    /**
+     * @brief Filters rows [begin, end) of the frame apply() was given, on one of the pool's threads
+     */
+    void rows(int begin, int end, int worker);
+
+    /**
+     * @brief 3x3 median, on the calling thread
+     * @param vectorised false forces the plain C++ version, for comparisons
+     */
+    static void median3x3(const unsigned short* src, unsigned short* dst, int width, int height, bool vectorised = true);
+
+    /**
+     * @brief 5x5 median, on the calling thread
+     * @param vectorised false forces the plain C++ version, for comparisons
+     */
+    static void median5x5(const unsigned short* src, unsigned short* dst, int width, int height, bool vectorised = true);
+
+    /**
+     * @brief (2 * radius + 1)^2 median in constant time per pixel, for 12-bit data
+     *
+     * The window's fine bins are only brought up to date for the coarse bin the median
+     * falls in, which rarely changes from one pixel to the next.
+     *
+     * @param radius Up to MEDIAN_MAX_RADIUS, larger radii are cut down to it
+     */
+    void constantTime(const unsigned short* src, unsigned short* dst, int width, int height, int radius);
+
+    /**
+     * @brief Sorts every window. Slow, but obviously right: the other filters are checked against it
+     */
+    static void reference(const unsigned short* src, unsigned short* dst, int width, int height, int radius);
+
+    /**
+     * @brief Gets the instruction set the vectorised medians were built for: "AVX2", "SSE2" or "none"
+     */
+    static const char* instructionSet();
+
+    /**
+     * @brief Times every filter on a 640x480 and a full sensor frame, and checks them against reference()
+     *
+     * Prints the results to std::cout. Run with --benchmark-median.
+     *
+     * @return true if every filter matched reference()
+     */
+    static bool benchmark();
+
+private:
+
+    QVector<QVector<unsigned short> > Scratch;  //!< Column sorts of each worker
+    QVector<QVector<unsigned short> > Histograms; //!< constantTime() column histograms of each worker, zero between frames
+    const unsigned short* Src;          //!< Frame apply() is filtering
+    unsigned short* Dst;                //!< Where it goes
+    int             Width;              //!< Width of the frame
+    int             Height;             //!< Height of the frame
+    int             Size;               //!< Window size
+};
+
+#endif // MEDIANFILTER_H
@@ -6,14 +6,19 @@ MultiChannelViewer::MultiChannelViewer(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MultiChannelViewer)
 {
+    Startup_Clock.start();
     ui->setupUi(this);
     //this->show();   //!< Displays main GUI
 
+    /// Frames and their metadata cross from the camera threads to the GUI thread
+    qRegisterMetaType<FrameBuffer>("FrameBuffer");
+    qRegisterMetaType<FrameInfo>("FrameInfo");
+
 
     /// Setting initial values for recording, screenshot, and False-coloring thresholds
     recording = false;
-    screenshot_cam1 = false;
-    screenshot_cam2 = false;
+    Record_Start_Composite = -1;
+    screenshot_cam3 = false;
     monochrome = false;
     opacity_val = 0.1;
     thresh_calibrated = 2;
@@ -22,152 +27,206 @@ MultiChannelViewer::MultiChannelViewer(QWidget *parent) :
     exposure_NIR = 500000;
     brightness_WL = 0;
     contrast_WL = 100;
-    Cam1_Image = new QImage(WIDTH, HEIGHT, QImage::Format_RGB888);
-    Cam2_Image = new QImage(WIDTH, HEIGHT, QImage::Format_RGB888);
-    Cam2_Image_Raw = new unsigned char[HEIGHT*WIDTH*2];
-    Cam1_Image->fill(0);
-    Cam2_Image->fill(0);
-
-
-    if (this->InitializePv() && this->ConnectToCam()) //!< Executes if PvAPI initializes and Cameras connect successfully
+    WL_Channel = NULL;
+    NIR_Channel = NULL;
+    Composite_Pairer = NULL;
+    Crop_Detector = NULL;
+    Crop_Skip = CROP_SKIP_FRAMES;
+    Crop_Attempts = 0;
+    Offline = false;
+    Replay_Running = 0;
+    Finding_Defects = false;
+
+    QSettings settings;
+    QString sync = settings.value("Sync/Mode", "off").toString();
+    Sync_Mode = (sync == "triggered") ? SyncTriggered : ((sync == "paired") ? SyncPaired : SyncOff);
+    Raw_Recording = settings.value("Recording/Raw", false).toBool();
+    Record_Demosaic = (settings.value("Recording/Demosaic", "bilinear").toString() == "gradient") ? DemosaicGradient : DemosaicBilinear;
+    Recording_Kernel.setMethod(Record_Demosaic);
+
+    /// Parallel/Threads sets the pixel loops' workers (0, the default, for one per core).
+    /// Parallel/Serial lists loops kept on one thread, e.g. "median,yuv"
+    WorkerPool::setSharedWorkers(settings.value("Parallel/Threads", 0).toInt());
+    QStringList serial = settings.value("Parallel/Serial").toStringList();
+    for (int i = 0; i < KernelCount; i++)
+        WorkerPool::shared()->setParallel((ParallelKernel)i, !serial.contains(WorkerPool::kernelName((ParallelKernel)i)));
+
+    /// Preallocated buffers for rendering. Interpolated Bayer rows are padded to 4 bytes, as PvAPI padded them.
+    Interpolation_Pool = new FramePool((WIDTH*3 + ULONG_PADDING(WIDTH*3))*HEIGHT, FRAMEPOOL_SPARE);
+    RGB_Pool = new FramePool(WIDTH*HEIGHT*3, 2*FRAMEPOOL_SPARE);
+    ARGB_Pool = new FramePool(WIDTH*HEIGHT*4, FRAMEPOOL_SPARE);
+    Mono16_Pool = new FramePool(WIDTH*HEIGHT*2, FRAMEPOOL_SPARE);
+
+    connect(&Statistics_Timer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+
+    /// --synthetic[=WL,NIR,...] runs the whole pipeline on generated frames, no camera needed
+    QStringList synthetic_roles;
+    QStringList arguments = QApplication::arguments();
+    for (int i = 1; i < arguments.count(); i++)
     {
-        if (this->Two_Cameras_Connected) //!< Executes if two cameras (WL and NIR) are detected
-        {
-            this->exposure_control = new AutoExpose(&Cam1, &Cam2);
-
-            Cam1.moveToThread(&thread1); //!< Assigns Cam1 to Thread1
-            Cam2.moveToThread(&thread2); //!< Assigns Cam2 to Thread2
-
-            Cam2.SetMono16Bit();    //!< Enables 16-bit Mono format for Cam2 (NIR cam)
-
-
-            /// Connects various slots and signals. Identical for the second set of connections
-            ///
-            /// The first connection connects the frameReady signal to the renderFrame slot.
-            /// When the camera has finished capturing a frame, the function will execute
-            /// displaying the frame on the Main GUI window
-            ///
-            /// The second connection connects the SIG_renderFrame_WL_Cam_Done signal to the capture() slot.
-            /// This completes the loop so that when the Main GUI has finished displaying the frame,
-            /// it tells the camera to capture another frame
-            ///
-            /// The third connection ties the camera object to its own thread, and by extension, tying all these
-            /// connections to that same thread, so that the camera captures and displays an image all on its own
-            /// thread
-            connect(&Cam1, SIGNAL(frameReady(Camera*)), this, SLOT(renderFrame_WL_Cam(Camera*)),Qt::AutoConnection);
-            connect(this, SIGNAL(SIG_renderFrame_WL_Cam_Done()), &Cam1, SLOT(capture()),Qt::AutoConnection);
-            connect(&thread1, SIGNAL(started()), &Cam1, SLOT(capture()));
-
-
-            ///Identical to the above set of slots and signals, except for Cam2 and Cam2-specific functions
-            connect(&Cam2, SIGNAL(frameReady(Camera*)), this, SLOT(renderFrame_NIR_Cam(Camera*)),Qt::AutoConnection);
-            connect(this, SIGNAL(SIG_renderFrame_NIR_Cam_Done()), &Cam2, SLOT(capture()), Qt::AutoConnection);
-            connect(&thread2, SIGNAL(started()), &Cam2, SLOT(capture()));
+        if (arguments[i] == "--synthetic")
+            synthetic_roles << "WL" << "NIR";
+        else if (arguments[i].startsWith("--synthetic="))
+            synthetic_roles = arguments[i].mid(12).split(',');
+    }
 
-            connect(this, SIGNAL(SIG_AutoExpose(QImage*,unsigned char*)),
-                    exposure_control, SLOT(AutoExposure_Two_Cams(QImage*,unsigned char*)), Qt::DirectConnection);
+    /// --replay=a.mcvraw,b.mcvraw runs the pipeline on raw recordings, --replay-mode overrides Replay/Mode
+    /// --discover searches the network for cameras even if the last run's addresses are known
+    QStringList replay_files;
+    QString replay_mode = settings.value("Replay/Mode", "realtime").toString();
+    bool discover = false;
+    bool auto_crop = false;
+    for (int i = 1; i < arguments.count(); i++)
+    {
+        if (arguments[i].startsWith("--replay="))
+            replay_files = arguments[i].mid(9).split(',');
+        else if (arguments[i].startsWith("--replay-mode="))
+            replay_mode = arguments[i].mid(14);
+        else if (arguments[i] == "--discover")
+            discover = true;
+        else if (arguments[i] == "--crop")
+            auto_crop = true;
+    }
 
-            Cam1.captureSetup();    //!< Sets up Cam1 capture settings
-            Cam2.captureSetup();    //!< Sets up Cam2 capture settings
+    /// Crop/Auto (or --crop, for this run only) streams only the endoscope's image circle, found on the first frames
+    if (auto_crop || settings.value("Crop/Auto", false).toBool())
+        Crop_Detector = new CircleDetector();
+    Offline = !synthetic_roles.isEmpty() || !replay_files.isEmpty();
 
+    bool connected;
+    if (!replay_files.isEmpty())
+        connected = this->ConnectToReplay(replay_files, replay_mode);
+    else if (!synthetic_roles.isEmpty())
+        connected = this->ConnectToSynthetic(synthetic_roles);
+    else
+        connected = this->ConnectToCam(discover);
+    if (connected) //!< Executes if PvAPI initializes and Cameras connect successfully
+    {
+        WL_Channel = Registry.primary(RoleWhiteLight);
+        NIR_Channel = Registry.primary(RoleNearInfrared);
 
-            this->show();
-            thread1.start();        //!< Initializes thread1 and starts Cam1 stream/display
-            thread2.start();        //!< Initializes thread2 and starts Cam2 stream/display
-        }
+        /// Autoexposure follows the primary cameras. A lone NIR camera is passed as Cam1
+        if (WL_Channel && NIR_Channel)
+            this->exposure_control = new AutoExpose(WL_Channel->Cam, NIR_Channel->Cam);
         else
+            this->exposure_control = new AutoExpose((WL_Channel) ? WL_Channel->Cam : NIR_Channel->Cam);
+
+        /// AutoExposure/TargetFPS > 0 has the NIR camera bin rather than drop below that frame rate
+        if (NIR_Channel)
+            this->exposure_control->setTargetFPS(settings.value("AutoExposure/TargetFPS", 0.0).toDouble());
+
+        connect(this, SIGNAL(SIG_AutoExpose(QImage,FrameBuffer,FrameInfo,FrameInfo)),
+                exposure_control, SLOT(AutoExposure_Two_Cams(QImage,FrameBuffer,FrameInfo,FrameInfo)), Qt::DirectConnection);
+        connect(this, SIGNAL(SIG_AutoExpose_WL(QImage,FrameInfo)),
+                exposure_control, SLOT(AutoExposure_WL_Cam(QImage,FrameInfo)), Qt::DirectConnection);
+        connect(this, SIGNAL(SIG_AutoExpose_NIR(FrameBuffer,FrameInfo)),
+                exposure_control, SLOT(AutoExposure_NIR_Cam(FrameBuffer,FrameInfo)), Qt::DirectConnection);
+
+        /// Connects each camera's frameReady signal to the render slot for its role.
+        /// When the camera has finished capturing a frame, the slot displays it on the GUI,
+        /// then queues capture() on the camera's own thread so it moves on to the next frame.
+        /// Each camera lives on its own thread (see CameraRegistry), so cameras capture in parallel.
+        for (int i = 0; i < Registry.count(); i++)
         {
-            this->exposure_control = new AutoExpose(&Cam1);
+            CameraChannel* channel = Registry.channel(i);
+            if (channel->Role == RoleWhiteLight)
+                connect(channel->Cam, SIGNAL(frameReady(FrameSource*,FrameBuffer,FrameInfo)), this, SLOT(renderFrame_WL_Cam(FrameSource*,FrameBuffer,FrameInfo)));
+            else
+                connect(channel->Cam, SIGNAL(frameReady(FrameSource*,FrameBuffer,FrameInfo)), this, SLOT(renderFrame_NIR_Cam(FrameSource*,FrameBuffer,FrameInfo)));
+            connect(channel->Cam, SIGNAL(attributeApplied(FrameSource*,QString,unsigned long,qint64,FrameInfo)),
+                    this, SLOT(attributeApplied(FrameSource*,QString,unsigned long,qint64,FrameInfo)));
+
+            channel->Image = QImage(WIDTH, HEIGHT, QImage::Format_RGB888);
+            channel->Image.fill(0);
+            Bandwidth.addCamera(channel->Cam); //!< Splits the link evenly until the cameras have been measured
+
+            /// Filter/MedianSize picks the NIR median window: 3 or 5 vectorised, 1 off, 7 by default
+            if (channel->Role == RoleNearInfrared
+                    && !channel->Cam->setMedianSize(settings.value("Filter/MedianSize", FRAMEPROCESSOR_MEDIAN_SIZE).toInt()))
+                std::cout << "Filter/MedianSize must be 1 or an odd size, keeping " << FRAMEPROCESSOR_MEDIAN_SIZE << std::endl;
+
+            /// Filter/Denoise is "median" or "temporal" for every NIR camera, Filter/<name>/Denoise for one of them
+            QString denoise = settings.value("Filter/" + channel->Name + "/Denoise",
+                                             settings.value("Filter/Denoise", "median")).toString();
+            if (channel->Role == RoleNearInfrared
+                    && !channel->Cam->setDenoise((denoise == "temporal") ? DenoiseTemporal : DenoiseMedian,
+                                        settings.value("Filter/TemporalWeight", TEMPORAL_WEIGHT).toInt(),
+                                        settings.value("Filter/TemporalMotion", TEMPORAL_MOTION).toInt()))
+                std::cout << "Filter/TemporalWeight must be 1 to " << TEMPORAL_WEIGHT_ONE << " and Filter/TemporalMotion 0 to "
+                          << TEMPORAL_MAX_LEVEL << ", " << channel->Name.toStdString() << " keeps the median" << std::endl;
+            if (channel == NIR_Channel)
+                connect(channel->Cam, SIGNAL(defectsFound(FrameSource*,int)), this, SLOT(defectsFound(FrameSource*,int)));
+        }
 
-            Cam1.moveToThread(&thread1);
-            if (Cam1.isWhiteLight()) //!< Executes if Cam is White Light only
-            {
+        /// The primary WL camera paces every other camera, which must have SyncIn1 wired to its SyncOut1
+        if (Sync_Mode == SyncTriggered && WL_Channel)
+        {
+            for (int i = 0; i < Registry.count(); i++)
+                Registry.channel(i)->Cam->setTriggerMode((Registry.channel(i) == WL_Channel) ? TriggerMaster : TriggerSlave);
+        }
+        else if (Sync_Mode == SyncTriggered)
+        {
+            std::cout << "No WL camera to trigger from, cameras free-run" << std::endl;
+            Sync_Mode = SyncPaired;
+        }
 
-                /// Connects various slots and signals.
-                ///
-                /// The first connection connects the frameReady signal to the renderFrame slot.
-                /// When the camera has finished capturing a frame, the renderFrame_WL_Cam function will execute
-                /// displaying the frame on the Main GUI window
-                ///
-                /// The second connection connects the SIG_renderFrame_WL_Cam_Done signal to the capture() slot.
-                /// This completes the loop so that when the Main GUI has finished displaying the frame,
-                /// it tells the camera to capture another frame
-                ///
-                /// The third connection ties the camera object to its own thread, and by extension, tying all these
-                /// connections to that same thread, so that the camera captures and displays an image all on its own
-                /// thread
-                connect(&Cam1, SIGNAL(frameReady(Camera*)), this, SLOT(renderFrame_WL_Cam(Camera*)));
-                connect(this, SIGNAL(SIG_renderFrame_WL_Cam_Done()), &Cam1, SLOT(capture()));
-                connect(&thread1, SIGNAL(started()), &Cam1, SLOT(capture()));
-                connect(this, SIGNAL(SIG_AutoExpose_WL(QImage*)),
-                        exposure_control, SLOT(AutoExposure_WL_Cam(QImage*)), Qt::DirectConnection);
-
-                this->Single_Cameras_is_WL = true;
-
-                /// UI Tweaks (deletes all unneeded elements from NIR cam)
-                delete ui->NIR_Camera;
-                delete ui->cam_2;
-                delete ui->cam_3;
-                delete ui->Monochrome;
-                delete ui->opacitySlider;
-                delete ui->text_Opacity;
-                delete ui->NIR_Thresh;
-                delete ui->NIR_Thresh_label;
-
-                /// UI Resizing
-                ui->WL_camera->setGeometry(200,640,221,141);
-                ui->Media->setGeometry(250,540,129,85);
-                ui->AutoExposure->setGeometry(20,490,111,20);
-                this->resize(640,900);
-            }
-            else if (Cam1.isNearInfrared()) //!< Executes if Cam is NIR only
-            {
+        /// Defective pixels found before are kept in the parameter file saved or loaded last
+        QString parameters = settings.value("Parameters/File").toString();
+        if (!parameters.isEmpty())
+            loadDefects(parameters);
 
-                /// Connects various slots and signals.
-                ///
-                /// The first connection connects the frameReady signal to the renderFrame slot.
-                /// When the camera has finished capturing a frame, the renderFrame_WL_Cam function will execute
-                /// displaying the frame on the Main GUI window
-                ///
-                /// The second connection connects the SIG_renderFrame_WL_Cam_Done signal to the capture() slot.
-                /// This completes the loop so that when the Main GUI has finished displaying the frame,
-                /// it tells the camera to capture another frame
-                ///
-                /// The third connection ties the camera object to its own thread, and by extension, tying all these
-                /// connections to that same thread, so that the camera captures and displays an image all on its own
-                /// thread
-                connect(&Cam1, SIGNAL(frameReady(Camera*)), this, SLOT(renderFrame_NIR_Cam(Camera*)));
-                connect(this, SIGNAL(SIG_renderFrame_NIR_Cam_Done()), &Cam1, SLOT(capture()));
-                connect(&thread1, SIGNAL(started()), &Cam1, SLOT(capture()));
-                connect(this, SIGNAL(SIG_AutoExpose_NIR(unsigned char*)),
-                        exposure_control, SLOT(AutoExposure_NIR_Cam(unsigned char*)), Qt::DirectConnection);
-
-                this->Single_Cameras_is_WL = false;
-                Cam1.SetMono16Bit();
-
-                // UI Tweaks (deletes all unneeded elements from WL cam)
-                delete ui->WL_camera;
-                delete ui->cam_1;
-                delete ui->cam_3;
-                delete ui->Monochrome;
-                delete ui->opacitySlider;
-                delete ui->text_Opacity;
-
-                // UI Resizing
-                ui->cam_2->setGeometry(0,0,640,480);
-                ui->NIR_Camera->setGeometry(200,640,221,141);
-                ui->Media->setGeometry(250,540,129,85);
-                ui->AutoExposure->setGeometry(20,490,111,20);
-                ui->NIR_Thresh->setGeometry(250,800,124,24);
-                ui->NIR_Thresh_label->setGeometry(250,826,124,16);
-                this->resize(640,900);
-            }
-            Cam1.captureSetup();
+        this->setupDisplays();
+        this->setupComposite();
 
-            this->show();
-            thread1.start();
+        if (!NIR_Channel) //!< Executes if there is no NIR camera
+        {
+            /// UI Tweaks (deletes all unneeded elements from NIR cam)
+            delete ui->NIR_Camera;
+            delete ui->cam_2;
+            delete ui->cam_3;
+            delete ui->Monochrome;
+            delete ui->opacitySlider;
+            delete ui->text_Opacity;
+            delete ui->NIR_Thresh;
+            delete ui->NIR_Thresh_label;
+
+            /// UI Resizing
+            ui->WL_camera->setGeometry(200,640,221,141);
+            ui->Media->setGeometry(250,540,129,85);
+            ui->AutoExposure->setGeometry(20,490,111,20);
+            this->resize(640,900);
         }
-
+        else if (!WL_Channel) //!< Executes if there is no WL camera
+        {
+            // UI Tweaks (deletes all unneeded elements from WL cam)
+            delete ui->WL_camera;
+            delete ui->cam_1;
+            delete ui->cam_3;
+            delete ui->Monochrome;
+            delete ui->opacitySlider;
+            delete ui->text_Opacity;
+
+            // UI Resizing
+            ui->cam_2->setGeometry(0,0,640,480);
+            ui->NIR_Camera->setGeometry(200,640,221,141);
+            ui->Media->setGeometry(250,540,129,85);
+            ui->AutoExposure->setGeometry(20,490,111,20);
+            ui->NIR_Thresh->setGeometry(250,800,124,24);
+            ui->NIR_Thresh_label->setGeometry(250,826,124,16);
+            this->resize(640,900);
+        }
+        else if (Composite_Channels.isEmpty())
+            ui->cam_3->hide();
+
+        this->show();
+        QElapsedTimer setup;
+        setup.start();
+        Registry.start();           //!< Sets up every camera, then starts each one's thread and stream
+        std::cout << "Cameras set up in " << setup.elapsed() << " ms, "
+                  << Startup_Clock.elapsed() << " ms after startup" << std::endl;
+        Statistics_Timer.start(1000);
+        if (Registry.count() > 1)
+            Bandwidth.start();      //!< Hands bandwidth an exposure-limited camera can't use to the others
     }
     else
     {
@@ -181,15 +240,16 @@ MultiChannelViewer::MultiChannelViewer(QWidget *parent) :
 
 MultiChannelViewer::~MultiChannelViewer()
 {
+    delete Composite_Pairer;
+    for (int i = 0; i < Extra_Displays.count(); i++)
+        delete Extra_Displays[i];
     delete ui;
 }
 
-bool MultiChannelViewer::InitializePv()
+bool MultiChannelViewer::InitializePv(bool discovery)
 {
-    tPvErr errcodeinit = PvInitialize(); //Initialize PvAPI module
-    if (errcodeinit != ePvErrSuccess) //Program shuts down if weird error is encountered
+    if (!Registry.initialize(discovery)) //Program shuts down if weird error is encountered
     {
-        std::cout << "PvInitialize err: " << errcodeinit << std::endl;
         QMessageBox errBox;
         errBox.critical(0,"Error","Camera Module could not be initalized.");
         errBox.setFixedSize(500,200);
@@ -198,140 +258,295 @@ bool MultiChannelViewer::InitializePv()
     return true;
 }
 
-bool MultiChannelViewer::ConnectToCam()
+bool MultiChannelViewer::ConnectToCam(bool discover)
 {
-    tPvCameraInfoEx   info[2];
-    unsigned long     numCameras;
-
-    /// Creates messagebox that shows camera's connected
-    int returnVal = QMessageBox::Retry;
-    QMessageBox* WaitForCamera = new QMessageBox();
-    WaitForCamera->setModal(true);
-    WaitForCamera->setStandardButtons(QMessageBox::Ok | QMessageBox::Retry);
-    WaitForCamera->setDefaultButton(QMessageBox::Ok);
-    WaitForCamera->setWindowTitle("Waiting for Cameras");
-    WaitForCamera->setText("Cameras found: ");
-    QThread::sleep(3);
-
-    while (returnVal == QMessageBox::Retry) //!< Allows user to refresh list of cameras if they forget to connect a camera before the application launches
+    QSettings settings;
+    QStringList cached = settings.value("Cameras/Addresses").toStringList();
+    if (discover)
+        cached.clear();
+    QElapsedTimer timer;
+    timer.start();
+
+    /// The cameras of the last run are opened straight by address, skipping the discovery broadcast
+    if (!cached.isEmpty())
     {
-        numCameras = PvCameraListEx(info, 2, NULL, sizeof(tPvCameraInfoEx));
-        QThread::msleep(500);
-        QString CamerasFound;
-
-        if (numCameras == 0)
-            CamerasFound = tr("\n");
-        if (numCameras == 1)
-            CamerasFound = tr("%1\n").arg(info[0].CameraName);
-        if (numCameras == 2)
-            CamerasFound = tr("%1\n%2\n").arg(info[0].CameraName, info[1].CameraName);
-
-        WaitForCamera->setInformativeText(CamerasFound);
-        returnVal = WaitForCamera->exec();
+        if (!InitializePv(false))
+            return false;
+        if (Registry.openByAddress(cached) > 0)
+        {
+            std::cout << Registry.count() << " cameras opened by address in " << timer.elapsed() << " ms" << std::endl;
+            return true;
+        }
+        std::cout << "Cameras moved since the last run, looking for them" << std::endl;
+        Registry.uninitialize();
     }
-    delete WaitForCamera;
+    if (!InitializePv(true))
+        return false;
 
-    /// If two cameras are found, opens them
-    if ((numCameras >= 2) && (info[0].PermittedAccess & ePvAccessMaster) && (info[1].PermittedAccess & ePvAccessMaster))
+    /// Only asks the user when cameras seem to be missing
+    QStringList names = Registry.discover(cached.count());
+    if (names.isEmpty() || names.count() < cached.count())
     {
-        Cam1.setID(info[0].UniqueId);
-        Cam1.setCameraName(info[0].CameraName);
+        /// Creates messagebox that shows camera's connected
+        int returnVal = QMessageBox::Retry;
+        QMessageBox* WaitForCamera = new QMessageBox();
+        WaitForCamera->setModal(true);
+        WaitForCamera->setStandardButtons(QMessageBox::Ok | QMessageBox::Retry);
+        WaitForCamera->setDefaultButton(QMessageBox::Ok);
+        WaitForCamera->setWindowTitle("Waiting for Cameras");
+        WaitForCamera->setText("Cameras found: ");
+
+        while (true) //!< Allows user to refresh list of cameras if they forget to connect a camera before the application launches
+        {
+            QString CamerasFound("\n");
 
-        Cam2.setID(info[1].UniqueId);
-        Cam2.setCameraName(info[1].CameraName);
+            if (!names.isEmpty())
+                CamerasFound = names.join("\n") + "\n";
 
-        /// Ensures that Cam1 is a WL cam and Cam2 is an NIR Cam if Two Cameras are connected
-        if (Cam1.GrabHandleFromID() && Cam2.GrabHandleFromID())
-        {
-            if (!Cam1.isWhiteLight() && !Cam2.isNearInfrared())
-            {
-                Camera temp;
-                temp.copyCamera(Cam1);
-                Cam1.copyCamera(Cam2);
-                Cam2.copyCamera(temp);
-            }
-            this->Two_Cameras_Connected = true;
-            return true;
+            WaitForCamera->setInformativeText(CamerasFound);
+            returnVal = WaitForCamera->exec();
+            if (returnVal != QMessageBox::Retry)
+                break;
+            names = Registry.discover(cached.count());
         }
+        delete WaitForCamera;
+        timer.restart();    //!< Time spent in the dialog isn't startup time
+        Startup_Clock.restart();
+    }
+
+    /// Opens every camera found. Roles (WL or NIR) are read from each camera's part number
+    if (Registry.open() == 0)
+        return false;
+    std::cout << Registry.count() << " cameras found and opened in " << timer.elapsed() << " ms" << std::endl;
+
+    settings.setValue("Cameras/Addresses", Registry.addresses());
+    return true;
+}
+
+bool MultiChannelViewer::ConnectToSynthetic(const QStringList &roles)
+{
+    QSettings settings;
+    double fps = settings.value("Synthetic/FPS", 30.0).toDouble();
+    return Registry.openSynthetic(roles, WIDTH, HEIGHT, fps) > 0;
+}
+
+bool MultiChannelViewer::ConnectToReplay(const QStringList &files, const QString &mode)
+{
+    QSettings settings;
+    ReplayMode replay = (mode == "fast") ? ReplayFast : ((mode == "step") ? ReplayStep : ReplayRealTime);
+    if (Registry.openReplay(files, replay, settings.value("Replay/Loop", false).toBool()) == 0)
         return false;
+
+    for (int i = 0; i < Registry.count(); i++)
+        connect(Registry.channel(i)->Cam, SIGNAL(replayFinished(FrameSource*)), this, SLOT(replayFinished(FrameSource*)));
+    Replay_Running = Registry.count();
+    Replay_Clock.start();
+
+    /// Space releases the next frame of every recording
+    if (replay == ReplayStep)
+    {
+        QShortcut* step = new QShortcut(QKeySequence(Qt::Key_Space), this);
+        connect(step, SIGNAL(activated()), this, SLOT(stepReplay()));
+    }
+    return true;
+}
+
+void MultiChannelViewer::stepReplay()
+{
+    for (int i = 0; i < Registry.count(); i++)
+    {
+        ReplaySource* source = qobject_cast<ReplaySource*>(Registry.channel(i)->Cam);
+        if (source)
+            source->step();
+    }
+}
+
+void MultiChannelViewer::replayFinished(FrameSource *source)
+{
+    CameraChannel* channel = Registry.channelOf(source);
+    if (!channel)
+        return;
+
+    /// Delivered frames over wall time is the pipeline's throughput in fast mode
+    CaptureStatistics statistics = source->getStatistics();
+    double seconds = Replay_Clock.nsecsElapsed() / 1e9;
+    std::cout << "Replay of " << channel->Name.toStdString() << " finished: " << statistics.Delivered
+              << " frames in " << seconds << " s (" << ((seconds > 0) ? statistics.Delivered / seconds : 0)
+              << " fps), " << statistics.Skipped << " skipped" << std::endl;
+
+    if (--Replay_Running == 0 && Composite_Pairer)
+        std::cout << "Composite: " << Composite_Pairer->paired() << " paired, "
+                  << Composite_Pairer->unpaired() << " unpaired" << std::endl;
+}
+
+void MultiChannelViewer::attributeApplied(FrameSource *source, QString name, unsigned long value, qint64 requested, FrameInfo info)
+{
+    CameraChannel* channel = Registry.channelOf(source);
+    if (!channel)
+        return;
+
+    /// Arrival of the first frame exposed with the value, so it includes exposure and transfer time
+    double lag = (info.HostTime - requested) / 1000.0;
+    if (name == "ExposureValue")
+    {
+        channel->ExposureLag = lag;
+        return;
     }
-    /// If only one camera is found, opens it
-    if ((numCameras == 1) && (info[0].PermittedAccess & ePvAccessMaster))
+    std::cout << channel->Name.toStdString() << ": " << name.toStdString() << " = " << value
+              << " from frame " << info.FrameCount << ", " << lag << " ms after it was asked for" << std::endl;
+}
+
+void MultiChannelViewer::firstFrame(CameraChannel *channel)
+{
+    channel->FirstFrame = Startup_Clock.elapsed();
+    std::cout << channel->Name.toStdString() << ": first frame " << channel->FirstFrame << " ms after startup" << std::endl;
+}
+
+void MultiChannelViewer::setupDisplays()
+{
+    for (int i = 0; i < Registry.count(); i++)
     {
-        Cam1.setID(info[0].UniqueId);
-        Cam1.setCameraName(info[0].CameraName);
-        if (Cam1.GrabHandleFromID())
+        CameraChannel* channel = Registry.channel(i);
+        if (channel == WL_Channel)
+            channel->Display = ui->cam_1;
+        else if (channel == NIR_Channel)
+            channel->Display = ui->cam_2;
+        else
         {
-            this->Two_Cameras_Connected = false;
-            return true;
+            QLabel* display = new QLabel();
+            display->setWindowTitle(channel->Name);
+            display->resize(WIDTH, HEIGHT);
+            display->show();
+            Extra_Displays.append(display);
+            channel->Display = display;
         }
     }
-    return false;
 }
 
-void MultiChannelViewer::renderFrame_WL_Cam(Camera* cam)
+void MultiChannelViewer::setupComposite()
 {
-    tPvFrame* FramePtr1 = cam->getFramePtr();
-    tPvHandle* CamHandle = cam->getHandle();
+    QSettings settings;
+    QStringList names = settings.value("Composite/Channels").toStringList();
+
+    for (int i = 0; i < names.count(); i++)
+    {
+        CameraChannel* channel = Registry.channelNamed(names[i].trimmed());
+        if (channel && !Composite_Channels.contains(channel))
+            Composite_Channels.append(channel);
+    }
+
+    if (Composite_Channels.isEmpty() && WL_Channel && NIR_Channel)
+    {
+        Composite_Channels.append(WL_Channel);
+        Composite_Channels.append(NIR_Channel);
+    }
+
+    /// The first WL channel is drawn underneath, everything else on top of it
+    for (int i = 1; i < Composite_Channels.count(); i++)
+    {
+        if (Composite_Channels[i]->Role == RoleWhiteLight && Composite_Channels[0]->Role != RoleWhiteLight)
+        {
+            CameraChannel* underlay = Composite_Channels[i];
+            Composite_Channels.remove(i);
+            Composite_Channels.prepend(underlay);
+            break;
+        }
+    }
 
-    unsigned long line_padding = ULONG_PADDING(FramePtr1->Width*3);
-    unsigned long line_size = (FramePtr1->Width*3) + line_padding;
-    unsigned long buffer_size = line_size * FramePtr1->Height;
-    unsigned char* buffer = new unsigned char[buffer_size];
-    unsigned char* bufferPtr = buffer;
+    if (Composite_Channels.count() < 2)
+        Composite_Channels.clear();
 
-    /// RGB frame data from camera is in Bayer 8-bit format. This function converts it to RGB 24-bit.
-    PvUtilityColorInterpolate(FramePtr1, &buffer[0], &buffer[1], &buffer[2], 2, 0);
+    QStringList composite;
+    for (int i = 0; i < Composite_Channels.count(); i++)
+        composite << Composite_Channels[i]->Name;
+    Composite_Name = composite.join("+");
 
-    QImage imgFrame(FramePtr1->Width, FramePtr1->Height, QImage::Format_RGB888);
+    if (Sync_Mode != SyncOff && !Composite_Channels.isEmpty())
+    {
+        double tolerance = settings.value("Sync/Tolerance", PAIRING_TOLERANCE * 1000.0).toDouble() / 1000.0;
+        Composite_Pairer = new FramePairer(Composite_Channels.count(), tolerance);
+    }
+}
+
+void MultiChannelViewer::updateComposite(CameraChannel *channel, const QImage &image, const FrameInfo &info)
+{
+    int stream = Composite_Channels.indexOf(channel);
+    if (stream < 0)
+        return;
 
-    /// Sets corresponding pixels of imgFrame equal to the camera frame data.
-    /// Uses pointer arithmetic to traverse through the frame data.
-    for (int i = 0; i < FramePtr1->Height; i++)
+    if (Composite_Pairer)
+    {
+        FrameGroup group;
+        if (Composite_Pairer->push(stream, image, info, &group))
+            renderFrame_Cam3(group.Images, group.Infos.first());
+    }
+    else if (stream == 0)
     {
-        for (int j = 0; j < FramePtr1->Width; j++)
+        QVector<QImage> images;
+        for (int i = 0; i < Composite_Channels.count(); i++)
         {
-            unsigned char r = *bufferPtr;   //!< R-Pixel
-            bufferPtr++;
-            unsigned char g = *bufferPtr;   //!< G-Pixel
-            bufferPtr++;
-            unsigned char b = *bufferPtr;   //!< B-Pixel
-            bufferPtr++;
-
-            int r_brightcontr = (r*(contrast_WL*0.01) + brightness_WL);
-            int g_brightcontr = (g*(contrast_WL*0.01) + brightness_WL);
-            int b_brightcontr = (b*(contrast_WL*0.01) + brightness_WL);
-
-            if (r_brightcontr > 255) {r_brightcontr = 255;}
-            if (r_brightcontr < 0) {r_brightcontr = 0;}
-            if (g_brightcontr > 255) {g_brightcontr = 255;}
-            if (g_brightcontr < 0) {g_brightcontr = 0;}
-            if (b_brightcontr > 255) {b_brightcontr = 255;}
-            if (b_brightcontr < 0) {b_brightcontr = 0;}
-
-            QRgb color = qRgb(r_brightcontr, g_brightcontr, b_brightcontr);
-            imgFrame.setPixel(j, i, color); //!< Sets pixel with (r,g,b) at location j,i
+            Composite_Channels[i]->Mutex.lock();
+            images.append(Composite_Channels[i]->Image);
+            Composite_Channels[i]->Mutex.unlock();
         }
+        renderFrame_Cam3(images, info);
+    }
+}
+
+void MultiChannelViewer::renderFrame_WL_Cam(FrameSource* cam, FrameBuffer frame, FrameInfo info)
+{
+    CameraChannel* channel = Registry.channelOf(cam);
+    if (channel->FirstFrame < 0)
+        firstFrame(channel);
+
+    /// Both buffers come from preallocated pools, so steady-state streaming does not allocate pixel memory
+    FrameBuffer buffer = this->Interpolation_Pool->acquire();
+    FrameBuffer rgb = this->RGB_Pool->acquire();
+    if (buffer.isNull() || rgb.isNull())
+    {
+        /// Every buffer is still held downstream (e.g. by a stalled autoexposure thread), so this frame is skipped
+        QMetaObject::invokeMethod(cam, "capture", Qt::QueuedConnection);
+        return;
     }
-    imgFrame = imgFrame.mirrored(true, false);  //!< Flips WL image. Needed due to dichroic
-    ui->cam_1->setScaledContents(true);
-    ui->cam_1->setPixmap(QPixmap::fromImage(imgFrame));
-    ui->cam_1->show(); //!< Displays image on Main GUI
+    unsigned char* bufferPtr = buffer.data();
 
-    //Mutex1.lock();
-    //QMutexLocker *Locker = new QMutexLocker(&Mutex1);
-    *Cam1_Image = imgFrame.copy(); //!< Updates latest frame. Mutex in place to prevent race conditions
-    //delete Locker;
-    //Mutex1.unlock();
+    /// RGB frame data from camera is in Bayer 8-bit format. This converts it to RGB 24-bit, stripe by stripe.
+    this->Interpolation_Kernel.run(frame.data(), info.Width, info.Height, info.BayerPattern,
+                                   bufferPtr, info.Width*3 + ULONG_PADDING(info.Width*3), NULL);
+
+    unsigned char* rgbPtr = rgb.data();
+
+    /// A cropped frame only covers part of the view, the rest of it stays black
+    bool cropped = info.Width != WIDTH || info.Height != HEIGHT;
+    if (cropped)
+        memset(rgbPtr, 0, WIDTH*HEIGHT*3);
+
+    /// Sets corresponding pixels of the output frame equal to the camera frame data, with brightness
+    /// and contrast applied. Rows are mirrored (needed due to dichroic) without an extra copy.
+    this->Brightness_Kernel.run(bufferPtr, info.Width, info.Height, rgbPtr, WIDTH,
+                                info.OffsetX, info.OffsetY, brightness_WL, contrast_WL, NULL);
+    QImage imgFrame = rgb.toImage(WIDTH, HEIGHT, WIDTH*3, QImage::Format_RGB888);
+    channel->Display->setScaledContents(true);
+    channel->Display->setPixmap(QPixmap::fromImage(imgFrame));
+    channel->Display->show(); //!< Displays image on GUI
+
+    if (this->Crop_Detector && channel == WL_Channel)
+        detectCrop(channel, frame, info);
+
+    channel->Mutex.lock();
+    channel->Image = imgFrame; //!< Updates latest frame. Shares the pooled buffer instead of copying it
+    channel->Raw = frame;
+    channel->Info = info;
+    channel->Mutex.unlock();
 
     qApp->processEvents(); //!< Process other GUI events
 
-    if (screenshot_cam1) //!< Takes screenshot
+    if (channel->Screenshot) //!< Takes screenshot
     {
         QString timestamp = QDateTime::currentDateTime().toString();
         timestamp.replace(QString(" "), QString("_"));
         timestamp.replace(QString(":"), QString("-"));
-        timestamp.append("_WL.png");
+        timestamp.append("_" + channel->Name + ".png");
         //timestamp = QString("/Screenshot/") + timestamp;
 
 #ifdef _WIN32
@@ -353,50 +568,79 @@ void MultiChannelViewer::renderFrame_WL_Cam(Camera* cam)
         file.open(QIODevice::WriteOnly);
         imgFrame.save(&file, "PNG");
         file.close();
-        screenshot_cam1 = false;
+        channel->Screenshot = false;
     }
     if (recording) //!< Starts recording
     {
-        unsigned char* mirror_buffer;
-        mirror_buffer = imgFrame.bits();
+        const unsigned char* mirror_buffer = imgFrame.constBits();
+
+        /// Recordings may be demosaiced the slower, gradient-corrected way, while the view keeps bilinear
+        FrameBuffer recorded;
+        FrameBuffer demosaiced;
+        if (this->Record_Demosaic != DemosaicBilinear)
+        {
+            demosaiced = this->Interpolation_Pool->acquire();
+            recorded = this->RGB_Pool->acquire();
+        }
+        if (!demosaiced.isNull() && !recorded.isNull())    //!< Else the view's frame is recorded
+        {
+            this->Recording_Kernel.run(frame.data(), info.Width, info.Height, info.BayerPattern,
+                                       demosaiced.data(), info.Width*3 + ULONG_PADDING(info.Width*3), NULL);
+            if (cropped)
+                memset(recorded.data(), 0, WIDTH*HEIGHT*3);
+            this->Brightness_Kernel.run(demosaiced.data(), info.Width, info.Height, recorded.data(), WIDTH,
+                                        info.OffsetX, info.OffsetY, brightness_WL, contrast_WL, NULL);
+            mirror_buffer = recorded.data();
+        }
 
-        for (int i = 0; i < static_cast<int>((this->exposure_WL / 1000000.0)*24 + 1); i++)
-            Video1.WriteFrame(mirror_buffer);
+        /// Frames are placed on the video's timeline by their hardware capture time
+        if (channel->RecordStart < 0)
+            channel->RecordStart = info.timestampSeconds();
+        channel->Video->WriteFrame(mirror_buffer, info.timestampSeconds() - channel->RecordStart);
     }
 
-    if(this->Two_Cameras_Connected)
-        renderFrame_Cam3(); //!< Renders third screen on GUI
-    else
+    updateComposite(channel, imgFrame, info); //!< Renders third screen on GUI
+
+    if (this->autoexpose && !this->Finding_Defects && channel == WL_Channel)
     {
-        if (this->autoexpose)
-            emit SIG_AutoExpose_WL(this->Cam1_Image);
+        if (NIR_Channel)
+        {
+            NIR_Channel->Mutex.lock();
+            FrameBuffer NIR_Raw = NIR_Channel->Raw;
+            FrameInfo NIR_Info = NIR_Channel->Info;
+            NIR_Channel->Mutex.unlock();
+            emit SIG_AutoExpose(imgFrame, NIR_Raw, info, NIR_Info);
+        }
+        else
+            emit SIG_AutoExpose_WL(imgFrame, info);
     }
 
-    delete[] buffer;
-    emit SIG_renderFrame_WL_Cam_Done(); //!< Tells WL camera to capture another frame
+    QMetaObject::invokeMethod(cam, "capture", Qt::QueuedConnection); //!< Tells the camera to capture another frame
 }
 
-void MultiChannelViewer::renderFrame_NIR_Cam(Camera* cam)
+void MultiChannelViewer::renderFrame_NIR_Cam(FrameSource* cam, FrameBuffer frame, FrameInfo info)
 {
-    tPvFrame* FramePtr1 = cam->getFramePtr();
-    tPvHandle* CamHandle = cam->getHandle();
-    //PvAttrUint32Set(*CamHandle, "ExposureValue", this->exposure_NIR);
-
-    unsigned short* rawPtr = static_cast<unsigned short*>(FramePtr1->ImageBuffer);
-
-    int Histogram_NIR[4096] = {0};
-    //int Histogram_NIR[65535] = {0};
-    int pixel_count = 0;
-    //thresh_calibrated = 18;
-    for (int i = 0; i < FramePtr1->Height*FramePtr1->Width; i++)
+    CameraChannel* channel = Registry.channelOf(cam);
+    if (channel->FirstFrame < 0)
+        firstFrame(channel);
+
+    /// Binning keeps the field of view but delivers fewer pixels. Scaling them back up here keeps the
+    /// false coloring, overlay, autoexposure mask and recordings on WIDTH x HEIGHT frames
+    if (info.Width != WIDTH || info.Height != HEIGHT)
+        frame = unbinMono16(frame, info);
+    if (frame.isNull())
     {
-        if (rawPtr[i] > thresh_calibrated)
-        {
-            //unsigned short NIR = static_cast<unsigned short>(rawPtr[i]);
-            Histogram_NIR[rawPtr[i]]++;
-            pixel_count++;
-        }
+        QMetaObject::invokeMethod(cam, "capture", Qt::QueuedConnection); //!< No buffer to scale it into, skipped
+        return;
     }
+    else if (this->Crop_Detector && !WL_Channel && channel == NIR_Channel)
+        detectCrop(channel, frame, info);
+
+    const unsigned short* rawPtr = reinterpret_cast<const unsigned short*>(frame.data());
+
+    int Histogram_NIR[KERNEL_LEVELS];
+    int pixel_count = this->FalseColour_Kernel.histogram(rawPtr, info.Width, info.Height,
+                                                         thresh_calibrated, Histogram_NIR, NULL);
 
     /*int Percent_Cutoff = 0;
     for (int i = 0; i < 4096; i++)
@@ -451,104 +695,38 @@ void MultiChannelViewer::renderFrame_NIR_Cam(Camera* cam)
     }
 
 
-    unsigned char* buffer = new unsigned char[3*FramePtr1->Height*FramePtr1->Width];
-    unsigned char* bufferPtr = buffer;
-
-    QImage imgFrame(FramePtr1->Width, FramePtr1->Height, QImage::Format_RGB888);
-    for (int i = 0; i < FramePtr1->Height; i++)
+    FrameBuffer buffer = this->RGB_Pool->acquire();
+    if (buffer.isNull())
     {
-        for (int j = 0; j < FramePtr1->Width; j++)
-        {
-            unsigned short counts = *rawPtr;
-            unsigned char r;
-            unsigned char g;
-            unsigned char b;
-            if (counts <= thresh1)
-            {
-                r = 0;
-                g = 0;
-                b = 0;
-            }
-            else if (counts <= thresh2)
-            {
-                r = 0;
-                g = 0;
-                b = 255;
-            }
-            else if (counts <= thresh3)
-            {
-                r = 0;
-                g = 255;
-                b = 255;
-            }
-            else if (counts <= thresh4)
-            {
-                r = 0;
-                g = 255;
-                //b = 255*(1-(counts-thresh3)/space);
-                b = 0;
-            }
-            else if (counts <= thresh5)
-            {
-                //r = 255*(counts-thresh4)/space;
-                r = 255;
-                g = 255;
-                b = 0;
-            }
-            else if (counts <= thresh6)
-            {
-                r = 255;
-                g = 0;
-                //g = 255*(1-(counts-thresh5)/space);
-                b = 0;
-            }
-            /*else if (counts <= thresh7)
-            {
-                r = 255;
-                g = 255*(counts-thresh6)/space;
-                b = 255*(counts-thresh6)/space;
-            }*/
-            else
-            {
-                r = 255;
-                g = 255;
-                b = 255;
-            }
-
-            bufferPtr[0] = r;
-            bufferPtr[1] = g;
-            bufferPtr[2] = b;
-            bufferPtr = bufferPtr + 3;
-
-            QRgb color = qRgb(r, g, b);
-            imgFrame.setPixel(j, i, color);
-
-            /*imgFrame.setPixel(2*j, 2*i, color);
-            imgFrame.setPixel(2*j + 1, 2*i, color);
-            imgFrame.setPixel(2*j, 2*i + 1, color);
-            imgFrame.setPixel(2*j + 1, 2*i + 1, color);*/
-            rawPtr++;
-        }
+        QMetaObject::invokeMethod(cam, "capture", Qt::QueuedConnection); //!< Every buffer is still held downstream, skipped
+        return;
     }
-    ui->cam_2->setScaledContents(true);
-    ui->cam_2->setPixmap(QPixmap::fromImage(imgFrame));
-    ui->cam_2->show();
+    int thresholds[6] = {thresh1, thresh2, thresh3, thresh4, thresh5, thresh6};
+    this->FalseColour_Kernel.colour(rawPtr, info.Width, info.Height, thresholds, buffer.data(), NULL);
+
+    QImage imgFrame = buffer.toImage(info.Width, info.Height, info.Width*3, QImage::Format_RGB888);
+    channel->Display->setScaledContents(true);
+    channel->Display->setPixmap(QPixmap::fromImage(imgFrame));
+    channel->Display->show();
 
-    *Cam2_Image = imgFrame;
-    std::memcpy(Cam2_Image_Raw, FramePtr1->ImageBuffer, FramePtr1->ImageBufferSize);
+    channel->Mutex.lock();
+    channel->Image = imgFrame;
+    channel->Raw = frame; //!< Keeps the raw frame alive without copying it
+    channel->Info = info;
+    channel->Mutex.unlock();
 
-    if (!this->Two_Cameras_Connected && this->autoexpose)
-        emit SIG_AutoExpose_NIR(this->Cam2_Image_Raw);
+    if (!WL_Channel && channel == NIR_Channel && this->autoexpose && !this->Finding_Defects)
+        emit SIG_AutoExpose_NIR(frame, info);
 
 
     qApp->processEvents();
 
-    if (screenshot_cam2)
+    if (channel->Screenshot)
     {
         QString timestamp = QDateTime::currentDateTime().toString();
         timestamp.replace(QString(" "), QString("_"));
         timestamp.replace(QString(":"), QString("-"));
-        timestamp.append("_NIR.png");
+        timestamp.append("_" + channel->Name + ".png");
 
 #ifdef _WIN32
         timestamp = QString("Screenshot\\") + timestamp;
@@ -569,81 +747,143 @@ void MultiChannelViewer::renderFrame_NIR_Cam(Camera* cam)
         file.open(QIODevice::WriteOnly);
         imgFrame.save(&file, "PNG");
         file.close();
-        screenshot_cam2 = false;
+        channel->Screenshot = false;
     }
 
     if (recording)
     {
-        for (int i = 0; i < static_cast<int>((this->exposure_NIR / 1000000.0)*24 + 1); i++)
-                Video2.WriteFrame(buffer);
+        if (channel->RecordStart < 0)
+            channel->RecordStart = info.timestampSeconds();
+        channel->Video->WriteFrame(buffer.data(), info.timestampSeconds() - channel->RecordStart);
     }
 
-    //renderFrame_Cam3(); //!< Doesn't need to be called in both render functions.
-
+    updateComposite(channel, imgFrame, info);
 
-    delete[] buffer;
-
-    emit SIG_renderFrame_NIR_Cam_Done();
+    QMetaObject::invokeMethod(cam, "capture", Qt::QueuedConnection);
 }
 
-void MultiChannelViewer::renderFrame_Cam3()
+FrameBuffer MultiChannelViewer::unbinMono16(const FrameBuffer &frame, FrameInfo &info)
 {
-    QImage Cam1_Image_Mono;
-    QPixmap imgFrame(Cam1_Image->size());
-    QPainter p(&imgFrame);
-
-    Mutex1.lock();
-    if (monochrome)
+    FrameBuffer full = this->Mono16_Pool->acquire();
+    if (full.isNull())
+        return full;
+    const unsigned short* src = reinterpret_cast<const unsigned short*>(frame.data());
+    unsigned short* dst = reinterpret_cast<unsigned short*>(full.data());
+
+    /// Part of the view the frame covers. Frames that don't say how they were binned are taken to cover all of it
+    int left = 0;
+    int top = 0;
+    int right = WIDTH;
+    int bottom = HEIGHT;
+    if (info.Binning > 0)
     {
-        Cam1_Image_Mono = Cam1_Image->copy();
-        unsigned char *data = Cam1_Image_Mono.bits();
-        int pixelCount = Cam1_Image_Mono.width() * Cam1_Image_Mono.height();
+        left = qMin((int)info.OffsetX, WIDTH);
+        top = qMin((int)info.OffsetY, HEIGHT);
+        right = qMin(left + (int)(info.Width*info.Binning), WIDTH);
+        bottom = qMin(top + (int)(info.Height*info.Binning), HEIGHT);
+    }
 
-        // Convert each pixel to grayscale
-        for(int i = 0; i < pixelCount; ++i)
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        if (y < top || y >= bottom)
         {
-           int r = data[0];
-           int g = data[1];
-           int b = data[2];
-           int val = qGray(r, g, b); //!< Qt's integrated Grayscale conversion
-
-           data[0] = val; //!< Pointer Arithmetic. Image is 3-byte aligned, each representing R, G, or B.
-           data[1] = val;
-           data[2] = val;
-           data += 3;
+            memset(dst, 0, WIDTH*2);
+            dst += WIDTH;
+            continue;
         }
-        p.drawImage(QPoint(0,0), Cam1_Image_Mono);
+        const unsigned short* row = src + ((y - top) * info.Height / (bottom - top)) * info.Width;
+        for (int x = 0; x < WIDTH; x++)
+            *dst++ = (x < left || x >= right) ? 0 : row[(x - left) * info.Width / (right - left)];
     }
-    else
+
+    info.Width = WIDTH;
+    info.Height = HEIGHT;
+    info.ImageSize = WIDTH*HEIGHT*2;
+    info.OffsetX = 0;
+    info.OffsetY = 0;
+    info.Binning = 1;
+    return full;
+}
+
+void MultiChannelViewer::detectCrop(CameraChannel *channel, const FrameBuffer &frame, const FrameInfo &info)
+{
+    if (this->Crop_Skip > 0)
+    {
+        this->Crop_Skip--;
+        return;
+    }
+    if (!this->Crop_Detector->add(frame, info))
+        return;
+
+    QRect box = this->Crop_Detector->bounds();
+    if (box.isEmpty())
     {
-        p.drawImage(QPoint(0,0), *Cam1_Image);
+        /// Maybe the scope wasn't lit or pointed at anything yet
+        this->Crop_Detector->reset();
+        this->Crop_Skip = CROP_SKIP_FRAMES;
+        if (++this->Crop_Attempts < CROP_ATTEMPTS)
+            return;
+        std::cout << "No image circle found, cameras stream their whole window" << std::endl;
+        delete this->Crop_Detector;
+        this->Crop_Detector = NULL;
+        return;
     }
-    Mutex1.unlock();
+    delete this->Crop_Detector;
+    this->Crop_Detector = NULL;
 
-    Mutex2.lock();
-    unsigned char* cam2_data = Cam2_Image->bits();
-    QImage Cam2_Image_transparency = Cam2_Image->convertToFormat(QImage::Format_ARGB32);
-    QRgb transparent_pixel = qRgba(0,0,0,0);
+    for (int i = 0; i < Registry.count(); i++)
+    {
+        CameraChannel* other = Registry.channel(i);
+        QRect crop = box;
+        if (other != channel)   //!< The WL camera sits behind the dichroic, so its image is mirrored
+            crop = CircleDetector::transfer(box, WIDTH, HEIGHT, (other->Role == RoleWhiteLight) != (channel->Role == RoleWhiteLight));
+        if (other->Cam->setCrop(crop))
+            std::cout << "Cropped " << other->Name.toStdString() << " to the image circle: " << crop.width() << "x" << crop.height()
+                      << " at (" << crop.x() << "," << crop.y() << "), "
+                      << 100 * crop.width() * crop.height() / (WIDTH*HEIGHT) << "% of the window" << std::endl;
+    }
+}
 
-    for (int i = 0; i < Cam2_Image->height(); i++)
+void MultiChannelViewer::renderFrame_Cam3(const QVector<QImage> &images, const FrameInfo &info)
+{
+    bool underlay = (Composite_Channels.first()->Role == RoleWhiteLight);
+    QImage Underlay_Image;
+    QVector<QImage> Overlay_Images;     //!< Latest frame of every channel drawn on top, kept for recording
+    QPixmap imgFrame(QSize(WIDTH, HEIGHT));
+    imgFrame.fill(Qt::black);
+    QPainter p(&imgFrame);
+
+    if (underlay)
     {
-        for (int j = 0; j < Cam2_Image->width(); j++)
+        Underlay_Image = images[0];
+
+        FrameBuffer mono;
+        if (monochrome)
+            mono = this->RGB_Pool->acquire();
+        if (!mono.isNull())     //!< Without a buffer the underlay stays in colour for this frame
         {
-            if (cam2_data[0] == 0 && cam2_data[1] == 0 && cam2_data[2] == 0)
-            {
-                Cam2_Image_transparency.setPixel(j,i,transparent_pixel);
-            }
-            else
-            {
-                QRgb pixel = qRgba(cam2_data[0],cam2_data[1],cam2_data[2],255*opacity_val);
-                Cam2_Image_transparency.setPixel(j,i,pixel);
-            }
-            cam2_data = cam2_data + 3;
+            this->Monochrome_Kernel.run(Underlay_Image.constBits(), mono.data(),
+                                        Underlay_Image.width(), Underlay_Image.height(), NULL);
+            Underlay_Image = mono.toImage(Underlay_Image.width(), Underlay_Image.height(),
+                                          Underlay_Image.width()*3, QImage::Format_RGB888);
         }
+        p.drawImage(QPoint(0,0), Underlay_Image);
     }
-    Mutex2.unlock();
 
-    p.drawImage(QPoint(0,0), Cam2_Image_transparency);
+    for (int k = (underlay) ? 1 : 0; k < images.count(); k++)
+    {
+        QImage Overlay_Image = images[k];
+        Overlay_Images.append(Overlay_Image);
+
+        FrameBuffer overlay = this->ARGB_Pool->acquire();
+        if (overlay.isNull())
+            continue;   //!< Without a buffer this overlay is left out of this frame
+        this->Overlay_Kernel.run(Overlay_Image.constBits(), reinterpret_cast<QRgb*>(overlay.data()),
+                                 Overlay_Image.width(), Overlay_Image.height(), 255*opacity_val, NULL);
+        QImage Overlay_transparency = overlay.toImage(Overlay_Image.width(), Overlay_Image.height(),
+                                                      Overlay_Image.width()*4, QImage::Format_ARGB32);
+        p.drawImage(QPoint(0,0), Overlay_transparency);
+    }
     p.end();
 
     ui->cam_3->setScaledContents(true);
@@ -652,16 +892,12 @@ void MultiChannelViewer::renderFrame_Cam3()
 
     qApp->processEvents();
 
-    if (autoexpose)
-        //QtConcurrent::run(this, &MultiChannelViewer::AutoExposure);
-        emit SIG_AutoExpose(this->Cam1_Image, this->Cam2_Image_Raw);
-
     if (screenshot_cam3)
     {
         QString timestamp = QDateTime::currentDateTime().toString();
         timestamp.replace(QString(" "), QString("_"));
         timestamp.replace(QString(":"), QString("-"));
-        timestamp.append("_WL+NIR.png");
+        timestamp.append("_" + Composite_Name + ".png");
 
 #ifdef _WIN32
         timestamp = QString("Screenshot\\") + timestamp;
@@ -685,28 +921,23 @@ void MultiChannelViewer::renderFrame_Cam3()
         screenshot_cam3 = false;
     }
 
-    if (recording)  //!< Use foreground * alpha + background * (1-alpha)
+    FrameBuffer RGB24;
+    if (recording)
+        RGB24 = this->RGB_Pool->acquire();
+    if (!RGB24.isNull())    //!< Use foreground * alpha + background * (1-alpha). Without a buffer this frame isn't recorded
     {
-        QImage RGB24(WIDTH, HEIGHT, QImage::Format_RGB888);
-        unsigned char* Cam1_Image_ptr = (monochrome) ? Cam1_Image_Mono.bits() : Cam1_Image->bits();
-        unsigned char* Cam2_Image_ptr = Cam2_Image->bits();
-        unsigned char* RGB24_ptr = RGB24.bits();
+        if (underlay)
+            memcpy(RGB24.data(), Underlay_Image.constBits(), WIDTH*HEIGHT*3);
+        else
+            memset(RGB24.data(), 0, WIDTH*HEIGHT*3);
 
-        for (int i = 0; i < WIDTH*HEIGHT; i++)
-        {
-            RGB24_ptr[0] = Cam1_Image_ptr[0] * (1.0
-                                                -opacity_val) + Cam2_Image_ptr[0] * (opacity_val);
-            RGB24_ptr[1] = Cam1_Image_ptr[1] * (1.0-opacity_val) + Cam2_Image_ptr[1] * (opacity_val);
-            RGB24_ptr[2] = Cam1_Image_ptr[2] * (1.0-opacity_val) + Cam2_Image_ptr[2] * (opacity_val);
-            RGB24_ptr += 3;
-            Cam1_Image_ptr += 3;
-            Cam2_Image_ptr += 3;
-        }
+        for (int k = 0; k < Overlay_Images.count(); k++)
+            this->Blend_Kernel.run(Overlay_Images[k].constBits(), RGB24.data(), WIDTH, HEIGHT, 255*opacity_val, NULL);
 
-        //RGB24 = RGB24.convertToFormat(QImage::Format_RGB888);
-        int exposure = (this->exposure_WL < this->exposure_NIR) ? this->exposure_WL : this->exposure_NIR;
-        for (int i = 0; i < static_cast<int>((exposure / 1000000.0)*24 + 1); i++)
-            Video3.WriteFrame(RGB24.bits());
+        /// The third screen is refreshed on frames of its first channel, so it follows that camera's clock
+        if (this->Record_Start_Composite < 0)
+            this->Record_Start_Composite = info.timestampSeconds();
+        Composite_Video.WriteFrame(RGB24.data(), info.timestampSeconds() - this->Record_Start_Composite);
     }
 }
 
@@ -715,8 +946,12 @@ void MultiChannelViewer::calibrate_NIR_thresh(QAbstractButton *button)
     QMessageBox::StandardButton btn = Calibrate_Window->standardButton(button);
     if (btn == QMessageBox::Ok)
     {
-        unsigned short* Image_NIR_data = new unsigned short[HEIGHT*WIDTH];
-        std::memcpy(Image_NIR_data, Cam2_Image_Raw, HEIGHT*WIDTH*2);
+        NIR_Channel->Mutex.lock();
+        FrameBuffer raw = NIR_Channel->Raw; //!< Holds on to the latest raw frame while averaging it
+        NIR_Channel->Mutex.unlock();
+        if (raw.isNull())
+            return;
+        const unsigned short* Image_NIR_data = reinterpret_cast<const unsigned short*>(raw.data());
         unsigned long long sum = 0;
 
         //for (int i = 0; i < HEIGHT*WIDTH; i++)
@@ -731,10 +966,130 @@ void MultiChannelViewer::calibrate_NIR_thresh(QAbstractButton *button)
         int average = sum / ((HEIGHT-1)*(WIDTH-1));
         this->thresh_calibrated = average + 2;
         ui->NIR_Thresh->setValue(thresh_calibrated);
-        delete Image_NIR_data;
     }
 }
 
+void MultiChannelViewer::find_defects(QAbstractButton *button)
+{
+    QMessageBox::StandardButton btn = Calibrate_Window->standardButton(button);
+    if (btn != QMessageBox::Ok || !NIR_Channel)
+        return;
+    FrameSource* cam = NIR_Channel->Cam;
+
+    /// Autoexposure is held off so binning stays off and the exposure stays put while dark frames come in
+    QSettings settings;
+    this->Finding_Defects = true;
+    cam->setBinning(1);
+    cam->findDefects(DEFECT_CALIBRATION_FRAMES, settings.value("Defects/Threshold", DEFECT_THRESHOLD).toInt());
+    ui->statusBar->showMessage(tr("Looking for defective pixels, keep the NIR lens covered"));
+}
+
+void MultiChannelViewer::defectsFound(FrameSource *source, int count)
+{
+    Q_UNUSED(source);
+    this->Finding_Defects = false;
+    applyDefects(NIR_Channel->Cam->getDefects());
+    ui->statusBar->showMessage(tr("%1 defective pixels found, save the parameters to keep them").arg(count));
+}
+
+void MultiChannelViewer::applyDefects(const QVector<QPoint> &defects)
+{
+    if (!NIR_Channel)
+        return;
+    FrameSource* cam = NIR_Channel->Cam;
+    cam->setDefects(defects);
+
+    /// Defects were most of what the median removed, so it stays off with them unless Filter/MedianSize asks for it
+    QSettings settings;
+    if (!settings.contains("Filter/MedianSize"))
+        cam->setMedianSize((defects.isEmpty()) ? FRAMEPROCESSOR_MEDIAN_SIZE : 1);
+}
+
+bool MultiChannelViewer::loadDefects(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= static_cast<qint64>(sizeof(Param)))
+        return false;
+    QDataStream readStream(&file);
+    QVector<QPoint> defects;
+    if (readStream.skipRawData(sizeof(Param)) != sizeof(Param) || !DefectMap::read(readStream, defects))
+        return false;
+    applyDefects(defects);
+    std::cout << defects.count() << " defective pixels loaded from " << fileName.toStdString() << std::endl;
+    return true;
+}
+
+void MultiChannelViewer::updateStatistics()
+{
+    QString message;
+
+    for (int i = 0; i < Registry.count(); i++)
+    {
+        CameraChannel* channel = Registry.channel(i);
+        CaptureStatistics stats = channel->Cam->getStatistics();
+        QString name = channel->Name;
+
+        message.append(tr("%1: %2 frames, %3 dropped, %4 incomplete, %5 skipped, %6 resent, %7 MB/s   ")
+                       .arg(name).arg(stats.Delivered).arg(stats.Dropped + stats.DriverDropped)
+                       .arg(stats.Incomplete).arg(stats.Skipped).arg(stats.PacketsResent)
+                       .arg(Bandwidth.allocation(channel->Cam) / 1000000.0, 0, 'f', 1));
+
+        CaptureStatistics &last = channel->LastStatistics;
+        if (stats.Dropped != last.Dropped || stats.Incomplete != last.Incomplete || stats.DriverDropped != last.DriverDropped)
+        {
+            std::cout << QDateTime::currentDateTime().toString().toStdString() << " " << name.toStdString()
+                      << ": delivered " << stats.Delivered
+                      << ", dropped " << stats.Dropped
+                      << ", incomplete " << stats.Incomplete
+                      << ", driver dropped " << stats.DriverDropped
+                      << ", skipped " << stats.Skipped
+                      << ", packets missed " << stats.PacketsMissed
+                      << ", packets resent " << stats.PacketsResent << std::endl;
+        }
+        if (stats.Reconnects != last.Reconnects)
+        {
+            std::cout << QDateTime::currentDateTime().toString().toStdString() << " " << name.toStdString()
+                      << ": reconnected (" << stats.Reconnects << " so far), streaming again "
+                      << stats.ResumeMs << " ms after the camera came back, "
+                      << stats.OutageMs << " ms after it was lost" << std::endl;
+
+            /// A reconnected camera's clock starts over, its videos carry on from the frames already written
+            channel->RecordStart = -1;
+            if (!Composite_Channels.isEmpty() && channel == Composite_Channels.first())
+                Record_Start_Composite = -1;
+        }
+        last = stats;
+
+        if (channel->ExposureLag >= 0)
+            message.append(tr("%1: exposure lag %2 ms   ").arg(name).arg(channel->ExposureLag, 0, 'f', 0));
+    }
+
+    /// Time to the last camera's first frame, how long the user waited for the program
+    qint64 started = 0;
+    for (int i = 0; i < Registry.count(); i++)
+        started = (Registry.channel(i)->FirstFrame < 0 || started < 0) ? -1 : qMax(started, Registry.channel(i)->FirstFrame);
+    if (started > 0)
+        message.append(tr("streaming %1 ms after startup   ").arg(started));
+
+    /// Frames that found the worker pool busy, which cost latency or parallelism
+    int queued = 0;
+    int alone = 0;
+    for (int kernel = 0; kernel < KernelCount; kernel++)
+    {
+        queued += WorkerPool::shared()->queued(static_cast<ParallelKernel>(kernel));
+        alone += WorkerPool::shared()->ranAlone(static_cast<ParallelKernel>(kernel));
+    }
+    if (queued > 0 || alone > 0)
+        message.append(tr("pool: %1 frames waited, %2 ran alone   ").arg(queued).arg(alone));
+
+    if (Composite_Pairer)
+        message.append(tr("%1: %2 paired, %3 unmatched, skew %4 ms")
+                       .arg(Composite_Name).arg(Composite_Pairer->paired()).arg(Composite_Pairer->unpaired())
+                       .arg(Composite_Pairer->lastSkew() * 1000.0, 0, 'f', 1));
+
+    ui->statusBar->showMessage(message);
+}
+
 /*void writeParameters(QString file_name, Param& data)
 {
   //std::ofstream out(file_name.);
@@ -755,26 +1110,26 @@ void MultiChannelViewer::closeEvent(QCloseEvent *event)
 {
     if (recording)
     {
-        Video1.CloseVideo();
-        Video2.CloseVideo();
-        Video3.CloseVideo();
+        for (int i = 0; i < Registry.count(); i++)
+            Registry.channel(i)->Video->CloseVideo();
+        Composite_Video.CloseVideo();
+        closeRawRecordings();
     }
 
+    Bandwidth.stop();
     QThread::sleep(1);
 
-    thread1.quit();
-    Cam1.captureEnd();
+    Registry.stop();
 
-    if (this->Two_Cameras_Connected)
+    /// Drops the frames still held, so they go back to the camera pools before PvAPI shuts down
+    for (int i = 0; i < Registry.count(); i++)
     {
-        thread2.quit();
-        Cam2.captureEnd();
+        Registry.channel(i)->Raw.reset();
+        Registry.channel(i)->Image = QImage();
     }
-        thread2.quit();
-
-    delete[] Cam2_Image_Raw;
 
-    PvUnInitialize();
+    if (!Offline)
+        Registry.uninitialize();
     QApplication::exit(0);
 }
 
@@ -783,10 +1138,6 @@ void MultiChannelViewer::on_Record_toggled(bool checked)
 {
     if (checked)
     {
-        QString timestamp_filename_WL;
-        QString timestamp_filename_NIR;
-        QString timestamp_filename_WL_NIR;
-
         #ifdef _WIN32
         system("md Video");
         #endif
@@ -795,79 +1146,74 @@ void MultiChannelViewer::on_Record_toggled(bool checked)
         system("mkdir ../../../Video");
         #endif
 
-        if (this->Two_Cameras_Connected || this->Single_Cameras_is_WL)
+        /// One video per camera, named after its channel (_WL, _NIR, _NIR2...), plus one for the third screen
+        for (int i = 0; i <= Registry.count(); i++)
         {
-            timestamp_filename_WL = QDateTime::currentDateTime().toString();
-            timestamp_filename_WL.append("_WL.avi");
-            timestamp_filename_WL.replace(QString(" "), QString("_"));
-            timestamp_filename_WL.replace(QString(":"), QString("-"));
-
-            #ifdef _WIN32
-            timestamp_filename_WL = QString("Video\\") + timestamp_filename_WL;
-            #endif
+            bool composite = (i == Registry.count());
+            if (composite && Composite_Channels.isEmpty())
+                break;
 
-            #ifdef __APPLE__
-            timestamp_filename_WL = QString("../../../Video/") + timestamp_filename_WL;
-            #endif
-
-            char* filename_WL = (char*) timestamp_filename_WL.toStdString().c_str();
-            this->Video1.SetupVideo(filename_WL, 640, 480, 12, 2, 750000); //bitrate = 40000000
-        }
-
-        if (this->Two_Cameras_Connected || !this->Single_Cameras_is_WL)
-        {
-            timestamp_filename_NIR = QDateTime::currentDateTime().toString();
-            timestamp_filename_NIR.append("_NIR.avi");
-            timestamp_filename_NIR.replace(QString(" "), QString("_"));
-            timestamp_filename_NIR.replace(QString(":"), QString("-"));
+            QString timestamp_filename = QDateTime::currentDateTime().toString();
+            timestamp_filename.append("_" + ((composite) ? Composite_Name : Registry.channel(i)->Name) + ".avi");
+            timestamp_filename.replace(QString(" "), QString("_"));
+            timestamp_filename.replace(QString(":"), QString("-"));
 
             #ifdef _WIN32
-            timestamp_filename_NIR = QString("Video\\") + timestamp_filename_NIR;
+            timestamp_filename = QString("Video\\") + timestamp_filename;
             #endif
 
             #ifdef __APPLE__
-            timestamp_filename_NIR = QString("../../../Video/") + timestamp_filename_NIR;
-            #endif
-
-            char* filename_NIR = (char*) timestamp_filename_NIR.toStdString().c_str();
-            this->Video2.SetupVideo(filename_NIR, 640, 480, 12, 2, 750000);
-        }
-
-        if (this->Two_Cameras_Connected)
-        {
-            timestamp_filename_WL_NIR = QDateTime::currentDateTime().toString();
-            timestamp_filename_WL_NIR.append("_WL+NIR.avi");
-            timestamp_filename_WL_NIR.replace(QString(" "), QString("_"));
-            timestamp_filename_WL_NIR.replace(QString(":"), QString("-"));
-
-            #ifdef _WIN32
-            timestamp_filename_WL_NIR = QString("Video\\") + timestamp_filename_WL_NIR;
+            timestamp_filename = QString("../../../Video/") + timestamp_filename;
             #endif
 
-            #ifdef __APPLE__
-            timestamp_filename_WL_NIR = QString("../../../Video/") + timestamp_filename_WL_NIR;
-            #endif
+            std::string filename = timestamp_filename.toStdString();
+            FFMPEG* video = (composite) ? &this->Composite_Video : Registry.channel(i)->Video;
+            video->SetupVideo(const_cast<char*>(filename.c_str()), 640, 480, 12, 2, 750000); //bitrate = 40000000
+            if (!composite)
+                Registry.channel(i)->RecordStart = -1;
 
-            char* filename_WL_NIR = (char*) timestamp_filename_WL_NIR.toStdString().c_str();
-            this->Video3.SetupVideo(filename_WL_NIR, 640, 480, 12, 2, 750000);
+            /// Raw recording takes every frame straight off the capture thread, before any correction or denoising
+            if (!composite && Raw_Recording)
+            {
+                CameraChannel* channel = Registry.channel(i);
+                timestamp_filename.replace(QString(".avi"), QString(".mcvraw"));
+                if (channel->Recorder->open(timestamp_filename, channel->Name))
+                    connect(channel->Cam, SIGNAL(rawFrameReady(FrameSource*,FrameBuffer,FrameInfo)),
+                            channel->Recorder, SLOT(push(FrameSource*,FrameBuffer,FrameInfo)), Qt::DirectConnection);
+            }
         }
 
+        Record_Start_Composite = -1;
         recording = true;
     }
 
     if (!checked)
     {
         recording = false;
-        Video1.CloseVideo();
-        Video2.CloseVideo();
-        Video3.CloseVideo();
+        for (int i = 0; i < Registry.count(); i++)
+            Registry.channel(i)->Video->CloseVideo();
+        Composite_Video.CloseVideo();
+        closeRawRecordings();
+    }
+}
+
+void MultiChannelViewer::closeRawRecordings()
+{
+    for (int i = 0; i < Registry.count(); i++)
+    {
+        CameraChannel* channel = Registry.channel(i);
+        if (!channel->Recorder->isOpen())
+            continue;
+        disconnect(channel->Cam, SIGNAL(rawFrameReady(FrameSource*,FrameBuffer,FrameInfo)),
+                   channel->Recorder, SLOT(push(FrameSource*,FrameBuffer,FrameInfo)));
+        channel->Recorder->close();
     }
 }
 
 void MultiChannelViewer::on_Screenshot_clicked()
 {
-    this->screenshot_cam1 = true;
-    this->screenshot_cam2 = true;
+    for (int i = 0; i < Registry.count(); i++)
+        Registry.channel(i)->Screenshot = true;
     this->screenshot_cam3 = true;
 }
 
@@ -887,32 +1233,30 @@ void MultiChannelViewer::on_opacitySlider_valueChanged(int value)
 void MultiChannelViewer::on_RegionX_WL_valueChanged(int arg1)
 {
     this->region_x_WL = arg1;
-    PvAttrUint32Set(*(Cam1.getHandle()), "RegionX", arg1);
+    if (WL_Channel)
+        WL_Channel->Cam->setAttribute("RegionX", arg1);
 }
 
 void MultiChannelViewer::on_RegionY_WL_valueChanged(int arg1)
 {
     this->region_y_WL = arg1;
-    PvAttrUint32Set(*(Cam1.getHandle()), "RegionY", arg1);
+    if (WL_Channel)
+        WL_Channel->Cam->setAttribute("RegionY", arg1);
 }
 
 void MultiChannelViewer::on_RegionX_NIR_valueChanged(int arg1)
 {
     this->region_x_NIR  = arg1;
-    if (this->Two_Cameras_Connected)
-        PvAttrUint32Set(*(Cam2.getHandle()), "RegionX", arg1);
-    else if (!Single_Cameras_is_WL)
-        PvAttrUint32Set(*(Cam1.getHandle()), "RegionX", arg1);
+    if (NIR_Channel)
+        NIR_Channel->Cam->setAttribute("RegionX", arg1);
     return;
 }
 
 void MultiChannelViewer::on_RegionY_NIR_valueChanged(int arg1)
 {
     this->region_y_NIR = arg1;
-    if (this->Two_Cameras_Connected)
-        PvAttrUint32Set(*(Cam2.getHandle()), "RegionY", arg1);
-    else if (!Single_Cameras_is_WL)
-        PvAttrUint32Set(*(Cam1.getHandle()), "RegionY", arg1);
+    if (NIR_Channel)
+        NIR_Channel->Cam->setAttribute("RegionY", arg1);
     return;
 }
 
@@ -921,57 +1265,38 @@ void MultiChannelViewer::on_AutoExposure_stateChanged(int arg1)
     if (arg1 == Qt::Checked)
     {
         this->autoexpose = true;
-        if (this->Two_Cameras_Connected)
-        {
+        if (WL_Channel)
             ui->WL_Exposure->setReadOnly(true);
+        if (NIR_Channel)
             ui->NIR_Exposure->setReadOnly(true);
-        }
-        else
-        {
-            if (this->Single_Cameras_is_WL)
-                ui->WL_Exposure->setReadOnly(true);
-            if (!this->Single_Cameras_is_WL)
-                ui->NIR_Exposure->setReadOnly(true);
-        }
     }
     if (arg1 == Qt::Unchecked)
     {
         this->autoexpose = false;
-        if (this->Two_Cameras_Connected)
-        {
+        if (WL_Channel)
             ui->WL_Exposure->setReadOnly(false);
+        if (NIR_Channel)
             ui->NIR_Exposure->setReadOnly(false);
-        }
-        else
-        {
-            if (this->Single_Cameras_is_WL)
-                ui->WL_Exposure->setReadOnly(false);
-            if (!this->Single_Cameras_is_WL)
-                ui->NIR_Exposure->setReadOnly(false);
-        }
     }
 }
 
 void MultiChannelViewer::on_WL_Exposure_valueChanged(int arg1)
 {
     this->exposure_control->ChangeExposure_WL(static_cast<unsigned int>(arg1));
-    tPvHandle *cam = Cam1.getHandle();
-    if (cam != NULL)
-        PvAttrUint32Set(*cam, "ExposureValue", arg1);
+    if (WL_Channel)
+        WL_Channel->Cam->setExposure(arg1);
 }
 
 void MultiChannelViewer::on_NIR_Exposure_valueChanged(int arg1)
 {
     this->exposure_control->ChangeExposure_NIR(static_cast<unsigned int>(arg1));
-    tPvHandle *cam;
-    cam = (this->Two_Cameras_Connected) ? this->Cam2.getHandle() : this->Cam1.getHandle();
-    if (cam != NULL)
-        PvAttrUint32Set(*cam, "ExposureValue", arg1);
+    if (NIR_Channel)
+        NIR_Channel->Cam->setExposure(arg1);
 }
 
 void MultiChannelViewer::on_actionCalibrate_NIR_triggered()
 {
-    if (Single_Cameras_is_WL && !Two_Cameras_Connected)
+    if (!NIR_Channel)
     {
         QMessageBox* InvalidMsg = new QMessageBox();
         InvalidMsg->setIcon(QMessageBox::Critical);
@@ -991,6 +1316,28 @@ void MultiChannelViewer::on_actionCalibrate_NIR_triggered()
     Calibrate_Window->open(this, SLOT(calibrate_NIR_thresh(QAbstractButton*)));
 }
 
+void MultiChannelViewer::on_actionFind_Defects_triggered()
+{
+    if (!NIR_Channel)
+    {
+        QMessageBox* InvalidMsg = new QMessageBox();
+        InvalidMsg->setIcon(QMessageBox::Critical);
+        InvalidMsg->setModal(true);
+        InvalidMsg->setText("ERROR: No NIR Camera detected.");
+        InvalidMsg->setAttribute(Qt::WA_DeleteOnClose);
+        InvalidMsg->show();
+        return;
+    }
+    Calibrate_Window = new QMessageBox();
+    Calibrate_Window->setModal(true);
+    Calibrate_Window->setStandardButtons(QMessageBox::Ok | QMessageBox::Cancel);
+    Calibrate_Window->setDefaultButton(QMessageBox::Ok);
+    Calibrate_Window->setWindowTitle(tr("Find Defective Pixels"));
+    Calibrate_Window->setText("This will look for hot and dead pixels of the NIR camera.\nCover the NIR lens completely.");
+    Calibrate_Window->setAttribute(Qt::WA_DeleteOnClose);
+    Calibrate_Window->open(this, SLOT(find_defects(QAbstractButton*)));
+}
+
 void MultiChannelViewer::on_actionAbout_triggered()
 {
     QString title = "MultiChannelViewer Copyright (C) 2016 Michael Rossi";
@@ -1051,6 +1398,12 @@ void MultiChannelViewer::on_actionSave_Parameters_triggered()
         std::cout << "Success\n";
     else
         std::cout << "Failed\n";
+
+    /// The NIR camera's defective pixels follow the Param block, and are loaded again at startup
+    if (NIR_Channel)
+        DefectMap::write(writeStream, NIR_Channel->Cam->getDefects());
+    QSettings settings;
+    settings.setValue("Parameters/File", QFileInfo(file).absoluteFilePath());
     //writeParameters(fileName_std, parameters);
 }
 
@@ -1064,7 +1417,7 @@ void MultiChannelViewer::on_actionLoad_Parameters_triggered()
 
     QFile file(fileName);
     file.open(QIODevice::ReadOnly);
-    if (file.size() != sizeof(Param))
+    if (file.size() < static_cast<qint64>(sizeof(Param)))   //!< Files saved before defect lists end with the Param block
     {
         QMessageBox errBox;
         errBox.critical(0,"Error","File is not a valid Parameter file.");
@@ -1084,7 +1437,7 @@ void MultiChannelViewer::on_actionLoad_Parameters_triggered()
         this->opacity_val = parameters.opacity_val;
         this->region_x_NIR = parameters.region_x_NIR;
         this->region_x_WL = parameters.region_x_WL;
-        this->region_y_NIR - parameters.region_y_NIR;
+        this->region_y_NIR = parameters.region_y_NIR;
         this->region_y_WL = parameters.region_y_WL;
         this->thresh_calibrated = parameters.thresh_calibrated;
 
@@ -1092,6 +1445,12 @@ void MultiChannelViewer::on_actionLoad_Parameters_triggered()
         on_RegionX_WL_valueChanged(parameters.region_x_WL);
         on_RegionY_NIR_valueChanged(parameters.region_y_NIR);
         on_RegionY_WL_valueChanged(parameters.region_y_WL);
+
+        QVector<QPoint> defects;
+        if (!readStream.atEnd() && DefectMap::read(readStream, defects))
+            applyDefects(defects);
+        QSettings settings;
+        settings.setValue("Parameters/File", QFileInfo(file).absoluteFilePath());
     }
     else
     {
@@ -29,6 +29,8 @@
 #define HEIGHT 480
 #define AUTOEXPOSURE_CUTOFF 3000.0
 #define PARAMETER_SIZE 56
+#define CROP_SKIP_FRAMES 30         //!< Frames left for autoexposure to find the light before the image circle is looked for
+#define CROP_ATTEMPTS 3             //!< Times the image circle is looked for before cameras are left uncropped
 
 #ifdef __APPLE__
 #define _OSX
@@ -55,17 +57,25 @@
 #include <QPainter>
 #include <QMutex>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QTimer>
+#include <QSettings>
+#include <QShortcut>
+#include <QElapsedTimer>
 
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
 
-#include <PvAPI/PvApi.h>
-#include <PvAPI/PvRegIo.h>
-
-#include <camera.h>
+#include <cameraregistry.h>
+#include <bandwidthmanager.h>
+#include <framepool.h>
+#include <framepairer.h>
 #include <FFMPEGClass.h>
 #include <autoexpose.h>
+#include <circledetector.h>
+#include <imagekernels.h>
+#include <bayerdemosaic.h>
 
 typedef struct Parameters
 {
@@ -83,6 +93,16 @@ typedef struct Parameters
     int region_y_NIR;
 } Param;
 
+/**
+ * @brief How frames of the composite channels are lined up
+ */
+enum SyncMode
+{
+    SyncOff,            //!< Cameras free-run, the third screen blends whatever each channel showed last
+    SyncPaired,         //!< Cameras free-run, the third screen only blends frames captured within the pairing tolerance
+    SyncTriggered       //!< The WL camera triggers every other camera through SyncOut1/SyncIn1, and frames are paired
+};
+
 namespace Ui {
 class MultiChannelViewer;
 }
@@ -111,91 +131,115 @@ public:
     /**
      * @brief Initializes PvAPI functions
      *
-     * Also prompts users to connect two cameras if two cameras
-     * aren't connected. InitializePv() will "freeze" the thread
-     * if 2 cameras aren't plugged in (The GUI remains operable
-     * but the program will not continue until
-     * 2 cameras are plugged in).
-     *
+     * @param discovery False to skip the discovery broadcast, for cameras opened by address
      * @return True if everything works, false otherwise
      */
-    bool InitializePv();
+    bool InitializePv(bool discovery);
 
     /**
-     * @brief Automatically connects two cameras to Cam1 and Cam2
+     * @brief Opens every camera on the network
      *
-     * ConnectToCam() automatically grabs the first 2 cameras it
-     * sees, then assigns their handles to private members Cam1
-     * and Cam2.
+     * The cameras of the last run (Cameras/Addresses in the settings) are opened by
+     * address without discovery. Otherwise, or if one of them does not answer, the
+     * network is searched. Only if fewer cameras turn up than expected are the cameras
+     * found so far shown, letting the user refresh the list until every camera is
+     * plugged in. Each camera that opens becomes a channel in Registry, WL or NIR
+     * depending on its part number.
      *
-     * @return True if everything works, false otherwise
+     * @param discover True to search the network even if addresses are cached (--discover)
+     * @return True if at least one camera was opened, false otherwise
      */
-    bool ConnectToCam();    //!< TODO: Implement a way of discriminating between NIR and WL cams
-
-signals:
+    bool ConnectToCam(bool discover);
 
     /**
-     * @brief Emitted when frame from Cam1 has finished rendering
+     * @brief Opens synthetic cameras instead of real ones
+     *
+     * Used when the program is started with --synthetic[=WL,NIR,...]. Frames are
+     * WIDTH x HEIGHT, the frame rate is read from Synthetic/FPS in the settings
+     * (0 for as fast as possible).
+     *
+     * @param roles One entry per camera, "WL" or "NIR"
+     * @return True if at least one camera was opened, false otherwise
      */
-    void SIG_renderFrame_WL_Cam_Done();
+    bool ConnectToSynthetic(const QStringList &roles);
 
     /**
-     * @brief Emitted when frame from Cam2 has finished rendering
+     * @brief Plays back raw recordings instead of opening cameras
+     *
+     * Used when the program is started with --replay=file1,file2,... The mode is read
+     * from Replay/Mode in the settings unless --replay-mode is given: "realtime" paces
+     * frames by their recorded timestamps, "fast" runs as fast as the pipeline goes and
+     * "step" releases one frame per press of the space bar.
+     *
+     * @param files Raw recordings (.mcvraw)
+     * @param mode "realtime", "fast" or "step"
+     * @return True if at least one recording was opened, false otherwise
      */
-    void SIG_renderFrame_NIR_Cam_Done();
+    bool ConnectToReplay(const QStringList &files, const QString &mode);
+
+signals:
 
     /**
      * @brief Emitted when Autoexposure for both cams needs to be called
      */
-    void SIG_AutoExpose(QImage *WL_Image, unsigned char* NIR_Raw_Image);
+    void SIG_AutoExpose(QImage WL_Image, FrameBuffer NIR_Raw_Image, FrameInfo WL_Info, FrameInfo NIR_Info);
 
     /**
      * @brief Emitted when Autoexposure for single WL cam needs to be called
      */
-    void SIG_AutoExpose_WL(QImage *WL_Image);
+    void SIG_AutoExpose_WL(QImage WL_Image, FrameInfo WL_Info);
 
     /**
      * @brief Emitted when Autoexposure for single NIR cam needs to be called
      */
-    void SIG_AutoExpose_NIR(unsigned char* NIR_Raw_Image);
+    void SIG_AutoExpose_NIR(FrameBuffer NIR_Raw_Image, FrameInfo NIR_Info);
 
 public slots:
 
     /**
-     * @brief Displays 24-bit RGB frame from WL Cam1 in Main GUI
+     * @brief Displays 24-bit RGB frame from a WL camera
      *
-     * renderFrame_WL_Cam() is intended for the white light camera.
+     * renderFrame_WL_Cam() is intended for the white light cameras.
      * This function assumes that the original frame format is
      * 8-bit Bayer. It then automatically interpolates to 24-bit RGB
-     * before displaying to screen.
+     * before displaying it in the camera's channel display. Once done it
+     * asks the same camera for its next frame.
      *
-     * @param cam (Pointer to Cam1)
+     * @param cam Camera the frame came from
+     * @param frame Raw Bayer 8-bit frame
+     * @param info Metadata of frame
      */
-    void renderFrame_WL_Cam(Camera *cam);
+    void renderFrame_WL_Cam(FrameSource *cam, FrameBuffer frame, FrameInfo info);
 
     /**
-     * @brief Displays 24-bit RGB from NIR Cam2 in Main GUI
+     * @brief Displays 24-bit RGB from a NIR camera
      *
-     * renderFrame_NIR_Cam() is intended for the near-infrared (NIR) camera.
+     * renderFrame_NIR_Cam() is intended for the near-infrared (NIR) cameras.
      * This function assumes that the original frame format is
      * 16-bit Mono. It then applies a False coloring transformation
      * based of the intensities of the values, before displaying to
-     * screen as 24-bit RGB.
+     * screen as 24-bit RGB. Once done it asks the same camera for its next frame.
+     * Binned frames are first scaled back up to WIDTH x HEIGHT.
      *
-     * @param cam (Pointer to Cam2)
+     * @param cam Camera the frame came from
+     * @param frame Raw 16-bit Mono frame
+     * @param info Metadata of frame
      */
-    void renderFrame_NIR_Cam(Camera *cam);
+    void renderFrame_NIR_Cam(FrameSource *cam, FrameBuffer frame, FrameInfo info);
 
     /**
-     * @brief Displays 32-bit RGBA from a combined image of WL Cam1 and NIR Cam2 in Main GUI
+     * @brief Displays 32-bit RGBA from a combined image of the composite channels in Main GUI
      *
      * renderFrame_Cam3() is intended for rendering the third screen.
      * Even though the function has Cam in it, there is no third camera attached.
-     * This function renders the third screen, which is the latest NIR Cam2 image
-     * on top of the latest WL Cam1 image (transparency layer).
+     * This function renders the third screen, which is the image of every
+     * channel in Composite_Channels laid as a transparency layer on top of the
+     * first one (a WL camera, when the composite has one).
      *
+     * @param images Rendered image of each composite channel, in Composite_Channels order
+     * @param info Metadata of the first image, places the frame on the recording's timeline
      */
-    void renderFrame_Cam3();
+    void renderFrame_Cam3(const QVector<QImage> &images, const FrameInfo &info);
 
     /**
      * @brief Automatically sets the NIR False-coloring cutoff threshold
@@ -209,6 +253,49 @@ public slots:
      */
     void calibrate_NIR_thresh(QAbstractButton* button);
 
+    /**
+     * @brief Has the NIR camera look for defective pixels in the next dark frames
+     *
+     * Called when the window opened by on_actionFind_Defects_triggered() is closed. Autoexposure
+     * is held off and binning turned off until defectsFound() comes back.
+     *
+     * @param button QAbstractButton passed from on_actionFind_Defects_triggered() slot
+     */
+    void find_defects(QAbstractButton* button);
+
+    /**
+     * @brief Starts correcting the defects the NIR camera found, and lets autoexposure run again
+     */
+    void defectsFound(FrameSource* source, int count);
+
+    /**
+     * @brief Shows each camera's frame counters in the status bar
+     *
+     * Called once a second by Statistics_Timer. Whenever a camera loses frames a line is
+     * also written to the log, telling link losses (dropped/incomplete/resent) apart from
+     * a host that can't keep up (driver drops/skipped). Reconnects are logged with the
+     * time it took to resume streaming.
+     */
+    void updateStatistics();
+
+    /**
+     * @brief Releases the next frame of every recording being replayed in step mode
+     */
+    void stepReplay();
+
+    /**
+     * @brief Logs how long a recording took to play back, and how many of its frames were shown
+     */
+    void replayFinished(FrameSource* source);
+
+    /**
+     * @brief Notes when a queued camera setting reached the frames
+     *
+     * Exposure changes come many times a second from autoexposure, so their latency is only
+     * shown in the status bar. Other settings (region, bandwidth) are logged.
+     */
+    void attributeApplied(FrameSource* source, QString name, unsigned long value, qint64 requested, FrameInfo info);
+
 protected:
     void closeEvent(QCloseEvent *event);
 
@@ -237,6 +324,8 @@ private slots:  /// GUI related functions
 
     void on_actionCalibrate_NIR_triggered();
 
+    void on_actionFind_Defects_triggered();
+
     void on_actionAbout_triggered();
 
     void on_NIR_Thresh_valueChanged(int arg1);
@@ -250,30 +339,115 @@ private slots:  /// GUI related functions
     void on_actionLoad_Parameters_triggered();
 
 private:
-    Ui::MultiChannelViewer *ui;
-    Camera Cam1;                    //!< White Light Camera
-    Camera Cam2;                    //!< Near Infrared Camera
-    bool Two_Cameras_Connected;     //!< True if two cameras are connected, false otherwise
-    bool Single_Cameras_is_WL;      //!< True if one camera is connected and is WL, false otherwise
 
-    QImage* Cam1_Image;             //!< WL Cam frame data for third screen
-    QImage* Cam2_Image;             //!< NIR Cam frame data for third screen (False colorized)
-    unsigned char* Cam2_Image_Raw;  //!< NIR Cam raw frame date (16-bit monochrome)
+    /**
+     * @brief Gives each channel somewhere to show its frames
+     *
+     * The primary WL and NIR channels use the main window's cam_1 and cam_2,
+     * every other channel gets a window of its own.
+     */
+    void setupDisplays();
+
+    /**
+     * @brief Picks the channels blended into the third screen
+     *
+     * Reads the channel names listed under Composite/Channels in the settings
+     * (e.g. "WL,NIR,NIR2"), and falls back to the primary WL and NIR channels.
+     * A WL channel, if there is one, is moved to the front to act as the underlay.
+     * Fewer than two channels disable the third screen.
+     */
+    void setupComposite();
+
+    /**
+     * @brief Stops every channel's raw recording and writes its frame index
+     */
+    void closeRawRecordings();
+
+    /**
+     * @brief Scales a binned Mono16 frame back up to WIDTH x HEIGHT by repeating its pixels
+     *
+     * A cropped frame is put back where it sits in the view, the rest is left black.
+     *
+     * @param frame Binned or cropped frame
+     * @param info Metadata of frame, updated to describe the returned frame
+     * @return Full size frame from Mono16_Pool, or a null handle if the pool is exhausted (info is left alone then)
+     */
+    FrameBuffer unbinMono16(const FrameBuffer &frame, FrameInfo &info);
+
+    /**
+     * @brief Looks for the endoscope's image circle and crops every camera to it (Crop/Auto)
+     *
+     * Fed with the frames of the channel the circle is looked for in, WL if there is one.
+     * Other cameras get the same box, mirrored if they sit on the other side of the
+     * dichroic and grown a little (see CircleDetector::transfer()).
+     */
+    void detectCrop(CameraChannel* channel, const FrameBuffer &frame, const FrameInfo &info);
+
+    /**
+     * @brief Logs how long after startup a channel's first frame arrived
+     */
+    void firstFrame(CameraChannel* channel);
+
+    /**
+     * @brief Hands a channel's freshly rendered frame to the third screen
+     *
+     * Without synchronisation the third screen is redrawn on each frame of the first composite
+     * channel, with whatever the other channels showed last. With synchronisation the frame goes
+     * through Composite_Pairer and the third screen is only redrawn for matched frames.
+     */
+    void updateComposite(CameraChannel* channel, const QImage &image, const FrameInfo &info);
 
-    QThread thread1;                //!< WL Cam streaming thread
-    QThread thread2;                //!< NIR Cam streaming thread
+    /**
+     * @brief Has the NIR camera correct these defective pixels
+     *
+     * Unless Filter/MedianSize is set, the median filter is turned off while there are defects
+     * to correct, and back on when there are none.
+     */
+    void applyDefects(const QVector<QPoint> &defects);
 
-    QMutex Mutex1;                  //!< WL Cam Mutex (for Cam1_Image)
-    QMutex Mutex2;                  //!< NIR Cam Mutex (for Cam2_Image and Cam2_Image_Raw)
+    /**
+     * @brief Applies the defect list of a parameter file, see applyDefects()
+     * @return false if the file can't be read or was saved without a defect list
+     */
+    bool loadDefects(const QString &fileName);
 
-    FFMPEG Video1;                  //!< WL Video Encoder
-    FFMPEG Video2;                  //!< NIR Video Encoder
-    FFMPEG Video3;                  //!< WL+NIR Video Encoder
+    Ui::MultiChannelViewer *ui;
+    CameraRegistry Registry;        //!< Every open camera, with its thread, encoder and latest frame
+    CameraChannel* WL_Channel;      //!< First WL camera, drives the WL controls. NULL if there is none
+    CameraChannel* NIR_Channel;     //!< First NIR camera, drives the NIR controls. NULL if there is none
+    QVector<CameraChannel*> Composite_Channels; //!< Channels blended into the third screen, underlay first
+    QString Composite_Name;         //!< Names of Composite_Channels joined by '+', used in file names
+    QVector<QLabel*> Extra_Displays;//!< Windows of channels that don't fit in the main window
+    bool Offline;                   //!< True when running on synthetic cameras or recordings, PvAPI is then never initialized
+    int Replay_Running;             //!< Recordings still playing back
+    QElapsedTimer Replay_Clock;     //!< Started with the replay, times its throughput
+    QElapsedTimer Startup_Clock;    //!< Started when the window is created, times the first frames
+    SyncMode Sync_Mode;             //!< Read from Sync/Mode in the settings ("off", "paired" or "triggered")
+    FramePairer* Composite_Pairer;  //!< Lines up composite frames by capture time. NULL when Sync_Mode is SyncOff
+    CircleDetector* Crop_Detector;  //!< Looks for the image circle when Crop/Auto is set. NULL when off or done
+    int Crop_Skip;                  //!< Frames still to skip before Crop_Detector is fed
+    int Crop_Attempts;              //!< Times the image circle was looked for without success
+
+    FramePool* Interpolation_Pool;  //!< Buffers for Bayer to RGB interpolation
+    FramePool* RGB_Pool;            //!< Buffers for rendered 24-bit RGB frames
+    FramePool* ARGB_Pool;           //!< Buffers for the third screen's NIR transparency layer
+    FramePool* Mono16_Pool;         //!< Buffers for binned or cropped NIR frames brought back to full size
+
+    BayerDemosaic Interpolation_Kernel;         //!< WL Bayer to RGB, spread over WorkerPool::shared()
+    BayerDemosaic Recording_Kernel;             //!< WL Bayer to RGB for recordings, when Record_Demosaic isn't bilinear
+    BrightnessContrast Brightness_Kernel;       //!< WL brightness and contrast
+    FalseColour FalseColour_Kernel;             //!< NIR histogram and false colouring
+    Monochrome Monochrome_Kernel;               //!< Third screen's monochrome underlay
+    OverlayAlpha Overlay_Kernel;                //!< Third screen's transparency layers
+    OverlayBlend Blend_Kernel;                  //!< Third screen's overlays blended into recorded frames
+
+    FFMPEG Composite_Video;         //!< Third screen Video Encoder (each channel has its own encoder)
 
     bool recording;                 //!< Set to true when Video Encoders are recording
+    bool Raw_Recording;             //!< Read from Recording/Raw in the settings, also record every channel's sensor data losslessly
+    DemosaicMethod Record_Demosaic; //!< Read from Recording/Demosaic in the settings, how recorded WL frames are demosaiced
+    double Record_Start_Composite;  //!< Capture time (s) of the first frame in Composite_Video, -1 before it arrives
 
-    bool screenshot_cam1;           //!< Set to true when screenshotting cam1
-    bool screenshot_cam2;           //!< Set to true when screenshotting cam2
     bool screenshot_cam3;           //!< Set to true when screenshotting thirdscreen
 
     int thresh_calibrated;
@@ -294,6 +468,10 @@ private:
     int region_y_NIR;               //!< Y-coordinate of topleft pixel for NIR cam
 
     QMessageBox* Calibrate_Window;
+    bool Finding_Defects;           //!< True while the NIR camera looks for defective pixels, autoexposure is held off
+
+    QTimer Statistics_Timer;        //!< Refreshes the frame counters shown in the status bar
+    BandwidthManager Bandwidth;     //!< Shares the GigE link between every camera
 };
 
 #endif // MULTICHANNELVIEWER_H
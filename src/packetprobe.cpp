@@ -0,0 +1,104 @@
+#include "packetprobe.h"
+
+#include <iostream>
+
+/// Jumbo sizes first, then the sizes common switches and NICs cap at, then plain Ethernet
+static const unsigned long PacketCandidates[] = {9000, 8228, 8000, 7000, 6000, 4000, 3000, 2000, PACKET_STANDARD_MTU};
+
+unsigned long PacketProbeResult::packetsPerFrame(unsigned long frameSize) const
+{
+    if (this->Payload == 0)
+        return 0;
+    return (frameSize + this->Payload - 1) / this->Payload;
+}
+
+MockPacketPath::MockPacketPath(unsigned long mtu, bool negotiates)
+{
+    this->Mtu = mtu;
+    this->Negotiates = negotiates;
+    this->Current = PACKET_STANDARD_MTU;
+    this->Requests = 0;
+}
+
+bool MockPacketPath::adjust(unsigned long maximum)
+{
+    this->Requests++;
+    if (maximum > this->Mtu)
+    {
+        if (!this->Negotiates)
+            return false;
+        maximum = this->Mtu;
+    }
+    this->Current = maximum;
+    return true;
+}
+
+unsigned long MockPacketPath::packetSize()
+{
+    return this->Current;
+}
+
+int MockPacketPath::requests() const
+{
+    return this->Requests;
+}
+
+PacketProbeResult PacketProbe::probe(PacketPath &path)
+{
+    PacketProbeResult result;
+    result.PacketSize = 0;
+    result.Fallback = false;
+    result.Attempts = 0;
+
+    int count = sizeof(PacketCandidates) / sizeof(PacketCandidates[0]);
+    for (int i = 0; i < count && result.PacketSize == 0; i++)
+    {
+        result.Attempts++;
+        if (!path.adjust(PacketCandidates[i]))
+            continue;
+
+        /// The driver may settle below the candidate, but a size it didn't clamp is suspect
+        unsigned long size = path.packetSize();
+        if (size >= PACKET_STANDARD_MTU && size <= PacketCandidates[i])
+            result.PacketSize = size;
+    }
+
+    if (result.PacketSize == 0)
+    {
+        path.adjust(PACKET_STANDARD_MTU);
+        result.PacketSize = PACKET_STANDARD_MTU;
+        result.Fallback = true;
+    }
+
+    result.Payload = result.PacketSize - PACKET_OVERHEAD;
+    result.Jumbo = result.PacketSize > PACKET_STANDARD_MTU;
+    return result;
+}
+
+bool PacketProbe::check()
+{
+    struct Case { const char* Name; unsigned long Mtu; bool Negotiates; unsigned long Expected; bool Fallback; };
+    const Case cases[] = {
+        {"jumbo 9000, negotiating", 9000, true, 9000, false},
+        {"jumbo 8228, negotiating", 8228, true, 8228, false},
+        {"jumbo 7500, negotiating", 7500, true, 7500, false},
+        {"4000, not negotiating", 4000, false, 4000, false},
+        {"1500 only, negotiating", PACKET_STANDARD_MTU, true, PACKET_STANDARD_MTU, false},
+        {"1500 only, not negotiating", PACKET_STANDARD_MTU, false, PACKET_STANDARD_MTU, false},
+        {"1000, not negotiating", 1000, false, PACKET_STANDARD_MTU, true}
+    };
+
+    bool passed = true;
+    std::cout << "Packet size probe on simulated paths" << std::endl;
+    for (unsigned int i = 0; i < sizeof(cases)/sizeof(cases[0]); i++)
+    {
+        MockPacketPath path(cases[i].Mtu, cases[i].Negotiates);
+        PacketProbeResult result = probe(path);
+        bool right = result.PacketSize == cases[i].Expected && result.Fallback == cases[i].Fallback
+                && path.packetSize() == result.PacketSize;
+        passed = passed && right;
+        std::cout << "  " << cases[i].Name << ": " << result.PacketSize << " bytes after " << result.Attempts
+                  << " attempts" << ((result.Fallback) ? ", fallback" : "") << ((right) ? "" : ", WRONG") << std::endl;
+    }
+    return passed;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The PacketProbe class finds the largest GigE Vision stream packet that
+ * makes it from a camera to the host. It starts at jumbo sizes and works
+ * down a list of candidates until the driver settles on one. If none of them
+ * work it falls back to the standard 1500 byte Ethernet MTU. Fewer, larger
+ * packets mean fewer interrupts and less CPU time per frame.
+ *
+ * The probe talks to the network through PacketPath, so it can run against
+ * MockPacketPath as well as against a real camera (PvPacketPath, see
+ * Camera), and needs nothing from PvAPI itself.
+ */
+
+#ifndef PACKETPROBE_H
+#define PACKETPROBE_H
+
+#define PACKET_STANDARD_MTU 1500    //!< Ethernet MTU every GigE path supports
+#define PACKET_OVERHEAD 36          //!< IP (20) + UDP (8) + GVSP (8) header bytes in every stream packet
+
+/**
+ * @brief Outcome of a packet size probe
+ */
+struct PacketProbeResult
+{
+    unsigned long   PacketSize;     //!< Negotiated stream packet size, which is also the MTU the path needs
+    unsigned long   Payload;        //!< Image bytes carried by each packet (PacketSize - PACKET_OVERHEAD)
+    bool            Jumbo;          //!< True if PacketSize is above PACKET_STANDARD_MTU
+    bool            Fallback;       //!< True if every candidate failed and the standard MTU was forced
+    int             Attempts;       //!< Number of candidates tried
+
+    /**
+     * @brief Gets the number of packets needed to send frameSize bytes
+     */
+    unsigned long packetsPerFrame(unsigned long frameSize) const;
+};
+
+/**
+ * @brief The part of the network path the probe needs
+ */
+class PacketPath
+{
+public:
+    virtual ~PacketPath() {}
+
+    /**
+     * @brief Asks the driver for the largest packet size not above maximum
+     * @return true if a packet size was negotiated
+     */
+    virtual bool adjust(unsigned long maximum) = 0;
+
+    /**
+     * @brief Reads back the packet size currently in use
+     */
+    virtual unsigned long packetSize() = 0;
+};
+
+/**
+ * @brief Simulated network path, for exercising the probe without hardware
+ *
+ * Packets up to the path's MTU get through. Above it a negotiating path clamps the
+ * packet size, the way PvCaptureAdjustPacketSize() does, and a non-negotiating path
+ * fails the request outright, the way a misconfigured switch looks to the driver.
+ */
+class MockPacketPath : public PacketPath
+{
+public:
+
+    /**
+     * @param mtu Largest packet the simulated path carries
+     * @param negotiates True to clamp oversized requests, false to fail them
+     */
+    MockPacketPath(unsigned long mtu, bool negotiates = true);
+
+    bool adjust(unsigned long maximum);
+    unsigned long packetSize();
+
+    int requests() const;           //!< Number of adjust() calls so far
+
+private:
+    unsigned long   Mtu;            //!< Simulated path MTU
+    bool            Negotiates;     //!< Clamp (true) or fail (false) oversized requests
+    unsigned long   Current;        //!< Packet size last negotiated
+    int             Requests;       //!< adjust() calls so far
+};
+
+class PacketProbe
+{
+public:
+
+    /**
+     * @brief Finds the largest packet size path supports
+     *
+     * Candidates are tried from the largest down. A candidate is accepted when the
+     * driver negotiates a size no larger than it, and no smaller than the standard MTU.
+     * If every candidate fails the path is forced to PACKET_STANDARD_MTU.
+     */
+    static PacketProbeResult probe(PacketPath &path);
+
+    /**
+     * @brief Runs probe() against simulated paths and checks the size it settles on
+     *
+     * Covers jumbo paths that negotiate, a path that fails oversized requests instead of
+     * clamping them, a 1500-only path and one too small for any candidate. Prints the
+     * results to std::cout. Run with --check-packet-probe.
+     *
+     * @return true if every path got the expected packet size
+     */
+    static bool check();
+};
+
+#endif // PACKETPROBE_H
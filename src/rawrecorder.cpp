@@ -0,0 +1,456 @@
+#include "rawrecorder.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+/// Rounds value up to a multiple of alignment
+static quint64 alignUp(quint64 value, quint64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+RawRecorder::RawRecorder(QObject *parent) : QThread(parent)
+{
+    this->ChunkSize = RAW_CHUNK_SIZE;
+    this->Chunk = 0;
+    this->ChunkData = NULL;
+    this->ChunkUsed = 0;
+    this->Allocated = 0;
+    this->Stopping = false;
+    this->Open = false;
+    memset(&this->Statistics, 0, sizeof(RawRecorderStatistics));
+}
+
+RawRecorder::~RawRecorder()
+{
+    close();
+}
+
+bool RawRecorder::open(const QString &filename, const QString &cameraName, quint64 chunkSize)
+{
+    close();
+
+    this->ChunkSize = alignUp(qMax(chunkSize, (quint64)RAW_CHUNK_GRANULARITY), RAW_CHUNK_GRANULARITY);
+    this->Chunk = 0;
+    this->ChunkData = NULL;
+    this->ChunkUsed = RAW_HEADER_SIZE;
+    this->Allocated = 0;
+    this->Index.clear();
+    this->Stopping = false;
+    memset(&this->Statistics, 0, sizeof(RawRecorderStatistics));
+
+    this->File.setFileName(filename);
+    if (!this->File.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        std::cout << "Cannot create raw recording " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    RawFileHeader header;
+    memset(&header, 0, sizeof(RawFileHeader));
+    memcpy(header.Magic, RAW_FILE_MAGIC, sizeof(header.Magic));
+    header.Version = RAW_VERSION;
+    header.HeaderSize = RAW_HEADER_SIZE;
+    header.ChunkSize = this->ChunkSize;
+    header.StartTime = hostTimeUs();
+    strncpy(header.CameraName, cameraName.toStdString().c_str(), sizeof(header.CameraName) - 1);
+
+    /// Header goes in through the file, the first chunk's mapping then covers it as well
+    if (this->File.write(reinterpret_cast<const char*>(&header), sizeof(RawFileHeader)) != sizeof(RawFileHeader)
+            || !mapChunk(0))
+    {
+        this->File.close();
+        return false;
+    }
+
+    this->Open = true;
+    start();
+    return true;
+}
+
+void RawRecorder::close()
+{
+    QMutexLocker locker(&this->QueueMutex);
+    if (!this->Open)
+        return;
+    this->Open = false;
+    this->Stopping = true;
+    this->QueueCondition.wakeAll();
+    locker.unlock();
+
+    wait();
+
+    if (this->ChunkData != NULL)
+    {
+        this->File.unmap(this->ChunkData);
+        this->ChunkData = NULL;
+    }
+
+    /// Drop the unused preallocated space, then put the index right after the last record
+    quint64 end = this->Chunk * this->ChunkSize + this->ChunkUsed;
+    this->File.resize(end);
+    this->File.seek(end);
+    if (!this->Index.isEmpty())
+        this->File.write(reinterpret_cast<const char*>(this->Index.constData()),
+                         this->Index.count() * sizeof(RawIndexEntry));
+
+    RawIndexTrailer trailer;
+    memset(&trailer, 0, sizeof(RawIndexTrailer));
+    memcpy(trailer.Magic, RAW_INDEX_MAGIC, sizeof(trailer.Magic));
+    trailer.Count = this->Index.count();
+    trailer.IndexOffset = end;
+    this->File.write(reinterpret_cast<const char*>(&trailer), sizeof(RawIndexTrailer));
+
+    quint64 frames = this->Index.count();
+    this->File.seek(offsetof(RawFileHeader, FrameCount));
+    this->File.write(reinterpret_cast<const char*>(&frames), sizeof(frames));
+    this->File.close();
+
+    RawRecorderStatistics statistics = getStatistics();
+    std::cout << "Raw recording closed: " << statistics.Written << " frames, "
+              << statistics.Dropped << " dropped, queue peak " << statistics.QueuePeak << std::endl;
+    this->Index.clear();
+}
+
+bool RawRecorder::isOpen()
+{
+    QMutexLocker locker(&this->QueueMutex);
+    return this->Open;
+}
+
+RawRecorderStatistics RawRecorder::getStatistics()
+{
+    QMutexLocker locker(&this->QueueMutex);
+    return this->Statistics;
+}
+
+void RawRecorder::push(FrameSource *source, FrameBuffer frame, FrameInfo info)
+{
+    Q_UNUSED(source);
+
+    QMutexLocker locker(&this->QueueMutex);
+    if (!this->Open || frame.isNull())
+        return;
+    if (this->Queue.count() >= RAW_QUEUE_DEPTH)
+    {
+        this->Statistics.Dropped++;
+        return;
+    }
+
+    PendingFrame pending;
+    pending.Frame = frame;
+    pending.Info = info;
+    this->Queue.enqueue(pending);
+    if ((unsigned long)this->Queue.count() > this->Statistics.QueuePeak)
+        this->Statistics.QueuePeak = this->Queue.count();
+    this->QueueCondition.wakeOne();
+}
+
+void RawRecorder::run()
+{
+    while (true)
+    {
+        QMutexLocker locker(&this->QueueMutex);
+        while (this->Queue.isEmpty() && !this->Stopping)
+            this->QueueCondition.wait(&this->QueueMutex);
+        if (this->Queue.isEmpty())
+            break;  //!< Stopping and nothing left to write
+        PendingFrame pending = this->Queue.dequeue();
+        locker.unlock();
+
+        /// The copy runs without the lock, so push() never waits on the disk
+        quint64 before = this->Chunk * this->ChunkSize + this->ChunkUsed;
+        bool written = writeFrame(pending);
+        pending.Frame.reset();  //!< Hand the buffer back to its pool straight away
+
+        locker.relock();
+        if (written)
+        {
+            this->Statistics.Written++;
+            this->Statistics.Bytes += this->Chunk * this->ChunkSize + this->ChunkUsed - before;
+        }
+        else
+            this->Statistics.Dropped++;
+    }
+}
+
+bool RawRecorder::writeFrame(const PendingFrame &pending)
+{
+    quint64 payload = qMin((quint64)pending.Info.ImageSize, (quint64)pending.Frame.size());
+    quint64 record = alignUp(sizeof(RawFrameHeader) + payload, RAW_RECORD_ALIGNMENT);
+    if (record > this->ChunkSize - RAW_HEADER_SIZE)
+        return false;  //!< Would not fit even in an empty chunk
+
+    if (this->ChunkData == NULL || this->ChunkUsed + record > this->ChunkSize)
+    {
+        quint64 next = (this->ChunkData == NULL) ? this->Chunk : this->Chunk + 1;
+        if (!mapChunk(next))
+            return false;
+    }
+
+    RawFrameHeader header;
+    memset(&header, 0, sizeof(RawFrameHeader));
+    header.Magic = RAW_FRAME_MAGIC;
+    header.PayloadSize = payload;
+    header.Timestamp = pending.Info.Timestamp;
+    header.HostTime = pending.Info.HostTime;
+    header.TimestampFrequency = pending.Info.TimestampFrequency;
+    header.FrameCount = pending.Info.FrameCount;
+    header.ExposureValue = pending.Info.ExposureValue;
+    header.CameraID = pending.Info.CameraID;
+    header.Width = pending.Info.Width;
+    header.Height = pending.Info.Height;
+    header.Format = pending.Info.Format;
+    header.BitDepth = pending.Info.BitDepth;
+    header.BayerPattern = pending.Info.BayerPattern;
+    header.Index = this->Index.count();
+    header.OffsetX = pending.Info.OffsetX;
+    header.OffsetY = pending.Info.OffsetY;
+    header.Binning = pending.Info.Binning;
+    header.SensorX = pending.Info.SensorX;
+    header.SensorY = pending.Info.SensorY;
+
+    uchar* destination = this->ChunkData + this->ChunkUsed;
+    memcpy(destination, &header, sizeof(RawFrameHeader));
+    memcpy(destination + sizeof(RawFrameHeader), pending.Frame.data(), payload);
+
+    RawIndexEntry entry;
+    entry.Offset = this->Chunk * this->ChunkSize + this->ChunkUsed;
+    entry.HostTime = header.HostTime;
+    entry.Timestamp = header.Timestamp;
+    entry.FrameCount = header.FrameCount;
+    entry.PayloadSize = header.PayloadSize;
+    this->Index.append(entry);
+
+    this->ChunkUsed += record;
+    return true;
+}
+
+bool RawRecorder::mapChunk(quint64 chunk)
+{
+    if (this->ChunkData != NULL)
+    {
+        /// Unmapping leaves the dirty pages to the OS's write-back, the writer does not wait for the disk
+        this->File.unmap(this->ChunkData);
+        this->ChunkData = NULL;
+    }
+
+    quint64 end = (chunk + 1) * this->ChunkSize;
+    if (end > this->Allocated)
+    {
+        quint64 size = end + (RAW_PREALLOCATE_CHUNKS - 1) * this->ChunkSize;
+        if (!this->File.resize(size))
+        {
+            std::cout << "Cannot grow raw recording to " << size << " bytes" << std::endl;
+            return false;
+        }
+        this->Allocated = size;
+    }
+
+    this->ChunkData = this->File.map(chunk * this->ChunkSize, this->ChunkSize);
+    if (this->ChunkData == NULL)
+        return false;
+    this->Chunk = chunk;
+    this->ChunkUsed = (chunk == 0) ? RAW_HEADER_SIZE : 0;
+    return true;
+}
+
+RawRecording::RawRecording()
+{
+    memset(&this->Header, 0, sizeof(RawFileHeader));
+}
+
+RawRecording::~RawRecording()
+{
+    close();
+}
+
+bool RawRecording::open(const QString &filename)
+{
+    close();
+
+    this->File.setFileName(filename);
+    if (!this->File.open(QIODevice::ReadOnly))
+        return false;
+
+    if (this->File.read(reinterpret_cast<char*>(&this->Header), sizeof(RawFileHeader)) != sizeof(RawFileHeader)
+            || memcmp(this->Header.Magic, RAW_FILE_MAGIC, sizeof(this->Header.Magic)) != 0
+            || this->Header.ChunkSize == 0)
+    {
+        close();
+        return false;
+    }
+
+    RawIndexTrailer trailer;
+    quint64 size = this->File.size();
+    bool indexed = false;
+    if (size >= RAW_HEADER_SIZE + sizeof(RawIndexTrailer))
+    {
+        this->File.seek(size - sizeof(RawIndexTrailer));
+        if (this->File.read(reinterpret_cast<char*>(&trailer), sizeof(RawIndexTrailer)) == sizeof(RawIndexTrailer)
+                && memcmp(trailer.Magic, RAW_INDEX_MAGIC, sizeof(trailer.Magic)) == 0
+                && trailer.IndexOffset + trailer.Count * sizeof(RawIndexEntry) + sizeof(RawIndexTrailer) == size)
+        {
+            this->Index.resize(trailer.Count);
+            this->File.seek(trailer.IndexOffset);
+            quint64 bytes = trailer.Count * sizeof(RawIndexEntry);
+            indexed = (quint64)this->File.read(reinterpret_cast<char*>(this->Index.data()), bytes) == bytes;
+        }
+    }
+
+    if (!indexed)
+    {
+        std::cout << "Raw recording " << filename.toStdString() << " has no index, scanning it" << std::endl;
+        scan();
+    }
+    return true;
+}
+
+void RawRecording::close()
+{
+    /// QFile::close() releases every mapping
+    this->File.close();
+    this->Chunks.clear();
+    this->Index.clear();
+    memset(&this->Header, 0, sizeof(RawFileHeader));
+}
+
+int RawRecording::count() const
+{
+    return this->Index.count();
+}
+
+QString RawRecording::cameraName() const
+{
+    return QString::fromLatin1(this->Header.CameraName, strnlen(this->Header.CameraName, sizeof(this->Header.CameraName)));
+}
+
+qint64 RawRecording::startTime() const
+{
+    return this->Header.StartTime;
+}
+
+const RawIndexEntry& RawRecording::entry(int index) const
+{
+    return this->Index[index];
+}
+
+FrameInfo RawRecording::info(int index)
+{
+    FrameInfo info;
+    memset(&info, 0, sizeof(FrameInfo));
+    const RawFrameHeader* header = this->header(index);
+    if (header == NULL)
+        return info;
+
+    info.CameraID = header->CameraID;
+    info.Timestamp = header->Timestamp;
+    info.TimestampFrequency = header->TimestampFrequency;
+    info.FrameCount = header->FrameCount;
+    info.ExposureValue = header->ExposureValue;
+    info.HostTime = header->HostTime;
+    info.Width = header->Width;
+    info.Height = header->Height;
+    info.ImageSize = header->PayloadSize;
+    info.Format = static_cast<FrameFormat>(header->Format);
+    info.BitDepth = header->BitDepth;
+    info.BayerPattern = static_cast<BayerLayout>(header->BayerPattern);
+    if (this->Header.Version >= 2)
+    {
+        info.OffsetX = header->OffsetX;
+        info.OffsetY = header->OffsetY;
+        info.Binning = header->Binning;
+    }
+
+    /// Older files only know the crop, as if the region sat in the sensor's corner
+    if (this->Header.Version >= 3)
+    {
+        info.SensorX = header->SensorX;
+        info.SensorY = header->SensorY;
+    }
+    else
+    {
+        info.SensorX = info.OffsetX;
+        info.SensorY = info.OffsetY;
+    }
+    return info;
+}
+
+const uchar* RawRecording::frame(int index)
+{
+    const RawFrameHeader* header = this->header(index);
+    if (header == NULL)
+        return NULL;
+    return reinterpret_cast<const uchar*>(header) + frameHeaderSize();
+}
+
+const RawFrameHeader* RawRecording::header(int index)
+{
+    if (index < 0 || index >= this->Index.count())
+        return NULL;
+
+    quint64 offset = this->Index[index].Offset;
+    quint64 chunk = offset / this->Header.ChunkSize;
+    uchar* data = this->Chunks.value(chunk, NULL);
+    if (data == NULL)
+    {
+        /// The last chunk is cut short where the recording ended
+        quint64 start = chunk * this->Header.ChunkSize;
+        quint64 length = qMin((quint64)this->Header.ChunkSize, (quint64)this->File.size() - start);
+        data = this->File.map(start, length);
+        if (data == NULL)
+            return NULL;
+        this->Chunks.insert(chunk, data);
+    }
+    return reinterpret_cast<const RawFrameHeader*>(data + (offset - chunk * this->Header.ChunkSize));
+}
+
+void RawRecording::scan()
+{
+    this->Index.clear();
+    quint64 size = this->File.size();
+    quint64 headerSize = frameHeaderSize();
+
+    for (quint64 chunk = 0; chunk * this->Header.ChunkSize < size; chunk++)
+    {
+        quint64 start = chunk * this->Header.ChunkSize;
+        quint64 offset = (chunk == 0) ? RAW_HEADER_SIZE : 0;
+        quint64 length = qMin((quint64)this->Header.ChunkSize, size - start);
+        int found = 0;
+
+        /// Preallocated space reads back as zeros, so the first word that is not a record ends the chunk
+        while (offset + headerSize <= length)
+        {
+            RawFrameHeader header;
+            memset(&header, 0, sizeof(RawFrameHeader));
+            this->File.seek(start + offset);
+            if ((quint64)this->File.read(reinterpret_cast<char*>(&header), headerSize) != headerSize
+                    || header.Magic != RAW_FRAME_MAGIC
+                    || header.Index != (quint32)this->Index.count()
+                    || offset + headerSize + header.PayloadSize > length)
+                break;
+
+            RawIndexEntry entry;
+            entry.Offset = start + offset;
+            entry.HostTime = header.HostTime;
+            entry.Timestamp = header.Timestamp;
+            entry.FrameCount = header.FrameCount;
+            entry.PayloadSize = header.PayloadSize;
+            this->Index.append(entry);
+            found++;
+
+            offset += alignUp(headerSize + header.PayloadSize, RAW_RECORD_ALIGNMENT);
+        }
+
+        if (found == 0)
+            break;  //!< The writer never reached this chunk
+    }
+}
+
+quint64 RawRecording::frameHeaderSize() const
+{
+    if (this->Header.Version >= 3)
+        return sizeof(RawFrameHeader);
+    return (this->Header.Version >= 2) ? RAW_V2_FRAME_HEADER_SIZE : RAW_V1_FRAME_HEADER_SIZE;
+}
@@ -0,0 +1,321 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * RawRecorder stores sensor frames exactly as the camera delivered them
+ * (Bayer8 for WL, 12-bit Mono16 for NIR) together with their FrameInfo,
+ * so nothing is lost to tone mapping or H.264. Frames are taken from
+ * FrameSource::rawFrameReady, before defect correction and denoising.
+ * Frames are queued from the capture thread without copying and written
+ * by the recorder's own thread into a preallocated file, one
+ * memory-mapped chunk at a time.
+ *
+ * RawRecording reads such a file back. Its frame index gives constant
+ * time access to any frame.
+ *
+ * File layout: a RAW_HEADER_SIZE header, then records (RawFrameHeader +
+ * pixels, RAW_RECORD_ALIGNMENT aligned) packed into chunks of ChunkSize
+ * bytes. A record never crosses a chunk boundary. Closing the recording
+ * appends the frame index and a RawIndexTrailer. A file that was never
+ * closed is indexed by walking the records instead.
+ */
+
+#ifndef RAWRECORDER_H
+#define RAWRECORDER_H
+
+#define RAW_FILE_MAGIC "MCVRAW01"           //!< First 8 bytes of every raw recording
+#define RAW_INDEX_MAGIC "MCVRIDX1"          //!< First 8 bytes of the index trailer
+#define RAW_FRAME_MAGIC 0x4652564DU         //!< "MVRF", first word of every record
+#define RAW_VERSION 3                       //!< Format version written to RawFileHeader
+#define RAW_V1_FRAME_HEADER_SIZE 64         //!< Size of a version 1 RawFrameHeader, which ends at Index
+#define RAW_V2_FRAME_HEADER_SIZE 80         //!< Size of a version 2 RawFrameHeader, which ends at Binning and a reserved word
+#define RAW_HEADER_SIZE 4096                //!< Bytes reserved for RawFileHeader at the start of the file
+#define RAW_RECORD_ALIGNMENT 64             //!< Records start on this boundary, keeps pixel data cache-line aligned
+#define RAW_CHUNK_SIZE (64UL << 20)         //!< Default chunk size, mapped one at a time while writing
+#define RAW_CHUNK_GRANULARITY (64UL << 10)  //!< Chunk sizes are rounded to this (mapping offsets must be aligned to it on Windows)
+#define RAW_PREALLOCATE_CHUNKS 4            //!< Chunks reserved when the file is opened and each time it runs out
+#define RAW_QUEUE_DEPTH 64                  //!< Frames waiting for the writer before new ones are dropped
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QHash>
+#include <QFile>
+#include <QString>
+#include <framesource.h>
+
+/**
+ * @brief Start of a raw recording
+ */
+struct RawFileHeader
+{
+    char        Magic[8];           //!< RAW_FILE_MAGIC
+    quint32     Version;            //!< RAW_VERSION
+    quint32     HeaderSize;         //!< RAW_HEADER_SIZE, first record follows it
+    quint64     ChunkSize;          //!< Size of a chunk in bytes, chunk n starts at n * ChunkSize
+    quint64     FrameCount;         //!< Frames in the file, 0 until the recording is closed
+    qint64      StartTime;          //!< Host time the recording was opened, in microseconds (see hostTimeUs())
+    char        CameraName[32];     //!< Channel name, e.g. "WL" or "NIR"
+};
+
+/**
+ * @brief Precedes the pixel data of every frame in a raw recording
+ */
+struct RawFrameHeader
+{
+    quint32     Magic;              //!< RAW_FRAME_MAGIC
+    quint32     PayloadSize;        //!< Bytes of pixel data following this header
+    quint64     Timestamp;          //!< FrameInfo::Timestamp
+    qint64      HostTime;           //!< FrameInfo::HostTime
+    quint32     TimestampFrequency; //!< FrameInfo::TimestampFrequency
+    quint32     FrameCount;         //!< FrameInfo::FrameCount
+    quint32     ExposureValue;      //!< FrameInfo::ExposureValue
+    quint32     CameraID;           //!< FrameInfo::CameraID
+    quint32     Width;              //!< FrameInfo::Width
+    quint32     Height;             //!< FrameInfo::Height
+    quint32     Format;             //!< FrameInfo::Format
+    quint32     BitDepth;           //!< FrameInfo::BitDepth
+    quint32     BayerPattern;       //!< FrameInfo::BayerPattern
+    quint32     Index;              //!< Position of the frame in the recording
+    quint32     OffsetX;            //!< FrameInfo::OffsetX (version 2)
+    quint32     OffsetY;            //!< FrameInfo::OffsetY (version 2)
+    quint32     Binning;            //!< FrameInfo::Binning (version 2)
+    quint32     SensorX;            //!< FrameInfo::SensorX (version 3)
+    quint32     SensorY;            //!< FrameInfo::SensorY (version 3)
+    quint32     Reserved;           //!< 0
+};
+
+/**
+ * @brief One entry of the frame index
+ */
+struct RawIndexEntry
+{
+    quint64     Offset;             //!< File offset of the frame's RawFrameHeader
+    qint64      HostTime;           //!< Host arrival time, in microseconds
+    quint64     Timestamp;          //!< Hardware timestamp, in camera clock ticks
+    quint32     FrameCount;         //!< Hardware frame counter
+    quint32     PayloadSize;        //!< Bytes of pixel data
+};
+
+/**
+ * @brief Last bytes of a closed raw recording, points at the frame index
+ */
+struct RawIndexTrailer
+{
+    char        Magic[8];           //!< RAW_INDEX_MAGIC
+    quint64     Count;              //!< Number of RawIndexEntry records
+    quint64     IndexOffset;        //!< File offset of the first RawIndexEntry
+};
+
+/**
+ * @brief Counters of a RawRecorder
+ */
+struct RawRecorderStatistics
+{
+    unsigned long   Written;        //!< Frames copied into the file
+    unsigned long   Dropped;        //!< Frames discarded because the queue was full or the file could not grow
+    unsigned long   QueuePeak;      //!< Deepest the queue has been
+    quint64         Bytes;          //!< Bytes written, headers and padding included
+};
+
+class RawRecorder : public QThread
+{
+    Q_OBJECT
+public:
+
+    explicit RawRecorder(QObject *parent = 0);
+
+    /**
+     * @brief Closes the recording if it is still open
+     */
+    ~RawRecorder();
+
+    /**
+     * @brief Creates the file, preallocates its first chunks and starts the writer thread
+     *
+     * @param filename File to create. An existing file is overwritten
+     * @param cameraName Stored in the header, e.g. "WL" or "NIR"
+     * @param chunkSize Bytes mapped at a time, rounded up to RAW_CHUNK_GRANULARITY
+     * @return true if the file is ready for frames, false otherwise
+     */
+    bool open(const QString &filename, const QString &cameraName, quint64 chunkSize = RAW_CHUNK_SIZE);
+
+    /**
+     * @brief Writes the queued frames, appends the index and closes the file
+     *
+     * Blocks until the writer thread has finished.
+     */
+    void close();
+
+    /**
+     * @brief Checks if the recorder is accepting frames
+     */
+    bool isOpen();
+
+    /**
+     * @brief Gets a snapshot of the recorder's counters. Thread-safe
+     */
+    RawRecorderStatistics getStatistics();
+
+public slots:
+
+    /**
+     * @brief Queues a frame for writing
+     *
+     * Only takes a reference to the frame, so it is safe to connect to FrameSource::rawFrameReady
+     * with Qt::DirectConnection and run on the capture thread. Never blocks: when the writer
+     * is RAW_QUEUE_DEPTH frames behind the frame is dropped and counted.
+     */
+    void push(FrameSource* source, FrameBuffer frame, FrameInfo info);
+
+protected:
+
+    /**
+     * @brief Writer loop, copies queued frames into the mapped chunk
+     */
+    void run();
+
+private:
+
+    /**
+     * @brief A frame waiting for the writer
+     */
+    struct PendingFrame
+    {
+        FrameBuffer     Frame;      //!< Pixel data, shared with the rest of the program
+        FrameInfo       Info;       //!< Metadata of Frame
+    };
+
+    /**
+     * @brief Copies one frame into the file. Writer thread only
+     * @return true if the frame was written, false if the file could not grow
+     */
+    bool writeFrame(const PendingFrame &pending);
+
+    /**
+     * @brief Maps the given chunk, growing the file first if needed. Writer thread only
+     * @return true if the chunk is mapped, false otherwise
+     */
+    bool mapChunk(quint64 chunk);
+
+    QFile               File;           //!< The recording
+    quint64             ChunkSize;      //!< Size of a chunk in bytes
+    quint64             Chunk;          //!< Chunk currently mapped
+    uchar*              ChunkData;      //!< Mapping of Chunk, NULL if none
+    quint64             ChunkUsed;      //!< Bytes of Chunk already holding records
+    quint64             Allocated;      //!< Current size of the file (preallocated space included)
+    QVector<RawIndexEntry> Index;       //!< Entry of every written frame, appended to the file by close()
+
+    QMutex              QueueMutex;     //!< Guards Queue, Stopping, Open and Statistics
+    QWaitCondition      QueueCondition; //!< Wakes the writer when a frame is queued or the recorder closes
+    QQueue<PendingFrame> Queue;         //!< Frames waiting for the writer, oldest first
+    bool                Stopping;       //!< Set by close(), the writer drains Queue and exits
+    bool                Open;           //!< True between open() and close()
+    RawRecorderStatistics Statistics;   //!< See getStatistics()
+};
+
+class RawRecording
+{
+public:
+
+    RawRecording();
+
+    /**
+     * @brief Unmaps and closes the file
+     */
+    ~RawRecording();
+
+    /**
+     * @brief Opens a raw recording and loads its frame index
+     *
+     * If the file was not closed properly (no index trailer), the index is rebuilt by
+     * walking the records of each chunk.
+     *
+     * @return true if the file is a raw recording, false otherwise
+     */
+    bool open(const QString &filename);
+
+    /**
+     * @brief Closes the file and releases its mappings
+     */
+    void close();
+
+    /**
+     * @brief Gets the number of frames in the recording
+     */
+    int count() const;
+
+    /**
+     * @brief Gets the name of the camera the recording was made with
+     */
+    QString cameraName() const;
+
+    /**
+     * @brief Gets the host time the recording was opened, in microseconds (see hostTimeUs())
+     */
+    qint64 startTime() const;
+
+    /**
+     * @brief Gets the index entry of a frame
+     * @param index Frame number, 0 to count() - 1
+     */
+    const RawIndexEntry& entry(int index) const;
+
+    /**
+     * @brief Gets the metadata of a frame
+     * @param index Frame number, 0 to count() - 1
+     */
+    FrameInfo info(int index);
+
+    /**
+     * @brief Gets the pixel data of a frame
+     *
+     * The pointer is into the mapped file and stays valid until close().
+     *
+     * @param index Frame number, 0 to count() - 1
+     * @return Pointer to entry(index).PayloadSize bytes, NULL if the frame cannot be mapped
+     */
+    const uchar* frame(int index);
+
+private:
+
+    /**
+     * @brief Gets a frame's header through its chunk's mapping
+     */
+    const RawFrameHeader* header(int index);
+
+    /**
+     * @brief Rebuilds Index from the records, for files without an index trailer
+     */
+    void scan();
+
+    /**
+     * @brief Gets the size of a RawFrameHeader in this file, which depends on its version
+     */
+    quint64 frameHeaderSize() const;
+
+    QFile               File;           //!< The recording
+    RawFileHeader       Header;         //!< Copy of the file's header
+    QVector<RawIndexEntry> Index;       //!< Entry of every frame
+    QHash<quint64, uchar*> Chunks;      //!< Mapping of every chunk accessed so far, by chunk number
+};
+
+#endif // RAWRECORDER_H
@@ -0,0 +1,258 @@
+#include "replaysource.h"
+
+#include <QThread>
+#include <cstring>
+
+ReplaySource::ReplaySource(const QString &filename, ReplayMode mode, QObject *parent) : FrameSource(parent)
+{
+    this->Mode = mode;
+    this->Loop = false;
+    this->Position = 0;
+    this->Epoch = 0;
+    this->Offset = 0;
+    this->ExposureValue = 0;
+    this->FrameSize = 0;
+    this->TimestampFrequency = 0;
+    this->Pool = NULL;
+    this->Steps = 0;
+    this->Stopped = false;
+    memset(&(this->Statistics),0,sizeof(CaptureStatistics));
+
+    if (this->Recording.open(filename))
+    {
+        for (int i = 0; i < this->Recording.count(); i++)
+            if (this->Recording.entry(i).PayloadSize > this->FrameSize)
+                this->FrameSize = this->Recording.entry(i).PayloadSize;
+        if (this->Recording.count() > 0)
+        {
+            FrameInfo first = this->Recording.info(0);
+            this->ExposureValue = first.ExposureValue;
+            this->TimestampFrequency = first.TimestampFrequency;
+        }
+    }
+}
+
+ReplaySource::~ReplaySource()
+{
+    delete this->Pool;
+}
+
+bool ReplaySource::isValid()
+{
+    return this->Recording.count() > 0;
+}
+
+QString ReplaySource::cameraName()
+{
+    return this->Recording.cameraName();
+}
+
+void ReplaySource::setLoop(bool loop)
+{
+    this->Loop = loop;
+}
+
+void ReplaySource::captureSetup()
+{
+    if (!this->Pool && this->FrameSize > 0)
+        this->Pool = new FramePool(this->FrameSize, FRAMEPOOL_SPARE);
+
+    this->Position = 0;
+    this->Epoch = hostTimeUs();
+
+    /// Channels were recorded together, so the first frames keep their offsets from the start of the recording
+    this->Offset = 0;
+    if (isValid() && this->Recording.entry(0).HostTime > this->Recording.startTime())
+        this->Offset = this->Recording.entry(0).HostTime - this->Recording.startTime();
+
+    QMutexLocker locker(&this->Mutex);
+    this->Stopped = false;
+    this->Steps = 0;
+}
+
+void ReplaySource::captureEnd()
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Stopped = true;
+    this->StepCondition.wakeAll();
+}
+
+void ReplaySource::SetMono16Bit()
+{
+    /// The format is whatever was recorded
+}
+
+bool ReplaySource::isNearInfrared()
+{
+    return isValid() && this->Recording.info(0).Format == FormatMono16;
+}
+
+void ReplaySource::setExposure(unsigned long exposure)
+{
+    this->ExposureValue = exposure;
+}
+
+unsigned long ReplaySource::getExposure()
+{
+    return this->ExposureValue;
+}
+
+bool ReplaySource::setAttribute(const char *name, unsigned long value)
+{
+    Q_UNUSED(name);
+    Q_UNUSED(value);
+    return true;    //!< The frames were captured already
+}
+
+CaptureStatistics ReplaySource::getStatistics()
+{
+    QMutexLocker locker(&this->Mutex);
+    return this->Statistics;
+}
+
+unsigned long ReplaySource::getFrameSize()
+{
+    return this->FrameSize;
+}
+
+void ReplaySource::setStreamBytesPerSecond(unsigned long bytesPerSecond)
+{
+    Q_UNUSED(bytesPerSecond);   //!< No link to share
+}
+
+void ReplaySource::setTriggerMode(TriggerMode mode)
+{
+    Q_UNUSED(mode);             //!< Playback follows the recorded timing
+}
+
+bool ReplaySource::setBinning(unsigned int factor)
+{
+    return factor == 1;         //!< Frames come at the size they were recorded at
+}
+
+unsigned int ReplaySource::getBinning()
+{
+    return 1;
+}
+
+bool ReplaySource::setCrop(const QRect &crop)
+{
+    Q_UNUSED(crop);
+    return false;   //!< Frames come at the size they were recorded at
+}
+
+void ReplaySource::step()
+{
+    QMutexLocker locker(&this->Mutex);
+    this->Steps++;
+    this->StepCondition.wakeAll();
+}
+
+void ReplaySource::capture()
+{
+    if (!this->Pool)
+        return;
+
+    if (this->Position >= this->Recording.count())
+    {
+        if (!this->Loop)
+            return;
+        this->Position = 0;
+        this->Epoch = hostTimeUs();
+        this->Offset = 0;
+        this->Processor.reset();    //!< The last frame's averages don't belong to the first one
+    }
+
+    if (this->Mode == ReplayStep)
+    {
+        QMutexLocker locker(&this->Mutex);
+        while (this->Steps == 0 && !this->Stopped)
+            this->StepCondition.wait(&this->Mutex);
+        if (this->Stopped)
+            return;
+        this->Steps--;
+    }
+    else if (this->Mode == ReplayRealTime)
+    {
+        if (!sleepUntil(this->Epoch + this->Offset + recordedTime(this->Position)))
+            return;
+
+        /// Like a live camera, a pipeline that fell behind gets the newest frame, not a backlog
+        qint64 now = hostTimeUs();
+        int skipped = 0;
+        while (this->Position + 1 < this->Recording.count()
+               && this->Epoch + this->Offset + recordedTime(this->Position + 1) <= now)
+        {
+            this->Position++;
+            skipped++;
+        }
+        if (skipped > 0)
+        {
+            QMutexLocker locker(&this->Mutex);
+            this->Statistics.Skipped += skipped;
+        }
+    }
+    else
+    {
+        QMutexLocker locker(&this->Mutex);
+        if (this->Stopped)
+            return;
+    }
+
+    const uchar* data = this->Recording.frame(this->Position);
+    FrameInfo info = this->Recording.info(this->Position);
+    this->Position++;
+    if (data == NULL)
+    {
+        QMutexLocker locker(&this->Mutex);
+        this->Statistics.Dropped++;
+        QMetaObject::invokeMethod(this, "capture", Qt::QueuedConnection); //!< Nobody else will ask for the next frame
+        return;
+    }
+
+    FrameBuffer buffer = this->Pool->acquire();
+    if (buffer.isNull())
+    {
+        QMutexLocker locker(&this->Mutex);
+        this->Statistics.Dropped++;     //!< Consumers hold every buffer
+        QMetaObject::invokeMethod(this, "capture", Qt::QueuedConnection);
+        return;
+    }
+    memcpy(buffer.data(), data, info.ImageSize);
+
+    this->Mutex.lock();
+    this->Statistics.Delivered++;
+    this->Mutex.unlock();
+
+    emit rawFrameReady(this, buffer, info);
+    buffer = processFrame(buffer, info, this->Pool);
+    emit frameReady(this, buffer, info);
+
+    if (this->Position >= this->Recording.count() && !this->Loop)
+        emit replayFinished(this);
+}
+
+qint64 ReplaySource::recordedTime(int index)
+{
+    const RawIndexEntry& first = this->Recording.entry(0);
+    const RawIndexEntry& entry = this->Recording.entry(index);
+    if (this->TimestampFrequency == 0 || entry.Timestamp < first.Timestamp)
+        return entry.HostTime - first.HostTime;
+    return static_cast<qint64>((entry.Timestamp - first.Timestamp) * 1000000.0 / this->TimestampFrequency);
+}
+
+bool ReplaySource::sleepUntil(qint64 due)
+{
+    while (true)
+    {
+        {
+            QMutexLocker locker(&this->Mutex);
+            if (this->Stopped)
+                return false;
+        }
+        qint64 now = hostTimeUs();
+        if (now >= due)
+            return true;
+        QThread::usleep(qMin(due - now, (qint64)REPLAY_SLEEP_SLICE));
+    }
+}
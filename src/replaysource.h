@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The ReplaySource class is a FrameSource that plays back a raw recording
+ * (see RawRecorder), so a captured session can be run through the live
+ * pipeline again on a machine without cameras. Frames keep the metadata
+ * they were recorded with.
+ *
+ * In real-time mode frames are released when their recorded hardware
+ * timestamp comes due, and frames the pipeline is too slow for are
+ * skipped, the way a live camera behaves. Fast mode releases each frame as
+ * soon as the previous one has been processed, for benchmarking. Step
+ * mode releases one frame per call to step(), for debugging.
+ */
+
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#define REPLAY_SLEEP_SLICE 50000    //!< Longest uninterrupted sleep while pacing, in microseconds, so captureEnd() is noticed
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <framesource.h>
+#include <rawrecorder.h>
+
+/**
+ * @brief How a ReplaySource releases frames
+ */
+enum ReplayMode
+{
+    ReplayRealTime,     //!< Paced by the recorded timestamps
+    ReplayFast,         //!< As fast as the pipeline takes them
+    ReplayStep          //!< One frame per step()
+};
+
+class ReplaySource : public FrameSource
+{
+    Q_OBJECT
+public:
+
+    /**
+     * @brief Opens a raw recording for playback
+     *
+     * @param filename Raw recording (.mcvraw) to play back
+     * @param mode How frames are released
+     * @param parent Parent object (Defaults to no parent)
+     */
+    ReplaySource(const QString &filename, ReplayMode mode, QObject *parent = 0);
+
+    ~ReplaySource();
+
+    /**
+     * @brief Checks if the recording could be opened and holds at least one frame
+     */
+    bool isValid();
+
+    /**
+     * @brief Gets the name of the channel the recording was made from, e.g. "WL" or "NIR"
+     */
+    QString cameraName();
+
+    /**
+     * @brief Makes playback start over at the first frame instead of ending
+     */
+    void setLoop(bool loop);
+
+    void captureSetup();
+    void captureEnd();
+    void SetMono16Bit();
+    bool isNearInfrared();
+    void setExposure(unsigned long exposure);
+    unsigned long getExposure();
+    bool setAttribute(const char* name, unsigned long value);
+    CaptureStatistics getStatistics();
+    unsigned long getFrameSize();
+    void setStreamBytesPerSecond(unsigned long bytesPerSecond);
+    void setTriggerMode(TriggerMode mode);
+    bool setBinning(unsigned int factor);
+    unsigned int getBinning();
+
+    bool setCrop(const QRect &crop);
+
+public slots:
+
+    /**
+     * @brief Waits for the next frame's turn and hands it out through frameReady()
+     *
+     * Does nothing once the recording has ended (unless looping) or captureEnd() was called.
+     */
+    void capture();
+
+    /**
+     * @brief Releases one frame in step mode. Thread-safe
+     */
+    void step();
+
+signals:
+
+    /**
+     * @brief Emitted once the last frame of the recording has been handed out
+     * @param source The source that finished
+     */
+    void replayFinished(FrameSource* source);
+
+private:
+
+    /**
+     * @brief Gets a frame's capture time relative to the first frame, in microseconds
+     *
+     * Uses the hardware timestamp, or the host arrival time when the camera's clock
+     * frequency was not recorded.
+     */
+    qint64 recordedTime(int index);
+
+    /**
+     * @brief Sleeps until the given host time, giving up early if captureEnd() is called
+     * @return false if playback was stopped while waiting
+     */
+    bool sleepUntil(qint64 due);
+
+    RawRecording    Recording;          //!< The file being played back
+    ReplayMode      Mode;               //!< How frames are released
+    bool            Loop;               //!< Start over at the end instead of finishing
+    int             Position;           //!< Index of the next frame to hand out
+    qint64          Epoch;              //!< Host time (us) at which the first frame is due, real-time mode
+    qint64          Offset;             //!< Delay of the first frame after the recording was opened, keeps channels in step
+    unsigned long   ExposureValue;      //!< Exposure asked for by autoexposure. Frames keep the recorded one
+    unsigned long   FrameSize;          //!< Largest frame in the recording, in bytes
+    unsigned long   TimestampFrequency; //!< Recorded camera clock ticks per second, 0 if unknown
+    FramePool*      Pool;               //!< Frame buffers. Created in captureSetup()
+    CaptureStatistics Statistics;       //!< Frame counters, see getStatistics()
+    QMutex          Mutex;              //!< Guards Statistics, Steps and Stopped
+    QWaitCondition  StepCondition;      //!< Wakes capture() on step() and captureEnd()
+    int             Steps;              //!< Frames released by step() and not yet handed out
+    bool            Stopped;            //!< Set by captureEnd()
+};
+
+#endif // REPLAYSOURCE_H
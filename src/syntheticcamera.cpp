@@ -0,0 +1,329 @@
+#include "syntheticcamera.h"
+
+#include <cmath>
+#include <cstring>
+
+SyntheticCamera::SyntheticCamera(unsigned int width, unsigned int height, double fps, QObject *parent) : FrameSource(parent)
+{
+    this->Width = width;
+    this->Height = height;
+    this->FPS = fps;
+    this->Mono16 = false;
+    this->ExposureValue = SYNTHETIC_WL_EXPOSURE;
+    this->PendingExposure = SYNTHETIC_WL_EXPOSURE;
+    this->FrameSize = 0;
+    this->Binning = 1;
+    this->PendingBinning = 1;
+    this->FrameCount = 0;
+    this->NextFrame = 0;
+    this->Random = 2463534242u;
+    this->Stopped = false;
+    this->Pool = NULL;
+    memset(&(this->Statistics),0,sizeof(CaptureStatistics));
+}
+
+SyntheticCamera::~SyntheticCamera()
+{
+    delete this->Pool;
+}
+
+void SyntheticCamera::captureSetup()
+{
+    this->FrameSize = this->Width * this->Height * ((this->Mono16) ? 2 : 1);
+    if (!this->Pool)
+        this->Pool = new FramePool(this->FrameSize, FRAMEPOOL_SPARE);
+
+    /// Gaussian falloff, sigma a third of the radius
+    int size = 2*SYNTHETIC_BLOB_RADIUS + 1;
+    double sigma = SYNTHETIC_BLOB_RADIUS / 3.0;
+    this->Sprite.resize(size*size);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            double dx = x - SYNTHETIC_BLOB_RADIUS;
+            double dy = y - SYNTHETIC_BLOB_RADIUS;
+            this->Sprite[y*size + x] = static_cast<unsigned short>(1024.0 * std::exp(-(dx*dx + dy*dy) / (2.0*sigma*sigma)));
+        }
+    }
+
+    /// Smooth, tissue-like texture for the WL scene: a vignette with some low frequency ripples
+    if (!this->Mono16)
+    {
+        this->Scene.resize(this->Width * this->Height);
+        for (unsigned int y = 0; y < this->Height; y++)
+        {
+            for (unsigned int x = 0; x < this->Width; x++)
+            {
+                double u = (x - this->Width/2.0) / this->Width;
+                double v = (y - this->Height/2.0) / this->Height;
+                double value = 150.0 * (1.0 - 1.6*(u*u + v*v))
+                             + 25.0 * std::sin(x * 0.045) * std::cos(y * 0.06)
+                             + 15.0 * std::sin((x + y) * 0.013);
+                this->Scene[y*this->Width + x] = static_cast<unsigned char>(qBound(0.0, value, 255.0));
+            }
+        }
+    }
+
+    this->NextFrame = hostTimeUs();
+    this->Stopped = false;
+}
+
+void SyntheticCamera::captureEnd()
+{
+    this->Stopped = true;
+}
+
+void SyntheticCamera::SetMono16Bit()
+{
+    this->Mono16 = true;
+    QMutexLocker locker(&this->StatisticsMutex);
+    this->ExposureValue = SYNTHETIC_NIR_EXPOSURE;
+    this->PendingExposure = SYNTHETIC_NIR_EXPOSURE;
+}
+
+bool SyntheticCamera::isNearInfrared()
+{
+    return this->Mono16;
+}
+
+void SyntheticCamera::setExposure(unsigned long exposure)
+{
+    QMutexLocker locker(&this->StatisticsMutex);
+    this->PendingExposure = exposure;
+}
+
+unsigned long SyntheticCamera::getExposure()
+{
+    QMutexLocker locker(&this->StatisticsMutex);
+    return this->PendingExposure;
+}
+
+bool SyntheticCamera::setAttribute(const char *name, unsigned long value)
+{
+    Q_UNUSED(name);
+    Q_UNUSED(value);
+    return true;    //!< Nothing to move, the scene has no region of interest
+}
+
+CaptureStatistics SyntheticCamera::getStatistics()
+{
+    QMutexLocker locker(&this->StatisticsMutex);
+    return this->Statistics;
+}
+
+unsigned long SyntheticCamera::getFrameSize()
+{
+    return this->FrameSize;
+}
+
+void SyntheticCamera::setStreamBytesPerSecond(unsigned long bytesPerSecond)
+{
+    Q_UNUSED(bytesPerSecond);   //!< No link to share
+}
+
+void SyntheticCamera::setTriggerMode(TriggerMode mode)
+{
+    Q_UNUSED(mode);             //!< Always free-runs
+}
+
+bool SyntheticCamera::setBinning(unsigned int factor)
+{
+    if (!this->Mono16 || factor < 1 || this->Width % factor != 0 || this->Height % factor != 0)
+        return false;
+    QMutexLocker locker(&this->StatisticsMutex);
+    this->PendingBinning = factor;
+    return true;
+}
+
+unsigned int SyntheticCamera::getBinning()
+{
+    return this->Binning;
+}
+
+bool SyntheticCamera::setCrop(const QRect &crop)
+{
+    Q_UNUSED(crop);
+    return false;   //!< Frames are generated at full size
+}
+
+void SyntheticCamera::capture()
+{
+    if (this->Stopped || !this->Pool)
+        return;
+
+    this->StatisticsMutex.lock();
+    this->Binning = this->PendingBinning;
+    this->ExposureValue = this->PendingExposure;
+    this->StatisticsMutex.unlock();
+
+    /// Paces frames like a free-running sensor: no faster than the frame rate, nor than the exposure allows
+    qint64 period = 0;
+    if (this->FPS > 0)
+    {
+        period = static_cast<qint64>(1000000.0 / this->FPS);
+        if (static_cast<qint64>(this->ExposureValue) > period)
+            period = this->ExposureValue;
+    }
+    qint64 now = hostTimeUs();
+    if (this->NextFrame > now)
+    {
+        QThread::usleep(this->NextFrame - now);
+        now = hostTimeUs();
+    }
+    this->NextFrame = ((this->NextFrame > now) ? this->NextFrame : now) + period;
+
+    FrameBuffer buffer = this->Pool->acquire();
+    if (buffer.isNull())
+    {
+        QMutexLocker locker(&this->StatisticsMutex);
+        this->Statistics.Dropped++;     //!< Consumers hold every buffer, like a camera with no frame queued
+        QMetaObject::invokeMethod(this, "capture", Qt::QueuedConnection);
+        return;
+    }
+    double seconds = now / 1000000.0;
+    if (this->Mono16 && this->Binning > 1)
+    {
+        this->Unbinned.resize(this->Width * this->Height);
+        renderMono16(this->Unbinned.data(), seconds);
+        binMono16(this->Unbinned.constData(), reinterpret_cast<unsigned short*>(buffer.data()), this->Binning);
+    }
+    else if (this->Mono16)
+        renderMono16(reinterpret_cast<unsigned short*>(buffer.data()), seconds);
+    else
+        renderBayer8(buffer.data(), seconds);
+
+    this->FrameCount = (this->FrameCount % 65535) + 1;
+
+    FrameInfo info;
+    memset(&info, 0, sizeof(FrameInfo));
+    info.CameraID = (this->Mono16) ? 0xFFFF0002 : 0xFFFF0001;
+    info.TimestampFrequency = 1000000;
+    info.Timestamp = (now > static_cast<qint64>(this->ExposureValue)) ? now - this->ExposureValue : 0; //!< Exposure start, like the cameras
+    info.FrameCount = this->FrameCount;
+    info.ExposureValue = this->ExposureValue;
+    info.HostTime = hostTimeUs();
+    info.Width = this->Width / this->Binning;
+    info.Height = this->Height / this->Binning;
+    info.ImageSize = this->FrameSize / (this->Binning * this->Binning);
+    info.Format = (this->Mono16) ? FormatMono16 : FormatBayer8;
+    info.BitDepth = (this->Mono16) ? 12 : 8;
+    info.BayerPattern = BayerRGGB;
+    info.Binning = this->Binning;
+
+    this->StatisticsMutex.lock();
+    this->Statistics.Delivered++;
+    this->StatisticsMutex.unlock();
+
+    emit rawFrameReady(this, buffer, info);
+    buffer = processFrame(buffer, info, this->Pool);
+    emit frameReady(this, buffer, info);
+}
+
+void SyntheticCamera::blobPositions(double seconds, int *x, int *y)
+{
+    for (int i = 0; i < SYNTHETIC_BLOBS; i++)
+    {
+        /// Each blob follows its own slow Lissajous path
+        double phase = i * 2.1;
+        x[i] = static_cast<int>(this->Width/2.0 + this->Width/3.0 * std::sin(seconds * (0.31 + 0.07*i) + phase));
+        y[i] = static_cast<int>(this->Height/2.0 + this->Height/3.0 * std::sin(seconds * (0.23 + 0.05*i) + 2.0*phase));
+    }
+}
+
+void SyntheticCamera::renderMono16(unsigned short *dst, double seconds)
+{
+    unsigned int pixels = this->Width * this->Height;
+    for (unsigned int i = 0; i < pixels; i++)
+        dst[i] = SYNTHETIC_DARK_LEVEL + (nextRandom() & 7) + (nextRandom() & 7);  //!< Black level plus read noise
+
+    int x[SYNTHETIC_BLOBS], y[SYNTHETIC_BLOBS];
+    blobPositions(seconds, x, y);
+
+    /// Fluorescence builds up linearly with the exposure
+    unsigned int peak = static_cast<unsigned int>(SYNTHETIC_NIR_PEAK * (static_cast<double>(this->ExposureValue) / SYNTHETIC_NIR_EXPOSURE));
+    int size = 2*SYNTHETIC_BLOB_RADIUS + 1;
+
+    for (int b = 0; b < SYNTHETIC_BLOBS; b++)
+    {
+        unsigned int strength = peak * (SYNTHETIC_BLOBS - b) / SYNTHETIC_BLOBS;
+        for (int sy = 0; sy < size; sy++)
+        {
+            int py = y[b] + sy - SYNTHETIC_BLOB_RADIUS;
+            if (py < 0 || py >= static_cast<int>(this->Height))
+                continue;
+            for (int sx = 0; sx < size; sx++)
+            {
+                int px = x[b] + sx - SYNTHETIC_BLOB_RADIUS;
+                if (px < 0 || px >= static_cast<int>(this->Width))
+                    continue;
+                unsigned int value = dst[py*this->Width + px] + ((strength * this->Sprite[sy*size + sx]) >> 10);
+                dst[py*this->Width + px] = (value > SYNTHETIC_FULL_SCALE) ? SYNTHETIC_FULL_SCALE : value;
+            }
+        }
+    }
+}
+
+void SyntheticCamera::binMono16(const unsigned short *src, unsigned short *dst, unsigned int factor)
+{
+    unsigned int width = this->Width / factor;
+    unsigned int height = this->Height / factor;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            unsigned int sum = 0;
+            for (unsigned int j = 0; j < factor; j++)
+            {
+                const unsigned short* row = src + (y*factor + j)*this->Width + x*factor;
+                for (unsigned int i = 0; i < factor; i++)
+                    sum += row[i];
+            }
+            dst[y*width + x] = (sum > SYNTHETIC_FULL_SCALE) ? SYNTHETIC_FULL_SCALE : sum;
+        }
+    }
+}
+
+void SyntheticCamera::renderBayer8(unsigned char *dst, double seconds)
+{
+    /// Brightness scales with the exposure, 256 being the nominal brightness
+    unsigned int gain = static_cast<unsigned int>(256.0 * this->ExposureValue / SYNTHETIC_WL_EXPOSURE);
+
+    /// RGGB filter: R on even rows/even columns, B on odd rows/odd columns, G elsewhere.
+    /// The scene is reddish, like tissue: full red, 70% green and 55% blue.
+    static const unsigned int ChannelWeight[3] = {256, 180, 140};
+    for (unsigned int y = 0; y < this->Height; y++)
+    {
+        const unsigned char* scene = &this->Scene[y*this->Width];
+        unsigned char* row = dst + y*this->Width;
+        for (unsigned int x = 0; x < this->Width; x++)
+        {
+            int channel = ((y & 1) == 0) ? (((x & 1) == 0) ? 0 : 1) : (((x & 1) == 0) ? 1 : 2);
+            unsigned int value = (((scene[x] * ChannelWeight[channel]) >> 8) * gain >> 8) + (nextRandom() & 7);
+            row[x] = (value > 255) ? 255 : value;
+        }
+    }
+
+    int x[SYNTHETIC_BLOBS], y[SYNTHETIC_BLOBS];
+    blobPositions(seconds, x, y);
+    int size = 2*SYNTHETIC_BLOB_RADIUS + 1;
+
+    /// Blobs show up faintly in white light too, as a green tint
+    for (int b = 0; b < SYNTHETIC_BLOBS; b++)
+    {
+        for (int sy = 0; sy < size; sy++)
+        {
+            int py = y[b] + sy - SYNTHETIC_BLOB_RADIUS;
+            if (py < 0 || py >= static_cast<int>(this->Height))
+                continue;
+            for (int sx = 0; sx < size; sx++)
+            {
+                int px = x[b] + sx - SYNTHETIC_BLOB_RADIUS;
+                if (px < 0 || px >= static_cast<int>(this->Width) || ((px + py) & 1) == 0)
+                    continue;   //!< Only green sites
+                unsigned int value = dst[py*this->Width + px] + ((40 * gain >> 8) * this->Sprite[sy*size + sx] >> 10);
+                dst[py*this->Width + px] = (value > 255) ? 255 : value;
+            }
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The SyntheticCamera class is a FrameSource that makes up its frames.
+ * It produces Bayer8 frames of a textured scene (WL) or 12-bit Mono16
+ * frames of a dark background (NIR). Both have sensor noise and a few
+ * fluorescent blobs drifting across the image. The brightness follows the
+ * exposure, so autoexposure reacts the way it does with a real camera, and
+ * frames are paced by the frame rate and the exposure. With the frame rate
+ * set to 0 frames come as fast as they can be generated, for profiling the
+ * rest of the pipeline.
+ */
+
+#ifndef SYNTHETICCAMERA_H
+#define SYNTHETICCAMERA_H
+
+#define SYNTHETIC_BLOBS 3               //!< Number of fluorescent blobs in the scene
+#define SYNTHETIC_BLOB_RADIUS 48        //!< Radius of a blob's footprint, in pixels
+#define SYNTHETIC_DARK_LEVEL 12         //!< Mono16 black level, in counts
+#define SYNTHETIC_FULL_SCALE 4095       //!< Largest Mono16 value (12-bit sensor)
+#define SYNTHETIC_WL_EXPOSURE 60000     //!< WL exposure (us) at which the scene is rendered at its nominal brightness
+#define SYNTHETIC_NIR_EXPOSURE 500000   //!< NIR exposure (us) at which blobs reach SYNTHETIC_NIR_PEAK
+#define SYNTHETIC_NIR_PEAK 3000         //!< Blob peak above the black level at SYNTHETIC_NIR_EXPOSURE, in counts
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <framesource.h>
+
+class SyntheticCamera : public FrameSource
+{
+    Q_OBJECT
+public:
+
+    /**
+     * @brief Creates a synthetic WL (Bayer8) camera
+     *
+     * @param width Frame width in pixels
+     * @param height Frame height in pixels
+     * @param fps Frames per second, 0 to deliver frames as fast as they are generated
+     * @param parent Parent object (Defaults to no parent)
+     */
+    SyntheticCamera(unsigned int width, unsigned int height, double fps, QObject *parent = 0);
+
+    ~SyntheticCamera();
+
+    void captureSetup();
+    void captureEnd();
+    void SetMono16Bit();
+    bool isNearInfrared();
+    void setExposure(unsigned long exposure);
+    unsigned long getExposure();
+    bool setAttribute(const char* name, unsigned long value);
+    CaptureStatistics getStatistics();
+    unsigned long getFrameSize();
+    void setStreamBytesPerSecond(unsigned long bytesPerSecond);
+    void setTriggerMode(TriggerMode mode);
+
+    /**
+     * @brief Asks for factor x factor binning (NIR only)
+     *
+     * Binned pixels add up the charge of the pixels they cover, like the cameras', so
+     * they are factor^2 brighter, clipped at SYNTHETIC_FULL_SCALE.
+     */
+    bool setBinning(unsigned int factor);
+
+    unsigned int getBinning();
+
+    bool setCrop(const QRect &crop);
+
+public slots:
+
+    /**
+     * @brief Generates the next frame, waiting for its turn, and hands it out through frameReady()
+     */
+    void capture();
+
+private:
+
+    /**
+     * @brief Draws the NIR scene: black level, noise and blobs scaled by the exposure
+     */
+    void renderMono16(unsigned short* dst, double seconds);
+
+    /**
+     * @brief Sums factor x factor blocks of a full resolution Mono16 frame into dst
+     */
+    void binMono16(const unsigned short* src, unsigned short* dst, unsigned int factor);
+
+    /**
+     * @brief Draws the WL scene through an RGGB colour filter, scaled by the exposure
+     */
+    void renderBayer8(unsigned char* dst, double seconds);
+
+    /**
+     * @brief Works out where each blob is at a given time
+     */
+    void blobPositions(double seconds, int* x, int* y);
+
+    /**
+     * @brief xorshift32, cheap enough to run once per pixel
+     */
+    inline unsigned int nextRandom()
+    {
+        this->Random ^= this->Random << 13;
+        this->Random ^= this->Random >> 17;
+        this->Random ^= this->Random << 5;
+        return this->Random;
+    }
+
+    unsigned int    Width;              //!< Frame width in pixels
+    unsigned int    Height;             //!< Frame height in pixels
+    double          FPS;                //!< Frame rate, 0 for unthrottled
+    bool            Mono16;             //!< True for NIR frames
+    unsigned long   ExposureValue;      //!< Exposure of the frame being generated, in microseconds. Scales the brightness
+    unsigned long   PendingExposure;    //!< Exposure asked for by setExposure()
+    unsigned long   FrameSize;          //!< Bytes per frame at full resolution
+    unsigned int    Binning;            //!< Binning factor of the frames being generated
+    unsigned int    PendingBinning;     //!< Binning factor asked for by setBinning()
+    QVector<unsigned short> Unbinned;   //!< Full resolution frame, binned into the delivered one
+    unsigned long   FrameCount;         //!< Frame counter, 1 to 65535 like the cameras'
+    qint64          NextFrame;          //!< Host time (us) the next frame is due
+    unsigned int    Random;             //!< Noise generator state
+    bool            Stopped;            //!< Set by captureEnd()
+    FramePool*      Pool;               //!< Frame buffers. Created in captureSetup()
+    QVector<unsigned short> Sprite;     //!< Gaussian blob profile, 0 to 1024
+    QVector<unsigned char>  Scene;      //!< WL scene texture, one value per pixel
+    CaptureStatistics Statistics;       //!< Frame counters, see getStatistics()
+    QMutex          StatisticsMutex;    //!< Guards Statistics, PendingBinning and PendingExposure against other threads
+};
+
+#endif // SYNTHETICCAMERA_H
@@ -0,0 +1,336 @@
+#include "temporalfilter.h"
+#include "medianfilter.h"
+
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEMPORAL_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Weight of a pixel that differs from its average by difference levels
+ *
+ * The weight grows by slope per level above the motion threshold, until excess reaches cap.
+ * Every step fits 16 bits, so the SSE2 version works out the same numbers.
+ */
+static inline int motionWeight(int difference, int motion, int base, int slope, int cap)
+{
+    int excess = (difference > motion) ? difference - motion : 0;
+    if (excess > cap)
+        excess = cap;
+    int weight = base + excess*slope;
+    return (weight < TEMPORAL_WEIGHT_ONE) ? weight : TEMPORAL_WEIGHT_ONE;
+}
+
+/**
+ * @brief Moves count accumulators towards their new pixels, one pixel at a time
+ *
+ * acc + ((value << F) - acc)*w >> F is split into the whole levels and the fraction, so the
+ * products fit 32 bits for 12-bit data: (value - average)*w - (fraction*w >> F).
+ */
+static void averageScalar(const unsigned short* src, unsigned short* dst, unsigned int* acc, int count,
+                          int motion, int base, int slope, int cap)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int value = (src[i] < TEMPORAL_MAX_LEVEL) ? src[i] : TEMPORAL_MAX_LEVEL;
+        int average = acc[i] >> TEMPORAL_FRACTION_BITS;
+        int fraction = acc[i] & (TEMPORAL_WEIGHT_ONE - 1);
+        int difference = (value > average) ? value - average : average - value;
+        int weight = motionWeight(difference, motion, base, slope, cap);
+        acc[i] += (value - average)*weight - ((fraction*weight) >> TEMPORAL_FRACTION_BITS);
+        dst[i] = static_cast<unsigned short>((acc[i] + TEMPORAL_WEIGHT_ONE/2) >> TEMPORAL_FRACTION_BITS);
+    }
+}
+
+#if defined(TEMPORAL_SSE2)
+/**
+ * @brief Unsigned 16-bit minimum, which SSE2 lacks: a - (a - b saturated at 0)
+ */
+static inline __m128i minU16(__m128i a, __m128i b)
+{
+    return _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+/**
+ * @brief averageScalar() on 8 pixels at a time, the tail one at a time
+ *
+ * Levels, differences and weights are worked out in 16-bit lanes, the accumulators in two
+ * registers of four 32-bit lanes each. Levels are at most 4095, so packing with signed
+ * saturation never saturates.
+ */
+static void averageVector(const unsigned short* src, unsigned short* dst, unsigned int* acc, int count,
+                          int motion, int base, int slope, int cap)
+{
+    const __m128i max_level = _mm_set1_epi16(TEMPORAL_MAX_LEVEL);
+    const __m128i fraction_mask = _mm_set1_epi32(TEMPORAL_WEIGHT_ONE - 1);
+    const __m128i half = _mm_set1_epi32(TEMPORAL_WEIGHT_ONE/2);
+    const __m128i one = _mm_set1_epi16(TEMPORAL_WEIGHT_ONE);
+    const __m128i motion_v = _mm_set1_epi16(static_cast<short>(motion));
+    const __m128i base_v = _mm_set1_epi16(static_cast<short>(base));
+    const __m128i slope_v = _mm_set1_epi16(static_cast<short>(slope));
+    const __m128i cap_v = _mm_set1_epi16(static_cast<short>(cap));
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i value = minU16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), max_level);
+        __m128i acc_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i acc_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 4));
+
+        __m128i average = _mm_packs_epi32(_mm_srli_epi32(acc_low, TEMPORAL_FRACTION_BITS),
+                                          _mm_srli_epi32(acc_high, TEMPORAL_FRACTION_BITS));
+        __m128i fraction = _mm_packs_epi32(_mm_and_si128(acc_low, fraction_mask),
+                                           _mm_and_si128(acc_high, fraction_mask));
+
+        __m128i difference = _mm_or_si128(_mm_subs_epu16(value, average), _mm_subs_epu16(average, value));
+        __m128i excess = minU16(_mm_subs_epu16(difference, motion_v), cap_v);
+        __m128i weight = minU16(_mm_add_epi16(base_v, _mm_mullo_epi16(excess, slope_v)), one);
+
+        /// (value - average)*weight needs up to 21 bits, the low and high halves make the 32-bit products
+        __m128i step = _mm_sub_epi16(value, average);
+        __m128i step_low = _mm_mullo_epi16(step, weight);
+        __m128i step_high = _mm_mulhi_epi16(step, weight);
+        __m128i correction = _mm_srli_epi16(_mm_mullo_epi16(fraction, weight), TEMPORAL_FRACTION_BITS);
+
+        acc_low = _mm_add_epi32(acc_low, _mm_sub_epi32(_mm_unpacklo_epi16(step_low, step_high),
+                                                       _mm_unpacklo_epi16(correction, zero)));
+        acc_high = _mm_add_epi32(acc_high, _mm_sub_epi32(_mm_unpackhi_epi16(step_low, step_high),
+                                                         _mm_unpackhi_epi16(correction, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), acc_low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i + 4), acc_high);
+
+        __m128i out = _mm_packs_epi32(_mm_srli_epi32(_mm_add_epi32(acc_low, half), TEMPORAL_FRACTION_BITS),
+                                      _mm_srli_epi32(_mm_add_epi32(acc_high, half), TEMPORAL_FRACTION_BITS));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+    averageScalar(src + i, dst + i, acc + i, count - i, motion, base, slope, cap);
+}
+#else
+#define averageVector averageScalar
+#endif
+
+TemporalFilter::TemporalFilter()
+{
+    this->Width = 0;
+    this->Height = 0;
+    this->Exposure = 0;
+    this->Gain = 0;
+    this->Primed = false;
+    this->Weight = TEMPORAL_WEIGHT;
+    this->Motion = TEMPORAL_MOTION;
+    this->Vectorised = true;
+    this->Src = NULL;
+    this->Dst = NULL;
+}
+
+bool TemporalFilter::setWeights(int weight, int motion)
+{
+    if (weight < 1 || weight > TEMPORAL_WEIGHT_ONE || motion < 0 || motion > TEMPORAL_MAX_LEVEL)
+        return false;
+    this->Weight = weight;
+    this->Motion = motion;
+    return true;
+}
+
+void TemporalFilter::reset()
+{
+    this->Primed = false;
+}
+
+void TemporalFilter::apply(const unsigned short *src, unsigned short *dst, int width, int height,
+                           unsigned long exposure, unsigned long gain, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+
+    if (width != this->Width || height != this->Height || exposure != this->Exposure || gain != this->Gain)
+    {
+        this->Width = width;
+        this->Height = height;
+        this->Exposure = exposure;
+        this->Gain = gain;
+        this->Primed = false;
+    }
+    if (this->Accumulators.count() < width*height)
+        this->Accumulators.resize(width*height);
+
+    this->Src = src;
+    this->Dst = dst;
+    pool->parallelFor(KernelTemporal, *this, height, WorkerPool::stripeRows(width*6));
+    this->Primed = true;
+}
+
+void TemporalFilter::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    const unsigned short* src = this->Src + begin*this->Width;
+    unsigned short* dst = this->Dst + begin*this->Width;
+    unsigned int* acc = this->Accumulators.data() + begin*this->Width;
+    int count = (end - begin)*this->Width;
+
+    /// The first frame is the average so far
+    if (!this->Primed)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            unsigned short value = (src[i] < TEMPORAL_MAX_LEVEL) ? src[i] : TEMPORAL_MAX_LEVEL;
+            acc[i] = static_cast<unsigned int>(value) << TEMPORAL_FRACTION_BITS;
+            dst[i] = value;
+        }
+        return;
+    }
+
+    /// The weight reaches TEMPORAL_WEIGHT_ONE about Motion levels above the threshold
+    int motion = qMax(this->Motion, 1);
+    int slope = (TEMPORAL_WEIGHT_ONE - this->Weight + motion - 1) / motion;
+    int cap = (slope > 0) ? (TEMPORAL_WEIGHT_ONE - this->Weight + slope - 1) / slope : 0;
+    if (this->Vectorised)
+        averageVector(src, dst, acc, count, this->Motion, this->Weight, slope, cap);
+    else
+        averageScalar(src, dst, acc, count, this->Motion, this->Weight, slope, cap);
+}
+
+const char* TemporalFilter::instructionSet()
+{
+#if defined(TEMPORAL_SSE2)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+/**
+ * @brief Fills a frame like a NIR image of fine vessels: a dim background, a lit disc and thin bright lines
+ */
+static void benchmarkScene(unsigned short* scene, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int dx = x - width/2;
+            int dy = y - height/2;
+            bool lit = dx*dx + dy*dy < (height*height)/5;
+            bool vessel = (x % 12) < 2 || (y % 16) == 0;
+            scene[y*width + x] = static_cast<unsigned short>(200 + ((lit) ? 1200 : 0) + ((vessel) ? 600 : 0));
+        }
+    }
+}
+
+/**
+ * @brief Adds about 23 levels of noise to the scene, different every call
+ */
+static void benchmarkNoise(const unsigned short* scene, unsigned short* frame, int count, unsigned int &seed)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int noise = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            seed = seed*1103515245 + 12345;
+            noise += (seed >> 16) % 41;
+        }
+        frame[i] = static_cast<unsigned short>(scene[i] + noise - 80);
+    }
+}
+
+/**
+ * @brief Root mean square difference between a frame and the clean scene
+ *
+ * @param flat If not NULL, only pixels it marks are counted
+ */
+static double benchmarkError(const unsigned short* frame, const unsigned short* scene, const unsigned char* flat, int count)
+{
+    double sum = 0;
+    int counted = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (flat && !flat[i])
+            continue;
+        double difference = static_cast<double>(frame[i]) - scene[i];
+        sum += difference*difference;
+        counted++;
+    }
+    return (counted > 0) ? std::sqrt(sum / counted) : 0;
+}
+
+bool TemporalFilter::benchmark()
+{
+    bool exact = true;
+    int sizes[2][2] = {{640, 480}, {MEDIAN_BENCHMARK_WIDTH, MEDIAN_BENCHMARK_HEIGHT}};
+    WorkerPool pool(1);     //!< Both filters on one thread, so the cost per frame compares directly
+    std::cout << "Temporal filter, vectorised with " << instructionSet() << ", against the 7x7 median over "
+              << TEMPORAL_BENCHMARK_FRAMES << " frames" << std::endl;
+
+    for (int s = 0; s < 2; s++)
+    {
+        int width = sizes[s][0];
+        int height = sizes[s][1];
+        int count = width*height;
+        QVector<unsigned short> scene(count);
+        QVector<unsigned short> noisy(count);
+        QVector<unsigned short> median(count);
+        QVector<unsigned short> vector(count);
+        QVector<unsigned short> scalar(count);
+        benchmarkScene(scene.data(), width, height);
+        unsigned int seed = 12345;
+
+        /// Noise is compared where the scene is flat under the whole 7x7 window, so the median's blur doesn't count
+        QVector<unsigned char> flat(count);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                bool same = true;
+                for (int dy = -3; dy <= 3 && same; dy++)
+                    for (int dx = -3; dx <= 3 && same; dx++)
+                        same = scene[qBound(0, y + dy, height - 1)*width + qBound(0, x + dx, width - 1)] == scene[y*width + x];
+                flat[y*width + x] = same;
+            }
+        }
+
+        MedianFilter median_filter;
+        TemporalFilter temporal;
+        TemporalFilter plain;
+        plain.Vectorised = false;
+        QElapsedTimer clock;
+        qint64 median_ns = 0;
+        qint64 temporal_ns = 0;
+        for (int frame = 0; frame < TEMPORAL_BENCHMARK_FRAMES; frame++)
+        {
+            benchmarkNoise(scene.constData(), noisy.data(), count, seed);   //!< Not timed, only the filters are
+
+            clock.start();
+            median_filter.apply(noisy.constData(), median.data(), width, height, 7, &pool);
+            median_ns += clock.nsecsElapsed();
+
+            clock.start();
+            temporal.apply(noisy.constData(), vector.data(), width, height, 0, 0, &pool);
+            temporal_ns += clock.nsecsElapsed();
+
+            plain.apply(noisy.constData(), scalar.data(), width, height, 0, 0, &pool);
+            exact = exact && memcmp(vector.constData(), scalar.constData(), count*sizeof(unsigned short)) == 0;
+        }
+
+        double median_ms = median_ns / 1000000.0 / TEMPORAL_BENCHMARK_FRAMES;
+        double temporal_ms = temporal_ns / 1000000.0 / TEMPORAL_BENCHMARK_FRAMES;
+        std::cout << width << "x" << height << ", noise left on flat areas / error against the clean scene:" << std::endl;
+        std::cout << "  unfiltered: " << benchmarkError(noisy.constData(), scene.constData(), flat.constData(), count) << " / "
+                  << benchmarkError(noisy.constData(), scene.constData(), NULL, count) << " levels RMS" << std::endl;
+        std::cout << "  7x7 median (default): " << median_ms << " ms/frame, "
+                  << benchmarkError(median.constData(), scene.constData(), flat.constData(), count) << " / "
+                  << benchmarkError(median.constData(), scene.constData(), NULL, count) << " levels RMS" << std::endl;
+        std::cout << "  temporal, weight " << TEMPORAL_WEIGHT << "/" << TEMPORAL_WEIGHT_ONE << ": " << temporal_ms
+                  << " ms/frame, " << median_ms / temporal_ms << "x faster, "
+                  << benchmarkError(vector.constData(), scene.constData(), flat.constData(), count) << " / "
+                  << benchmarkError(vector.constData(), scene.constData(), NULL, count) << " levels RMS"
+                  << ((exact) ? "" : ", VECTORISED DIFFERS FROM PLAIN") << std::endl;
+    }
+    return exact;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The TemporalFilter class denoises the NIR camera's Mono16 frames over
+ * time instead of space, so fine fluorescence detail isn't blurred the
+ * way a spatial median blurs it.
+ *
+ * Every pixel keeps an exponential moving average of its values in a
+ * 32-bit accumulator, in fixed point with TEMPORAL_FRACTION_BITS bits
+ * below the level. Each frame moves the average towards the new value
+ * by a weight out of TEMPORAL_WEIGHT_ONE. Still pixels get the small
+ * base weight, so noise averages out over many frames; pixels that
+ * differ from their average by more than the motion threshold get a
+ * weight growing with the difference, up to the new value outright, so
+ * moving tissue doesn't leave a trail.
+ *
+ * Eight pixels are done at once with SSE2 on x86-64 builds, one at a
+ * time in plain C++ elsewhere; both give the same result. It is exact
+ * for 12-bit data, larger values are clipped to 4095.
+ *
+ * The averages only make sense for frames taken the same way, so they
+ * start over from the next frame when the exposure, gain or frame size
+ * changes, or after reset().
+ */
+
+#ifndef TEMPORALFILTER_H
+#define TEMPORALFILTER_H
+
+#define TEMPORAL_FRACTION_BITS 8        //!< Bits of the accumulators below the level, and of the weights
+#define TEMPORAL_WEIGHT_ONE (1 << TEMPORAL_FRACTION_BITS)   //!< Weight that replaces the average with the new value
+#define TEMPORAL_MAX_LEVEL 4095         //!< Largest level kept, 12-bit data
+#define TEMPORAL_WEIGHT 16              //!< Default base weight, 1/16: about the noise of a 7x7 median on still frames
+#define TEMPORAL_MOTION 96              //!< Default difference (levels) above which a pixel is taken as moving, 4x the noise benchmark() adds
+#define TEMPORAL_BENCHMARK_FRAMES 64    //!< Frames benchmark() runs, enough for the averages to settle
+
+#include <QVector>
+#include <workerpool.h>
+
+class TemporalFilter : public RowKernel
+{
+public:
+
+    TemporalFilter();
+
+    /**
+     * @brief Sets how strongly frames are averaged, from the next frame on
+     *
+     * Doesn't start the averages over.
+     *
+     * @param weight Base weight of a new frame, 1 to TEMPORAL_WEIGHT_ONE. Smaller removes more noise
+     * @param motion Difference in levels from the average above which the weight grows. Should be
+     *               a few times the noise of the frames
+     * @return false if either is out of range, nothing is changed then
+     */
+    bool setWeights(int weight, int motion);
+
+    /**
+     * @brief Starts the averages over with the next frame
+     */
+    void reset();
+
+    /**
+     * @brief Adds a frame to the averages and writes the averaged frame
+     *
+     * Rows are spread over a WorkerPool.
+     *
+     * @param src Frame to add
+     * @param dst Where the averaged frame goes, may be src
+     * @param width Width of the frame in pixels
+     * @param height Height of the frame in pixels
+     * @param exposure Exposure the frame was taken with, a change starts the averages over
+     * @param gain Gain the frame was taken with, a change starts the averages over
+     * @param pool Pool to spread the rows over, NULL for WorkerPool::shared()
+     */
+    void apply(const unsigned short* src, unsigned short* dst, int width, int height,
+               unsigned long exposure, unsigned long gain, WorkerPool* pool = NULL);
+
+    /**
+     * @brief Averages rows [begin, end) of the frame apply() was given, on one of the pool's threads
+     */
+    void rows(int begin, int end, int worker);
+
+    /**
+     * @brief Gets the instruction set the filter was built for: "SSE2" or "none"
+     */
+    static const char* instructionSet();
+
+    /**
+     * @brief Compares the filter with the default 7x7 median on a noisy scene with fine detail
+     *
+     * Prints the time per frame and the error left against the clean scene to std::cout,
+     * and checks the vectorised filter against the plain C++ one. Run with --benchmark-denoise.
+     *
+     * @return true if both versions gave the same frames
+     */
+    static bool benchmark();
+
+private:
+
+    QVector<unsigned int> Accumulators; //!< Average of each pixel, TEMPORAL_FRACTION_BITS below the level
+    int             Width;              //!< Size the averages were kept for
+    int             Height;
+    unsigned long   Exposure;           //!< Exposure the averages were kept for
+    unsigned long   Gain;               //!< Gain the averages were kept for
+    bool            Primed;             //!< False until a frame has been added since the last reset
+    int             Weight;             //!< Base weight, see setWeights()
+    int             Motion;             //!< Motion threshold, see setWeights()
+    bool            Vectorised;         //!< False forces the plain C++ version, for benchmark()
+    const unsigned short* Src;          //!< Frame apply() is adding
+    unsigned short* Dst;                //!< Where the averaged frame goes
+};
+
+#endif // TEMPORALFILTER_H
@@ -0,0 +1,232 @@
+#include "workerpool.h"
+
+static WorkerPool* SharedPool = NULL;   //!< Created by WorkerPool::shared()
+static int SharedWorkers = 0;           //!< Set by WorkerPool::setSharedWorkers()
+static QMutex SharedMutex;              //!< Guards SharedPool and SharedWorkers
+
+/**
+ * @brief Thread of the pool, runs WorkerPool::work()
+ */
+class WorkerThread : public QThread
+{
+public:
+    WorkerThread(WorkerPool* pool, int worker)
+    {
+        this->Pool = pool;
+        this->Worker = worker;
+    }
+
+protected:
+    void run()
+    {
+        this->Pool->work(this->Worker);
+    }
+
+private:
+    WorkerPool*     Pool;
+    int             Worker;
+};
+
+WorkerPool::WorkerPool(int workers)
+{
+    this->Body = NULL;
+    this->Owner = NULL;
+    this->Rows = 0;
+    this->Stripe = 1;
+    this->Stripes = 0;
+    this->Generation = 0;
+    this->Running = 0;
+    this->Quit = false;
+    for (int i = 0; i < KernelCount; i++)
+        this->Parallel[i] = true;
+
+    if (workers <= 0)
+        workers = QThread::idealThreadCount();
+    for (int i = 1; i < workers; i++)   //!< Worker 0 is the caller of parallelFor()
+    {
+        QThread* thread = new WorkerThread(this, i);
+        this->Threads.append(thread);
+        thread->start();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    this->Mutex.lock();
+    this->Quit = true;
+    this->Wake.wakeAll();
+    this->Mutex.unlock();
+    for (int i = 0; i < this->Threads.count(); i++)
+    {
+        this->Threads[i]->wait();
+        delete this->Threads[i];
+    }
+}
+
+WorkerPool* WorkerPool::shared()
+{
+    QMutexLocker locker(&SharedMutex);
+    if (!SharedPool)
+        SharedPool = new WorkerPool(SharedWorkers);
+    return SharedPool;
+}
+
+void WorkerPool::setSharedWorkers(int workers)
+{
+    QMutexLocker locker(&SharedMutex);
+    SharedWorkers = workers;
+}
+
+int WorkerPool::workers() const
+{
+    return this->Threads.count() + 1;
+}
+
+void WorkerPool::setParallel(ParallelKernel kernel, bool parallel)
+{
+    this->Parallel[kernel] = parallel;
+}
+
+bool WorkerPool::isParallel(ParallelKernel kernel) const
+{
+    return this->Parallel[kernel];
+}
+
+const char* WorkerPool::kernelName(ParallelKernel kernel)
+{
+    switch (kernel)
+    {
+    case KernelMedian:
+        return "median";
+    case KernelInterpolation:
+        return "interpolation";
+    case KernelBrightness:
+        return "brightness";
+    case KernelFalseColour:
+        return "falsecolour";
+    case KernelOverlay:
+        return "overlay";
+    case KernelMonochrome:
+        return "monochrome";
+    case KernelYuv:
+        return "yuv";
+    case KernelTemporal:
+        return "temporal";
+    case KernelBlend:
+        return "blend";
+    default:
+        return "";
+    }
+}
+
+int WorkerPool::stripeRows(int rowBytes)
+{
+    if (rowBytes <= 0)
+        return 1;
+    return qMax(1, WORKERPOOL_STRIPE_BYTES / rowBytes);
+}
+
+void WorkerPool::parallelFor(ParallelKernel kernel, RowKernel &body, int rows, int stripe)
+{
+    if (rows <= 0)
+        return;
+    stripe = qMax(1, stripe);
+
+    /// Serial kernels and single stripes run here and now
+    if (!this->Parallel[kernel] || this->Threads.isEmpty() || stripe >= rows)
+    {
+        body.rows(0, rows, 0);
+        return;
+    }
+
+    if (!this->Busy.tryLock())
+    {
+        /// Waiting for the frame this one was started from would never end
+        if (isSpreading())
+        {
+            this->Alone[kernel].ref();
+            body.rows(0, rows, 0);
+            return;
+        }
+
+        /// Another thread's frame is a few stripes from done, after which this one has every worker
+        this->Queued[kernel].ref();
+        this->Busy.lock();
+    }
+
+    this->Mutex.lock();
+    this->Owner = QThread::currentThread();
+    this->Body = &body;
+    this->Rows = rows;
+    this->Stripe = stripe;
+    this->Stripes = (rows + stripe - 1) / stripe;
+    this->Next.store(0);
+    this->Running = this->Threads.count();
+    this->Generation++;
+    this->Wake.wakeAll();
+    this->Mutex.unlock();
+
+    takeStripes(0);
+
+    /// Stripes taken by other threads may still be running
+    this->Mutex.lock();
+    while (this->Running > 0)
+        this->Done.wait(&this->Mutex);
+    this->Body = NULL;
+    this->Owner = NULL;
+    this->Mutex.unlock();
+    this->Busy.unlock();
+}
+
+int WorkerPool::queued(ParallelKernel kernel) const
+{
+    return this->Queued[kernel].load();
+}
+
+int WorkerPool::ranAlone(ParallelKernel kernel) const
+{
+    return this->Alone[kernel].load();
+}
+
+bool WorkerPool::isSpreading() const
+{
+    QThread* current = QThread::currentThread();
+    if (this->Threads.contains(current))
+        return true;
+    QMutexLocker locker(&this->Mutex);
+    return current == this->Owner;
+}
+
+void WorkerPool::work(int worker)
+{
+    int seen = 0;
+    this->Mutex.lock();
+    while (true)
+    {
+        while (this->Generation == seen && !this->Quit)
+            this->Wake.wait(&this->Mutex);
+        if (this->Quit)
+            break;
+        seen = this->Generation;
+        this->Mutex.unlock();
+
+        takeStripes(worker);
+
+        this->Mutex.lock();
+        if (--this->Running == 0)
+            this->Done.wakeAll();
+    }
+    this->Mutex.unlock();
+}
+
+void WorkerPool::takeStripes(int worker)
+{
+    while (true)
+    {
+        int stripe = this->Next.fetchAndAddOrdered(1);
+        if (stripe >= this->Stripes)
+            return;
+        int begin = stripe * this->Stripe;
+        this->Body->rows(begin, qMin(begin + this->Stripe, this->Rows), worker);
+    }
+}
@@ -0,0 +1,203 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The WorkerPool class spreads the pixel loops of a frame over every
+ * core. Its threads are started once and sleep between frames, so a
+ * frame doesn't pay for starting threads.
+ *
+ * parallelFor() cuts a frame into stripes of rows, small enough that a
+ * stripe's pixels stay in the core's cache, and the pool's threads and
+ * the calling thread take stripes until none are left. The loop itself
+ * is a RowKernel, which processes any range of rows it is handed.
+ *
+ * Only one frame is spread at a time. A thread that finds the pool busy
+ * (another camera's thread, say) waits its turn and then gets every worker,
+ * which is sooner than running its frame alone on one core would finish.
+ * Only a loop started from inside the frame being spread can't wait for
+ * it, and runs on its own thread. Both are counted, see queued() and
+ * ranAlone(). Each kind of loop can be kept serial with setParallel(), to
+ * compare or to leave cores free.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#define WORKERPOOL_STRIPE_BYTES 65536   //!< Bytes of source pixels in a stripe, about half an L2 cache
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+
+/**
+ * @brief Pixel loops that can be spread over the pool, see WorkerPool::setParallel()
+ */
+enum ParallelKernel
+{
+    KernelMedian,           //!< NIR median filter, MedianFilter
+    KernelInterpolation,    //!< Bayer to RGB interpolation of WL frames
+    KernelBrightness,       //!< Brightness and contrast of WL frames
+    KernelFalseColour,      //!< False colouring of NIR frames
+    KernelOverlay,          //!< Overlay transparency of the composite view
+    KernelMonochrome,       //!< Monochrome underlay of the composite view
+    KernelYuv,              //!< RGB to YUV conversion of recorded frames
+    KernelTemporal,         //!< NIR temporal filter, TemporalFilter
+    KernelBlend,            //!< Overlays blended into recorded composite frames
+    KernelCount
+};
+
+/**
+ * @brief A pixel loop that runs on any range of rows
+ */
+class RowKernel
+{
+public:
+    virtual ~RowKernel() {}
+
+    /**
+     * @brief Processes rows [begin, end)
+     *
+     * Runs on several threads at once, for different rows. Rows must not depend on
+     * each other.
+     *
+     * @param worker Index of the thread running it, 0 to WorkerPool::workers() - 1,
+     *               for kernels that need scratch memory of their own
+     */
+    virtual void rows(int begin, int end, int worker) = 0;
+};
+
+class WorkerPool
+{
+public:
+
+    /**
+     * @brief Starts the pool's threads
+     * @param workers Threads that run stripes, the calling thread included. 0 for one per core
+     */
+    explicit WorkerPool(int workers = 0);
+
+    /**
+     * @brief Stops the threads, once the frame they are on is done
+     */
+    ~WorkerPool();
+
+    /**
+     * @brief Gets the pool every pixel loop of the viewer shares
+     *
+     * Created on first use with the number of workers given to setSharedWorkers().
+     */
+    static WorkerPool* shared();
+
+    /**
+     * @brief Sets how many workers shared() starts with, 0 for one per core
+     *
+     * Only takes effect before the first call to shared().
+     */
+    static void setSharedWorkers(int workers);
+
+    /**
+     * @brief Gets the number of threads that run stripes, the calling thread included
+     */
+    int workers() const;
+
+    /**
+     * @brief Spreads a kind of loop over the pool, or keeps it on the calling thread
+     */
+    void setParallel(ParallelKernel kernel, bool parallel);
+
+    bool isParallel(ParallelKernel kernel) const;
+
+    /**
+     * @brief Gets the name of a kind of loop, as the Parallel/Serial setting spells it
+     */
+    static const char* kernelName(ParallelKernel kernel);
+
+    /**
+     * @brief Gets the number of rows whose pixels fit in WORKERPOOL_STRIPE_BYTES
+     * @param rowBytes Bytes a row of the kernel reads
+     */
+    static int stripeRows(int rowBytes);
+
+    /**
+     * @brief Runs a kernel on rows [0, rows), stripe by stripe, and returns once every row is done
+     *
+     * The kernel runs on the calling thread alone if its kind is kept serial or if the
+     * frame is a single stripe. If another frame is being spread, it waits for that frame,
+     * unless it was started from inside it.
+     *
+     * @param kernel Kind of loop, see setParallel()
+     * @param body Loop to run
+     * @param rows Rows of the frame
+     * @param stripe Rows handed out at a time, e.g. from stripeRows()
+     */
+    void parallelFor(ParallelKernel kernel, RowKernel &body, int rows, int stripe);
+
+    /**
+     * @brief Gets the number of frames of a kind of loop that waited for another frame to be spread
+     */
+    int queued(ParallelKernel kernel) const;
+
+    /**
+     * @brief Gets the number of frames of a kind of loop that found the pool busy and ran on one thread
+     *
+     * Only loops started from inside a frame being spread, by the kernel itself, end up here.
+     */
+    int ranAlone(ParallelKernel kernel) const;
+
+private:
+
+    friend class WorkerThread;
+
+    /**
+     * @brief Loop of each thread of the pool: sleeps until a frame is handed out, then takes stripes
+     */
+    void work(int worker);
+
+    /**
+     * @brief Takes stripes of the current frame until there are none left
+     */
+    void takeStripes(int worker);
+
+    /**
+     * @brief Checks if the calling thread is working on the frame being spread
+     */
+    bool isSpreading() const;
+
+    QVector<QThread*> Threads;          //!< Threads of the pool, worker 0 is whoever calls parallelFor()
+    QMutex          Busy;               //!< Held while a frame is spread
+    mutable QMutex  Mutex;              //!< Guards the frame being spread, Owner, Generation, Running and Quit
+    QThread*        Owner;              //!< Thread spreading the current frame, NULL between frames
+    QWaitCondition  Wake;               //!< Signalled when a frame is handed out, or to quit
+    QWaitCondition  Done;               //!< Signalled when the last thread leaves a frame
+    RowKernel*      Body;               //!< Kernel of the frame being spread
+    int             Rows;               //!< Rows of the frame being spread
+    int             Stripe;             //!< Rows per stripe of the frame being spread
+    int             Stripes;            //!< Stripes of the frame being spread
+    QAtomicInt      Next;               //!< Next stripe to take
+    int             Generation;         //!< Counts frames handed out, so a thread takes each one once
+    int             Running;            //!< Threads still on the current frame
+    bool            Quit;               //!< Set by the destructor
+    bool            Parallel[KernelCount];  //!< Kinds of loop spread over the pool
+    QAtomicInt      Queued[KernelCount];    //!< Frames of each kind that waited for the pool
+    QAtomicInt      Alone[KernelCount];     //!< Frames of each kind run on one thread as the pool was busy
+};
+
+#endif // WORKERPOOL_H
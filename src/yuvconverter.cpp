@@ -0,0 +1,116 @@
+#include "yuvconverter.h"
+#include "FFMPEGClass.h"
+
+#include <cstring>
+
+YuvConverter::YuvConverter()
+{
+    this->BandRows = 0;
+    this->Width = 0;
+    this->Height = 0;
+    this->Flags = 0;
+    this->Src = NULL;
+    this->SrcStride = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        this->Dst[i] = NULL;
+        this->DstStride[i] = 0;
+    }
+}
+
+YuvConverter::~YuvConverter()
+{
+    release();
+}
+
+void YuvConverter::release()
+{
+    for (int i = 0; i < this->Bands.count(); i++)
+        sws_freeContext(this->Bands[i].Context);
+    this->Bands.clear();
+}
+
+bool YuvConverter::convert(const uint8_t *src, int srcStride, uint8_t * const dst[], const int dstStride[],
+                           int width, int height, int flags, WorkerPool *pool)
+{
+    if (!pool)
+        pool = WorkerPool::shared();
+
+    /// One band per worker, so a serial kernel or a busy pool costs no more than one context would
+    int bands = (pool->isParallel(KernelYuv)) ? pool->workers() : 1;
+    int band_rows = ((height + bands - 1) / bands + YUV_BAND_MARGIN - 1) / YUV_BAND_MARGIN * YUV_BAND_MARGIN;
+    if (this->Bands.isEmpty() || width != this->Width || height != this->Height
+            || flags != this->Flags || band_rows != this->BandRows)
+    {
+        release();
+        this->Width = width;
+        this->Height = height;
+        this->Flags = flags;
+        this->BandRows = band_rows;
+        for (int top = 0; top < height; top += band_rows)
+        {
+            Band band;
+            band.Above = qMin(top, YUV_BAND_MARGIN);
+            band.Below = qMin(height - qMin(top + band_rows, height), YUV_BAND_MARGIN);
+            int rows = band.Above + qMin(band_rows, height - top) + band.Below;
+            band.Context = sws_getContext(width, rows, AV_PIX_FMT_RGB24, width, rows, AV_PIX_FMT_YUV420P,
+                                          flags, NULL, NULL, NULL);
+            if (!band.Context)
+            {
+                release();
+                return false;
+            }
+            if (band.Above > 0 || band.Below > 0)
+                band.Scratch.resize(width*rows + 2*((width + 1)/2)*(rows/2));
+            this->Bands.append(band);
+        }
+    }
+
+    this->Src = src;
+    this->SrcStride = srcStride;
+    for (int i = 0; i < 3; i++)
+    {
+        this->Dst[i] = dst[i];
+        this->DstStride[i] = dstStride[i];
+    }
+    pool->parallelFor(KernelYuv, *this, height, this->BandRows);
+    return true;
+}
+
+void YuvConverter::rows(int begin, int end, int worker)
+{
+    Q_UNUSED(worker);
+    for (int index = begin / this->BandRows; index * this->BandRows < end; index++)
+    {
+        Band &band = this->Bands[index];
+        int top = index * this->BandRows;
+        int band_rows = qMin(this->BandRows, this->Height - top);
+        int rows = band.Above + band_rows + band.Below;
+        const uint8_t* src[4] = {this->Src + (top - band.Above)*this->SrcStride, NULL, NULL, NULL};
+        int src_stride[4] = {this->SrcStride, 0, 0, 0};
+
+        if (band.Scratch.isEmpty())
+        {
+            uint8_t* dst[4] = {this->Dst[0] + top*this->DstStride[0],
+                               this->Dst[1] + (top/2)*this->DstStride[1],
+                               this->Dst[2] + (top/2)*this->DstStride[2], NULL};
+            int dst_stride[4] = {this->DstStride[0], this->DstStride[1], this->DstStride[2], 0};
+            sws_scale(band.Context, src, src_stride, 0, rows, dst, dst_stride);
+            continue;
+        }
+
+        /// The margins are converted into scratch, the rows belonging to the band are copied out
+        int chroma_width = (this->Width + 1)/2;
+        uint8_t* scratch[4] = {band.Scratch.data(), band.Scratch.data() + this->Width*rows,
+                               band.Scratch.data() + this->Width*rows + chroma_width*(rows/2), NULL};
+        int scratch_stride[4] = {this->Width, chroma_width, chroma_width, 0};
+        sws_scale(band.Context, src, src_stride, 0, rows, scratch, scratch_stride);
+
+        for (int y = 0; y < band_rows; y++)
+            memcpy(this->Dst[0] + (top + y)*this->DstStride[0], scratch[0] + (band.Above + y)*this->Width, this->Width);
+        for (int i = 1; i < 3; i++)
+            for (int y = 0; y < band_rows/2; y++)
+                memcpy(this->Dst[i] + (top/2 + y)*this->DstStride[i],
+                       scratch[i] + (band.Above/2 + y)*chroma_width, chroma_width);
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author  Michael Rossi <rossisantomauro.m@husky.neu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The YuvConverter class converts the RGB24 frames being recorded to the
+ * YUV 4:2:0 pictures the encoder takes, spread over a WorkerPool.
+ *
+ * A swscale context converts a whole frame at once, so the frame is cut
+ * into bands with a context each, one band per worker. Chroma is filtered
+ * across rows, so each band also converts YUV_BAND_MARGIN rows past its
+ * edges into scratch planes and keeps only its own rows. Bands start on a
+ * multiple of the margin, which keeps chroma rows and swscale's filter
+ * phase where a single whole-frame context has them, and the result is
+ * the same whatever the number of bands.
+ */
+
+#ifndef YUVCONVERTER_H
+#define YUVCONVERTER_H
+
+#define YUV_BAND_MARGIN 8   //!< Rows converted past a band's edges, more than the bicubic chroma filter reaches
+
+#include <QVector>
+#include <stdint.h>
+
+#include <workerpool.h>
+
+struct SwsContext;
+
+class YuvConverter : public RowKernel
+{
+public:
+    YuvConverter();
+
+    /**
+     * @brief Frees the swscale contexts
+     */
+    ~YuvConverter();
+
+    /**
+     * @brief Converts a frame
+     *
+     * The contexts are made on the first frame, and again when the size or the pool changes.
+     *
+     * @param src RGB24 plane
+     * @param srcStride Bytes per row of src
+     * @param dst Y, U and V planes
+     * @param dstStride Bytes per row of each plane
+     * @param width Width of the frame
+     * @param height Height of the frame, even
+     * @param flags swscale flags, e.g. SWS_BICUBIC
+     * @return false if swscale couldn't make a context
+     */
+    bool convert(const uint8_t* src, int srcStride, uint8_t* const dst[], const int dstStride[],
+                 int width, int height, int flags, WorkerPool* pool);
+
+    /**
+     * @brief Converts the bands of rows [begin, end)
+     */
+    void rows(int begin, int end, int worker);
+
+private:
+
+    /**
+     * @brief Frees every context
+     */
+    void release();
+
+    /**
+     * @brief A band's context and where its rows lie
+     */
+    struct Band
+    {
+        SwsContext*     Context;        //!< Converts Above + BandRows + Below rows
+        int             Above;          //!< Margin rows converted above the band
+        int             Below;          //!< Margin rows converted below the band
+        QVector<uint8_t> Scratch;       //!< Y, U and V planes of the whole context, empty without margins
+    };
+
+    QVector<Band>   Bands;          //!< Each band, for BandRows rows (fewer for the last)
+    int             BandRows;       //!< Rows per band, a multiple of YUV_BAND_MARGIN
+    int             Width;          //!< Size the contexts were made for
+    int             Height;
+    int             Flags;          //!< swscale flags the contexts were made with
+    const uint8_t*  Src;            //!< Frame being converted
+    int             SrcStride;
+    uint8_t*        Dst[3];
+    int             DstStride[3];
+};
+
+#endif // YUVCONVERTER_H